@@ -38,4 +38,11 @@ Fast UKF SSR updates may give dramatically incorrect results in case of adaptive
 */
 //#define YAFL_USE_FAST_UKF
 
+/*
+Use SIMD (SSE2/AVX2/AVX-512) versions of element-wise vector kernels,
+the kernel set is selected at run time by CPU feature detection.
+Works on x86 with GCC compatible compilers and double precision yaflFloat only.
+*/
+//#define YAFL_USE_SIMD
+
 #endif // YAFL_CONFIG_H
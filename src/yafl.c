@@ -37,132 +37,976 @@
 #define _NX  (self->Nx)
 #define _NZ  (self->Nz)
 
+#define _STATS (self->stats)
+
 /*=============================================================================
                                   Base UDEKF
 =============================================================================*/
 #define _JFX (((yaflEKFBaseSt *)self)->jf)
 #define _JHX (((yaflEKFBaseSt *)self)->jh)
+#define _JFS (((yaflEKFBaseSt *)self)->jfs)
+#define _JHS (((yaflEKFBaseSt *)self)->jhs)
+
+#define _FNNZ (((yaflEKFBaseSt *)self)->Fnnz)
+#define _FIDX (((yaflEKFBaseSt *)self)->Fidx)
+
+#define _HNNZ (((yaflEKFBaseSt *)self)->Hnnz)
+#define _HIDX (((yaflEKFBaseSt *)self)->Hidx)
 
 #define _HY  (((yaflEKFBaseSt *)self)->H)
 #define _W   (((yaflEKFBaseSt *)self)->W)
 #define _D   (((yaflEKFBaseSt *)self)->D)
 
-yaflStatusEn yafl_ekf_base_predict(yaflKalmanBaseSt * self)
+#define _PHI (((yaflEKFBaseSt *)self)->Phi)
+#define _ND  (((yaflEKFBaseSt *)self)->Nd)
+#define _FD  (((yaflEKFBaseSt *)self)->Fd)
+#define _UQD (((yaflEKFBaseSt *)self)->Uqd)
+#define _DQD (((yaflEKFBaseSt *)self)->Dqd)
+#define _UQS (((yaflEKFBaseSt *)self)->Uqs)
+#define _DQS (((yaflEKFBaseSt *)self)->Dqs)
+
+/*=============================================================================
+                              Update statistics
+=============================================================================*/
+static inline void _stats_reset(yaflKalmanStatsSt * st)
+{
+    if (st)
+    {
+        st->nis = 0.0;
+        st->ll  = 0.0;
+        st->n   = 0;
+    }
+}
+
+/*Adds a scalar update with innovation nu and innovation variance s*/
+static inline void _stats_add(yaflKalmanStatsSt * st, yaflFloat nu, \
+                              yaflFloat s)
+{
+    if (st)
+    {
+        yaflFloat e = nu * (nu / s);
+
+        st->nis += e;
+        st->ll  -= 0.5 * (YAFL_LOG_2PI + YAFL_LN(s) + e);
+        st->n++;
+    }
+}
+
+/*
+Computes w[:, nx:] = (I + S).dot(u), S values are in w[:, :nx],
+S row i nonzero element column indices are in idx[nx * i : nx * i + nnz[i]]
+*/
+static yaflStatusEn _sparse_set_fu(yaflInt nx, yaflFloat * w, yaflInt * nnz, \
+                                   yaflInt * idx, yaflFloat * u)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt nx2;
+    yaflInt i;
+
+    nx2 = 2 * nx;
+
+    /*w[:, nx:] = u*/
+    YAFL_TRY(status, yafl_math_bset_u(nx2, w + nx, nx, u));
+
+    /*w[:, nx:] += S.dot(u)*/
+    for (i = 0; i < nx; i++)
+    {
+        yaflFloat * wi;
+        yaflInt * idxi;
+        yaflInt m;
+
+        wi   = w + nx2 * i;
+        idxi = idx + nx * i;
+
+        for (m = 0; m < nnz[i]; m++)
+        {
+            yaflFloat sik;
+            yaflInt k;
+            yaflInt j;
+
+            k   = idxi[m];
+            sik = wi[k];
+
+            /*u[k, k] == 1, u[k, j] == u[k + ((j - 1) * j) / 2] for j > k*/
+            wi[nx + k] += sik;
+            for (j = k + 1; j < nx; j++)
+            {
+                wi[nx + j] += sik * u[k + ((j - 1) * j) / 2];
+            }
+        }
+    }
+    return status;
+}
+
+/*
+Computes Up, Dp from W = (***|FUp), common to all EKF like predicts,
+Q = uq * (dq * qn) * uq.T
+*/
+static inline yaflStatusEn _ekf_predict_mwgsu(yaflKalmanBaseSt * self, \
+                                              yaflFloat * uq,          \
+                                              yaflFloat * dq,          \
+                                              yaflFloat qn)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt i;
+    yaflInt nx2;
+
+    nx2 = _NX * 2;
+
+    YAFL_TRY(status, yafl_math_bset_u(nx2, _W, _NX, uq));
+    /* Now W = (Uq|FUp) */
+
+    /* D = concatenate([Dq * qn, Dp]) */
+    i = _NX*sizeof(yaflFloat);
+    YAFL_TRY(status, yafl_math_set_vxn(_NX, _D, dq, qn));
+    memcpy((void *)(_D + _NX), (void *)_DP, i);
+
+    /* Up, Dp = MWGSU(w, d)*/
+    YAFL_TRY(status, yafl_math_mwgsu(_NX, nx2, _UP, _DP, _W, _D));
+
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_ekf_base_predict(yaflKalmanBaseSt * self)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt nx2;
+
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(_UP,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_DP,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UQ,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_DQ,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_NX > 1, YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(_W,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_D,      YAFL_ST_INV_ARG_1);
+
+    YAFL_TRY(status, yafl_ekf_base_flush(self));
+
+    nx2 = _NX * 2;
+
+    /*Default f(x) = x*/
+    if (0 == _FX)
+    {
+        YAFL_CHECK(0 == _JFX, YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(0 == _JFS, YAFL_ST_INV_ARG_1);
+
+        /* F = I, so no need to build F and compute F.dot(Up) */
+        YAFL_TRY(status, YAFL_MATH_BSET_U(nx2, 0, _NX, _W, _NX, _UP));
+    }
+    else if (_JFS)
+    {
+        YAFL_CHECK(_FNNZ, YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(_FIDX, YAFL_ST_INV_ARG_1);
+
+        YAFL_TRY(status,  _FX(self, _X, _X));  /* x = f(x_old, ...) */
+        /* Place nonzeros of S(x, ...) = df/dx - I to W */
+        YAFL_TRY(status, _JFS(self, _W, _FNNZ, _FIDX, _X));
+        /* Now W = (S|***) */
+        YAFL_TRY(status, _sparse_set_fu(_NX, _W, _FNNZ, _FIDX, _UP));
+    }
+    else
+    {
+        //yaflFloat * x;
+
+        /*Must have some Jacobian function*/
+        YAFL_CHECK(_JFX, YAFL_ST_INV_ARG_1);
+
+        //x = self->x;
+        YAFL_TRY(status,  _FX(self, _X, _X));  /* x = f(x_old, ...) */
+        YAFL_TRY(status, _JFX(self, _W, _X));  /* Place F(x, ...)=df/dx to W  */
+
+        /* Now W = (F|***) */
+        YAFL_TRY(status, \
+                 YAFL_MATH_BSET_BU(nx2, 0, _NX, _W, _NX, _NX, nx2, 0, 0, _W, _UP));
+    }
+    /* Now W = (***|FUp) */
+    YAFL_TRY(status, _ekf_predict_mwgsu(self, _UQ, _DQ, 1.0));
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_ekf_base_predict_x(yaflKalmanBaseSt * self)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt nx2;
+    yaflInt i;
+
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(_X,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_NX > 1, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_W,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_PHI,    YAFL_ST_INV_ARG_1);
+
+    nx2 = _NX * 2;
+
+    /*
+    The first deferred predict sets Phi = F, the products
+    F.dot(Phi) are done from the second one only.
+    */
+    if (0 == _FX)
+    {
+        /*Default f(x) = x, F = I, so Phi does not change*/
+        YAFL_CHECK(0 == _JFX, YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(0 == _JFS, YAFL_ST_INV_ARG_1);
+
+        if (0 == _ND)
+        {
+            /* Phi = I */
+            memset((void *)_PHI, 0, _NX * _NX * sizeof(yaflFloat));
+            for (i = 0; i < _NX; i++)
+            {
+                _PHI[(_NX + 1) * i] = 1.0;
+            }
+        }
+    }
+    else if (_JFS)
+    {
+        YAFL_CHECK(_FNNZ, YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(_FIDX, YAFL_ST_INV_ARG_1);
+
+        YAFL_TRY(status,  _FX(self, _X, _X));  /* x = f(x_old, ...) */
+        /* Place nonzeros of S(x, ...) = df/dx - I to W */
+        YAFL_TRY(status, _JFS(self, _W, _FNNZ, _FIDX, _X));
+
+        /* Phi = (I + S).dot(Phi), O(nnz * nx) */
+        for (i = 0; i < _NX; i++)
+        {
+            yaflFloat * phii;
+            yaflFloat * wi;
+            yaflInt * idxi;
+            yaflInt m;
+
+            phii = _PHI + _NX * i;
+            wi   = _W + nx2 * i;
+            idxi = _FIDX + _NX * i;
+
+            if (0 == _ND)
+            {
+                /* Phi[i] = (I + S)[i] */
+                memset((void *)phii, 0, _NX * sizeof(yaflFloat));
+                phii[i] = 1.0;
+                for (m = 0; m < _FNNZ[i]; m++)
+                {
+                    phii[idxi[m]] += wi[idxi[m]];
+                }
+                continue;
+            }
+
+            /* W[i, nx:] = Phi[i] + S[i].dot(Phi) */
+            memcpy((void *)(wi + _NX), (void *)phii, _NX * sizeof(yaflFloat));
+            for (m = 0; m < _FNNZ[i]; m++)
+            {
+                YAFL_TRY(status, yafl_math_add_vxn(_NX, wi + _NX, \
+                                                   _PHI + _NX * idxi[m], \
+                                                   wi[idxi[m]]));
+            }
+        }
+    }
+    else
+    {
+        /*Must have some Jacobian function*/
+        YAFL_CHECK(_JFX, YAFL_ST_INV_ARG_1);
+
+        YAFL_TRY(status,  _FX(self, _X, _X));  /* x = f(x_old, ...) */
+        YAFL_TRY(status, _JFX(self, _W, _X));  /* Place F(x, ...)=df/dx to W  */
+
+        /* Phi = F.dot(Phi), zeros of F are skipped */
+        for (i = 0; i < _NX; i++)
+        {
+            yaflFloat * wi;
+            yaflInt k;
+
+            wi = _W + nx2 * i;
+
+            if (0 == _ND)
+            {
+                /* Phi[i] = F[i] */
+                memcpy((void *)(_PHI + _NX * i), (void *)wi, \
+                       _NX * sizeof(yaflFloat));
+                continue;
+            }
+
+            /* W[i, nx:] = F[i].dot(Phi) */
+            memset((void *)(wi + _NX), 0, _NX * sizeof(yaflFloat));
+            for (k = 0; k < _NX; k++)
+            {
+                if (0.0 != wi[k])
+                {
+                    YAFL_TRY(status, yafl_math_add_vxn(_NX, wi + _NX, \
+                                                       _PHI + _NX * k, wi[k]));
+                }
+            }
+        }
+    }
+
+    if (_FX && _ND)
+    {
+        /* Phi = W[:, nx:] */
+        for (i = 0; i < _NX; i++)
+        {
+            memcpy((void *)(_PHI + _NX * i), (void *)(_W + nx2 * i + _NX), \
+                   _NX * sizeof(yaflFloat));
+        }
+    }
+
+    _ND++;
+
+    if (_FD && (1 == _ND))
+    {
+        /*Phi == F now, it is saved for exact Q fold*/
+        memcpy((void *)_FD, (void *)_PHI, _NX * _NX * sizeof(yaflFloat));
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_ekf_base_flush(yaflKalmanBaseSt * self)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt nd;
+
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+
+    if (0 == _ND)
+    {
+        return status;
+    }
+
+    YAFL_CHECK(_UP,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_DP,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UQ,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_DQ,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_W,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_D,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_PHI,    YAFL_ST_INV_ARG_1);
+
+    nd  = _ND;
+    _ND = 0;
+
+    if (_FD && (nd > 1))
+    {
+        YAFL_CHECK(_UQD, YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(_DQD, YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(_UQS, YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(_DQS, YAFL_ST_INV_ARG_1);
+
+        /* Phi, Qd = F**Nd, sum(F**j Q F**j.T, j < Nd), Fd is destroyed */
+        memcpy((void *)_UQS, (void *)_UQ, YAFL_U_SZ(_NX) * sizeof(yaflFloat));
+        memcpy((void *)_DQS, (void *)_DQ, _NX * sizeof(yaflFloat));
+        YAFL_TRY(status, yafl_ekf_base_fq_pow(self, nd, _FD, _UQS, _DQS, \
+                                              _PHI, _UQD, _DQD));
+
+        /* W = (***|Phi.dot(Up)) */
+        YAFL_TRY(status, \
+                 YAFL_MATH_BSET_MU(2 * _NX, 0, _NX, _W, _NX, _NX, _PHI, _UP));
+        YAFL_TRY(status, _ekf_predict_mwgsu(self, _UQD, _DQD, 1.0));
+        return status;
+    }
+
+    /* W = (***|Phi.dot(Up)) */
+    YAFL_TRY(status, \
+             YAFL_MATH_BSET_MU(2 * _NX, 0, _NX, _W, _NX, _NX, _PHI, _UP));
+
+    /* Intermediate Q are folded as Nd * Q */
+    YAFL_TRY(status, _ekf_predict_mwgsu(self, _UQ, _DQ, (yaflFloat)nd));
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_ekf_base_predict_n(yaflKalmanBaseSt * self, yaflInt k)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt i;
+
+    YAFL_CHECK(self,  YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(k > 0, YAFL_ST_INV_ARG_2);
+
+    if (_PHI)
+    {
+        for (i = 0; i < k; i++)
+        {
+            YAFL_TRY(status, yafl_ekf_base_predict_x(self));
+        }
+        YAFL_TRY(status, yafl_ekf_base_flush(self));
+    }
+    else
+    {
+        for (i = 0; i < k; i++)
+        {
+            YAFL_TRY(status, yafl_ekf_base_predict(self));
+        }
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+/*
+Computes transition and process noise of a steps then b steps:
+fa = fb.dot(fa), Qa = fb.dot(Qa).dot(fb.T) + Qb, fb may be fa
+*/
+static yaflStatusEn _fq_combine(yaflKalmanBaseSt * self,                          \
+                                yaflFloat * fa, yaflFloat * uqa, yaflFloat * dqa, \
+                                yaflFloat * fb, yaflFloat * uqb, yaflFloat * dqb)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt nx2;
+    yaflInt i;
+
+    nx2 = _NX * 2;
+
+    /* W = (Uqb|fb.dot(Uqa)), D = concatenate([Dqb, Dqa]) */
+    YAFL_TRY(status, yafl_math_bset_u(nx2, _W, _NX, uqb));
+    YAFL_TRY(status, YAFL_MATH_BSET_MU(nx2, 0, _NX, _W, _NX, _NX, fb, uqa));
+
+    i = _NX * sizeof(yaflFloat);
+    memcpy((void *)       _D, (void *)dqb, i);
+    memcpy((void *)(_D + _NX), (void *)dqa, i);
+
+    YAFL_TRY(status, yafl_math_mwgsu(_NX, nx2, uqa, dqa, _W, _D));
+
+    /* W is free now */
+    YAFL_TRY(status, yafl_math_set_mm(_NX, _NX, _NX, _W, fb, fa));
+    memcpy((void *)fa, (void *)_W, _NX * i);
+
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_ekf_base_fq_pow(yaflKalmanBaseSt * self, yaflInt k,               \
+                                  yaflFloat * fa, yaflFloat * uqa, yaflFloat * dqa, \
+                                  yaflFloat * fk, yaflFloat * uqk, yaflFloat * dqk)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt first = 1;
+    yaflInt nu;
+    yaflInt m;
+
+    YAFL_CHECK(self,    YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_NX > 1, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_W,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_D,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(k > 0,   YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(fa,      YAFL_ST_INV_ARG_3);
+    YAFL_CHECK(uqa,     YAFL_ST_INV_ARG_4);
+    YAFL_CHECK(dqa,     YAFL_ST_INV_ARG_5);
+    YAFL_CHECK(fk,      YAFL_ST_INV_ARG_6);
+    YAFL_CHECK(uqk,     YAFL_ST_INV_ARG_7);
+    YAFL_CHECK(dqk,     YAFL_ST_INV_ARG_8);
+
+    nu = ((_NX - 1) * _NX) / 2;
+
+    for (m = k; m; m >>= 1)
+    {
+        if (m & 1)
+        {
+            if (first)
+            {
+                memcpy((void *)fk,  (void *)fa,  _NX * _NX * sizeof(yaflFloat));
+                memcpy((void *)uqk, (void *)uqa, nu * sizeof(yaflFloat));
+                memcpy((void *)dqk, (void *)dqa, _NX * sizeof(yaflFloat));
+                first = 0;
+            }
+            else
+            {
+                YAFL_TRY(status, _fq_combine(self, fk, uqk, dqk, \
+                                             fa, uqa, dqa));
+            }
+        }
+
+        if (m > 1)
+        {
+            /* (Fa, Qa) = (Fa**2, Q(2 * a)) */
+            YAFL_TRY(status, _fq_combine(self, fa, uqa, dqa, \
+                                         fa, uqa, dqa));
+        }
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+/*
+Merges ascending index list b into ascending index list a in place,
+a must have room for the union.
+*/
+static inline yaflInt _idx_merge(yaflInt * a, yaflInt na, yaflInt * b, yaflInt nb)
+{
+    yaflInt ia;
+    yaflInt ib;
+    yaflInt n;
+
+    /*Count the union size*/
+    for (n = na, ia = 0, ib = 0; ib < nb; )
+    {
+        if ((ia < na) && (a[ia] < b[ib]))
+        {
+            ia++;
+        }
+        else
+        {
+            n += (ia >= na) || (a[ia] != b[ib]);
+            ia += (ia < na) && (a[ia] == b[ib]);
+            ib++;
+        }
+    }
+
+    /*Merge from the end*/
+    for (ia = na - 1, ib = nb - 1, na = n - 1; ib >= 0; na--)
+    {
+        if ((ia >= 0) && (a[ia] >= b[ib]))
+        {
+            ib -= (a[ia] == b[ib]);
+            a[na] = a[ia--];
+        }
+        else
+        {
+            a[na] = b[ib--];
+        }
+    }
+    return n;
+}
+
+/*Sparse version of yafl_math_rum: res = linalg.inv(u).dot(res)*/
+static yaflStatusEn _sparse_rum(yaflInt nr, yaflInt nc, yaflFloat * res, \
+                                yaflInt * nnz, yaflInt * idx, yaflFloat * u)
+{
+    yaflInt j;
+    yaflInt nrj;
+
+    for (j = nr - 1, nrj = ((j - 1) * j) / 2; j > 0; nrj -= --j)
+    {
+        yaflInt * idxj;
+        yaflFloat * resj;
+        yaflInt i;
+
+        idxj = idx + nc * j;
+        resj = res + nc * j;
+
+        for (i = j - 1; i >= 0; i--)
+        {
+            yaflFloat * resi;
+            yaflFloat uij;
+            yaflInt k;
+
+            uij = u[i + nrj];
+            if (0.0 == uij)
+            {
+                continue;
+            }
+
+            resi = res + nc * i;
+            for (k = 0; k < nnz[j]; k++)
+            {
+                resi[idxj[k]] -= uij * resj[idxj[k]];
+            }
+            nnz[i] = _idx_merge(idx + nc * i, nnz[i], idxj, nnz[j]);
+        }
+    }
+    return YAFL_ST_OK;
+}
+
+/*Sparse version of yafl_math_set_vtu: res = h.T.dot(u)*/
+static inline yaflStatusEn _sparse_set_vtu(yaflInt sz, yaflFloat * res,    \
+                                           yaflFloat * h, yaflInt nnz,     \
+                                           yaflInt * idx, yaflFloat * u)
+{
+    yaflInt k;
+    yaflInt k0;
+    yaflInt szk;
+
+    k0 = nnz ? idx[0] : sz;
+    for (k = 0; k < k0; k++)
+    {
+        res[k] = 0.0;
+    }
+
+    for (k = k0, szk = ((k - 1) * k) / 2; k < sz; szk += k++)
+    {
+        yaflFloat resk;
+        yaflInt m;
+
+        /*u[j, k] == u[j + szk] for j < k*/
+        resk = h[k];
+        for (m = 0; (m < nnz) && (idx[m] < k); m++)
+        {
+            resk += h[idx[m]] * u[idx[m] + szk];
+        }
+        res[k] = resk;
+    }
+    return YAFL_ST_OK;
+}
+
+/*f = h.dot(Up), h is the row i of H*/
+static inline yaflStatusEn _ekf_set_f(yaflKalmanBaseSt * self, yaflFloat * f, \
+                                      yaflFloat * h, yaflInt i)
+{
+    if (_JHS)
+    {
+        return _sparse_set_vtu(_NX, f, h, _HNNZ[i], _HIDX + _NX * i, _UP);
+    }
+    return yafl_math_set_vtu(_NX, f, h, _UP);
+}
+
+/*Does all scalar updates, see below*/
+static yaflStatusEn _ekf_scalar_updates(yaflKalmanBaseSt * self, \
+                                        yaflKalmanScalarUpdateP scalar_update);
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_ekf_base_update(yaflKalmanBaseSt * self, yaflFloat * z, yaflKalmanScalarUpdateP scalar_update)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt j;
+
+    YAFL_CHECK(self,   YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_HX,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_X,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_Y,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UR,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_NX > 1, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_NZ > 0, YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(_JHX || _JHS, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_HY,     YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(z,      YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(scalar_update, YAFL_ST_INV_ARG_3);
+
+    YAFL_TRY(status, yafl_ekf_base_flush(self));
+
+    _stats_reset(_STATS);
+
+    YAFL_TRY(status,  _HX(self, _Y,  _X)); /* self.y =  h(x,...) */
+
+    if (_JHS)
+    {
+        YAFL_CHECK(_HNNZ, YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(_HIDX, YAFL_ST_INV_ARG_1);
+
+        /* self.H = jhs(x,...), only nonzero elements are written */
+        memset((void *)_HY, 0, _NZ * _NX * sizeof(yaflFloat));
+        YAFL_TRY(status, _JHS(self, _HY, _HNNZ, _HIDX, _X));
+    }
+    else
+    {
+        YAFL_TRY(status, _JHX(self, _HY, _X)); /* self.H = jh(x,...) */
+    }
+
+    if (0 == _ZRF)
+    {
+        /*Default residual*/
+        for (j = 0; j < _NZ; j++)
+        {
+            _Y[j] = z[j] - _Y[j];
+        }
+    }
+    else
+    {
+        /*zrf must be aware of self internal structure*/
+        YAFL_TRY(status, _ZRF(self, _Y, z, _Y)); /* self.y = zrf(z, h(x,...)) */
+    }
+
+    /* Decorrelate measurement noise */
+
+    YAFL_TRY(status, yafl_math_ruv(_NZ,      _Y,  _UR));
+    if (_JHS)
+    {
+        YAFL_TRY(status, _sparse_rum(_NZ, _NX, _HY, _HNNZ, _HIDX, _UR));
+    }
+    else
+    {
+        YAFL_TRY(status, yafl_math_rum(_NZ, _NX, _HY, _UR));
+    }
+
+    /* Do scalar updates */
+    YAFL_TRY(status, _ekf_scalar_updates(self, scalar_update));
+
+    return status;
+}
+
+/*=============================================================================
+                                   Gating
+=============================================================================*/
+/* H = jh(x), dense or sparse */
+static inline yaflStatusEn _ekf_set_h(yaflKalmanBaseSt * self, yaflFloat * x)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+
+    if (_JHS)
+    {
+        YAFL_CHECK(_HNNZ, YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(_HIDX, YAFL_ST_INV_ARG_1);
+
+        memset((void *)_HY, 0, _NZ * _NX * sizeof(yaflFloat));
+        YAFL_TRY(status, _JHS(self, _HY, _HNNZ, _HIDX, x));
+    }
+    else
+    {
+        YAFL_TRY(status, _JHX(self, _HY, x)); /* self.H = jh(x,...) */
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_ekf_base_innov_ud(yaflKalmanBaseSt * self, yaflFloat * x, \
+                                    yaflFloat * up, yaflFloat * dp,         \
+                                    yaflFloat * zp, yaflFloat * us,         \
+                                    yaflFloat * ds)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt nc;
+
+    YAFL_CHECK(self,         YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UR,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_DR,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_NX > 1,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_NZ > 0,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_NZ <= _NX,   YAFL_ST_INV_ARG_1); /*Scratchpad size limit*/
+    YAFL_CHECK(_JHX || _JHS, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_HY,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_W,           YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_D,           YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(x,            YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(up,           YAFL_ST_INV_ARG_3);
+    YAFL_CHECK(dp,           YAFL_ST_INV_ARG_4);
+    YAFL_CHECK(us,           YAFL_ST_INV_ARG_6);
+    YAFL_CHECK(ds,           YAFL_ST_INV_ARG_7);
+
+    if (zp)
+    {
+        YAFL_CHECK(_HX,      YAFL_ST_INV_ARG_1);
+    }
+
+    YAFL_TRY(status, _ekf_set_h(self, x));
+
+    /*
+    W = (H.dot(Up)|Ur), D = (Dp, Dr), so
+    S = W.dot(diag(D)).dot(W.T) = Us.dot(diag(Ds)).dot(Us.T)
+    */
+    nc = _NX + _NZ;
+    YAFL_TRY(status, YAFL_MATH_BSET_MU(nc, 0, 0, _W, _NZ, _NX, _HY, up));
+    YAFL_TRY(status, YAFL_MATH_BSET_U(nc, 0, _NX, _W, _NZ, _UR));
+
+    memcpy((void *)_D,         (void *)dp,  _NX * sizeof(yaflFloat));
+    memcpy((void *)(_D + _NX), (void *)_DR, _NZ * sizeof(yaflFloat));
+
+    YAFL_TRY(status, yafl_math_mwgsu(_NZ, nc, us, ds, _W, _D));
+
+    if (zp)
+    {
+        /*W and D are free now*/
+        YAFL_TRY(status, _HX(self, zp, x)); /* zp = h(x,...) */
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+/* H = H.dot(m), m is nx x nx, D is used as row scratch */
+static inline yaflStatusEn _ekf_h_dot(yaflKalmanBaseSt * self, yaflFloat * m)
 {
     yaflStatusEn status = YAFL_ST_OK;
     yaflInt i;
-    yaflInt nx2;
 
-    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    for (i = 0; i < _NZ; i++)
+    {
+        yaflFloat * hi = _HY + _NX * i;
 
-    YAFL_CHECK(_UP,     YAFL_ST_INV_ARG_1);
-    YAFL_CHECK(_DP,     YAFL_ST_INV_ARG_1);
-    YAFL_CHECK(_UQ,     YAFL_ST_INV_ARG_1);
-    YAFL_CHECK(_DQ,     YAFL_ST_INV_ARG_1);
-    YAFL_CHECK(_NX > 1, YAFL_ST_INV_ARG_1);
+        YAFL_TRY(status, yafl_math_set_vtm(_NX, _NX, _D, hi, m));
+        memcpy((void *)hi, (void *)_D, _NX * sizeof(yaflFloat));
+    }
+    return status;
+}
 
-    YAFL_CHECK(_W,      YAFL_ST_INV_ARG_1);
-    YAFL_CHECK(_D,      YAFL_ST_INV_ARG_1);
+/*
+Innovation covariance of the deferred covariance state without flush:
+P = Phi.dot(Pd).dot(Phi.T) + Qd, Pd = Up.dot(diag(Dp)).dot(Up.T) and Qd is
+folded the same way as yafl_ekf_base_flush does, so Up, Dp, Nd, Phi and Fd
+are not changed. H = jh(x) is clobbered, W and D are used as scratchpad.
+*/
+static yaflStatusEn _ekf_innov_ud_deferred(yaflKalmanBaseSt * self, \
+                                           yaflFloat * us, yaflFloat * ds)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt nz;
+    yaflInt nx;
+    yaflInt nc;
+    yaflInt j;
 
-    nx2 = _NX * 2;
+    YAFL_CHECK(_UQ,  YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_DQ,  YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_PHI, YAFL_ST_INV_ARG_1);
 
-    /*Default f(x) = x*/
-    if (0 == _FX)
+    nz = _NZ;
+    nx = _NX;
+
+    YAFL_TRY(status, _ekf_set_h(self, _X));
+
+    if (_FD && (_ND > 1))
     {
-        YAFL_CHECK(0 == _JFX, YAFL_ST_INV_ARG_1);
+        /*
+        Exact fold: Qd = sum(F**j Q F**j.T, j < Nd), Phi = F**Nd, so
+        S = R + sum((H F**j Uq) Dq (H F**j Uq).T) + (H Phi Up) Dp (H Phi Up).T
+        is accumulated in Uqd, Dqd (they are flush scratch),
+        costs O(Nd * nz * nx**2).
+        */
+        YAFL_CHECK(_UQD, YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(_DQD, YAFL_ST_INV_ARG_1);
 
-        for (i = 0; i < _NX; i++)
+        memcpy((void *)_UQD, (void *)_UR, YAFL_U_SZ(nz) * sizeof(yaflFloat));
+        memcpy((void *)_DQD, (void *)_DR, nz * sizeof(yaflFloat));
+
+        nc = nz + nx;
+        for (j = 0; j < _ND; j++)
         {
-            yaflInt j;
-            yaflInt nci;
+            /* W = (Us|H.dot(Uq)), D = (Ds, Dq) */
+            YAFL_TRY(status, YAFL_MATH_BSET_U(nc, 0, 0, _W, nz, _UQD));
+            YAFL_TRY(status, YAFL_MATH_BSET_MU(nc, 0, nz, _W, nz, nx, _HY, _UQ));
 
-            nci = nx2 * i;
-            for (j = 0; j < _NX; j++)
-            {
-                _W[nci + j] = (i != j) ? 0.0 : 1.0;
-            }
+            memcpy((void *)_D,        (void *)_DQD, nz * sizeof(yaflFloat));
+            memcpy((void *)(_D + nz), (void *)_DQ,  nx * sizeof(yaflFloat));
+
+            YAFL_TRY(status, yafl_math_mwgsu(nz, nc, _UQD, _DQD, _W, _D));
+
+            /* H = H.dot(F) */
+            YAFL_TRY(status, _ekf_h_dot(self, _FD));
         }
-    }
-    else
-    {
-        //yaflFloat * x;
 
-        /*Must have some Jacobian function*/
-        YAFL_CHECK(_JFX, YAFL_ST_INV_ARG_1);
+        /* W = (Us|H.dot(Up)), D = (Ds, Dp), H = H.dot(F**Nd) now */
+        YAFL_TRY(status, YAFL_MATH_BSET_U(nc, 0, 0, _W, nz, _UQD));
+        YAFL_TRY(status, YAFL_MATH_BSET_MU(nc, 0, nz, _W, nz, nx, _HY, _UP));
 
-        //x = self->x;
-        YAFL_TRY(status,  _FX(self, _X, _X));  /* x = f(x_old, ...) */
-        YAFL_TRY(status, _JFX(self, _W, _X));  /* Place F(x, ...)=df/dx to W  */
+        memcpy((void *)_D,        (void *)_DQD, nz * sizeof(yaflFloat));
+        memcpy((void *)(_D + nz), (void *)_DP,  nx * sizeof(yaflFloat));
+
+        YAFL_TRY(status, yafl_math_mwgsu(nz, nc, us, ds, _W, _D));
+        return status;
     }
-    /* Now W = (F|***) */
-    YAFL_TRY(status, \
-             YAFL_MATH_BSET_BU(nx2, 0, _NX, _W, _NX, _NX, nx2, 0, 0, _W, _UP));
-    /* Now W = (F|FUp) */
-    YAFL_TRY(status, yafl_math_bset_u(nx2, _W, _NX, _UQ));
-    /* Now W = (Uq|FUp) */
 
-    /* D = concatenate([Dq, Dp]) */
-    i = _NX*sizeof(yaflFloat);
-    memcpy((void *)       _D, (void *)_DQ, i);
-    memcpy((void *)(_D + _NX), (void *)_DP, i);
+    /*
+    Default fold: Qd = Nd * Q, first
+    W = (H.dot(Phi).dot(Up)|H.dot(Uq)), D = (Dp, Nd * Dq)
+    */
+    nc = 2 * nx;
+    YAFL_TRY(status, YAFL_MATH_BSET_MU(nc, 0, nx, _W, nz, nx, _HY, _UQ));
+    YAFL_TRY(status, _ekf_h_dot(self, _PHI));
+    YAFL_TRY(status, YAFL_MATH_BSET_MU(nc, 0, 0, _W, nz, nx, _HY, _UP));
 
-    /* Up, Dp = MWGSU(w, d)*/
-    YAFL_TRY(status, yafl_math_mwgsu(_NX, nx2, _UP, _DP, _W, _D));
+    memcpy((void *)_D, (void *)_DP, nx * sizeof(yaflFloat));
+    YAFL_TRY(status, yafl_math_set_vxn(nx, _D + nx, _DQ, (yaflFloat)_ND));
 
+    YAFL_TRY(status, yafl_math_mwgsu(nz, nc, us, ds, _W, _D));
+
+    /* Then W = (Us|Ur), D = (Ds, Dr), W and D hold copies of us, ds */
+    nc = 2 * nz;
+    YAFL_TRY(status, YAFL_MATH_BSET_U(nc, 0, 0,  _W, nz, us));
+    YAFL_TRY(status, YAFL_MATH_BSET_U(nc, 0, nz, _W, nz, _UR));
+
+    memcpy((void *)_D,        (void *)ds,  nz * sizeof(yaflFloat));
+    memcpy((void *)(_D + nz), (void *)_DR, nz * sizeof(yaflFloat));
+
+    YAFL_TRY(status, yafl_math_mwgsu(nz, nc, us, ds, _W, _D));
     return status;
 }
 
 /*---------------------------------------------------------------------------*/
-yaflStatusEn yafl_ekf_base_update(yaflKalmanBaseSt * self, yaflFloat * z, yaflKalmanScalarUpdateP scalar_update)
+/*
+d2[k] = y.dot(linalg.inv(S)).dot(y.T), y = rf(z[k], zp), S = Us.dot(Ds).dot(Us.T),
+costs O(nz**2) per candidate, r is nz scratch vector.
+*/
+static yaflStatusEn _gate_d2(yaflKalmanBaseSt * self, yaflInt nz,  \
+                             yaflKalmanResFuncP rf, yaflFloat * z, \
+                             yaflInt n, yaflFloat * d2,            \
+                             yaflFloat * zp, yaflFloat * us,       \
+                             yaflFloat * ds, yaflFloat * r)
 {
     yaflStatusEn status = YAFL_ST_OK;
-    yaflInt j;
-
-    YAFL_CHECK(self,   YAFL_ST_INV_ARG_1);
-    YAFL_CHECK(_HX,     YAFL_ST_INV_ARG_1);
-    YAFL_CHECK(_X,      YAFL_ST_INV_ARG_1);
-    YAFL_CHECK(_Y,      YAFL_ST_INV_ARG_1);
-    YAFL_CHECK(_UR,     YAFL_ST_INV_ARG_1);
-    YAFL_CHECK(_NX > 1, YAFL_ST_INV_ARG_1);
-    YAFL_CHECK(_NZ > 0, YAFL_ST_INV_ARG_1);
-
-    YAFL_CHECK(_JHX,    YAFL_ST_INV_ARG_1);
-    YAFL_CHECK(_HY,     YAFL_ST_INV_ARG_1);
+    yaflInt k;
 
-    YAFL_CHECK(z,      YAFL_ST_INV_ARG_2);
-    YAFL_CHECK(scalar_update, YAFL_ST_INV_ARG_3);
+    for (k = 0; k < n; k++)
+    {
+        yaflFloat * zk = z + nz * k;
+        yaflFloat md = 0.0;
+        yaflInt j;
 
+        if (rf)
+        {
+            /*rf must be aware of self internal structure*/
+            YAFL_TRY(status, rf(self, r, zk, zp));
+        }
+        else
+        {
+            for (j = 0; j < nz; j++)
+            {
+                r[j] = zk[j] - zp[j];
+            }
+        }
 
-    YAFL_TRY(status,  _HX(self, _Y,  _X)); /* self.y =  h(x,...) */
-    YAFL_TRY(status, _JHX(self, _HY, _X)); /* self.H = jh(x,...) */
+        /* r = linalg.inv(Us).dot(r) */
+        YAFL_TRY(status, yafl_math_ruv(nz, r, us));
 
-    if (0 == _ZRF)
-    {
-        /*Default residual*/
-        for (j = 0; j < _NZ; j++)
+        for (j = 0; j < nz; j++)
         {
-            _Y[j] = z[j] - _Y[j];
+            md += r[j] * (r[j] / ds[j]);
         }
+        d2[k] = md;
     }
-    else
-    {
-        /*zrf must be aware of self internal structure*/
-        YAFL_TRY(status, _ZRF(self, _Y, z, _Y)); /* self.y = zrf(z, h(x,...)) */
-    }
+    return status;
+}
 
-    /* Decorrelate measurement noise */
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_ekf_base_gate(yaflKalmanBaseSt * self, yaflFloat * z, \
+                                yaflInt n, yaflFloat * d2)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat * zp;
+    yaflFloat * us;
+    yaflFloat * ds;
 
-    YAFL_TRY(status, yafl_math_ruv(_NZ,      _Y,  _UR));
-    YAFL_TRY(status, yafl_math_rum(_NZ, _NX, _HY, _UR));
+    YAFL_CHECK(self,         YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_X,           YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UP,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_DP,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_HY,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_D,           YAFL_ST_INV_ARG_1);
 
-    /* Do scalar updates */
-    for (j = 0; j < _NZ; j++)
+    YAFL_CHECK(z,            YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(n > 0,        YAFL_ST_INV_ARG_3);
+    YAFL_CHECK(d2,           YAFL_ST_INV_ARG_4);
+
+    /*H is not needed after S factorization, use it to store Us, Ds*/
+    us = _HY;
+    ds = us + YAFL_U_SZ(_NZ);
+
+    /*D is free after S factorization, it is used for residuals and zp*/
+    zp = _D + _NZ;
+
+    if (_ND)
     {
-        YAFL_TRY(status, scalar_update(self, j));
+        /*Deferred covariance is not flushed, the filter must not change*/
+        YAFL_CHECK(_HX,          YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(_UR,          YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(_DR,          YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(_NZ <= _NX,   YAFL_ST_INV_ARG_1); /*Scratchpad size limit*/
+        YAFL_CHECK(_JHX || _JHS, YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(_W,           YAFL_ST_INV_ARG_1);
+
+        YAFL_TRY(status, _ekf_innov_ud_deferred(self, us, ds));
+        YAFL_TRY(status, _HX(self, zp, _X)); /* zp = h(x,...) */
+    }
+    else
+    {
+        YAFL_TRY(status, yafl_ekf_base_innov_ud(self, _X, _UP, _DP, zp, \
+                                                us, ds));
     }
 
+    YAFL_TRY(status, _gate_d2(self, _NZ, _ZRF, z, n, d2, zp, us, ds, _D));
     return status;
 }
+
 /*=============================================================================
                                 Bierman filter
 =============================================================================*/
@@ -170,7 +1014,7 @@ static inline yaflStatusEn \
     _bierman_update_body(yaflInt    nx, yaflFloat * x, yaflFloat * u, \
                         yaflFloat * d, yaflFloat * f, yaflFloat * v, \
                         yaflFloat   r, yaflFloat  nu, yaflFloat  ac, \
-                        yaflFloat   gdot)
+                        yaflFloat   gdot, yaflKalmanStatsSt * st)
 {
     yaflStatusEn status = YAFL_ST_OK;
     yaflInt j;
@@ -229,6 +1073,9 @@ static inline yaflStatusEn \
     x += v * (nu / r)
     */
     YAFL_TRY(status, yafl_math_add_vxn(nx, x, v, nu / r));
+
+    /*r is the innovation variance now*/
+    _stats_add(st, nu, r);
     return status;
 }
 
@@ -262,14 +1109,14 @@ yaflStatusEn yafl_ekf_bierman_update_scalar(yaflKalmanBaseSt * self, yaflInt i)
     h = _HY + _NX * i;
     /* f = h.dot(Up) */
 #   define f _D
-    YAFL_TRY(status, yafl_math_set_vtu(_NX, f, h, _UP));
+    YAFL_TRY(status, _ekf_set_f(self, f, h, i));
 
     /* v = f.dot(Dp).T = Dp.dot(f.T).T */
 #define v h /*Don't need h any more, use it to store v*/
     YAFL_TRY(status, YAFL_MATH_SET_DV(_NX, v, _DP, f));
     YAFL_TRY(status, \
              _bierman_update_body(_NX, _X, _UP, _DP, f, v, _DR[i], _Y[i], \
-                                  1.0, 1.0));
+                                  1.0, 1.0, _STATS));
 
 #   undef v /*Don't nee v any more*/
 #   undef f
@@ -277,6 +1124,196 @@ yaflStatusEn yafl_ekf_bierman_update_scalar(yaflKalmanBaseSt * self, yaflInt i)
     return status;
 }
 
+/*---------------------------------------------------------------------------*/
+/*
+Sequential innovation: y[i] = y0[i] - h.dot(x - x0), where y0[i] and h
+are decorrelated prior residual and H row and x0 is the prior state,
+so every scalar update is done with y[i] = z[i] - h.dot(x).
+*/
+static inline void _ekf_seq_innov(yaflKalmanBaseSt * self, yaflFloat * h, \
+                                  yaflFloat * x0, yaflInt i)
+{
+    yaflFloat hdx = 0.0;
+    yaflInt k;
+
+    for (k = 0; k < _NX; k++)
+    {
+        hdx += h[k] * (_X[k] - x0[k]);
+    }
+    _Y[i] -= hdx;
+}
+
+/*---------------------------------------------------------------------------*/
+/*
+Bierman step k for one measurement, see _bierman_update_body:
+fk = f[k], v[k] = d[k] * fk, column k of u is uk = u[szk : szk + k],
+r is the running variance of the measurement.
+*/
+static inline void _bierman_step(yaflInt k, yaflFloat * uk, yaflFloat * dk, \
+                                 yaflFloat * v, yaflFloat * r, yaflFloat fk)
+{
+    yaflFloat a;
+    yaflFloat vk;
+    yaflFloat p;
+    yaflInt j;
+
+    vk = *dk * fk;
+    v[k] = vk;
+
+    a = *r + fk * vk;
+    *dk *= *r / a;
+    p = - fk / *r;
+    for (j = 0; j < k; j++)
+    {
+        yaflFloat ujk;
+        yaflFloat vj;
+
+        ujk = uk[j];
+        vj  = v[j];
+
+        uk[j] = ujk +   p * vj;
+        v[j]  = vj  + ujk * vk;
+    }
+    *r = a;
+}
+
+/*
+Fused Bierman kernel, does all the scalar updates in one pass over Up, Dp.
+
+Bierman step k of measurement i changes only column k of Up and d[k],
+and f[k] = h.dot(Up[:, k]) depends only on column k, so the steps k of
+all measurements may be done one after another column by column.
+Every measurement keeps its own v and running variance r, f[k] sums are
+done in the same order as in _ekf_set_f, so the arithmetic is the same
+as in the sequential path and the results are identical. The state is
+updated after the sweep with sequential innovations, see _ekf_seq_innov.
+
+v vectors are stored in the W rows and r in D, so nz < 2 * nx.
+*/
+static yaflStatusEn _ekf_bierman_update_fused(yaflKalmanBaseSt * self)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat * u;
+    yaflFloat * d;
+    yaflFloat * r;
+    yaflFloat * x0;
+    yaflInt nx;
+    yaflInt nz;
+    yaflInt szk;
+    yaflInt k;
+    yaflInt i;
+
+    /*_SCALAR_UPDATE_ARGS_CHECKS for all i < nz*/
+    YAFL_CHECK(self,    YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_NZ > 0, YAFL_ST_INV_ARG_2);
+    _EKF_BIERMAN_SELF_INTERNALS_CHECKS();
+    YAFL_CHECK(_W,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_X,      YAFL_ST_INV_ARG_1);
+
+    nx = _NX;
+    nz = _NZ;
+    u  = _UP;
+    d  = _DP;
+
+    r = _D;
+    for (i = 0; i < nz; i++)
+    {
+        r[i] = _DR[i];
+    }
+
+    /*Prior state for sequential innovations, the tail of W*/
+    x0 = _W + 2 * nx * nx - nx;
+    memcpy((void *)x0, (void *)_X, nx * sizeof(yaflFloat));
+
+    for (k = 0, szk = 0; k < nx; szk += k++)
+    {
+        yaflFloat * uk = u + szk;
+
+        for (i = 0; i < nz; i++)
+        {
+            yaflFloat * h = _HY + nx * i;
+            yaflFloat fk;
+            yaflInt j;
+
+            /* f[k] = h.dot(Up[:, k]) */
+            if (_JHS)
+            {
+                yaflInt   nnz = _HNNZ[i];
+                yaflInt * idx = _HIDX + nx * i;
+
+                fk = 0.0;
+                if (nnz && (k >= idx[0]))
+                {
+                    fk = h[k];
+                    for (j = 0; (j < nnz) && (idx[j] < k); j++)
+                    {
+                        fk += h[idx[j]] * uk[idx[j]];
+                    }
+                }
+            }
+            else
+            {
+                fk = h[k];
+                for (j = 0; j < k; j++)
+                {
+                    fk += h[j] * uk[j];
+                }
+            }
+
+            _bierman_step(k, uk, d + k, _W + nx * i, r + i, fk);
+        }
+    }
+
+    /* x += K * nu = v * (nu / r) for every measurement */
+    for (i = 0; i < nz; i++)
+    {
+        if (i)
+        {
+            _ekf_seq_innov(self, _HY + nx * i, x0, i);
+        }
+
+        YAFL_TRY(status, yafl_math_add_vxn(nx, _X, _W + nx * i, _Y[i] / r[i]));
+
+        /*r is the innovation variance now*/
+        _stats_add(_STATS, _Y[i], r[i]);
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+static yaflStatusEn _ekf_scalar_updates(yaflKalmanBaseSt * self, \
+                                        yaflKalmanScalarUpdateP scalar_update)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat * x0;
+    yaflInt j;
+
+    /*v and x0 of the fused kernel must fit in W*/
+    if ((yafl_ekf_bierman_update_scalar == scalar_update) && \
+        (_NZ < 2 * _NX))
+    {
+        return _ekf_bierman_update_fused(self);
+    }
+
+    /*Joseph updates use nx * (nx + 1) elements of W, the tail is free*/
+    x0 = _W + 2 * _NX * _NX - _NX;
+    if (_NZ > 1)
+    {
+        YAFL_CHECK(_W, YAFL_ST_INV_ARG_1);
+        memcpy((void *)x0, (void *)_X, _NX * sizeof(yaflFloat));
+    }
+
+    for (j = 0; j < _NZ; j++)
+    {
+        if (j)
+        {
+            _ekf_seq_innov(self, _HY + _NX * j, x0, j);
+        }
+        YAFL_TRY(status, scalar_update(self, j));
+    }
+    return status;
+}
+
 /*=============================================================================
                                 Joseph filter
 =============================================================================*/
@@ -285,7 +1322,7 @@ static inline yaflStatusEn \
                         yaflFloat * d, yaflFloat * f, yaflFloat * v, \
                         yaflFloat * k, yaflFloat * w, yaflFloat  nu, \
                         yaflFloat  a2, yaflFloat   s, yaflFloat  ac, \
-                        yaflFloat  gdot)
+                        yaflFloat  gdot, yaflKalmanStatsSt * st)
 {
     yaflStatusEn status = YAFL_ST_OK;
 
@@ -329,6 +1366,8 @@ static inline yaflStatusEn \
     /* x += k * nu */
     YAFL_TRY(status, yafl_math_add_vxn(nx, x, k, nu));
 #   undef D  /*Don't nee D any more*/
+
+    _stats_add(st, nu, s);
     return status;
 }
 
@@ -346,7 +1385,96 @@ do {                                         \
 } while (0)
 
 /*---------------------------------------------------------------------------*/
-yaflStatusEn yafl_ekf_joseph_update_scalar(yaflKalmanBaseSt * self, yaflInt i)
+yaflStatusEn yafl_ekf_joseph_update_scalar(yaflKalmanBaseSt * self, yaflInt i)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat s = 0.0;
+    yaflFloat  * f;
+    yaflFloat  * h;
+
+    _SCALAR_UPDATE_ARGS_CHECKS();
+    _EKF_JOSEPH_SELF_INTERNALS_CHECKS();
+
+#   define v _D
+    f = v + _NX;
+    h = _HY + _NX * i;
+
+    /* f = h.dot(Up) */
+    YAFL_TRY(status, _ekf_set_f(self, f, h, i));
+
+    /* v = f.dot(Dp).T = Dp.dot(f.T).T */
+    YAFL_TRY(status, YAFL_MATH_SET_DV(_NX, v, _DP, f));
+
+#   define r _DR[i]
+    /* s = r + f.dot(v)*/
+    YAFL_TRY(status, yafl_math_vtv(_NX, &s, f, v));
+    s += r;
+
+    /*K = Up.dot(v/s) = Up.dot(v)/s*/
+#   define K h /*Don't need h any more, use it to store K*/
+    YAFL_TRY(status, \
+             _joseph_update_body(_NX, _X, _UP, _DP, f, v, K, _W, _Y[i], r, \
+                                 s, 1.0, 1.0, _STATS));
+#   undef K /*Don't nee K any more*/
+#   undef r
+#   undef v
+
+    return status;
+}
+
+/*=============================================================================
+                           Rank one Joseph filter
+=============================================================================*/
+/*
+Joseph form update:
+P = (I - k.dot(h)).dot(P).dot((I - k.dot(h)).T) + r * outer(k, k)
+
+The gain k is computed independently of g = P.dot(h.T) as in the full
+Joseph form, and P is updated by yafl_math_udu_joseph, so gain errors
+are accounted for in O(nx**2) instead of MWGSU in O(nx**3).
+*/
+static inline yaflStatusEn \
+    _joseph_r1_update_body(yaflInt nx,    yaflFloat * x, yaflFloat * u, \
+                           yaflFloat * d, yaflFloat * f, yaflFloat * v, \
+                           yaflFloat * k, yaflFloat  nu, yaflFloat  r, \
+                           yaflFloat   s, yaflKalmanStatsSt * st)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat c = 0.0;
+
+    YAFL_CHECK(x, YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(u, YAFL_ST_INV_ARG_3);
+    YAFL_CHECK(d, YAFL_ST_INV_ARG_4);
+    YAFL_CHECK(f, YAFL_ST_INV_ARG_5);
+    YAFL_CHECK(v, YAFL_ST_INV_ARG_6);
+    YAFL_CHECK(k, YAFL_ST_INV_ARG_7);
+    YAFL_CHECK(s > 0, YAFL_ST_INV_ARG_10);
+
+    /* c = f.dot(v) = h.dot(P).dot(h.T) */
+    YAFL_TRY(status, yafl_math_vtv(nx, &c, f, v));
+
+#   define g f /*Don't need f any more, use it to store g*/
+    /* g = Up.dot(v) */
+    YAFL_TRY(status, yafl_math_set_uv(nx, g, u, v));
+
+    /* k = Up.dot(v / s) */
+    /*May be used in place*/
+    YAFL_TRY(status, yafl_math_set_vxn(nx, v, v, 1.0 / s));
+    YAFL_TRY(status, yafl_math_set_uv(nx, k, u, v));
+
+    /* x += k * nu */
+    YAFL_TRY(status, yafl_math_add_vxn(nx, x, k, nu));
+
+    /* Up, Dp = udu((I - k.dot(h)).dot(P).dot((I - k.dot(h)).T) + r * outer(k, k)) */
+    YAFL_TRY(status, yafl_math_udu_joseph(nx, u, d, g, k, c, r));
+#   undef g
+
+    _stats_add(st, nu, s);
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_ekf_joseph_r1_update_scalar(yaflKalmanBaseSt * self, yaflInt i)
 {
     yaflStatusEn status = YAFL_ST_OK;
     yaflFloat s = 0.0;
@@ -354,14 +1482,14 @@ yaflStatusEn yafl_ekf_joseph_update_scalar(yaflKalmanBaseSt * self, yaflInt i)
     yaflFloat  * h;
 
     _SCALAR_UPDATE_ARGS_CHECKS();
-    _EKF_JOSEPH_SELF_INTERNALS_CHECKS();
+    _EKF_BIERMAN_SELF_INTERNALS_CHECKS();
 
 #   define v _D
     f = v + _NX;
     h = _HY + _NX * i;
 
     /* f = h.dot(Up) */
-    YAFL_TRY(status, yafl_math_set_vtu(_NX, f, h, _UP));
+    YAFL_TRY(status, _ekf_set_f(self, f, h, i));
 
     /* v = f.dot(Dp).T = Dp.dot(f.T).T */
     YAFL_TRY(status, YAFL_MATH_SET_DV(_NX, v, _DP, f));
@@ -371,11 +1499,10 @@ yaflStatusEn yafl_ekf_joseph_update_scalar(yaflKalmanBaseSt * self, yaflInt i)
     YAFL_TRY(status, yafl_math_vtv(_NX, &s, f, v));
     s += r;
 
-    /*K = Up.dot(v/s) = Up.dot(v)/s*/
 #   define K h /*Don't need h any more, use it to store K*/
     YAFL_TRY(status, \
-             _joseph_update_body(_NX, _X, _UP, _DP, f, v, K, _W, _Y[i], r, \
-                                 s, 1.0, 1.0));
+             _joseph_r1_update_body(_NX, _X, _UP, _DP, f, v, K, _Y[i], r, \
+                                    s, _STATS));
 #   undef K /*Don't nee K any more*/
 #   undef r
 #   undef v
@@ -451,7 +1578,7 @@ yaflStatusEn yafl_ekf_adaptive_bierman_update_scalar(yaflKalmanBaseSt * self, \
     /* f = h.dot(Up) */
 #   define f _D
     //f = self->D;
-    YAFL_TRY(status, yafl_math_set_vtu(_NX, f, h, _UP));
+    YAFL_TRY(status, _ekf_set_f(self, f, h, i));
 
     /* v = f.dot(Dp).T = Dp.dot(f.T).T */
 #   define v _HY /*Don't need h any more, use it to store v*/
@@ -463,7 +1590,8 @@ yaflStatusEn yafl_ekf_adaptive_bierman_update_scalar(yaflKalmanBaseSt * self, \
                                   ((yaflEKFAdaptiveSt *)self)->chi2));
 
     YAFL_TRY(status, \
-             _bierman_update_body(_NX, _X, _UP, _DP, f, v, r, nu, ac, 1.0));
+             _bierman_update_body(_NX, _X, _UP, _DP, f, v, r, nu, ac, 1.0, \
+                                  _STATS));
 #   undef r
 #   undef v /*Don't nee v any more*/
 #   undef f
@@ -495,7 +1623,7 @@ yaflStatusEn \
     nu = _Y[i];
 
     /* f = h.dot(Up) */
-    YAFL_TRY(status, yafl_math_set_vtu(_NX, f, h, _UP));
+    YAFL_TRY(status, _ekf_set_f(self, f, h, i));
 
     /* v = f.dot(Dp).T = Dp.dot(f.T).T */
     YAFL_TRY(status, YAFL_MATH_SET_DV(_NX, v, _DP, f));
@@ -509,7 +1637,7 @@ yaflStatusEn \
 #   define K h /*Don't need h any more, use it to store K*/
     YAFL_TRY(status, \
              _joseph_update_body(_NX, _X, _UP, _DP, f, v, K, _W, nu, r, s, \
-                                 ac, 1.0));
+                                 ac, 1.0, _STATS));
 #   undef K /*Don't nee K any more*/
 #   undef r
 #   undef v
@@ -691,174 +1819,579 @@ yaflStatusEn \
     h = _HY + _NX * i;
     /* f = h.dot(Up) */
 #   define f _D
-    YAFL_TRY(status, yafl_math_set_vtu(_NX, f, h, _UP));
+    YAFL_TRY(status, _ekf_set_f(self, f, h, i));
+
+    /* v = f.dot(Dp).T = Dp.dot(f.T).T */
+#   define v h /*Don't need h any more, use it to store v*/
+    YAFL_TRY(status, YAFL_MATH_SET_DV(_NX, v, _DP, f));
+
+    YAFL_TRY(status, \
+             _bierman_update_body(_NX, _X, _UP, _DP, f, v, r05 * r05, nu, \
+                                  1.0, gdot, _STATS));
+
+#   undef v  /*Don't nee v any more*/
+#   undef f
+
+    return status;
+}
+
+/*=============================================================================
+                            Robust Joseph filter
+=============================================================================*/
+yaflStatusEn \
+    yafl_ekf_robust_joseph_update_scalar(yaflKalmanBaseSt * self, yaflInt i)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat gdot = 0.0;
+    yaflFloat s    = 0.0;
+    yaflFloat nu   = 0.0;
+    yaflFloat r05;
+    yaflFloat * h;
+    yaflFloat * f;
+
+    _SCALAR_UPDATE_ARGS_CHECKS();
+    _EKF_JOSEPH_SELF_INTERNALS_CHECKS();
+
+    r05 = _DR[i]; /* alpha = r**0.5 is stored in Dr*/
+    nu  = _Y[i];
+
+    YAFL_TRY(status, _SCALAR_ROBUSTIFY(self, &gdot, &nu, r05));
+
+    r05 *= r05;
+#   define A2 r05 /*Now it is r = alpha**2 */
+
+    h = _HY + _NX * i;
+#   define v _D
+    f = v + _NX;
+
+    /* f = h.dot(Up) */
+    YAFL_TRY(status, _ekf_set_f(self, f, h, i));
+
+    /* v = f.dot(Dp).T = Dp.dot(f.T).T */
+    YAFL_TRY(status, YAFL_MATH_SET_DV(_NX, v, _DP, f));
+
+    /* s = alpha**2 + gdot * f.dot(v)*/
+    YAFL_TRY(status, yafl_math_vtv(_NX, &s, f, v));
+    s = A2 + gdot * s;
+
+    /*K = Up.dot(v/s) = Up.dot(v)/s*/
+#   define K h /*Don't need h any more, use it to store K*/
+    YAFL_TRY(status, \
+             _joseph_update_body(_NX, _X, _UP, _DP, f, v, K, _W, nu, A2, s, \
+                                 1.0, gdot, _STATS));
+#   undef K  /*Don't nee K any more*/
+#   undef v
+#   undef A2 /*Don't nee A2 any more*/
+
+    return status;
+}
+
+/*=============================================================================
+                        Adaptive robust Bierman filter
+=============================================================================*/
+yaflStatusEn \
+    yafl_ekf_adaptive_robust_bierman_update_scalar(yaflKalmanBaseSt * self, \
+                                                   yaflInt i)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat gdot = 1.0;
+    yaflFloat ac   = 1.0;
+    yaflFloat nu   = 0.0;
+    yaflFloat r05;
+    yaflFloat * h;
+
+    _SCALAR_UPDATE_ARGS_CHECKS();
+    _EKF_BIERMAN_SELF_INTERNALS_CHECKS();
+
+    r05 = _DR[i]; /* alpha = r**0.5 is stored in Dr*/
+    nu  = _Y[i];
+
+    YAFL_TRY(status, _SCALAR_ROBUSTIFY(self, &gdot, &nu, r05));
+
+    r05 *= r05;
+#   define A2 r05 /*Now it is r = alpha**2 */
+
+    h = _HY + _NX * i;
+
+    /* f = h.dot(Up) */
+#   define f _D
+    YAFL_TRY(status, _ekf_set_f(self, f, h, i));
 
     /* v = f.dot(Dp).T = Dp.dot(f.T).T */
 #   define v h /*Don't need h any more, use it to store v*/
     YAFL_TRY(status, YAFL_MATH_SET_DV(_NX, v, _DP, f));
 
-    YAFL_TRY(status, \
-             _bierman_update_body(_NX, _X, _UP, _DP, f, v, r05 * r05, nu, \
-                                  1.0, gdot));
+    YAFL_TRY(status, \
+             _adaptive_correction(_NX, &ac, 0, f, v, A2, nu, gdot, \
+                                  ((yaflEKFAdaptiveRobustSt *)self)->chi2));
+
+    YAFL_TRY(status, _bierman_update_body(_NX, _X, _UP, _DP, f, v, A2, nu, \
+                                          ac, gdot, _STATS));
+#   undef v  /*Don't nee v any more*/
+#   undef f
+#   undef A2 /*Don't nee A2 any more*/
+
+    return status;
+}
+
+/*=============================================================================
+                        Adaptive robust Joseph filter
+=============================================================================*/
+yaflStatusEn \
+    yafl_ekf_adaptive_robust_joseph_update_scalar(yaflKalmanBaseSt * self, \
+                                                  yaflInt i)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat gdot = 1.0;
+    yaflFloat   ac = 1.0;
+    yaflFloat    s = 0.0;
+    yaflFloat * h;
+    yaflFloat * f;
+    yaflFloat r05;
+    yaflFloat nu;
+
+    _SCALAR_UPDATE_ARGS_CHECKS();
+    _EKF_JOSEPH_SELF_INTERNALS_CHECKS();
+
+    r05 = _DR[i]; /* alpha = r**0.5 is stored in Dr*/
+    nu  = _Y[i];
+
+    YAFL_TRY(status, _SCALAR_ROBUSTIFY(self, &gdot, &nu, r05));
+
+    r05 *= r05;
+#   define A2 r05 /*Now it is r = alpha**2 */
+
+    h = _HY + _NX * i;
+#   define v _D
+    f = v + _NX;
+
+    /* f = h.dot(Up) */
+    YAFL_TRY(status, _ekf_set_f(self, f, h, i));
+
+    /* v = f.dot(Dp).T = Dp.dot(f.T).T */
+    YAFL_TRY(status, YAFL_MATH_SET_DV(_NX, v, _DP, f));
+
+    YAFL_TRY(status, \
+             _adaptive_correction(_NX, &ac, &s, f, v, A2, nu, gdot, \
+                                  ((yaflEKFAdaptiveRobustSt *)self)->chi2));
+
+    /* K = Up.dot(v * ac / s) = Up.dot(v) * (ac / s) */
+#   define K h /*Don't need h any more, use it to store K*/
+    YAFL_TRY(status, \
+             _joseph_update_body(_NX, _X, _UP, _DP, f, v, K, _W, nu, A2, s, \
+                                 ac, gdot, _STATS));
+#   undef K  /*Don't nee K any more*/
+#   undef v
+#   undef A2 /*Don't nee A2 any more*/
+
+    return status;
+}
+
+/*=============================================================================
+                        Linear Kalman filter
+=============================================================================*/
+#define _LKF_SELF ((yaflLKFSt *)self)
+
+#define _LF    (_LKF_SELF->F)
+#define _LHM   (_LKF_SELF->Hm)
+#define _LHD   (_LKF_SELF->Hd)
+#define _LVER  (_LKF_SELF->ver)
+#define _LHVER (_LKF_SELF->Hver)
+
+#define _LKSS   (_LKF_SELF->Kss)
+#define _LSSS   (_LKF_SELF->Sss)
+#define _LUPH   (_LKF_SELF->Uph)
+#define _LDPH   (_LKF_SELF->Dph)
+#define _LSSTOL (_LKF_SELF->ss_tol)
+#define _LCHI2  (_LKF_SELF->chi2)
+#define _LSSVER (_LKF_SELF->ss_ver)
+#define _LSS    (_LKF_SELF->ss)
+
+#define _LSS_FROZEN() ((2 == _LSS) && (_LSSVER == _LVER))
+
+#define _LFK   (_LKF_SELF->Fk)
+#define _LUQK  (_LKF_SELF->Uqk)
+#define _LDQK  (_LKF_SELF->Dqk)
+#define _LFA   (_LKF_SELF->Fa)
+#define _LUQA  (_LKF_SELF->Uqa)
+#define _LDQA  (_LKF_SELF->Dqa)
+#define _LNK   (_LKF_SELF->Nk)
+#define _LKVER (_LKF_SELF->Kver)
+
+/*Leaves frozen gain mode, Up, Dp are set to the steady state updated P*/
+static inline void _lkf_ss_thaw(yaflKalmanBaseSt * self)
+{
+    memcpy((void *)_UP, (void *)_LUPH, (((_NX - 1) * _NX) / 2) * sizeof(yaflFloat));
+    memcpy((void *)_DP, (void *)_LDPH, _NX * sizeof(yaflFloat));
+    _LSS = 0;
+}
+
+/*
+Computes frozen gains: Bierman scalar updates are done on Uph, Dph copies
+of Up, Dp with zero x and nu = 1, so x becomes the scalar update gain.
+Uph, Dph hold the steady state updated P then.
+*/
+static yaflStatusEn _lkf_ss_gains(yaflKalmanBaseSt * self)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat * f;
+    yaflFloat * v;
+    yaflInt i;
+
+    f = _D;
+    v = _D + _NX;
+
+    memcpy((void *)_LUPH, (void *)_UP, (((_NX - 1) * _NX) / 2) * sizeof(yaflFloat));
+    memcpy((void *)_LDPH, (void *)_DP, _NX * sizeof(yaflFloat));
+
+    for (i = 0; i < _NZ; i++)
+    {
+        yaflFloat * k;
+        yaflFloat c;
+
+        k = _LKSS + _NX * i;
+
+        /* f = h.dot(Uph), v = Dph.dot(f.T) */
+        YAFL_TRY(status, yafl_math_set_vtu(_NX, f, _LHD + _NX * i, _LUPH));
+        YAFL_TRY(status, YAFL_MATH_SET_DV(_NX, v, _LDPH, f));
+
+        /* Innovation variance */
+        YAFL_TRY(status, yafl_math_vtv(_NX, &c, f, v));
+        _LSSS[i] = _DR[i] + c;
+
+        memset((void *)k, 0, _NX * sizeof(yaflFloat));
+        YAFL_TRY(status, \
+                 _bierman_update_body(_NX, k, _LUPH, _LDPH, f, v, _DR[i], 1.0, \
+                                      1.0, 1.0, 0));
+    }
+    return status;
+}
+
+/*Watches Up, Dp convergence and freezes the gains, called after predict*/
+static yaflStatusEn _lkf_ss_watch(yaflKalmanBaseSt * self)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat delta = 0.0;
+    yaflInt nu;
+    yaflInt i;
+
+    if (_LSSTOL <= 0.0)
+    {
+        return status;
+    }
+
+    if (_LSSVER != _LVER)
+    {
+        /* The model has changed, start again */
+        _LSSVER = _LVER;
+        _LSS    = 0;
+    }
+
+    nu = ((_NX - 1) * _NX) / 2;
+
+    if (_LSS)
+    {
+        for (i = 0; i < nu; i++)
+        {
+            yaflFloat d;
+
+            d = _UP[i] - _LUPH[i];
+            d = (d < 0.0) ? -d : d;
+            delta = (d > delta) ? d : delta;
+        }
+        for (i = 0; i < _NX; i++)
+        {
+            yaflFloat d;
+
+            d = (_DP[i] - _LDPH[i]) / _DP[i];
+            d = (d < 0.0) ? -d : d;
+            delta = (d > delta) ? d : delta;
+        }
+
+        /* Hd must be up to date */
+        if ((delta < _LSSTOL) && (_LHVER == _LVER))
+        {
+            YAFL_TRY(status, _lkf_ss_gains(self));
+            _LSS = 2;
+            return status;
+        }
+    }
+
+    memcpy((void *)_LUPH, (void *)_UP, nu * sizeof(yaflFloat));
+    memcpy((void *)_LDPH, (void *)_DP, _NX * sizeof(yaflFloat));
+    _LSS = 1;
+
+    return status;
+}
+
+/*Frozen gain update, y must be decorrelated*/
+static yaflStatusEn _lkf_ss_update(yaflKalmanBaseSt * self)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat * x0;
+    yaflInt i;
+
+    /* Divergence test */
+    for (i = 0; i < _NZ; i++)
+    {
+        if (_Y[i] * (_Y[i] / _LCHI2) > _LSSS[i])
+        {
+            /*Anomaly detected, fall back to full updates*/
+            _LSS = 0;
+            return YAFL_ST_MSK_ANOMALY;
+        }
+    }
+
+    /*Prior state for sequential innovations, see _ekf_seq_innov*/
+    x0 = _W + 2 * _NX * _NX - _NX;
+    if (_NZ > 1)
+    {
+        YAFL_CHECK(_W, YAFL_ST_INV_ARG_1);
+        memcpy((void *)x0, (void *)_X, _NX * sizeof(yaflFloat));
+    }
+
+    /* x += Kss.T.dot(y) */
+    for (i = 0; i < _NZ; i++)
+    {
+        if (i)
+        {
+            _ekf_seq_innov(self, _LHD + _NX * i, x0, i);
+        }
+        YAFL_TRY(status, yafl_math_add_vxn(_NX, _X, _LKSS + _NX * i, _Y[i]));
+        _stats_add(_STATS, _Y[i], _LSSS[i]);
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_lkf_base_predict(yaflKalmanBaseSt * self)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt nx2;
+
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(_X,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UP,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_DP,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UQ,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_DQ,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_NX > 1, YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(_LF,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_W,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_D,      YAFL_ST_INV_ARG_1);
+
+    nx2 = _NX * 2;
+
+    /* x = F.dot(x), D is used as a temporary */
+    YAFL_TRY(status, yafl_math_set_mv(_NX, _NX, _D, _LF, _X));
+    memcpy((void *)_X, (void *)_D, _NX * sizeof(yaflFloat));
+
+    /* Up, Dp hold the steady state predicted P */
+    if (_LSS_FROZEN())
+    {
+        return status;
+    }
+
+    if (2 == _LSS)
+    {
+        /* The model has changed, restore the steady state updated P */
+        _lkf_ss_thaw(self);
+    }
 
-#   undef v  /*Don't nee v any more*/
-#   undef f
+    /* W = (***|FUp), F is used in place, no copy to W */
+    YAFL_TRY(status, YAFL_MATH_BSET_MU(nx2, 0, _NX, _W, _NX, _NX, _LF, _UP));
 
+    YAFL_TRY(status, _ekf_predict_mwgsu(self, _UQ, _DQ, 1.0));
+    YAFL_TRY(status, _lkf_ss_watch(self));
     return status;
 }
 
-/*=============================================================================
-                            Robust Joseph filter
-=============================================================================*/
-yaflStatusEn \
-    yafl_ekf_robust_joseph_update_scalar(yaflKalmanBaseSt * self, yaflInt i)
+/*Computes F**k and Qk by squaring*/
+static yaflStatusEn _lkf_predict_n_cache(yaflKalmanBaseSt * self, yaflInt k)
 {
     yaflStatusEn status = YAFL_ST_OK;
-    yaflFloat gdot = 0.0;
-    yaflFloat s    = 0.0;
-    yaflFloat nu   = 0.0;
-    yaflFloat r05;
-    yaflFloat * h;
-    yaflFloat * f;
-
-    _SCALAR_UPDATE_ARGS_CHECKS();
-    _EKF_JOSEPH_SELF_INTERNALS_CHECKS();
-
-    r05 = _DR[i]; /* alpha = r**0.5 is stored in Dr*/
-    nu  = _Y[i];
-
-    YAFL_TRY(status, _SCALAR_ROBUSTIFY(self, &gdot, &nu, r05));
-
-    r05 *= r05;
-#   define A2 r05 /*Now it is r = alpha**2 */
-
-    h = _HY + _NX * i;
-#   define v _D
-    f = v + _NX;
+    yaflInt nu;
 
-    /* f = h.dot(Up) */
-    YAFL_TRY(status, yafl_math_set_vtu(_NX, f, h, _UP));
-
-    /* v = f.dot(Dp).T = Dp.dot(f.T).T */
-    YAFL_TRY(status, YAFL_MATH_SET_DV(_NX, v, _DP, f));
+    nu = ((_NX - 1) * _NX) / 2;
 
-    /* s = alpha**2 + gdot * f.dot(v)*/
-    YAFL_TRY(status, yafl_math_vtv(_NX, &s, f, v));
-    s = A2 + gdot * s;
+    /* (Fa, Qa) = (F, Q) */
+    memcpy((void *)_LFA,  (void *)_LF,  _NX * _NX * sizeof(yaflFloat));
+    memcpy((void *)_LUQA, (void *)_UQ,  nu * sizeof(yaflFloat));
+    memcpy((void *)_LDQA, (void *)_DQ,  _NX * sizeof(yaflFloat));
 
-    /*K = Up.dot(v/s) = Up.dot(v)/s*/
-#   define K h /*Don't need h any more, use it to store K*/
-    YAFL_TRY(status, \
-             _joseph_update_body(_NX, _X, _UP, _DP, f, v, K, _W, nu, A2, s, \
-                                 1.0, gdot));
-#   undef K  /*Don't nee K any more*/
-#   undef v
-#   undef A2 /*Don't nee A2 any more*/
+    YAFL_TRY(status, yafl_ekf_base_fq_pow(self, k, _LFA, _LUQA, _LDQA, \
+                                          _LFK, _LUQK, _LDQK));
 
+    _LNK   = k;
+    _LKVER = _LVER;
     return status;
 }
 
-/*=============================================================================
-                        Adaptive robust Bierman filter
-=============================================================================*/
-yaflStatusEn \
-    yafl_ekf_adaptive_robust_bierman_update_scalar(yaflKalmanBaseSt * self, \
-                                                   yaflInt i)
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_lkf_base_predict_n(yaflKalmanBaseSt * self, yaflInt k)
 {
     yaflStatusEn status = YAFL_ST_OK;
-    yaflFloat gdot = 1.0;
-    yaflFloat ac   = 1.0;
-    yaflFloat nu   = 0.0;
-    yaflFloat r05;
-    yaflFloat * h;
+    yaflInt nx2;
+    yaflInt i;
 
-    _SCALAR_UPDATE_ARGS_CHECKS();
-    _EKF_BIERMAN_SELF_INTERNALS_CHECKS();
+    YAFL_CHECK(self,  YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(k > 0, YAFL_ST_INV_ARG_2);
 
-    r05 = _DR[i]; /* alpha = r**0.5 is stored in Dr*/
-    nu  = _Y[i];
+    if ((1 == k) || (0 == _LFK))
+    {
+        for (i = 0; i < k; i++)
+        {
+            YAFL_TRY(status, yafl_lkf_base_predict(self));
+        }
+        return status;
+    }
 
-    YAFL_TRY(status, _SCALAR_ROBUSTIFY(self, &gdot, &nu, r05));
+    YAFL_CHECK(_X,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UP,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_DP,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UQ,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_DQ,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_NX > 1, YAFL_ST_INV_ARG_1);
 
-    r05 *= r05;
-#   define A2 r05 /*Now it is r = alpha**2 */
+    YAFL_CHECK(_LF,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_W,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_D,      YAFL_ST_INV_ARG_1);
 
-    h = _HY + _NX * i;
+    nx2 = _NX * 2;
 
-    /* f = h.dot(Up) */
-#   define f _D
-    YAFL_TRY(status, yafl_math_set_vtu(_NX, f, h, _UP));
+    if (2 == _LSS)
+    {
+        /* A gap is not a steady state, restore the steady state updated P */
+        _lkf_ss_thaw(self);
+    }
+    /* Start watching again after the gap */
+    _LSS = 0;
 
-    /* v = f.dot(Dp).T = Dp.dot(f.T).T */
-#   define v h /*Don't need h any more, use it to store v*/
-    YAFL_TRY(status, YAFL_MATH_SET_DV(_NX, v, _DP, f));
+    if ((_LNK != k) || (_LKVER != _LVER))
+    {
+        YAFL_TRY(status, _lkf_predict_n_cache(self, k));
+    }
 
-    YAFL_TRY(status, \
-             _adaptive_correction(_NX, &ac, 0, f, v, A2, nu, gdot, \
-                                  ((yaflEKFAdaptiveRobustSt *)self)->chi2));
+    /* x = Fk.dot(x), D is used as a temporary */
+    YAFL_TRY(status, yafl_math_set_mv(_NX, _NX, _D, _LFK, _X));
+    memcpy((void *)_X, (void *)_D, _NX * sizeof(yaflFloat));
 
-    YAFL_TRY(status, _bierman_update_body(_NX, _X, _UP, _DP, f, v, A2, nu, \
-                                          ac, gdot));
-#   undef v  /*Don't nee v any more*/
-#   undef f
-#   undef A2 /*Don't nee A2 any more*/
+    /* W = (Uqk|Fk.dot(Up)), D = concatenate([Dqk, Dp]) */
+    YAFL_TRY(status, YAFL_MATH_BSET_MU(nx2, 0, _NX, _W, _NX, _NX, _LFK, _UP));
+    YAFL_TRY(status, _ekf_predict_mwgsu(self, _LUQK, _LDQK, 1.0));
 
     return status;
 }
 
-/*=============================================================================
-                        Adaptive robust Joseph filter
-=============================================================================*/
-yaflStatusEn \
-    yafl_ekf_adaptive_robust_joseph_update_scalar(yaflKalmanBaseSt * self, \
-                                                  yaflInt i)
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_lkf_base_update(yaflKalmanBaseSt * self, yaflFloat * z, \
+                                  yaflKalmanScalarUpdateP scalar_update)
 {
     yaflStatusEn status = YAFL_ST_OK;
-    yaflFloat gdot = 1.0;
-    yaflFloat   ac = 1.0;
-    yaflFloat    s = 0.0;
-    yaflFloat * h;
-    yaflFloat * f;
-    yaflFloat r05;
-    yaflFloat nu;
+    yaflInt j;
 
-    _SCALAR_UPDATE_ARGS_CHECKS();
-    _EKF_JOSEPH_SELF_INTERNALS_CHECKS();
+    YAFL_CHECK(self,    YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_X,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_Y,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UR,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_NX > 1, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_NZ > 0, YAFL_ST_INV_ARG_1);
 
-    r05 = _DR[i]; /* alpha = r**0.5 is stored in Dr*/
-    nu  = _Y[i];
+    YAFL_CHECK(_LHM,    YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_LHD,    YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_HY,     YAFL_ST_INV_ARG_1);
 
-    YAFL_TRY(status, _SCALAR_ROBUSTIFY(self, &gdot, &nu, r05));
+    YAFL_CHECK(z,       YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(scalar_update, YAFL_ST_INV_ARG_3);
 
-    r05 *= r05;
-#   define A2 r05 /*Now it is r = alpha**2 */
+    _stats_reset(_STATS);
 
-    h = _HY + _NX * i;
-#   define v _D
-    f = v + _NX;
+    j = _NZ * _NX * sizeof(yaflFloat);
 
-    /* f = h.dot(Up) */
-    YAFL_TRY(status, yafl_math_set_vtu(_NX, f, h, _UP));
+    /* Decorrelate H only when the model has changed */
+    if (_LVER != _LHVER)
+    {
+        memcpy((void *)_LHD, (void *)_LHM, j);
+        YAFL_TRY(status, yafl_math_rum(_NZ, _NX, _LHD, _UR));
+        _LHVER = _LVER;
+    }
 
-    /* v = f.dot(Dp).T = Dp.dot(f.T).T */
-    YAFL_TRY(status, YAFL_MATH_SET_DV(_NX, v, _DP, f));
+    if (0 == _ZRF)
+    {
+        /* y = linalg.inv(Ur).dot(z - Hm.dot(x)) = linalg.inv(Ur).dot(z) - Hd.dot(x) */
+        memcpy((void *)_Y, (void *)z, _NZ * sizeof(yaflFloat));
+        YAFL_TRY(status, yafl_math_ruv(_NZ, _Y, _UR));
+        YAFL_TRY(status, yafl_math_sub_mv(_NZ, _NX, _Y, _LHD, _X));
+    }
+    else
+    {
+        /*zrf must be aware of self internal structure*/
+        YAFL_TRY(status, yafl_math_set_mv(_NZ, _NX, _Y, _LHM, _X));
+        YAFL_TRY(status, _ZRF(self, _Y, z, _Y)); /* self.y = zrf(z, Hm.dot(x)) */
+        YAFL_TRY(status, yafl_math_ruv(_NZ, _Y, _UR));
+    }
 
-    YAFL_TRY(status, \
-             _adaptive_correction(_NX, &ac, &s, f, v, A2, nu, gdot, \
-                                  ((yaflEKFAdaptiveRobustSt *)self)->chi2));
+    if ((2 == _LSS) && (_LSSVER != _LVER))
+    {
+        /* The model has changed, Up, Dp hold the predicted P which is fine here */
+        _LSS = 0;
+    }
 
-    /* K = Up.dot(v * ac / s) = Up.dot(v) * (ac / s) */
-#   define K h /*Don't need h any more, use it to store K*/
-    YAFL_TRY(status, \
-             _joseph_update_body(_NX, _X, _UP, _DP, f, v, K, _W, nu, A2, s, \
-                                 ac, gdot));
-#   undef K  /*Don't nee K any more*/
-#   undef v
-#   undef A2 /*Don't nee A2 any more*/
+    if (_LSS_FROZEN())
+    {
+        status |= _lkf_ss_update(self);
+        if (!(status & YAFL_ST_MSK_ANOMALY))
+        {
+            return status;
+        }
+        /* Do full update with steady state predicted P */
+    }
+
+    /* Scalar updates overwrite H rows, so they get a copy of Hd */
+    memcpy((void *)_HY, (void *)_LHD, _NZ * _NX * sizeof(yaflFloat));
+
+    /* Do scalar updates */
+    YAFL_TRY(status, _ekf_scalar_updates(self, scalar_update));
+
+    if (status & YAFL_ST_MSK_ANOMALY)
+    {
+        /* Don't trust the history */
+        _LSS = 0;
+    }
 
     return status;
 }
 
+#undef _LKF_SELF
+
+#undef _LF
+#undef _LHM
+#undef _LHD
+#undef _LVER
+#undef _LHVER
+
+#undef _LKSS
+#undef _LSSS
+#undef _LUPH
+#undef _LDPH
+#undef _LSSTOL
+#undef _LCHI2
+#undef _LSSVER
+#undef _LSS
+
+#undef _LSS_FROZEN
+
+#undef _LFK
+#undef _LUQK
+#undef _LDQK
+#undef _LFA
+#undef _LUQA
+#undef _LDQA
+#undef _LNK
+#undef _LKVER
+
 /*------------------------------------------------------------------------------
                                  Undef EKF stuff
 ------------------------------------------------------------------------------*/
@@ -866,11 +2399,27 @@ yaflStatusEn \
 
 #undef _JFX
 #undef _JHX
+#undef _JFS
+#undef _JHS
+
+#undef _FNNZ
+#undef _FIDX
+
+#undef _HNNZ
+#undef _HIDX
 
 #undef _HY
 #undef _W
 #undef _D
 
+#undef _PHI
+#undef _ND
+#undef _FD
+#undef _UQD
+#undef _DQD
+#undef _UQS
+#undef _DQS
+
 /*=============================================================================
                     Basic UD-factorized UKF functions
 =============================================================================*/
@@ -878,6 +2427,8 @@ yaflStatusEn \
 
 #define _UFX  (_KALMAN_SELF->f)
 #define _UHX  (_KALMAN_SELF->h)
+#define _UFB  (self->fb)
+#define _UHB  (self->hb)
 #define _UZRF (_KALMAN_SELF->zrf)
 
 #define _UX   (_KALMAN_SELF->x)
@@ -913,6 +2464,9 @@ yaflStatusEn \
 #define _WM        (self->wm)
 #define _WC        (self->wc)
 
+#define _W         (self->W)
+#define _D         (self->D)
+
 /*---------------------------------------------------------------------------*/
 static inline yaflStatusEn _compute_res(yaflKalmanBaseSt * self, yaflInt sz,    \
                                         yaflKalmanResFuncP rf, yaflFloat * res, \
@@ -936,6 +2490,125 @@ static inline yaflStatusEn _compute_res(yaflKalmanBaseSt * self, yaflInt sz,
     return status;
 }
 
+/*---------------------------------------------------------------------------*/
+/*UT covariance: rank-k update with positive weight points, then downdates*/
+static yaflStatusEn _ut_cov_seq(yaflUKFBaseSt * self, \
+                                yaflInt    res_sz,    \
+                                yaflFloat * res_v,    \
+                                yaflFloat * res_u,    \
+                                yaflFloat * res_d,    \
+                                yaflFloat * sp,       \
+                                yaflFloat * sigmas,   \
+                                yaflFloat * noise_u,  \
+                                yaflFloat * noise_d,  \
+                                yaflKalmanResFuncP rf)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt np;
+    yaflInt n;
+    yaflInt i;
+
+    np = self->sp_info->np;
+
+    if (noise_u)
+    {
+        YAFL_CHECK(noise_d, YAFL_ST_INV_ARG_8);
+        /*res_u, res_d = noise_u.copy(), noise_d.copy()*/
+        memcpy((void *)res_u, (void *)noise_u, (res_sz * (res_sz - 1)) / 2 * sizeof(yaflFloat));
+        memcpy((void *)res_d, (void *)noise_d, res_sz * sizeof(yaflFloat));
+    }
+    else
+    {
+        /* Zero res_u and res_d */
+        for (i = res_sz - 1; i >= 0; i--)
+        {
+            res_d[i] = 0.0;
+        }
+        for (i = ((res_sz * (res_sz - 1)) / 2) - 1; i >= 0; i--)
+        {
+            res_u[i] = 0.0;
+        }
+    }
+
+    /*Positive weight residuals go to _W rows, their weights go to _D*/
+    for (n = 0, i = 0; i < np; i++)
+    {
+        if (_WC[i] >= 0.0)
+        {
+            YAFL_TRY(status, _compute_res(_KALMAN_SELF, res_sz, rf, \
+                                          _W + res_sz * n,          \
+                                          sigmas + res_sz * i, res_v));
+            _D[n++] = _WC[i];
+        }
+    }
+
+    /*Update res_u and res_d with all positive weight points at once*/
+    if (n)
+    {
+        YAFL_TRY(status, yafl_math_udu_upk(res_sz, n, res_u, res_d, _D, _W));
+    }
+
+    /*Downdate res_u and res_d with negative weight points*/
+    for (i = 0; i < np; i++)
+    {
+        if (_WC[i] < 0.0)
+        {
+            YAFL_TRY(status, _compute_res(_KALMAN_SELF, res_sz, rf, sp, \
+                                          sigmas + res_sz * i, res_v));
+            YAFL_TRY(status, \
+                     yafl_math_udu_down(res_sz, res_u, res_d, -_WC[i], sp));
+        }
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+/*UT covariance: single MWGSU of stacked sigma point residuals and noise*/
+static yaflStatusEn _ut_cov_mwgsu(yaflUKFBaseSt * self, \
+                                  yaflInt    res_sz,    \
+                                  yaflFloat * res_v,    \
+                                  yaflFloat * res_u,    \
+                                  yaflFloat * res_d,    \
+                                  yaflFloat * sp,       \
+                                  yaflFloat * sigmas,   \
+                                  yaflFloat * noise_u,  \
+                                  yaflFloat * noise_d,  \
+                                  yaflKalmanResFuncP rf)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt np;
+    yaflInt nc;
+    yaflInt i;
+
+    np = self->sp_info->np;
+    nc = np + (noise_u ? res_sz : 0);
+
+    /* W = (residuals|***), D = concatenate([wc, ***]) */
+    for (i = 0; i < np; i++)
+    {
+        YAFL_TRY(status, _compute_res(_KALMAN_SELF, res_sz, rf, sp, \
+                                      sigmas + res_sz * i, res_v));
+        YAFL_TRY(status, yafl_math_bset_v(nc, _W + i, res_sz, sp));
+    }
+    memcpy((void *)_D, (void *)_WC, np * sizeof(yaflFloat));
+
+    if (noise_u)
+    {
+        /* W = (residuals|noise_u), D = concatenate([wc, noise_d]) */
+        YAFL_TRY(status, yafl_math_bset_u(nc, _W + np, res_sz, noise_u));
+        memcpy((void *)(_D + np), (void *)noise_d, res_sz * sizeof(yaflFloat));
+    }
+
+    /*
+    res_u, res_d = MWGSU(W, D)
+
+    Negative weights are summed with the others inside of MWGSU,
+    so there are no intermediate downdates which may fail.
+    */
+    YAFL_TRY(status, yafl_math_mwgsu(res_sz, nc, res_u, res_d, _W, _D));
+    return status;
+}
+
 /*---------------------------------------------------------------------------*/
 static yaflStatusEn _unscented_transform(yaflUKFBaseSt * self,   \
         yaflInt    res_sz,      \
@@ -951,7 +2624,6 @@ static yaflStatusEn _unscented_transform(yaflUKFBaseSt * self,   \
 {
     yaflStatusEn status = YAFL_ST_OK;
     yaflInt np;
-    yaflInt i;
     yaflUKFSigmaSt * sp_info;
 
     YAFL_CHECK(self,       YAFL_ST_INV_ARG_1);
@@ -969,6 +2641,8 @@ static yaflStatusEn _unscented_transform(yaflUKFBaseSt * self,   \
 
     YAFL_CHECK(_WM, YAFL_ST_INV_ARG_1);
     YAFL_CHECK(_WC, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_W,  YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_D,  YAFL_ST_INV_ARG_1);
 
     YAFL_CHECK(self->sp_info, YAFL_ST_INV_ARG_1);
     sp_info = self->sp_info;
@@ -986,47 +2660,78 @@ static yaflStatusEn _unscented_transform(yaflUKFBaseSt * self,   \
         YAFL_TRY(status, yafl_math_set_vtm(np, res_sz, res_v, _WM, sigmas));
     }
 
-    if (noise_u)
+    if (YAFL_UKF_UT_MWGSU == self->ut_mode)
+    {
+        YAFL_TRY(status, _ut_cov_mwgsu(self, res_sz, res_v, res_u, res_d, sp, \
+                                       sigmas, noise_u, noise_d, rf));
+    }
+    else
+    {
+        YAFL_TRY(status, _ut_cov_seq(self, res_sz, res_v, res_u, res_d, sp, \
+                                     sigmas, noise_u, noise_d, rf));
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+/*Sigma point propagation loop bodies*/
+static yaflStatusEn _fx_body(void * arg, yaflInt i)
+{
+    yaflUKFBaseSt * self;
+    yaflFloat * sigmai;
+
+    self   = (yaflUKFBaseSt *)arg;
+    sigmai = _SIGMAS_X + _UNX * i;
+    return _UFX(_KALMAN_SELF, sigmai, sigmai);
+}
+
+static yaflStatusEn _hx_body(void * arg, yaflInt i)
+{
+    yaflUKFBaseSt * self;
+
+    self = (yaflUKFBaseSt *)arg;
+    return _UHX(_KALMAN_SELF, _SIGMAS_Z + _UNZ * i, _SIGMAS_X + _UNX * i);
+}
+
+/*Calls body for every sigma point, in parallel if self->pfor is set*/
+static inline yaflStatusEn _propagate_sigmas(yaflUKFBaseSt * self, yaflInt np, \
+                                             yaflUKFParForBodyP body)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt i;
+
+    if (self->pfor)
     {
-        YAFL_CHECK(noise_d, YAFL_ST_INV_ARG_8);
-        /*res_u, res_d = noise_u.copy(), noise_d.copy()*/
-        memcpy((void *)res_u, (void *)noise_u, (res_sz * (res_sz - 1)) / 2 * sizeof(yaflFloat));
-        memcpy((void *)res_d, (void *)noise_d, res_sz * sizeof(yaflFloat));
+        YAFL_TRY(status, self->pfor(self->pfor_ctx, np, body, (void *)self));
     }
     else
     {
-        /* Zero res_u and res_d */
-        for (i = res_sz - 1; i >= 0; i--)
-        {
-            res_d[i] = 0.0;
-        }
-        for (i = ((res_sz * (res_sz - 1)) / 2) - 1; i >= 0; i--)
+        for (i = 0; i < np; i++)
         {
-            res_u[i] = 0.0;
+            YAFL_TRY(status, body((void *)self, i));
         }
     }
+    return status;
+}
 
-    for (i = 0; i < np; i++)
+/*Computes process sigmas in place, uses the batch function if set*/
+static inline yaflStatusEn _compute_sigmas_x(yaflUKFBaseSt * self, yaflInt np)
+{
+    if (_UFB)
     {
-        yaflFloat wci;
+        return _UFB(self, _SIGMAS_X, _SIGMAS_X, np);
+    }
+    return _propagate_sigmas(self, np, _fx_body);
+}
 
-        YAFL_TRY(status, _compute_res(_KALMAN_SELF, res_sz, rf , sp, \
-                                      sigmas + res_sz * i, res_v));
-        /*Update res_u and res_d*/
-        /*wc should be sorted in descending order*/
-        wci = _WC[i];
-        if (wci >= 0.0)
-        {
-            YAFL_TRY(status, \
-                     yafl_math_udu_up(res_sz, res_u, res_d, wci, sp));
-        }
-        else
-        {
-            YAFL_TRY(status, \
-                     yafl_math_udu_down(res_sz, res_u, res_d, -wci, sp));
-        }
+/*Computes measurement sigmas, uses the batch function if set*/
+static inline yaflStatusEn _compute_sigmas_z(yaflUKFBaseSt * self, yaflInt np)
+{
+    if (_UHB)
+    {
+        return _UHB(self, _SIGMAS_Z, _SIGMAS_X, np);
     }
-    return status;
+    return _propagate_sigmas(self, np, _hx_body);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -1035,7 +2740,6 @@ yaflStatusEn yafl_ukf_base_predict(yaflUKFBaseSt * self)
     yaflStatusEn status = YAFL_ST_OK;
 
     yaflInt np;
-    yaflInt i;
     yaflUKFSigmaSt * sp_info;
 
     /*Check some params and generate sigma points*/
@@ -1052,17 +2756,9 @@ yaflStatusEn yafl_ukf_base_predict(yaflUKFBaseSt * self)
     np = sp_info->np;
 
     /*Compute process sigmas*/
-    YAFL_CHECK(_UFX, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UFX || _UFB, YAFL_ST_INV_ARG_1);
 
-    if (_UFX)
-    {
-        for (i = 0; i < np; i++)
-        {
-            yaflFloat * sigmai;
-            sigmai = _SIGMAS_X + _UNX * i;
-            YAFL_TRY(status, _UFX(_KALMAN_SELF, sigmai, sigmai));
-        }
-    }
+    YAFL_TRY(status, _compute_sigmas_x(self, np));
 
     /*Predict x, Up, Dp*/
     YAFL_TRY(status, \
@@ -1071,6 +2767,23 @@ yaflStatusEn yafl_ukf_base_predict(yaflUKFBaseSt * self)
     return status;
 }
 
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_ukf_base_predict_n(yaflUKFBaseSt * self, yaflInt k)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt i;
+
+    YAFL_CHECK(self,  YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(k > 0, YAFL_ST_INV_ARG_2);
+
+    /*Nonlinear f, nothing to cache*/
+    for (i = 0; i < k; i++)
+    {
+        YAFL_TRY(status, yafl_ukf_base_predict(self));
+    }
+    return status;
+}
+
 /*---------------------------------------------------------------------------*/
 yaflStatusEn yafl_ukf_base_update(yaflUKFBaseSt * self, yaflFloat * z, \
                                   yaflKalmanScalarUpdateP scalar_update)
@@ -1086,7 +2799,7 @@ yaflStatusEn yafl_ukf_base_update(yaflUKFBaseSt * self, yaflFloat * z, \
 
     YAFL_CHECK(self,     YAFL_ST_INV_ARG_1);
 
-    YAFL_CHECK(_UHX, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UHX || _UHB, YAFL_ST_INV_ARG_1);
     YAFL_CHECK(_UX,  YAFL_ST_INV_ARG_1);
     YAFL_CHECK(_UY,  YAFL_ST_INV_ARG_1);
     YAFL_CHECK(_UUP, YAFL_ST_INV_ARG_1);
@@ -1112,12 +2825,10 @@ yaflStatusEn yafl_ukf_base_update(yaflUKFBaseSt * self, yaflFloat * z, \
     np = sp_info->np;
     YAFL_CHECK(np > 1, YAFL_ST_INV_ARG_1);
 
+    _stats_reset(_KALMAN_SELF->stats);
+
     /* Compute measurement sigmas */
-    for (i = 0; i < np; i++)
-    {
-        YAFL_TRY(status, _UHX(_KALMAN_SELF, _SIGMAS_Z + nz * i, \
-                              _SIGMAS_X + nx * i));
-    }
+    YAFL_TRY(status, _compute_sigmas_z(self, np));
 
     /* Compute zp*/
     if (_ZMF)
@@ -1179,6 +2890,57 @@ yaflStatusEn yafl_ukf_base_update(yaflUKFBaseSt * self, yaflFloat * z, \
     return status;
 }
 
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_ukf_base_gate(yaflUKFBaseSt * self, yaflFloat * z, \
+                                yaflInt n, yaflFloat * d2)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat * us;
+    yaflFloat * ds;
+    yaflInt np;
+    yaflInt nz;
+
+    YAFL_CHECK(self,         YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UHX || _UHB, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UUR,         YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UDR,         YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_ZP,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_PZX,         YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_SIGMAS_X,    YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_SIGMAS_Z,    YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_SX,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_D,           YAFL_ST_INV_ARG_1);
+
+    nz = _UNZ;
+    YAFL_CHECK(nz > 0,         YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(nz <= _UNX,     YAFL_ST_INV_ARG_1); /*Scratchpad size limit*/
+
+    YAFL_CHECK(self->sp_info,  YAFL_ST_INV_ARG_1);
+    np = self->sp_info->np;
+    YAFL_CHECK(np > 1,         YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(z,              YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(n > 0,          YAFL_ST_INV_ARG_3);
+    YAFL_CHECK(d2,             YAFL_ST_INV_ARG_4);
+
+    /* Compute measurement sigmas */
+    YAFL_TRY(status, _compute_sigmas_z(self, np));
+
+    /*Pzx is not needed before update, use it to store Us, Ds*/
+    us = _PZX;
+    ds = us + ((nz - 1) * nz) / 2;
+
+    /* Compute zp, Us, Ds, Sx is used as scratchpad */
+    YAFL_TRY(status, \
+             _unscented_transform(self, nz, _ZP, us, ds, _SX, _SIGMAS_Z, \
+                                  _UUR, _UDR, _ZMF, _UZRF));
+
+    /*W and D are free now, D is used for residuals*/
+    YAFL_TRY(status, _gate_d2(_KALMAN_SELF, nz, _UZRF, z, n, d2, _ZP, \
+                              us, ds, _D));
+    return status;
+}
+
 /*=============================================================================
                                  Bierman UKF
 =============================================================================*/
@@ -1226,7 +2988,7 @@ yaflStatusEn yafl_ukf_bierman_update_scalar(yaflKalmanBaseSt * self, yaflInt i)
 
     YAFL_TRY(status, \
              _bierman_update_body(nx, _X, _UP, _DP, f, v, _DR[i], _Y[i], \
-                                  1.0, 1.0));
+                                  1.0, 1.0, _STATS));
 #   undef f
     return status;
 }
@@ -1269,7 +3031,8 @@ yaflStatusEn yafl_ukf_adaptive_bierman_update_scalar(yaflKalmanBaseSt * self, ya
                                   ((yaflUKFAdaptivedSt *)self)->chi2));
 
     YAFL_TRY(status, \
-             _bierman_update_body(nx, _X, _UP, _DP, f, v, r, _Y[i], ac, 1.0));
+             _bierman_update_body(nx, _X, _UP, _DP, f, v, r, _Y[i], ac, 1.0, \
+                                  _STATS));
 #   undef f
     return status;
 }
@@ -1319,7 +3082,7 @@ yaflStatusEn yafl_ukf_robust_bierman_update_scalar(yaflKalmanBaseSt * self, \
 
     YAFL_TRY(status, \
              _bierman_update_body(nx, _X, _UP, _DP, f, v, r05 * r05, nu, \
-                                  1.0, gdot));
+                                  1.0, gdot, _STATS));
 #   undef f
     return status;
 }
@@ -1372,7 +3135,8 @@ yaflStatusEn \
                                   ((yaflUKFAdaptiveRobustSt *)self)->chi2));
 
     YAFL_TRY(status, \
-             _bierman_update_body(nx, _X, _UP, _DP, f, v, A2, nu, ac, gdot));
+             _bierman_update_body(nx, _X, _UP, _DP, f, v, A2, nu, ac, gdot, \
+                                  _STATS));
 #   undef f
 #   undef A2 /*Don't nee A2 any more*/
     return status;
@@ -1396,7 +3160,7 @@ yaflStatusEn yafl_ukf_update(yaflUKFBaseSt * self, yaflFloat * z)
     yaflFloat * ds;
 
     YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
-    YAFL_CHECK(_UHX, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UHX || _UHB, YAFL_ST_INV_ARG_1);
     YAFL_CHECK(_UX,  YAFL_ST_INV_ARG_1);
 
     y = _UY;
@@ -1430,12 +3194,10 @@ yaflStatusEn yafl_ukf_update(yaflUKFBaseSt * self, yaflFloat * z)
     ds = _UDS;
     YAFL_CHECK(ds, YAFL_ST_INV_ARG_1);
 
+    _stats_reset(_KALMAN_SELF->stats);
+
     /* Compute measurement sigmas */
-    for (i = 0; i < np; i++)
-    {
-        YAFL_TRY(status, _UHX(_KALMAN_SELF, _SIGMAS_Z + nz * i, \
-                              _SIGMAS_X + nx * i));
-    }
+    YAFL_TRY(status, _compute_sigmas_z(self, np));
 
     /* Compute zp, Us, Ds */
     YAFL_TRY(status, \
@@ -1485,6 +3247,9 @@ yaflStatusEn yafl_ukf_update(yaflUKFBaseSt * self, yaflFloat * z)
         Up, Dp = udu(P)
         */
         YAFL_TRY(status, yafl_math_udu_down(nx, _UUP, _UDP, 1.0 / ds[i], pzxi));
+
+        /*y is decorrelated by Us, so ds[i] is the innovation variance*/
+        _stats_add(_KALMAN_SELF->stats, y[i], ds[i]);
     }
     return status;
 }
@@ -1522,7 +3287,7 @@ yaflStatusEn yafl_ukf_adaptive_update(yaflUKFBaseSt * self, yaflFloat * z)
     yaflFloat * ds;
 
     YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
-    YAFL_CHECK(_UHX, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UHX || _UHB, YAFL_ST_INV_ARG_1);
     YAFL_CHECK(_UX,  YAFL_ST_INV_ARG_1);
 
     y = _UY;
@@ -1555,12 +3320,10 @@ yaflStatusEn yafl_ukf_adaptive_update(yaflUKFBaseSt * self, yaflFloat * z)
     ds = _UDS;
     YAFL_CHECK(ds, YAFL_ST_INV_ARG_1);
 
+    _stats_reset(_KALMAN_SELF->stats);
+
     /* Compute measurement sigmas */
-    for (i = 0; i < np; i++)
-    {
-        YAFL_TRY(status, _UHX(_KALMAN_SELF, _SIGMAS_Z + nz * i, \
-                              _SIGMAS_X + nx * i));
-    }
+    YAFL_TRY(status, _compute_sigmas_z(self, np));
 
     /* Compute zp, Us, Ds */
     YAFL_TRY(status, \
@@ -1596,11 +3359,7 @@ yaflStatusEn yafl_ukf_adaptive_update(yaflUKFBaseSt * self, yaflFloat * z)
 
         /* Now begin update with new _SIGMAS_X */
         /*  Recompute measurement sigmas */
-        for (i = 0; i < np; i++)
-        {
-            YAFL_TRY(status, _UHX(_KALMAN_SELF, _SIGMAS_Z + nz * i, \
-                              _SIGMAS_X + nx * i));
-        }
+        YAFL_TRY(status, _compute_sigmas_z(self, np));
 
         /*  Recompute zp, Us, Ds */
         YAFL_TRY(status, \
@@ -1658,6 +3417,9 @@ yaflStatusEn yafl_ukf_adaptive_update(yaflUKFBaseSt * self, yaflFloat * z)
         Up, Dp = udu(P)
         */
         YAFL_TRY(status, yafl_math_udu_down(nx, _UUP, _UDP, 1.0 / ds[i], pzxi));
+
+        /*y is decorrelated by Us, so ds[i] is the innovation variance*/
+        _stats_add(_KALMAN_SELF->stats, y[i], ds[i]);
     }
     return status;
 }
@@ -1799,6 +3561,283 @@ const yaflUKFSigmaMethodsSt yafl_ukf_merwe_spm =
     .spgf = _merwe_generate_points
 };
 
+/*=============================================================================
+                 Simplex and spherical simplex sigma points
+=============================================================================*/
+static yaflStatusEn _fill_weights(yaflUKFBaseSt * self, yaflInt np, \
+                                  yaflFloat w)
+{
+    yaflInt i;
+
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_WM,  YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_WC,  YAFL_ST_INV_ARG_1);
+
+    for (i = 0; i < np; i++)
+    {
+        _WM[i] = w;
+        _WC[i] = w;
+    }
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/*
+Minimal skew simplex weights: w1 = 1 / 2**nx for the points 0 and 1,
+2**(i - 1) * w1 for the point i > 1.
+*/
+static yaflStatusEn _simplex_compute_weights(yaflUKFBaseSt * self)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat w1;
+    yaflInt i;
+
+    YAFL_CHECK(self,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UNX,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->sp_info, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->sp_info->np == _UNX + 1, YAFL_ST_INV_ARG_1);
+
+    w1 = 1.0;
+    for (i = 0; i < _UNX; i++)
+    {
+        w1 *= 0.5;
+    }
+
+    YAFL_TRY(status, _fill_weights(self, _UNX + 1, w1));
+
+    for (i = 2; i <= _UNX; i++)
+    {
+        _WM[i] = 2.0 * _WM[i - 1];
+        _WC[i] = _WM[i];
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+static yaflStatusEn _spherical_compute_weights(yaflUKFBaseSt * self)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat w0;
+
+    YAFL_CHECK(self,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UNX,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->sp_info, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->sp_info->np == _UNX + 2, YAFL_ST_INV_ARG_1);
+
+    w0 = ((yaflUKFSphericalSt *)self->sp_info)->w0;
+    YAFL_CHECK(w0 >= 0.0, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(w0 <  1.0, YAFL_ST_INV_ARG_1);
+
+    YAFL_TRY(status, _fill_weights(self, _UNX + 1, (1.0 - w0) / (_UNX + 1)));
+
+    /*The center point is the last one*/
+    _WM[_UNX + 1] = w0;
+    _WC[_UNX + 1] = w0;
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+/*
+Generates nx + 1 simplex points, the unit point i coordinate j is:
+-c for i <= j, a for i == j + 1 and 0 for i > j + 1,
+the unit points are scaled by U * sqrt(D) and shifted by x.
+
+Spherical simplex, Julier (2003), all points have the weight w:
+c = 1 / sqrt((j + 1) * (j + 2) * w), a = (j + 1) * c.
+
+Minimal skew simplex, Julier and Uhlmann (2002), w is the weight w1
+of the points 0 and 1, see _simplex_compute_weights:
+a = c = 1 / sqrt(2**(j + 1) * w1).
+*/
+static yaflStatusEn _simplex_generate(yaflUKFBaseSt * self, yaflFloat w, \
+                                      yaflInt skew)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt nx;
+    yaflInt i;
+    yaflFloat * x;
+    yaflFloat * sigmas_x;
+    yaflFloat * dp;
+    yaflFloat * v;
+    yaflUKFSigmaAddP addf;
+
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    nx = _UNX;
+    YAFL_CHECK(nx, YAFL_ST_INV_ARG_1);
+
+    x = _UX;
+    YAFL_CHECK(x, YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(_UUP, YAFL_ST_INV_ARG_1);
+
+    dp = _UDP;
+    YAFL_CHECK(dp, YAFL_ST_INV_ARG_1);
+
+    sigmas_x = _SIGMAS_X;
+    YAFL_CHECK(sigmas_x, YAFL_ST_INV_ARG_1);
+
+    /*Sx is free at the moment*/
+    v = _USX;
+    YAFL_CHECK(v, YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(self->sp_info, YAFL_ST_INV_ARG_1);
+    addf = self->sp_info->addf;
+
+    for (i = 0; i <= nx; i++)
+    {
+        yaflFloat * sigmai;
+        yaflInt j;
+
+        yaflFloat wj = w;
+
+        for (j = 0; j < nx; j++)
+        {
+            yaflFloat c;
+            yaflFloat a;
+
+            if (skew)
+            {
+                /* wj = 2**(j + 1) * w1 */
+                wj *= 2.0;
+                c = YAFL_SQRT(dp[j] / wj);
+                a = c;
+            }
+            else
+            {
+                c = YAFL_SQRT(dp[j] / ((j + 1) * (j + 2) * w));
+                a = (j + 1) * c;
+            }
+            v[j] = (i <= j) ? -c : ((i == j + 1) ? a : 0.0);
+        }
+
+        sigmai = sigmas_x + nx * i;
+        YAFL_TRY(status, yafl_math_set_uv(nx, sigmai, _UUP, v));
+        YAFL_TRY(status, _add_delta(self, addf, nx, sigmai, x, 1.0));
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+static yaflStatusEn _simplex_generate_points(yaflUKFBaseSt * self)
+{
+    yaflFloat w1;
+    yaflInt i;
+
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UNX, YAFL_ST_INV_ARG_1);
+
+    /* w1 = 1 / 2**nx, see _simplex_compute_weights */
+    w1 = 1.0;
+    for (i = 0; i < _UNX; i++)
+    {
+        w1 *= 0.5;
+    }
+    return _simplex_generate(self, w1, 1);
+}
+
+/*---------------------------------------------------------------------------*/
+static yaflStatusEn _spherical_generate_points(yaflUKFBaseSt * self)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat w0;
+
+    YAFL_CHECK(self,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UNX,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UX,           YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_SIGMAS_X,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->sp_info, YAFL_ST_INV_ARG_1);
+
+    w0 = ((yaflUKFSphericalSt *)self->sp_info)->w0;
+    YAFL_CHECK(w0 >= 0.0, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(w0 <  1.0, YAFL_ST_INV_ARG_1);
+
+    YAFL_TRY(status, _simplex_generate(self, (1.0 - w0) / (_UNX + 1), 0));
+
+    /*The center point is the last one*/
+    memcpy((void *)(_SIGMAS_X + _UNX * (_UNX + 1)), (void *)_UX, \
+           _UNX * sizeof(yaflFloat));
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+const yaflUKFSigmaMethodsSt yafl_ukf_simplex_spm =
+{
+    .wf   = _simplex_compute_weights,
+    .spgf = _simplex_generate_points
+};
+
+const yaflUKFSigmaMethodsSt yafl_ukf_spherical_spm =
+{
+    .wf   = _spherical_compute_weights,
+    .spgf = _spherical_generate_points
+};
+
+/*=============================================================================
+                       Cubature rule sigma points
+=============================================================================*/
+static yaflStatusEn _cubature_compute_weights(yaflUKFBaseSt * self)
+{
+    YAFL_CHECK(self,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UNX,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->sp_info, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->sp_info->np == 2 * _UNX, YAFL_ST_INV_ARG_1);
+
+    return _fill_weights(self, 2 * _UNX, 0.5 / _UNX);
+}
+
+/*---------------------------------------------------------------------------*/
+static yaflStatusEn _cubature_generate_points(yaflUKFBaseSt * self)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt nx;
+    yaflInt i;
+    yaflFloat * x;
+    yaflFloat * sigmas_x;
+    yaflFloat * dp;
+    yaflUKFSigmaAddP addf;
+
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    nx = _UNX;
+    YAFL_CHECK(nx, YAFL_ST_INV_ARG_1);
+
+    x = _UX;
+    YAFL_CHECK(x, YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(_UUP, YAFL_ST_INV_ARG_1);
+
+    dp = _UDP;
+    YAFL_CHECK(dp, YAFL_ST_INV_ARG_1);
+
+    sigmas_x = _SIGMAS_X;
+    YAFL_CHECK(sigmas_x, YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(self->sp_info, YAFL_ST_INV_ARG_1);
+
+    /*x +- sqrt(nx * dp[i]) * Up[:, i], like Merwe, but no center point*/
+    YAFL_TRY(status, yafl_math_bset_ut(nx, sigmas_x, nx, _UUP));
+    memcpy((void *)(sigmas_x + nx * nx), (void *)sigmas_x, \
+           nx * nx * sizeof(yaflFloat));
+
+    addf = self->sp_info->addf;
+    for (i = 0; i < nx; i++)
+    {
+        yaflFloat mult;
+        mult = YAFL_SQRT(dp[i] * nx);
+        YAFL_TRY(status, \
+                 _add_delta(self, addf, nx, sigmas_x + nx * i, x,   mult));
+        YAFL_TRY(status, \
+                 _add_delta(self, addf, nx, sigmas_x + nx * (nx + i), x, - mult));
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+const yaflUKFSigmaMethodsSt yafl_ukf_cubature_spm =
+{
+    .wf   = _cubature_compute_weights,
+    .spgf = _cubature_generate_points
+};
+
 /*=============================================================================
                           Undef UKF stuff
 =============================================================================*/
@@ -1806,6 +3845,8 @@ const yaflUKFSigmaMethodsSt yafl_ukf_merwe_spm =
 
 #undef _UFX
 #undef _UHX
+#undef _UFB
+#undef _UHB
 #undef _UZRF
 
 #undef _UX
@@ -1829,6 +3870,9 @@ const yaflUKFSigmaMethodsSt yafl_ukf_merwe_spm =
 #undef _UPZX
 #undef _USX
 
+#undef _W
+#undef _D
+
 /*----------------------------------------------------------------------------*/
 #undef _SCALAR_ROBUSTIFY
 
@@ -47,6 +47,31 @@ Based on:
 */
 typedef yaflFloat (* yaflKalmanRobFuncP)(yaflKalmanBaseSt *, yaflFloat);
 
+#ifndef YAFL_LN
+#   define YAFL_LN  log
+#endif/*YAFL_LN*/
+
+#define YAFL_LOG_2PI (1.8378770664093454836)
+
+/*
+Optional update statistics, accumulated in O(nz) from the decorrelated
+innovations nu[i] and their variances s[i] = r[i] + f.dot(v) which are
+used by the scalar updates:
+nis = sum(nu[i]**2 / s[i])
+ll  = -0.5 * sum(log(2 * pi * s[i]) + nu[i]**2 / s[i])
+
+Every update resets them. Full UKF updates decorrelate y by S, EKF and LKF
+scalar updates use sequential innovations nu[i] = y[i] - h[i].dot(x - x0)
+(x0 is the prior state), so ll is the exact log likelihood of z (of the
+linearized model for EKF). Sequential UKF updates use prior residuals,
+so their ll is exact when nz == 1 only.
+*/
+typedef struct _yaflKalmanStatsSt {
+    yaflFloat nis; /*Normalized innovation squared*/
+    yaflFloat ll;  /*Gaussian log likelihood*/
+    yaflInt   n;   /*The number of scalar updates*/
+} yaflKalmanStatsSt;
+
 struct _yaflKalmanBaseSt {
     yaflKalmanFuncP f;       /*A state transition function*/
     yaflKalmanFuncP h;       /*A measurement function*/
@@ -64,11 +89,16 @@ struct _yaflKalmanBaseSt {
     yaflFloat * Ur; /*Upper triangular part of R*/
     yaflFloat * Dr; /*Diagonal part of R*/
 
+    yaflKalmanStatsSt * stats; /*Optional update statistics*/
+
     yaflInt   Nx;   /*State vector size*/
     yaflInt   Nz;   /*Measurement vector size*/
 };
 
 /*---------------------------------------------------------------------------*/
+/*Packed unit upper triangular n x n matrix size*/
+#define YAFL_U_SZ(n) ((((n) - 1) * (n)) / 2)
+
 #define YAFL_KALMAN_BASE_MEMORY_MIXIN(nx, nz) \
     yaflFloat x[nx];                          \
     yaflFloat y[nz];                          \
@@ -101,10 +131,22 @@ struct _yaflKalmanBaseSt {
     .Ur  = _mem.Ur,                                                \
     .Dr  = _mem.Dr,                                                \
                                                                    \
+    .stats = 0,                                                    \
+                                                                   \
     .Nx  = _nx,                                                    \
     .Nz  = _nz                                                     \
 }
 
+/*Binds update statistics, stats may be 0 to stop collecting them*/
+static inline yaflStatusEn yafl_kalman_set_stats(yaflKalmanBaseSt * self, \
+                                                 yaflKalmanStatsSt * stats)
+{
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+
+    self->stats = stats;
+    return YAFL_ST_OK;
+}
+
 /*---------------------------------------------------------------------------*/
 #define YAFL_KALMAN_PREDICT_WRAPPER(predict, base_type, func, self_type) \
 static inline yaflStatusEn func(self_type * self)                        \
@@ -125,44 +167,374 @@ static inline yaflStatusEn func(self_type * self, yaflFloat * z)       \
 =============================================================================*/
 typedef struct _yaflEKFBaseSt yaflEKFBaseSt;
 
+/*
+Sparse measurement Jacobian function.
+Parameters:
+yaflFloat * h   - nz x nx H matrix, is zeroed before the call,
+                  only nonzero elements must be written
+yaflInt   * nnz - nz vector, nnz[i] is the number of nonzero elements in row i
+yaflInt   * idx - nz x nx matrix, idx[nx * i : nx * i + nnz[i]] must be set to
+                  ascending column indices of nonzero elements in row i
+yaflFloat * x   - the state vector
+*/
+typedef yaflStatusEn (* yaflEKFSparseJacP)(yaflKalmanBaseSt *, yaflFloat *, \
+                                           yaflInt *, yaflInt *, yaflFloat *);
+
 struct _yaflEKFBaseSt {
     yaflKalmanBaseSt base; /*Base type*/
 
     yaflKalmanFuncP jf; /*Jacobian of a state transition function*/
     yaflKalmanFuncP jh; /*Jacobian of a measurement function*/
 
+    /*
+    Optional sparse Jacobian of a state transition function, used instead
+    of jf when set, see yafl_ekf_set_sparse_f. F is given as I + S and jfs
+    fills S like jhs does, with S values written to the nx x 2 * nx
+    scratchpad W (row stride is 2 * nx), which is not zeroed, and
+    column indices written to Fidx (row stride is nx).
+    */
+    yaflEKFSparseJacP jfs;
+
+    /*
+    Optional sparse Jacobian of a measurement function, used instead of jh
+    when set, see yafl_ekf_set_sparse_h.
+    */
+    yaflEKFSparseJacP jhs;
+
+    yaflInt   * Fnnz; /*Sparse F - I row nonzero element numbers*/
+    yaflInt   * Fidx; /*Sparse F - I row nonzero element column indices*/
+
     yaflFloat * H;   /*Measurement Jacobian values*/
+    yaflInt   * Hnnz; /*Sparse H row nonzero element numbers*/
+    yaflInt   * Hidx; /*Sparse H row nonzero element column indices*/
     yaflFloat * W;   /*Scratchpad memory block matrix*/
     yaflFloat * D;   /*Scratchpad memory diagonal matrix*/
+
+    yaflFloat * Phi; /*State transition matrix of deferred predicts*/
+    yaflInt     Nd;  /*Number of deferred predicts*/
+
+    yaflFloat * Fd;  /*F of the first deferred predict, exact Q fold*/
+    yaflFloat * Uqd; /*Q of Nd deferred predicts, exact Q fold*/
+    yaflFloat * Dqd;
+    yaflFloat * Uqs; /*Exact Q fold scratchpad*/
+    yaflFloat * Dqs;
 };
 
 /*---------------------------------------------------------------------------*/
-#define YAFL_EKF_BASE_MEMORY_MIXIN(nx, nz) \
-    YAFL_KALMAN_BASE_MEMORY_MIXIN(nx, nz); \
-                                           \
-    yaflFloat H[nz * nx];                  \
-    yaflFloat W[2 * nx * nx];              \
+/*Persistent EKF state only, scratchpad is in a workspace*/
+#define YAFL_EKF_STATE_MEMORY_MIXIN(nx, nz) \
+    YAFL_KALMAN_BASE_MEMORY_MIXIN(nx, nz)
+
+/*
+EKF scratchpad: H, W and D are dead between predict and update calls,
+so one workspace may be shared by any number of filters with the same
+or smaller nx and nz which are run in one thread.
+*/
+#define YAFL_EKF_WORKSPACE_MEMORY_MIXIN(nx, nz) \
+    yaflFloat H[nz * nx];                       \
+    yaflFloat W[2 * nx * nx];                   \
     yaflFloat D[2 * nx]
 
+#define YAFL_EKF_BASE_MEMORY_MIXIN(nx, nz) \
+    YAFL_EKF_STATE_MEMORY_MIXIN(nx, nz);   \
+    YAFL_EKF_WORKSPACE_MEMORY_MIXIN(nx, nz)
+
 /*---------------------------------------------------------------------------*/
 #define YAFL_EKF_BASE_INITIALIZER(_f, _jf, _h, _jh, _zrf, _nx, _nz, _mem) \
+    YAFL_EKF_BASE_WS_INITIALIZER(_f, _jf, _h, _jh, _zrf, _nx, _nz, _mem, _mem)
+
+/*
+Low memory EKF initializer: _mem has YAFL_EKF_STATE_MEMORY_MIXIN,
+_ws has YAFL_EKF_WORKSPACE_MEMORY_MIXIN.
+*/
+#define YAFL_EKF_BASE_WS_INITIALIZER(_f, _jf, _h, _jh, _zrf, _nx, _nz,    \
+                                     _mem, _ws)                           \
 {                                                                         \
     .base = YAFL_KALMAN_BASE_INITIALIZER(_f, _h, _zrf, _nx, _nz, _mem),   \
                                                                           \
     .jf  = (yaflKalmanFuncP)_jf,                                          \
     .jh  = (yaflKalmanFuncP)_jh,                                          \
+    .jfs = 0,                                                             \
+    .jhs = 0,                                                             \
                                                                           \
-    .H   = _mem.H,                                                        \
-    .W   = _mem.W,                                                        \
-    .D   = _mem.D                                                         \
+    .Fnnz = 0,                                                            \
+    .Fidx = 0,                                                            \
+                                                                          \
+    .H    = _ws.H,                                                        \
+    .Hnnz = 0,                                                            \
+    .Hidx = 0,                                                            \
+    .W    = _ws.W,                                                        \
+    .D    = _ws.D,                                                        \
+                                                                          \
+    .Phi  = 0,                                                            \
+    .Nd   = 0,                                                            \
+                                                                          \
+    .Fd   = 0,                                                            \
+    .Uqd  = 0,                                                            \
+    .Dqd  = 0,                                                            \
+    .Uqs  = 0,                                                            \
+    .Dqs  = 0                                                             \
+}
+
+/*---------------------------------------------------------------------------*/
+/*
+EKF workspace, sized for the largest nx and nz of the filters which use it.
+Filter state becomes pure data when the workspace is bound right before
+predict and update calls, so any thread may step any filter.
+*/
+typedef struct _yaflEKFWorkspaceSt {
+    yaflFloat * H; /*Measurement Jacobian*/
+    yaflFloat * W; /*Scratchpad memory block matrix*/
+    yaflFloat * D; /*Scratchpad memory diagonal matrix*/
+
+    yaflInt   Nx;  /*Max state vector size*/
+    yaflInt   Nz;  /*Max measurement vector size*/
+} yaflEKFWorkspaceSt;
+
+/*_mem has YAFL_EKF_WORKSPACE_MEMORY_MIXIN(_nx, _nz)*/
+#define YAFL_EKF_WORKSPACE_INITIALIZER(_nx, _nz, _mem) \
+{                                                      \
+    .H  = _mem.H,                                      \
+    .W  = _mem.W,                                      \
+    .D  = _mem.D,                                      \
+                                                       \
+    .Nx = _nx,                                         \
+    .Nz = _nz                                          \
+}
+
+/*Binds a workspace, may be called before any predict or update call*/
+static inline yaflStatusEn yafl_ekf_set_workspace(yaflEKFBaseSt * self, \
+                                                  yaflEKFWorkspaceSt * ws)
+{
+    YAFL_CHECK(self,                    YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(ws,                      YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(ws->H,                   YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(ws->W,                   YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(ws->D,                   YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(ws->Nx >= self->base.Nx, YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(ws->Nz >= self->base.Nz, YAFL_ST_INV_ARG_2);
+
+    self->H = ws->H;
+    self->W = ws->W;
+    self->D = ws->D;
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/*Sparse F - I index memory, may be added to any EKF memory structure*/
+#define YAFL_EKF_SPARSE_F_MEMORY_MIXIN(nx) \
+    yaflInt Fnnz[nx];                      \
+    yaflInt Fidx[nx * nx]
+
+/*
+Switches an EKF to sparse F = I + S, F.dot(Up) computation in predict
+will take O(nnz(S) * nx) instead of O(nx**3). Block diagonal and other
+structured F may be given this way too.
+*/
+static inline yaflStatusEn yafl_ekf_set_sparse_f(yaflEKFBaseSt * self,   \
+                                                 yaflEKFSparseJacP jfs,  \
+                                                 yaflInt * nnz,          \
+                                                 yaflInt * idx)
+{
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(jfs,  YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(nnz,  YAFL_ST_INV_ARG_3);
+    YAFL_CHECK(idx,  YAFL_ST_INV_ARG_4);
+
+    self->jfs  = jfs;
+    self->Fnnz = nnz;
+    self->Fidx = idx;
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/*Sparse H index memory, may be added to any EKF memory structure*/
+#define YAFL_EKF_SPARSE_H_MEMORY_MIXIN(nx, nz) \
+    yaflInt Hnnz[nz];                          \
+    yaflInt Hidx[nz * nx]
+
+/*
+Switches an EKF to sparse H, decorrelation and f = h.dot(Up) computations
+in all EKF scalar updates will skip zero elements of H.
+*/
+static inline yaflStatusEn yafl_ekf_set_sparse_h(yaflEKFBaseSt * self,   \
+                                                 yaflEKFSparseJacP jhs,  \
+                                                 yaflInt * nnz,          \
+                                                 yaflInt * idx)
+{
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(jhs,  YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(nnz,  YAFL_ST_INV_ARG_3);
+    YAFL_CHECK(idx,  YAFL_ST_INV_ARG_4);
+
+    self->jhs  = jhs;
+    self->Hnnz = nnz;
+    self->Hidx = idx;
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/*Deferred predict memory, may be added to any EKF memory structure*/
+#define YAFL_EKF_DEFERRED_MEMORY_MIXIN(nx) \
+    yaflFloat Phi[nx * nx]
+
+/*
+Enables yafl_ekf_base_predict_x: state only predicts which accumulate
+state transition matrices in phi. The covariance is propagated in one step
+by yafl_ekf_base_flush, which is called by predicts and updates, and must be
+called before Up, Dp reads.
+
+WARNING: by default the flush is an APPROXIMATION for Nd > 1, the
+intermediate Q are folded as Nd * Q instead of sum(F**j Q F**j.T, j < Nd).
+The relative P error grows with Nd and with the distance of F from I
+(5e-3 at Nd = 20 in tests/src/ekf_deferred_check.c), use
+yafl_ekf_set_deferred_exact when P must match the full predicts.
+
+The first deferred predict sets phi = F, the next ones cost F.dot(phi):
+O(nx**3) for dense and O(nnz * nx) for sparse F, the flush costs one full
+covariance predict. At nx = 9 (tests/src/ekf_deferred_check.c, one core):
+- one update per predict: the same time as full predicts,
+- 2 predicts per update: 1.4x faster, 20 predicts per update: 3x faster,
+- the exact fold needs about 10 predicts per update to break even,
+  it is 1.4x faster at 20, slower below 8 (0.6x - 0.8x at 2..5).
+*/
+static inline yaflStatusEn yafl_ekf_set_deferred(yaflEKFBaseSt * self, \
+                                                 yaflFloat * phi)
+{
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(phi,  YAFL_ST_INV_ARG_2);
+
+    self->Phi = phi;
+    self->Nd  = 0;
+    return YAFL_ST_OK;
+}
+
+/*Exact deferred Q fold memory, may be added to deferred predict memory*/
+#define YAFL_EKF_DEFERRED_EXACT_MEMORY_MIXIN(nx) \
+    yaflFloat Fd[nx * nx];                       \
+    yaflFloat Uqd[((nx - 1) * nx)/2];            \
+    yaflFloat Dqd[nx];                           \
+    yaflFloat Uqs[((nx - 1) * nx)/2];            \
+    yaflFloat Dqs[nx]
+
+/*
+Enables exact Q fold for constant F models: F of the first deferred
+predict is saved and yafl_ekf_base_flush computes the process noise of
+Nd predicts by yafl_ekf_base_fq_pow in O(log(Nd)) MWGSU calls, Phi is
+replaced by F**Nd. Arguments are the mixin fields in order,
+yafl_ekf_set_deferred must be called too.
+*/
+static inline yaflStatusEn yafl_ekf_set_deferred_exact(yaflEKFBaseSt * self, \
+                                                       yaflFloat * fd,      \
+                                                       yaflFloat * uqd,     \
+                                                       yaflFloat * dqd,     \
+                                                       yaflFloat * uqs,     \
+                                                       yaflFloat * dqs)
+{
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(fd,   YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(uqd,  YAFL_ST_INV_ARG_3);
+    YAFL_CHECK(dqd,  YAFL_ST_INV_ARG_4);
+    YAFL_CHECK(uqs,  YAFL_ST_INV_ARG_5);
+    YAFL_CHECK(dqs,  YAFL_ST_INV_ARG_6);
+
+    self->Fd  = fd;
+    self->Uqd = uqd;
+    self->Dqd = dqd;
+    self->Uqs = uqs;
+    self->Dqs = dqs;
+    self->Nd  = 0;
+    return YAFL_ST_OK;
 }
 
 /*---------------------------------------------------------------------------*/
 yaflStatusEn yafl_ekf_base_predict(yaflKalmanBaseSt * self);
 
+yaflStatusEn yafl_ekf_base_predict_x(yaflKalmanBaseSt * self);
+
+yaflStatusEn yafl_ekf_base_flush(yaflKalmanBaseSt * self);
+
+/*
+Advances the filter k steps, when deferred predicts are enabled, does
+k state only predicts and one covariance propagation, so Q is folded as
+k * Q unless the exact fold is enabled, see yafl_ekf_set_deferred.
+Without deferred predicts this is a loop of k predicts, so only the
+deferred EKF and the LKF cache (yafl_lkf_set_predict_n) make k steps faster.
+*/
+yaflStatusEn yafl_ekf_base_predict_n(yaflKalmanBaseSt * self, yaflInt k);
+
+/*
+k step transition and process noise by squaring: fk = fa**k, Qk is
+accumulated, O(log(k)) MWGSU. Qa and Qk are UD factorized nx x nx,
+fa, Uqa, Dqa are destroyed, EKF W and D are used as scratch.
+*/
+yaflStatusEn yafl_ekf_base_fq_pow(yaflKalmanBaseSt * self, yaflInt k,               \
+                                  yaflFloat * fa, yaflFloat * uqa, yaflFloat * dqa, \
+                                  yaflFloat * fk, yaflFloat * uqk, yaflFloat * dqk);
+
+/*
+y and H are decorrelated by Ur, then scalar updates are done one by one.
+The scalar update i > 0 gets the sequential innovation
+nu[i] = y[i] - h[i].dot(x - x0) (x0 is the prior state), not the prior
+residual y[i], so robust g, gdot and the adaptive chi2 test see the
+innovation left after the updates 0..i-1. The filter output differs from
+the older versions, which used prior residuals, when nz > 1 and
+H.dot(P).dot(H.T) is not diagonal, see tests/src/seq_innov_check.c.
+*/
 yaflStatusEn yafl_ekf_base_update(yaflKalmanBaseSt * self, yaflFloat * z, \
                                   yaflKalmanScalarUpdateP scalar_update);
 
+/*
+Innovation covariance S = H.dot(P).dot(H.T) + R in UD form:
+P = up.dot(diag(dp)).dot(up.T), H = jh(x) is left in H,
+us, ds = udu(S), nz <= nx. If zp is not 0, zp = h(x) is computed
+after us, ds, so zp may point into D. W and D are used as scratchpad,
+us and ds may point to H when H is not needed after call.
+Deferred covariance is not flushed.
+*/
+yaflStatusEn yafl_ekf_base_innov_ud(yaflKalmanBaseSt * self, yaflFloat * x, \
+                                    yaflFloat * up, yaflFloat * dp,         \
+                                    yaflFloat * zp, yaflFloat * us,         \
+                                    yaflFloat * ds);
+
+/*
+Read only gating: computes squared Mahalanobis distances
+d2[k] = y.dot(linalg.inv(S)).dot(y.T), y = zrf(z[k], h(x)),
+S = H.dot(P).dot(H.T) + R for n candidates z[k] = z[nz * k : nz * (k + 1)].
+h and jh are evaluated once, S is factorized once in UD form, every
+candidate costs O(nz**2).
+The filter is not changed: x, y, Up, Dp and the deferred covariance state
+(Nd, Phi, Fd) are kept, with deferred predicts S is computed from them
+with the same Q fold as yafl_ekf_base_flush, the exact fold costs
+O(Nd * nz * nx**2) then. H, W and D (and Uqd, Dqd of the exact fold) are
+clobbered, yafl_ekf_base_update recomputes them.
+Scratchpad size limit: nz <= nx, YAFL_ST_INV_ARG_1 is returned otherwise.
+*/
+yaflStatusEn yafl_ekf_base_gate(yaflKalmanBaseSt * self, yaflFloat * z, \
+                                yaflInt n, yaflFloat * d2);
+
+/*Predict and update with the workspace passed at call time*/
+static inline yaflStatusEn yafl_ekf_ws_predict(yaflKalmanBaseSt * self, \
+                                               yaflEKFWorkspaceSt * ws)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+
+    YAFL_TRY(status, yafl_ekf_set_workspace((yaflEKFBaseSt *)self, ws));
+    YAFL_TRY(status, yafl_ekf_base_predict(self));
+    return status;
+}
+
+static inline yaflStatusEn \
+    yafl_ekf_ws_update(yaflKalmanBaseSt * self, yaflEKFWorkspaceSt * ws, \
+                       yaflFloat * z, yaflKalmanScalarUpdateP scalar_update)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+
+    YAFL_TRY(status, yafl_ekf_set_workspace((yaflEKFBaseSt *)self, ws));
+    YAFL_TRY(status, yafl_ekf_base_update(self, z, scalar_update));
+    return status;
+}
+
 /*---------------------------------------------------------------------------*/
 #define YAFL_EKF_PREDICT_WRAPPER(func, self_type)                        \
     YAFL_KALMAN_PREDICT_WRAPPER(yafl_ekf_base_predict, yaflKalmanBaseSt, \
@@ -176,6 +548,17 @@ yaflStatusEn yafl_ekf_base_update(yaflKalmanBaseSt * self, yaflFloat * z, \
 /*---------------------------------------------------------------------------*/
 YAFL_EKF_PREDICT_WRAPPER(_yafl_ekf_predict_wrapper, yaflEKFBaseSt)
 
+YAFL_KALMAN_PREDICT_WRAPPER(yafl_ekf_base_predict_x, yaflKalmanBaseSt, \
+                            yafl_ekf_predict_x, yaflEKFBaseSt)
+
+YAFL_KALMAN_PREDICT_WRAPPER(yafl_ekf_base_flush, yaflKalmanBaseSt, \
+                            yafl_ekf_flush, yaflEKFBaseSt)
+
+static inline yaflStatusEn yafl_ekf_predict_n(yaflEKFBaseSt * self, yaflInt k)
+{
+    return yafl_ekf_base_predict_n((yaflKalmanBaseSt *)self, k);
+}
+
 /*-----------------------------------------------------------------------------
                                Bierman filter
 -----------------------------------------------------------------------------*/
@@ -188,6 +571,17 @@ YAFL_EKF_UPDATE_IMPL(yafl_ekf_bierman_update, yaflEKFBaseSt)
 #define YAFL_EKF_JOSEPH_PREDICT _yafl_ekf_predict_wrapper
 YAFL_EKF_UPDATE_IMPL(yafl_ekf_joseph_update, yaflEKFBaseSt)
 
+/*-----------------------------------------------------------------------------
+                           Rank one Joseph filter
+-----------------------------------------------------------------------------*/
+/*
+Joseph form update with independently computed gain done by
+yafl_math_udu_joseph (rank one UDU' update and downdate),
+O(nx**2) instead of O(nx**3) per measurement.
+*/
+#define YAFL_EKF_JOSEPH_R1_PREDICT _yafl_ekf_predict_wrapper
+YAFL_EKF_UPDATE_IMPL(yafl_ekf_joseph_r1_update, yaflEKFBaseSt)
+
 /*=============================================================================
                     Adaptive UD-factorized EKF definitions
 =============================================================================*/
@@ -322,6 +716,215 @@ YAFL_EKF_UPDATE_IMPL(yafl_ekf_adaptive_robust_bierman_update, \
 YAFL_EKF_UPDATE_IMPL(yafl_ekf_adaptive_robust_joseph_update, \
                      yaflEKFAdaptiveRobustSt)
 
+/*=============================================================================
+                 Linear UD-factorized Kalman filter definitions
+=============================================================================*/
+/*
+Linear time invariant model: f(x) = F.dot(x), h(x) = H.dot(x), so no
+Jacobian callbacks are needed.
+
+H decorrelated by Ur is cached in Hd and is recomputed only when ver
+differs from Hver, so any F, Hm, Q or R change must be followed by
+yafl_lkf_touch.
+
+Optional steady state mode, see yafl_lkf_set_ss: when Up, Dp stop changing
+after predict, the scalar update gains are frozen in Kss and predict and
+update take O(nx * nx) and O(nx * nz). While frozen, Up, Dp hold the steady
+state predicted P. The mode falls back to full UD updates on yafl_lkf_touch
+or when a measurement fails the chi2 test.
+
+Optional k step predict cache, see yafl_lkf_set_predict_n: F**k and UD
+factors of the accumulated process noise Qk are computed by squaring in
+O(log(k)) MWGSU calls and are reused while k and the model are the same.
+Only one k is cached, a different k recomputes the powers. At nx = 9
+(tests/src/predict_n_check.c) a repeated k costs one predict, k changing
+on every call is 0.85x of k predicts for k = 2, 3, 1.3x faster for
+k = 7, 8 and 6x faster for k = 64, 65.
+*/
+typedef struct {
+    yaflEKFBaseSt base; /*Base type, base.H is used as scratchpad*/
+
+    yaflFloat * F;  /*State transition matrix*/
+    yaflFloat * Hm; /*Measurement matrix*/
+    yaflFloat * Hd; /*Decorrelated measurement matrix: linalg.inv(Ur).dot(Hm)*/
+
+    yaflFloat * Kss; /*Frozen gains, nz x nx, row i is scalar update i gain*/
+    yaflFloat * Sss; /*Frozen decorrelated innovation variances*/
+    yaflFloat * Uph; /*Up of the previous predict*/
+    yaflFloat * Dph; /*Dp of the previous predict*/
+
+    yaflFloat ss_tol; /*Steady state tolerance, 0 disables the mode*/
+    yaflFloat chi2;   /*Frozen gain divergence test threshold*/
+
+    yaflInt   ver;    /*Model version*/
+    yaflInt   Hver;   /*Hd version*/
+    yaflInt   ss_ver; /*Model version watched by the steady state mode*/
+    yaflInt   ss;     /*Steady state: 0 - no history, 1 - watching, 2 - frozen*/
+
+    yaflFloat * Fk;  /*F**k*/
+    yaflFloat * Uqk; /*Upper triangular part of Qk*/
+    yaflFloat * Dqk; /*Diagonal part of Qk*/
+    yaflFloat * Fa;  /*Squaring scratchpad: F**(2**j)*/
+    yaflFloat * Uqa; /*Squaring scratchpad: Q(2**j) upper triangular part*/
+    yaflFloat * Dqa; /*Squaring scratchpad: Q(2**j) diagonal part*/
+
+    yaflInt   Nk;   /*Cached k*/
+    yaflInt   Kver; /*Cached k step predict version*/
+} yaflLKFSt;
+
+/*---------------------------------------------------------------------------*/
+#define YAFL_LKF_MEMORY_MIXIN(nx, nz)   \
+    YAFL_EKF_BASE_MEMORY_MIXIN(nx, nz); \
+                                        \
+    yaflFloat F[nx * nx];               \
+    yaflFloat Hm[nz * nx];              \
+    yaflFloat Hd[nz * nx]
+
+/*---------------------------------------------------------------------------*/
+#define YAFL_LKF_INITIALIZER(_zrf, _nx, _nz, _mem)                       \
+{                                                                        \
+    .base = YAFL_EKF_BASE_INITIALIZER(0, 0, 0, 0, _zrf, _nx, _nz, _mem), \
+                                                                         \
+    .F    = _mem.F,                                                      \
+    .Hm   = _mem.Hm,                                                     \
+    .Hd   = _mem.Hd,                                                     \
+                                                                         \
+    .Kss  = 0,                                                           \
+    .Sss  = 0,                                                           \
+    .Uph  = 0,                                                           \
+    .Dph  = 0,                                                           \
+                                                                         \
+    .ss_tol = 0.0,                                                       \
+    .chi2   = 10.8275662,                                                \
+                                                                         \
+    .ver    = 1,                                                         \
+    .Hver   = 0,                                                         \
+    .ss_ver = 0,                                                         \
+    .ss     = 0,                                                         \
+                                                                         \
+    .Fk   = 0,                                                           \
+    .Uqk  = 0,                                                           \
+    .Dqk  = 0,                                                           \
+    .Fa   = 0,                                                           \
+    .Uqa  = 0,                                                           \
+    .Dqa  = 0,                                                           \
+                                                                         \
+    .Nk   = 0,                                                           \
+    .Kver = 0                                                            \
+}
+
+/*---------------------------------------------------------------------------*/
+/*Steady state mode memory, may be added to any LKF memory structure*/
+#define YAFL_LKF_SS_MEMORY_MIXIN(nx, nz) \
+    yaflFloat Kss[nz * nx];              \
+    yaflFloat Sss[nz];                   \
+    yaflFloat Uph[((nx - 1) * nx)/2];    \
+    yaflFloat Dph[nx]
+
+/*
+Enables steady state mode, the gains are frozen when the max change of
+Up elements and relative change of Dp elements between two predicts
+is less than tol.
+*/
+static inline yaflStatusEn yafl_lkf_set_ss(yaflLKFSt * self, yaflFloat tol, \
+                                           yaflFloat * kss, yaflFloat * sss, \
+                                           yaflFloat * uph, yaflFloat * dph)
+{
+    YAFL_CHECK(self,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(tol > 0., YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(kss,      YAFL_ST_INV_ARG_3);
+    YAFL_CHECK(sss,      YAFL_ST_INV_ARG_4);
+    YAFL_CHECK(uph,      YAFL_ST_INV_ARG_5);
+    YAFL_CHECK(dph,      YAFL_ST_INV_ARG_6);
+
+    self->Kss    = kss;
+    self->Sss    = sss;
+    self->Uph    = uph;
+    self->Dph    = dph;
+    self->ss_tol = tol;
+    self->ss     = 0;
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/*k step predict cache memory, may be added to any LKF memory structure*/
+#define YAFL_LKF_PREDICT_N_MEMORY_MIXIN(nx) \
+    yaflFloat Fk[nx * nx];                  \
+    yaflFloat Uqk[((nx - 1) * nx)/2];       \
+    yaflFloat Dqk[nx];                      \
+    yaflFloat Fa[nx * nx];                  \
+    yaflFloat Uqa[((nx - 1) * nx)/2];       \
+    yaflFloat Dqa[nx]
+
+/*Enables k step predict cache, arguments are the mixin fields in order*/
+static inline yaflStatusEn yafl_lkf_set_predict_n(yaflLKFSt * self,              \
+                                                  yaflFloat * fk, yaflFloat * uqk, \
+                                                  yaflFloat * dqk, yaflFloat * fa, \
+                                                  yaflFloat * uqa, yaflFloat * dqa)
+{
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(fk,   YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(uqk,  YAFL_ST_INV_ARG_3);
+    YAFL_CHECK(dqk,  YAFL_ST_INV_ARG_4);
+    YAFL_CHECK(fa,   YAFL_ST_INV_ARG_5);
+    YAFL_CHECK(uqa,  YAFL_ST_INV_ARG_6);
+    YAFL_CHECK(dqa,  YAFL_ST_INV_ARG_7);
+
+    self->Fk   = fk;
+    self->Uqk  = uqk;
+    self->Dqk  = dqk;
+    self->Fa   = fa;
+    self->Uqa  = uqa;
+    self->Dqa  = dqa;
+    self->Nk   = 0;
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/*Marks F, Hm, Q or R as changed, must be called after any change*/
+static inline yaflStatusEn yafl_lkf_touch(yaflLKFSt * self)
+{
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    self->ver++;
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_lkf_base_predict(yaflKalmanBaseSt * self);
+
+/*Advances the filter k steps, uses the k step predict cache when set*/
+yaflStatusEn yafl_lkf_base_predict_n(yaflKalmanBaseSt * self, yaflInt k);
+
+/*Any EKF scalar update which uses yaflEKFBaseSt fields only may be used*/
+yaflStatusEn yafl_lkf_base_update(yaflKalmanBaseSt * self, yaflFloat * z, \
+                                  yaflKalmanScalarUpdateP scalar_update);
+
+/*---------------------------------------------------------------------------*/
+YAFL_KALMAN_PREDICT_WRAPPER(yafl_lkf_base_predict, yaflKalmanBaseSt, \
+                            yafl_lkf_predict, yaflLKFSt)
+
+static inline yaflStatusEn yafl_lkf_predict_n(yaflLKFSt * self, yaflInt k)
+{
+    return yafl_lkf_base_predict_n((yaflKalmanBaseSt *)self, k);
+}
+
+/*-----------------------------------------------------------------------------
+                            Bierman and Joseph filters
+-----------------------------------------------------------------------------*/
+static inline yaflStatusEn yafl_lkf_bierman_update(yaflLKFSt * self, \
+                                                   yaflFloat * z)
+{
+    return yafl_lkf_base_update((yaflKalmanBaseSt *)self, z, \
+                                yafl_ekf_bierman_update_scalar);
+}
+
+static inline yaflStatusEn yafl_lkf_joseph_update(yaflLKFSt * self, \
+                                                  yaflFloat * z)
+{
+    return yafl_lkf_base_update((yaflKalmanBaseSt *)self, z, \
+                                yafl_ekf_joseph_update_scalar);
+}
+
 /*=============================================================================
                     Basic UD-factorized UKF definitions
 =============================================================================*/
@@ -339,10 +942,17 @@ delta_x = x0 + factor * delta_x
 typedef yaflStatusEn (* yaflUKFSigmaAddP)(yaflUKFBaseSt *, yaflFloat *, \
                                           yaflFloat *, yaflFloat);
 
-/*Sigma point generator info base type*/
+/*
+Sigma point generator info base type.
+
+The weights depend on generator parameters only, so they are cached in
+a filter and are recomputed only when ver differs from the filter sp_ver.
+Any generator parameter change must be followed by yafl_ukf_sigma_touch.
+*/
 typedef struct _yaflUKFSigmaSt {
     yaflInt         np; /* The number of sigma points          */
     yaflUKFSigmaAddP addf; /* Sigma point addition function       */
+    yaflInt         ver; /* Parameter version                   */
 } yaflUKFSigmaSt;
 
 /*---------------------------------------------------------------------------*/
@@ -350,6 +960,16 @@ typedef struct _yaflUKFSigmaSt {
 {                                                         \
     .np   = (yaflInt)_np,                                 \
     .addf = (yaflUKFSigmaAddP)_addf,                      \
+    .ver  = 1                                             \
+}
+
+/*---------------------------------------------------------------------------*/
+/*Marks generator parameters as changed, must be called after any change*/
+static inline yaflStatusEn yafl_ukf_sigma_touch(yaflUKFSigmaSt * self)
+{
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    self->ver++;
+    return YAFL_ST_OK;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -364,6 +984,34 @@ typedef struct _yaflUKFSigmaMethodsSt {
     yaflUKFSigmaGenSigmasP  spgf; /* Sigma point generator function */
 } yaflUKFSigmaMethodsSt;
 
+/*---------------------------------------------------------------------------*/
+/*
+Batch sigma point function, propagates all the sigma points in one call.
+Parameters:
+yaflFloat * res    - np x nres result matrix (nres = nx for fb, nz for hb)
+yaflFloat * sigmas - np x nx sigma point matrix, may be equal to res
+yaflInt     np     - the number of sigma points
+*/
+typedef yaflStatusEn (* yaflUKFBatchFuncP)(yaflUKFBaseSt *, yaflFloat *, \
+                                           yaflFloat *, yaflInt);
+
+/*---------------------------------------------------------------------------*/
+/*
+Parallel for loop, used for sigma point propagation.
+Must call body(arg, i) for every i in [0, n) and return OR-ed statuses
+of the calls, the calls may run concurrently. yafl_sched_parfor may be used.
+*/
+typedef yaflStatusEn (* yaflUKFParForBodyP)(void *, yaflInt);
+typedef yaflStatusEn (* yaflUKFParForP)(void *, yaflInt, yaflUKFParForBodyP, \
+                                        void *);
+
+/*---------------------------------------------------------------------------*/
+/*Unscented transform covariance computation modes*/
+typedef enum {
+    YAFL_UKF_UT_SEQ   = 0, /* Rank-k update, then downdates by negative weight points (default) */
+    YAFL_UKF_UT_MWGSU = 1  /* Single MWGSU of sigma point residuals and noise factor            */
+} yaflUKFUTModeEn;
+
 /*---------------------------------------------------------------------------*/
 struct _yaflUKFBaseSt {
 
@@ -373,6 +1021,8 @@ struct _yaflUKFBaseSt {
     yaflUKFSigmaSt               * sp_info;
     /* A sigma point generator method table pointer     */
     const yaflUKFSigmaMethodsSt  * sp_meth;
+    /* sp_info->ver of the cached weights */
+    yaflInt                        sp_ver;
 
     yaflKalmanFuncP    xmf; /* State mean function              */
     yaflKalmanResFuncP xrf; /* State residual function function */
@@ -380,6 +1030,30 @@ struct _yaflUKFBaseSt {
     yaflKalmanFuncP    zmf; /* Measurement mean function function    */
     yaflFloat * zp; /* Predicted measurement vector */
 
+    /*
+    Optional batch versions of base.f and base.h, when set they are
+    used instead of base.f and base.h for sigma point propagation.
+    */
+    yaflUKFBatchFuncP fb; /* Batch state transition function */
+    yaflUKFBatchFuncP hb; /* Batch measurement function      */
+
+    yaflUKFUTModeEn ut_mode; /* Unscented transform mode */
+
+    /*
+    Optional sigma point propagation parallel for loop, NULL means sequential.
+
+    Reentrancy contract: when pfor is set, f and h are called concurrently
+    for different sigma points with the same filter pointer, so they:
+    - must write their output vectors only,
+    - must not modify the filter or use its scratchpad memory,
+    - must be thread safe with respect to any other shared data.
+    The results do not depend on pfor, see tests/src/ukf_par_check.c.
+    The speedup on several CPUs is not measured yet, tests/src/ukf_par_bench.c
+    times it.
+    */
+    yaflUKFParForP pfor;
+    void         * pfor_ctx; /* pfor context, e.g. a scheduler pointer */
+
     /*Scratchpad memory*/
     yaflFloat * Sx;  /* State       */
     yaflFloat * Pzx; /* Pzx cross covariance matrix */
@@ -388,12 +1062,25 @@ struct _yaflUKFBaseSt {
     yaflFloat * sigmas_z; /* Measurement sigma points */
     yaflFloat * wm;       /* Weights for mean calculations       */
     yaflFloat * wc;       /* Weights for covariance calculations */
+
+    /*
+    Unscented transform scratchpad memory, sizes are:
+    W: res_sz * (np + res_sz), res_sz = max(nx, nz)
+    D: np + res_sz
+    */
+    yaflFloat * W; /* Sigma point residuals and noise factor */
+    yaflFloat * D; /* Residual weights and noise diagonal    */
 };
 
 /*---------------------------------------------------------------------------*/
+/*Max of state and measurement sizes, used for scratchpad size computations*/
+#define YAFL_UKF_MAX_SZ(nx, nz) (((nx) > (nz)) ? (nx) : (nz))
+
 /*
-Warning: sigmas_x and _sigmas_z aren't defined in this mixin, see
-         sigma points generators mixins!!!
+Warning: wm, wc, sigmas_x, sigmas_z, W and D aren't defined in this mixin,
+         their sizes depend on the number of sigma points, so every
+         sigma point generator mixin provides them through
+         YAFL_UKF_SP_MEMORY_MIXIN!!!
 */
 #define YAFL_UKF_BASE_MEMORY_MIXIN(nx, nz) \
     YAFL_KALMAN_BASE_MEMORY_MIXIN(nx, nz);  \
@@ -411,11 +1098,19 @@ Warning: sigmas_x and _sigmas_z aren't defined in this mixin, see
                                                                               \
     .sp_info = _p,                                                            \
     .sp_meth = _pm,                                                           \
+    .sp_ver  = 0,                                                             \
+                                                                              \
+    .xmf = (yaflKalmanFuncP)_xmf,                                             \
+    .xrf = (yaflKalmanResFuncP)_xrf,                                          \
                                                                               \
-    .xmf = (yaflUKFFuncP)_xmf,                                                \
-    .xrf = (yaflUKFResFuncP)_xrf,                                             \
+    .zmf = (yaflKalmanFuncP)_zmf,                                             \
                                                                               \
-    .zmf = (yaflUKFFuncP)_zmf,                                                \
+    .fb  = 0,                                                                 \
+    .hb  = 0,                                                                 \
+                                                                              \
+    .ut_mode = YAFL_UKF_UT_SEQ,                                               \
+    .pfor     = 0,                                                            \
+    .pfor_ctx = 0,                                                            \
                                                                               \
     .zp  = _mem.zp,                                                           \
                                                                               \
@@ -426,32 +1121,84 @@ Warning: sigmas_x and _sigmas_z aren't defined in this mixin, see
     .sigmas_z  = _mem.sigmas_z,                                               \
                                                                               \
     .wm   = _mem.wm,                                                          \
-    .wc   = _mem.wc                                                           \
+    .wc   = _mem.wc,                                                          \
+                                                                              \
+    .W    = _mem.W,                                                           \
+    .D    = _mem.D                                                            \
 }
 
 /*---------------------------------------------------------------------------*/
+/*Recomputes the weights if the generator parameters have changed*/
+static inline yaflStatusEn yafl_ukf_update_weights(yaflUKFBaseSt * self)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+
+    YAFL_CHECK(self,              YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->sp_info,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->sp_meth,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->sp_meth->wf, YAFL_ST_INV_ARG_1);
+
+    if (self->sp_ver != self->sp_info->ver)
+    {
+        YAFL_TRY(status, self->sp_meth->wf(self));
+        self->sp_ver = self->sp_info->ver;
+    }
+    return status;
+}
+
+/*
+Must be called before start and after sp_info or sp_meth change,
+computes the weights unconditionally.
+*/
 static inline yaflStatusEn yafl_ukf_post_init(yaflUKFBaseSt * self)
 {
+    yaflStatusEn status = YAFL_ST_OK;
+
     YAFL_CHECK(self,              YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->sp_info,     YAFL_ST_INV_ARG_1);
     YAFL_CHECK(self->sp_meth,     YAFL_ST_INV_ARG_1);
     YAFL_CHECK(self->sp_meth->wf, YAFL_ST_INV_ARG_1);
-    return self->sp_meth->wf(self); /*Need to compute weights before start*/
+
+    YAFL_TRY(status, self->sp_meth->wf(self));
+    self->sp_ver = self->sp_info->ver;
+    return status;
 }
 
 static inline yaflStatusEn yafl_ukf_gen_sigmas(yaflUKFBaseSt * self)
 {
+    yaflStatusEn status = YAFL_ST_OK;
+
     YAFL_CHECK(self,                YAFL_ST_INV_ARG_1);
     YAFL_CHECK(self->sp_meth,       YAFL_ST_INV_ARG_1);
     YAFL_CHECK(self->sp_meth->spgf, YAFL_ST_INV_ARG_1);
-    self->sp_meth->spgf(self);
-    return self->sp_meth->wf(self);
+    YAFL_TRY(status, self->sp_meth->spgf(self));
+    YAFL_TRY(status, yafl_ukf_update_weights(self));
+    return status;
 }
 
 yaflStatusEn yafl_ukf_base_predict(yaflUKFBaseSt * self);
 
+/*
+Advances the filter k steps, sigma points are regenerated on every step.
+This is a loop of k predicts, it is not faster than them.
+*/
+yaflStatusEn yafl_ukf_base_predict_n(yaflUKFBaseSt * self, yaflInt k);
+
 yaflStatusEn yafl_ukf_base_update(yaflUKFBaseSt * self, yaflFloat * z, \
                                   yaflKalmanScalarUpdateP scalar_update);
 
+/*
+Read only gating, see yafl_ekf_base_gate, must be called after predict.
+Measurement sigmas are computed once and S is the unscented transform
+result. x, y, Up and Dp are not changed.
+Scratchpad size limit: nz <= nx, YAFL_ST_INV_ARG_1 is returned otherwise.
+zp, Pzx, Sx, W, D and the measurement sigmas are clobbered,
+yafl_ukf_base_update recomputes all of them, so only custom code which
+expects them to keep values from predict must not call the gate.
+*/
+yaflStatusEn yafl_ukf_base_gate(yaflUKFBaseSt * self, yaflFloat * z, \
+                                yaflInt n, yaflFloat * d2);
+
 /*---------------------------------------------------------------------------*/
 #define YAFL_UKF_PREDICT_WRAPPER(func, self_type)                     \
     YAFL_KALMAN_PREDICT_WRAPPER(yafl_ukf_base_predict, yaflUKFBaseSt, \
@@ -547,8 +1294,10 @@ typedef struct {
 
 /*---------------------------------------------------------------------------*/
 /*
-Warning: sigmas_x and _sigmas_z aren't defined in this mixin, see
-         sigma points generators mixins!!!
+Warning: wm, wc, sigmas_x, sigmas_z, W and D aren't defined in this mixin,
+         their sizes depend on the number of sigma points, so every
+         sigma point generator mixin provides them through
+         YAFL_UKF_SP_MEMORY_MIXIN!!!
 */
 #define YAFL_UKF_MEMORY_MIXIN(nx, nz)   \
     YAFL_UKF_BASE_MEMORY_MIXIN(nx, nz); \
@@ -594,6 +1343,19 @@ static inline \
 }
 
 yaflStatusEn yafl_ukf_adaptive_update(yaflUKFBaseSt * self, yaflFloat * z);
+/*=============================================================================
+                     Sigma point generators common memory
+=============================================================================*/
+/*Sigma points, weights and unscented transform scratchpad for np points*/
+#define YAFL_UKF_SP_MEMORY_MIXIN(np, nx, nz)                   \
+    yaflFloat wm[np];                                          \
+    yaflFloat wc[np];                                          \
+    yaflFloat sigmas_x[(np) * nx];                             \
+    yaflFloat sigmas_z[(np) * nz];                             \
+    yaflFloat W[((np) + YAFL_UKF_MAX_SZ(nx, nz)) *             \
+                YAFL_UKF_MAX_SZ(nx, nz)];                      \
+    yaflFloat D[(np) + YAFL_UKF_MAX_SZ(nx, nz)]
+
 /*=============================================================================
                      Van der Merwe sigma point generator
 =============================================================================*/
@@ -606,10 +1368,7 @@ typedef struct _yaflUKFMerweSt {
 
 /*---------------------------------------------------------------------------*/
 #define YAFL_UKF_MERWE_MEMORY_MIXIN(nx, nz) \
-    yaflFloat wm[2 * nx + 1];               \
-    yaflFloat wc[2 * nx + 1];               \
-    yaflFloat sigmas_x[(2 * nx + 1) * nx];  \
-    yaflFloat sigmas_z[(2 * nx + 1) * nz]
+    YAFL_UKF_SP_MEMORY_MIXIN((2 * nx + 1), nx, nz)
 
 /*---------------------------------------------------------------------------*/
 #define YAFL_UKF_MERWE_INITIALIZER(_nx, _addf, _alpha, _beta, _kappa, _mem) \
@@ -621,6 +1380,75 @@ typedef struct _yaflUKFMerweSt {
 }
 
 /*---------------------------------------------------------------------------*/
-const yaflUKFSigmaMethodsSt yafl_ukf_merwe_spm;
+extern const yaflUKFSigmaMethodsSt yafl_ukf_merwe_spm;
+
+/*=============================================================================
+                       Simplex sigma point generator
+=============================================================================*/
+/*
+Julier and Uhlmann minimal skew simplex: nx + 1 points, the set with
+the center point weight w0 = 0, which matches the mean and covariance
+and has zero marginal skew of the unit points. The weights are
+w1 = 1 / 2**nx for the points 0 and 1 and 2**(i - 1) * w1 for the point i,
+so all of them are positive, but the point spread grows as 2**(nx / 2),
+use the spherical simplex for large nx. Uses yaflUKFSigmaSt as is.
+
+S. J. Julier, J. K. Uhlmann, "Reduced sigma point filters for the
+propagation of means and covariances through nonlinear transformations",
+Proceedings of the American Control Conference, 2002.
+*/
+#define YAFL_UKF_SIMPLEX_MEMORY_MIXIN(nx, nz) \
+    YAFL_UKF_SP_MEMORY_MIXIN((nx + 1), nx, nz)
+
+/*---------------------------------------------------------------------------*/
+#define YAFL_UKF_SIMPLEX_INITIALIZER(_nx, _addf, _mem) \
+    YAFL_UKF_SIGMA_BASE_INITIALIZER((_nx + 1), _addf, _mem)
+
+/*---------------------------------------------------------------------------*/
+extern const yaflUKFSigmaMethodsSt yafl_ukf_simplex_spm;
+
+/*=============================================================================
+                   Julier spherical simplex sigma point generator
+=============================================================================*/
+/*
+nx + 1 points on a sphere with equal weights (1 - w0) / (nx + 1)
+and the center point with the weight w0, 0 <= w0 < 1. With w0 = 0
+it is the regular simplex with equal weights 1 / (nx + 1).
+*/
+typedef struct _yaflUKFSphericalSt {
+    yaflUKFSigmaSt base;
+    yaflFloat w0;
+} yaflUKFSphericalSt;
+
+/*---------------------------------------------------------------------------*/
+#define YAFL_UKF_SPHERICAL_MEMORY_MIXIN(nx, nz) \
+    YAFL_UKF_SP_MEMORY_MIXIN((nx + 2), nx, nz)
+
+/*---------------------------------------------------------------------------*/
+#define YAFL_UKF_SPHERICAL_INITIALIZER(_nx, _addf, _w0, _mem)             \
+{                                                                         \
+    .base = YAFL_UKF_SIGMA_BASE_INITIALIZER((_nx + 2), _addf, _mem),      \
+    .w0   = _w0                                                           \
+}
+
+/*---------------------------------------------------------------------------*/
+extern const yaflUKFSigmaMethodsSt yafl_ukf_spherical_spm;
+
+/*=============================================================================
+                      Cubature rule sigma point generator
+=============================================================================*/
+/*
+Third degree cubature rule: 2 * nx points with equal weights 1 / (2 * nx),
+no center point, so no negative weights. Uses yaflUKFSigmaSt as is.
+*/
+#define YAFL_UKF_CUBATURE_MEMORY_MIXIN(nx, nz) \
+    YAFL_UKF_SP_MEMORY_MIXIN((2 * nx), nx, nz)
+
+/*---------------------------------------------------------------------------*/
+#define YAFL_UKF_CUBATURE_INITIALIZER(_nx, _addf, _mem) \
+    YAFL_UKF_SIGMA_BASE_INITIALIZER((2 * _nx), _addf, _mem)
+
+/*---------------------------------------------------------------------------*/
+extern const yaflUKFSigmaMethodsSt yafl_ukf_cubature_spm;
 
 #endif // YAFL_H
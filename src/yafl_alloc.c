@@ -0,0 +1,357 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+#include <string.h>
+
+#include "yafl_alloc.h"
+
+/*=============================================================================
+                                    Arena
+=============================================================================*/
+/*Aligns mem start, returns the aligned size*/
+static inline size_t _align_mem(uint8_t ** mem, size_t size)
+{
+    size_t head = YAFL_ALIGN_UP((uintptr_t)*mem) - (uintptr_t)*mem;
+
+    if (head > size)
+    {
+        return 0;
+    }
+    *mem += head;
+    return size - head;
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_arena_init(yaflArenaSt * self, void * mem, size_t size)
+{
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(mem,  YAFL_ST_INV_ARG_2);
+
+    self->mem  = (uint8_t *)mem;
+    self->size = _align_mem(&self->mem, size);
+    self->used = 0;
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+void * yafl_arena_alloc(yaflArenaSt * self, size_t size)
+{
+    void * res;
+
+    if (!self || !self->mem || (size > self->size - self->used))
+    {
+        return 0;
+    }
+
+    res = (void *)(self->mem + self->used);
+    /*self->size may be unaligned, so the last block is not padded*/
+    self->used += size;
+    self->used  = (YAFL_ALIGN_UP(self->used) < self->size) ? \
+                  YAFL_ALIGN_UP(self->used) : self->size;
+    return res;
+}
+
+/*=============================================================================
+                                    Pool
+=============================================================================*/
+yaflStatusEn yafl_pool_init(yaflPoolSt * self, void * mem, size_t size, \
+                            size_t slot)
+{
+    yaflInt i;
+
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(mem,  YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(slot, YAFL_ST_INV_ARG_4);
+
+    self->mem  = (uint8_t *)mem;
+    size       = _align_mem(&self->mem, size);
+    self->slot = YAFL_ALIGN_UP((slot > sizeof(void *)) ? slot : sizeof(void *));
+    self->n    = (yaflInt)(size / self->slot);
+
+    /*The list is built from the end, so the slots are given in address order*/
+    self->free = 0;
+    for (i = self->n - 1; i >= 0; i--)
+    {
+        void ** p = (void **)(self->mem + self->slot * i);
+        *p = self->free;
+        self->free = (void *)p;
+    }
+    self->nfree = self->n;
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+void * yafl_pool_alloc(yaflPoolSt * self)
+{
+    void ** res;
+
+    if (!self || !self->free)
+    {
+        return 0;
+    }
+
+    res = (void **)self->free;
+    self->free = *res;
+    self->nfree--;
+    return (void *)res;
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_pool_free(yaflPoolSt * self, void * slot)
+{
+    size_t off;
+
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK((uint8_t *)slot >= self->mem, YAFL_ST_INV_ARG_2);
+
+    off = (size_t)((uint8_t *)slot - self->mem);
+    YAFL_CHECK(off < self->slot * (size_t)self->n, YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(0 == off % self->slot,              YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(self->nfree < self->n,              YAFL_ST_INV_ARG_2);
+
+    *(void **)slot = self->free;
+    self->free = slot;
+    self->nfree++;
+    return YAFL_ST_OK;
+}
+
+/*=============================================================================
+                                Block layouts
+=============================================================================*/
+/*
+Layout functions compute the block size when mem is 0,
+and set the filter array pointers otherwise.
+*/
+#define _TAKE(dst, n)                                            \
+do {                                                             \
+    if (mem)                                                     \
+    {                                                            \
+        dst = (yaflFloat *)(mem + off);                          \
+    }                                                            \
+    off = YAFL_ALIGN_UP(off + (size_t)(n) * sizeof(yaflFloat));  \
+} while (0)
+
+/*---------------------------------------------------------------------------*/
+static size_t _kalman_layout(yaflKalmanBaseSt * self, uint8_t * mem, \
+                             size_t off, yaflInt nx, yaflInt nz)
+{
+    _TAKE(self->x,  nx);
+    _TAKE(self->y,  nz);
+
+    _TAKE(self->Up, YAFL_U_SZ(nx));
+    _TAKE(self->Dp, nx);
+
+    _TAKE(self->Uq, YAFL_U_SZ(nx));
+    _TAKE(self->Dq, nx);
+
+    _TAKE(self->Ur, YAFL_U_SZ(nz));
+    _TAKE(self->Dr, nz);
+    return off;
+}
+
+/*---------------------------------------------------------------------------*/
+static size_t _ekf_layout(uint8_t * mem, yaflInt nx, yaflInt nz)
+{
+    yaflEKFBaseSt * self = (yaflEKFBaseSt *)mem;
+    size_t off = YAFL_ALIGN_UP(sizeof(yaflEKFBaseSt));
+
+    off = _kalman_layout(&self->base, mem, off, nx, nz);
+
+    _TAKE(self->H, nz * nx);
+    _TAKE(self->W, 2 * nx * nx);
+    _TAKE(self->D, 2 * nx);
+    return off;
+}
+
+/*---------------------------------------------------------------------------*/
+/*off is the size of the headers placed before the filter arrays*/
+static size_t _ukf_layout(yaflUKFSt * self, uint8_t * mem, size_t off, \
+                          yaflInt nx, yaflInt nz, yaflInt np)
+{
+    yaflInt sz = YAFL_UKF_MAX_SZ(nx, nz);
+
+    off = _kalman_layout(&self->base.base, mem, off, nx, nz);
+
+    _TAKE(self->base.zp,  nz);
+    _TAKE(self->base.Pzx, nz * nx);
+    _TAKE(self->base.Sx,  nx);
+
+    _TAKE(self->Us, YAFL_U_SZ(nz));
+    _TAKE(self->Ds, nz);
+
+    /*YAFL_UKF_SP_MEMORY_MIXIN*/
+    _TAKE(self->base.wm,       np);
+    _TAKE(self->base.wc,       np);
+    _TAKE(self->base.sigmas_x, np * nx);
+    _TAKE(self->base.sigmas_z, np * nz);
+    _TAKE(self->base.W,        (np + sz) * sz);
+    _TAKE(self->base.D,        np + sz);
+    return off;
+}
+
+#undef _NU
+#undef _TAKE
+
+/*=============================================================================
+                                    EKF
+=============================================================================*/
+size_t yafl_ekf_mem_size(yaflInt nx, yaflInt nz)
+{
+    if ((nx < 1) || (nz < 1))
+    {
+        return 0;
+    }
+    return _ekf_layout(0, nx, nz);
+}
+
+/*---------------------------------------------------------------------------*/
+yaflEKFBaseSt * yafl_ekf_create(void * mem, yaflKalmanFuncP f,           \
+                                yaflKalmanFuncP jf, yaflKalmanFuncP h,   \
+                                yaflKalmanFuncP jh, yaflKalmanResFuncP zrf, \
+                                yaflInt nx, yaflInt nz)
+{
+    yaflEKFBaseSt * self = (yaflEKFBaseSt *)mem;
+
+    if (!mem || ((uintptr_t)mem % YAFL_ALIGN) || (nx < 1) || (nz < 1))
+    {
+        return 0;
+    }
+
+    /*Zeroes the structure too, so all optional features are off*/
+    memset(mem, 0, _ekf_layout(0, nx, nz));
+    _ekf_layout((uint8_t *)mem, nx, nz);
+
+    self->base.f   = f;
+    self->base.h   = h;
+    self->base.zrf = zrf;
+    self->base.Nx  = nx;
+    self->base.Nz  = nz;
+
+    self->jf = jf;
+    self->jh = jh;
+    return self;
+}
+
+/*=============================================================================
+                                    UKF
+=============================================================================*/
+static yaflUKFSt * _ukf_init(uint8_t * mem, size_t off,                   \
+                             yaflUKFSigmaSt * sp,                         \
+                             const yaflUKFSigmaMethodsSt * spm,           \
+                             yaflKalmanFuncP f, yaflKalmanFuncP xmf,      \
+                             yaflKalmanResFuncP xrf, yaflKalmanFuncP h,   \
+                             yaflKalmanFuncP zmf, yaflKalmanResFuncP zrf, \
+                             yaflInt nx, yaflInt nz)
+{
+    yaflUKFSt * self = (yaflUKFSt *)mem;
+
+    /*Headers are set by caller, so the arrays only are zeroed*/
+    memset(mem + off, 0, _ukf_layout(0, 0, off, nx, nz, sp->np) - off);
+    memset(mem, 0, sizeof(yaflUKFSt));
+    _ukf_layout(self, mem, off, nx, nz, sp->np);
+
+    self->base.base.f   = f;
+    self->base.base.h   = h;
+    self->base.base.zrf = zrf;
+    self->base.base.Nx  = nx;
+    self->base.base.Nz  = nz;
+
+    self->base.sp_info = sp;
+    self->base.sp_meth = spm;
+    self->base.xmf     = xmf;
+    self->base.xrf     = xrf;
+    self->base.zmf     = zmf;
+    self->base.ut_mode = YAFL_UKF_UT_SEQ;
+
+    if (yafl_ukf_post_init(&self->base) >= YAFL_ST_ERR_THR)
+    {
+        return 0;
+    }
+    return self;
+}
+
+/*---------------------------------------------------------------------------*/
+size_t yafl_ukf_mem_size(yaflInt nx, yaflInt nz, yaflInt np)
+{
+    if ((nx < 1) || (nz < 1) || (np < 1))
+    {
+        return 0;
+    }
+    return _ukf_layout(0, 0, YAFL_ALIGN_UP(sizeof(yaflUKFSt)), nx, nz, np);
+}
+
+/*---------------------------------------------------------------------------*/
+yaflUKFSt * yafl_ukf_create(void * mem, yaflUKFSigmaSt * sp,              \
+                            const yaflUKFSigmaMethodsSt * spm,            \
+                            yaflKalmanFuncP f, yaflKalmanFuncP xmf,       \
+                            yaflKalmanResFuncP xrf, yaflKalmanFuncP h,    \
+                            yaflKalmanFuncP zmf, yaflKalmanResFuncP zrf,  \
+                            yaflInt nx, yaflInt nz)
+{
+    if (!mem || ((uintptr_t)mem % YAFL_ALIGN) || !sp || !spm || \
+        (nx < 1) || (nz < 1) || (sp->np < 1))
+    {
+        return 0;
+    }
+
+    return _ukf_init((uint8_t *)mem, YAFL_ALIGN_UP(sizeof(yaflUKFSt)), sp, \
+                     spm, f, xmf, xrf, h, zmf, zrf, nx, nz);
+}
+
+/*---------------------------------------------------------------------------*/
+#define _MERWE_HDR_SZ \
+    (YAFL_ALIGN_UP(sizeof(yaflUKFSt)) + YAFL_ALIGN_UP(sizeof(yaflUKFMerweSt)))
+
+size_t yafl_ukf_merwe_mem_size(yaflInt nx, yaflInt nz)
+{
+    if ((nx < 1) || (nz < 1))
+    {
+        return 0;
+    }
+    return _ukf_layout(0, 0, _MERWE_HDR_SZ, nx, nz, 2 * nx + 1);
+}
+
+/*---------------------------------------------------------------------------*/
+yaflUKFSt * yafl_ukf_merwe_create(void * mem, yaflKalmanFuncP f,           \
+                                  yaflKalmanFuncP xmf,                     \
+                                  yaflKalmanResFuncP xrf,                  \
+                                  yaflKalmanFuncP h, yaflKalmanFuncP zmf,  \
+                                  yaflKalmanResFuncP zrf,                  \
+                                  yaflInt nx, yaflInt nz, yaflFloat alpha, \
+                                  yaflFloat beta, yaflFloat kappa)
+{
+    yaflUKFMerweSt * sp;
+
+    if (!mem || ((uintptr_t)mem % YAFL_ALIGN) || (nx < 1) || (nz < 1))
+    {
+        return 0;
+    }
+
+    /*The generator goes right after the filter structure*/
+    sp = (yaflUKFMerweSt *)((uint8_t *)mem + YAFL_ALIGN_UP(sizeof(yaflUKFSt)));
+
+    sp->base.np   = 2 * nx + 1;
+    sp->base.addf = 0;
+    sp->base.ver  = 1;
+    sp->alpha     = alpha;
+    sp->beta      = beta;
+    sp->kappa     = kappa;
+
+    return _ukf_init((uint8_t *)mem, _MERWE_HDR_SZ, &sp->base, \
+                     &yafl_ukf_merwe_spm, f, xmf, xrf, h, zmf, zrf, nx, nz);
+}
+
+#undef _MERWE_HDR_SZ
@@ -0,0 +1,137 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+#ifndef YAFL_ALLOC_H
+#define YAFL_ALLOC_H
+
+#include <stddef.h>
+
+#include <yafl_config.h>
+#include "yafl.h"
+
+/*=============================================================================
+                     Runtime filter allocation and placement
+=============================================================================*/
+/*
+Filters created at run time are placed in one contiguous block:
+the filter structure goes first, then all its arrays, every part of the
+block starts at YAFL_ALIGN byte boundary, so the blocks must be YAFL_ALIGN
+aligned. The blocks may be taken from an arena or a pool, see below.
+*/
+#ifndef YAFL_ALIGN
+#   define YAFL_ALIGN 64 /*Cache line size, must be a power of 2*/
+#endif/*YAFL_ALIGN*/
+
+#define YAFL_ALIGN_UP(n) \
+    (((size_t)(n) + (YAFL_ALIGN - 1)) & ~((size_t)(YAFL_ALIGN - 1)))
+
+/*-----------------------------------------------------------------------------
+                                    Arena
+-----------------------------------------------------------------------------*/
+/*Bump allocator, blocks are freed all at once by yafl_arena_reset*/
+typedef struct _yaflArenaSt {
+    uint8_t * mem;  /*Aligned arena memory*/
+    size_t    size; /*Arena size*/
+    size_t    used; /*Used memory size*/
+} yaflArenaSt;
+
+/*Memory may be unaligned, unaligned head is skipped*/
+yaflStatusEn yafl_arena_init(yaflArenaSt * self, void * mem, size_t size);
+
+/*Returns YAFL_ALIGN aligned block or 0 if there is no memory*/
+void * yafl_arena_alloc(yaflArenaSt * self, size_t size);
+
+static inline yaflStatusEn yafl_arena_reset(yaflArenaSt * self)
+{
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    self->used = 0;
+    return YAFL_ST_OK;
+}
+
+/*-----------------------------------------------------------------------------
+                                    Pool
+-----------------------------------------------------------------------------*/
+/*
+Fixed size slot allocator for filter recycling, alloc and free are O(1),
+free slots are kept in a linked list stored in the slots.
+*/
+typedef struct _yaflPoolSt {
+    uint8_t * mem;  /*Aligned pool memory*/
+    size_t    slot; /*Aligned slot size*/
+    yaflInt   n;    /*The number of slots*/
+    yaflInt   nfree; /*The number of free slots*/
+    void    * free; /*Free slot list head*/
+} yaflPoolSt;
+
+/*Memory may be unaligned, unaligned head is skipped*/
+yaflStatusEn yafl_pool_init(yaflPoolSt * self, void * mem, size_t size, \
+                            size_t slot);
+
+/*Returns a YAFL_ALIGN aligned slot or 0 if there are no free slots*/
+void * yafl_pool_alloc(yaflPoolSt * self);
+
+yaflStatusEn yafl_pool_free(yaflPoolSt * self, void * slot);
+
+/*-----------------------------------------------------------------------------
+                                    EKF
+-----------------------------------------------------------------------------*/
+/*Exact block size of yafl_ekf_create filter*/
+size_t yafl_ekf_mem_size(yaflInt nx, yaflInt nz);
+
+/*
+Places yaflEKFBaseSt with YAFL_EKF_BASE_MEMORY_MIXIN arrays in mem,
+which must be at least yafl_ekf_mem_size(nx, nz) bytes. All the arrays
+are zeroed. Returns 0 on invalid arguments, so allocator results may be
+passed as is, e.g.:
+kf = yafl_ekf_create(yafl_pool_alloc(&pool), f, jf, h, jh, 0, nx, nz);
+*/
+yaflEKFBaseSt * yafl_ekf_create(void * mem, yaflKalmanFuncP f,           \
+                                yaflKalmanFuncP jf, yaflKalmanFuncP h,   \
+                                yaflKalmanFuncP jh, yaflKalmanResFuncP zrf, \
+                                yaflInt nx, yaflInt nz);
+
+/*-----------------------------------------------------------------------------
+                                    UKF
+-----------------------------------------------------------------------------*/
+/*Exact block size of yafl_ukf_create filter with np sigma points*/
+size_t yafl_ukf_mem_size(yaflInt nx, yaflInt nz, yaflInt np);
+
+/*
+Places yaflUKFSt with its arrays, including sigma point generator
+memory for sp->np points, in mem, which must be at least
+yafl_ukf_mem_size(nx, nz, sp->np) bytes. The weights are computed by
+yafl_ukf_post_init. May be used with all the UKF except adaptive ones.
+*/
+yaflUKFSt * yafl_ukf_create(void * mem, yaflUKFSigmaSt * sp,              \
+                            const yaflUKFSigmaMethodsSt * spm,            \
+                            yaflKalmanFuncP f, yaflKalmanFuncP xmf,       \
+                            yaflKalmanResFuncP xrf, yaflKalmanFuncP h,    \
+                            yaflKalmanFuncP zmf, yaflKalmanResFuncP zrf,  \
+                            yaflInt nx, yaflInt nz);
+
+/*Exact block size of yafl_ukf_merwe_create filter*/
+size_t yafl_ukf_merwe_mem_size(yaflInt nx, yaflInt nz);
+
+/*The same as yafl_ukf_create, yaflUKFMerweSt is placed in mem too*/
+yaflUKFSt * yafl_ukf_merwe_create(void * mem, yaflKalmanFuncP f,           \
+                                  yaflKalmanFuncP xmf,                     \
+                                  yaflKalmanResFuncP xrf,                  \
+                                  yaflKalmanFuncP h, yaflKalmanFuncP zmf,  \
+                                  yaflKalmanResFuncP zrf,                  \
+                                  yaflInt nx, yaflInt nz, yaflFloat alpha, \
+                                  yaflFloat beta, yaflFloat kappa);
+
+#endif // YAFL_ALLOC_H
@@ -0,0 +1,845 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+#include <string.h>
+
+#include "yafl_fleet.h"
+
+/*
+Lane loops pay off only when they are vectorized with wide enough vectors:
+GCC does not vectorize them at -O2 and SSE2 lanes do not cover the SoA
+overhead. So with GNU C on x86-64 the loop vectorizer is enabled for this
+file and the kernels are built for AVX2 and for the baseline ISA, the
+version is selected at load time (see target_clones in the GCC manual).
+Define YAFL_FLEET_NO_CLONES to build the kernels with the user flags only.
+*/
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && \
+    !defined(YAFL_FLEET_NO_CLONES)
+#   pragma GCC optimize ("tree-loop-vectorize", "vect-cost-model=dynamic")
+#   define _FLEET_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#   define _FLEET_KERNEL
+#endif
+
+#define _FX  (self->f)
+#define _JFX (self->jf)
+#define _HX  (self->h)
+#define _JHX (self->jh)
+
+#define _X   (self->x)
+#define _Y   (self->y)
+
+#define _UP  (self->Up)
+#define _DP  (self->Dp)
+
+#define _UQ  (self->Uq)
+#define _DQ  (self->Dq)
+
+#define _UR  (self->Ur)
+#define _DR  (self->Dr)
+
+#define _HY  (self->H)
+#define _W   (self->W)
+#define _D   (self->D)
+
+#define _NX  (self->Nx)
+#define _NZ  (self->Nz)
+#define _N   (self->N)
+
+#define _B   YAFL_FLEET_BLK
+
+/*
+Lane vector element access.
+Element e of the filter l, n is the lane vector size, l is the lane index,
+both must be defined in the scope.
+*/
+#define _E(p, e) ((p)[(e) * n + l])
+
+/*---------------------------------------------------------------------------*/
+/*Computes block mask, returns nonzero if there are filters to process*/
+static inline yaflInt _block_mask(uint8_t * res, uint8_t * mask, yaflInt nl)
+{
+    yaflInt l;
+    yaflInt any = 0;
+
+    for (l = 0; l < nl; l++)
+    {
+        res[l] = mask ? (0 != mask[l]) : 1;
+        any |= res[l];
+    }
+    return any;
+}
+
+/*=============================================================================
+                Lane vector versions of yafl_math functions
+                  (all the pointers are lane vector bases)
+=============================================================================*/
+/* res = a.T.dot(u), see yafl_math_set_vtu */
+static inline void _fleet_vtu(yaflInt n, yaflInt nl, yaflInt sz, \
+                              yaflFloat *res, yaflFloat *a, yaflFloat *u)
+{
+    yaflInt j;
+    yaflInt szj;
+    yaflInt l;
+
+    for (j = 0; j < sz; j++)
+    {
+        for (l = 0; l < nl; l++)
+        {
+            _E(res, j) = _E(a, j);
+        }
+    }
+
+    for (szj = 0, j = 1; j < sz; szj += j++)
+    {
+        yaflInt k;
+
+        for (k = 0; k < j; k++)
+        {
+            for (l = 0; l < nl; l++)
+            {
+                _E(res, j) += _E(a, k) * _E(u, k + szj);
+            }
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/* res = u.dot(b), see yafl_math_set_uv */
+static inline void _fleet_uv(yaflInt n, yaflInt nl, yaflInt sz, \
+                             yaflFloat *res, yaflFloat *u, yaflFloat *b)
+{
+    yaflInt j;
+    yaflInt szj;
+    yaflInt l;
+
+    for (j = 0; j < sz; j++)
+    {
+        for (l = 0; l < nl; l++)
+        {
+            _E(res, j) = _E(b, j);
+        }
+    }
+
+    for (szj = 0, j = 1; j < sz; szj += j++)
+    {
+        yaflInt k;
+
+        for (k = 0; k < j; k++)
+        {
+            for (l = 0; l < nl; l++)
+            {
+                _E(res, k) += _E(u, k + szj) * _E(b, j);
+            }
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/* res = inv(u).dot(res), see yafl_math_ruv */
+static inline void _fleet_ruv(yaflInt n, yaflInt nl, yaflInt sz, \
+                              yaflFloat *res, yaflFloat *u)
+{
+    yaflInt j;
+    yaflInt szj;
+
+    for (j = sz - 1, szj = ((j - 1) * j) / 2; j > 0; szj -= --j)
+    {
+        yaflInt i;
+
+        for (i = j - 1; i >= 0; i--)
+        {
+            yaflInt l;
+
+            for (l = 0; l < nl; l++)
+            {
+                _E(res, i) -= _E(u, i + szj) * _E(res, j);
+            }
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/* res = inv(u).dot(res), see yafl_math_rum */
+static inline void _fleet_rum(yaflInt n, yaflInt nl, yaflInt nr, yaflInt nc, \
+                              yaflFloat *res, yaflFloat *u)
+{
+    yaflInt j;
+    yaflInt nrj;
+
+    for (j = nr - 1, nrj = ((j - 1) * j) / 2; j > 0; nrj -= --j)
+    {
+        yaflInt ncj;
+        yaflInt i;
+
+        ncj = nc * j;
+
+        for (i = j - 1; i >= 0; i--)
+        {
+            yaflInt k;
+            yaflInt nci;
+
+            nci = nc * i;
+
+            for (k = nc - 1; k >= 0; k--)
+            {
+                yaflInt l;
+
+                for (l = 0; l < nl; l++)
+                {
+                    _E(res, nci + k) -= _E(u, i + nrj) * _E(res, ncj + k);
+                }
+            }
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*
+MWGSU for a block of nl filters, see yafl_math_mwgsu.
+res_u and res_d are updated for filters with nonzero m[l] only.
+*/
+_FLEET_KERNEL
+static yaflStatusEn _fleet_mwgsu(yaflInt n, yaflInt nl, uint8_t * m,   \
+                                 yaflInt nr, yaflInt nc,               \
+                                 yaflFloat *res_u, yaflFloat *res_d,   \
+                                 yaflFloat *w, yaflFloat *d)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt j;
+    yaflInt nrj;
+
+    for (j = nr - 1, nrj = ((j - 1) * j) / 2; j >= 0; nrj -= --j)
+    {
+        yaflInt   ncj;
+        yaflInt   k;
+        yaflInt   l;
+        yaflInt   reg = 0;
+        yaflFloat res_dj[_B];
+        yaflFloat rdj[_B];
+
+        ncj = nc * j;
+
+        for (l = 0; l < nl; l++)
+        {
+            yaflFloat wjk;
+
+            wjk = _E(w, ncj + nc - 1);
+            res_dj[l] = wjk * wjk * _E(d, nc - 1);
+        }
+
+        for (k = nc - 2; k >= 0; k--)
+        {
+            for (l = 0; l < nl; l++)
+            {
+                yaflFloat wjk;
+
+                wjk = _E(w, ncj + k);
+                res_dj[l] += wjk * wjk * _E(d, k);
+            }
+        }
+
+        /*Branchless regularization, res_u[:j,j] will be zero*/
+        for (l = 0; l < nl; l++)
+        {
+            yaflInt regl;
+
+            regl = (res_dj[l] < YAFL_EPS);
+            reg |= regl & m[l];
+
+            rdj[l]    = regl ? 0.0      : 1.0 / res_dj[l];
+            res_dj[l] = regl ? YAFL_EPS : res_dj[l];
+
+            _E(res_d, j) = m[l] ? res_dj[l] : _E(res_d, j);
+        }
+
+        if (reg)
+        {
+            status |= YAFL_ST_MSK_REGULARIZED;
+        }
+
+        for (k = j - 1; k >= 0; k--)
+        {
+            yaflInt   nck;
+            yaflInt   i;
+            yaflFloat ukj[_B];
+
+            nck = nc * k;
+
+            for (l = 0; l < nl; l++)
+            {
+                ukj[l] = _E(w, nck) * _E(d, 0) * _E(w, ncj);
+            }
+
+            for (i = 1; i < nc; i++)
+            {
+                for (l = 0; l < nl; l++)
+                {
+                    ukj[l] += _E(w, nck + i) * _E(d, i) * _E(w, ncj + i);
+                }
+            }
+
+            for (l = 0; l < nl; l++)
+            {
+                ukj[l] *= rdj[l];
+                _E(res_u, k + nrj) = m[l] ? ukj[l] : _E(res_u, k + nrj);
+            }
+
+            for (i = 0; i < nc; i++)
+            {
+                for (l = 0; l < nl; l++)
+                {
+                    _E(w, nck + i) -= ukj[l] * _E(w, ncj + i);
+                }
+            }
+        }
+    }
+    return status;
+}
+
+/*=============================================================================
+                                Fleet predict
+=============================================================================*/
+_FLEET_KERNEL
+yaflStatusEn yafl_fleet_predict(yaflFleetSt * self)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt n;
+    yaflInt nx;
+    yaflInt nx2;
+    yaflInt l0;
+
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(_UP,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_DP,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UQ,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_DQ,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_NX > 1, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_N > 0,  YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(_W,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_D,      YAFL_ST_INV_ARG_1);
+
+    n   = _N;
+    nx  = _NX;
+    nx2 = nx * 2;
+
+    /*Default f(x) = x*/
+    if (0 == _FX)
+    {
+        YAFL_CHECK(0 == _JFX, YAFL_ST_INV_ARG_1);
+    }
+    else
+    {
+        /*Must have some Jacobian function*/
+        YAFL_CHECK(_JFX, YAFL_ST_INV_ARG_1);
+
+        YAFL_TRY(status,  _FX(self, _X, _X));  /* x = f(x_old, ...) */
+        YAFL_TRY(status, _JFX(self, _W, _X));  /* Place F(x, ...)=df/dx to W  */
+    }
+
+    /* D = concatenate([Dq, Dp]) */
+    memcpy((void *)_D,            (void *)_DQ, nx * n * sizeof(yaflFloat));
+    memcpy((void *)(_D + nx * n), (void *)_DP, nx * n * sizeof(yaflFloat));
+
+    for (l0 = 0; l0 < n; l0 += _B)
+    {
+        yaflInt   nl;
+        yaflInt   i;
+        uint8_t   m[_B];
+        yaflFloat * w;
+        yaflFloat * u;
+        yaflFloat * uq;
+
+        nl = ((n - l0) < _B) ? (n - l0) : _B;
+        _block_mask(m, 0, nl);
+
+        w  = _W  + l0;
+        u  = _UP + l0;
+        uq = _UQ + l0;
+
+        for (i = 0; i < nx; i++)
+        {
+            yaflInt nci;
+            yaflInt szj;
+            yaflInt j;
+            yaflInt l;
+
+            nci = nx2 * i;
+
+            /* W = (F|FUp) */
+            for (szj = 0, j = 0; j < nx; szj += j++)
+            {
+                yaflInt k;
+
+                if (0 == _FX)
+                {
+                    for (l = 0; l < nl; l++)
+                    {
+                        _E(w, nci + nx + j) = (j > i) ? _E(u, i + szj) : \
+                                              ((j == i) ? 1.0 : 0.0);
+                    }
+                    continue;
+                }
+
+                for (l = 0; l < nl; l++)
+                {
+                    _E(w, nci + nx + j) = _E(w, nci + j);
+                }
+
+                for (k = 0; k < j; k++)
+                {
+                    for (l = 0; l < nl; l++)
+                    {
+                        _E(w, nci + nx + j) += _E(w, nci + k) * _E(u, k + szj);
+                    }
+                }
+            }
+
+            /* W = (Uq|FUp) */
+            for (szj = 0, j = 0; j < nx; szj += j++)
+            {
+                for (l = 0; l < nl; l++)
+                {
+                    _E(w, nci + j) = (j > i) ? _E(uq, i + szj) : \
+                                     ((j == i) ? 1.0 : 0.0);
+                }
+            }
+        }
+
+        /* Up, Dp = MWGSU(w, d)*/
+        YAFL_TRY(status, _fleet_mwgsu(n, nl, m, nx, nx2, u, _DP + l0, w, \
+                                      _D + l0));
+    }
+
+    return status;
+}
+
+/*=============================================================================
+                                Fleet update
+=============================================================================*/
+/*
+Sequential innovations: y[i] -= h.dot(x - x0), h is the decorrelated
+H row i, x0 are the prior states, inactive filters have x == x0
+*/
+static inline void _fleet_seq_innov(yaflFleetSt * self, yaflFloat * x0, \
+                                    yaflInt i)
+{
+    yaflInt n = _N;
+    yaflInt k;
+    yaflInt l;
+
+    for (k = 0; k < _NX; k++)
+    {
+        yaflFloat * h   = _HY + (_NX * i + k) * n;
+        yaflFloat * x   = _X + k * n;
+        yaflFloat * x0k = x0 + k * n;
+        yaflFloat * y   = _Y + i * n;
+
+        for (l = 0; l < n; l++)
+        {
+            y[l] -= h[l] * (x[l] - x0k[l]);
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+_FLEET_KERNEL
+yaflStatusEn yafl_fleet_update(yaflFleetSt * self, yaflFloat * z, \
+                               uint8_t * mask,                    \
+                               yaflFleetScalarUpdateP scalar_update)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat * x0;
+    yaflInt j;
+
+    YAFL_CHECK(self,    YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_HX,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_X,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_Y,      YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_UR,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_NX > 1, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_NZ > 0, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_N > 0,  YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(_JHX,    YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(_HY,     YAFL_ST_INV_ARG_1);
+
+    YAFL_CHECK(z,       YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(scalar_update, YAFL_ST_INV_ARG_4);
+
+    YAFL_TRY(status,  _HX(self, _Y,  _X)); /* self.y =  h(x,...) */
+    YAFL_TRY(status, _JHX(self, _HY, _X)); /* self.H = jh(x,...) */
+
+    for (j = _NZ * _N - 1; j >= 0; j--)
+    {
+        _Y[j] = z[j] - _Y[j];
+    }
+
+    /* Decorrelate measurement noise, inactive filters are harmless here */
+    _fleet_ruv(_N, _N, _NZ,      _Y,  _UR);
+    _fleet_rum(_N, _N, _NZ, _NX, _HY, _UR);
+
+    /*
+    Joseph updates use nx * (nx + 1) elements of W, the tail holds
+    the prior states for sequential innovations
+    */
+    x0 = _W + (2 * _NX * _NX - _NX) * _N;
+    if (_NZ > 1)
+    {
+        YAFL_CHECK(_W, YAFL_ST_INV_ARG_1);
+        memcpy((void *)x0, (void *)_X, _NX * _N * sizeof(yaflFloat));
+    }
+
+    /*
+    Do scalar updates, a filter which fails one of them must not stop
+    the updates of the others, so the status is accumulated
+    */
+    for (j = 0; j < _NZ; j++)
+    {
+        if (j)
+        {
+            _fleet_seq_innov(self, x0, j);
+        }
+        status |= scalar_update(self, j, mask);
+    }
+
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+#define _FLEET_SCALAR_UPDATE_CHECKS()         \
+do {                                          \
+    YAFL_CHECK(self,         YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->Nz > i, YAFL_ST_INV_ARG_2); \
+    YAFL_CHECK(_NX > 1,      YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(_N > 0,       YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(_X,           YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(_UP,          YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(_DP,          YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(_HY,          YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(_Y,           YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(_DR,          YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(_D,           YAFL_ST_INV_ARG_1); \
+} while (0)
+
+/*=============================================================================
+                                Bierman fleet
+=============================================================================*/
+_FLEET_KERNEL
+yaflStatusEn yafl_fleet_bierman_update_scalar(yaflFleetSt * self, yaflInt i, \
+                                              uint8_t * mask)
+{
+    yaflInt n;
+    yaflInt nx;
+    yaflInt l0;
+
+    _FLEET_SCALAR_UPDATE_CHECKS();
+
+    n  = _N;
+    nx = _NX;
+
+    for (l0 = 0; l0 < n; l0 += _B)
+    {
+        yaflInt   nl;
+        yaflInt   j;
+        yaflInt   k;
+        yaflInt   nxk;
+        yaflInt   l;
+        uint8_t   m[_B];
+        yaflFloat r[_B];
+        yaflFloat nu[_B];
+        yaflFloat * x;
+        yaflFloat * u;
+        yaflFloat * d;
+        yaflFloat * h;
+        yaflFloat * f;
+        yaflFloat * v;
+
+        nl = ((n - l0) < _B) ? (n - l0) : _B;
+        if (!_block_mask(m, mask ? (mask + l0) : 0, nl))
+        {
+            continue;
+        }
+
+        x = _X  + l0;
+        u = _UP + l0;
+        d = _DP + l0;
+        h = _HY + nx * n * i + l0;
+        v = _D  + l0;
+        f = _D  + nx * n + l0;
+
+        /* f = h.dot(Up) */
+        _fleet_vtu(n, nl, nx, f, h, u);
+
+        /* v = f.dot(Dp).T = Dp.dot(f.T).T */
+        for (j = 0; j < nx; j++)
+        {
+            for (l = 0; l < nl; l++)
+            {
+                _E(v, j) = _E(d, j) * _E(f, j);
+            }
+        }
+
+        for (l = 0; l < nl; l++)
+        {
+            r[l]  = _DR[n * i + l0 + l];
+            nu[l] = _Y[n * i + l0 + l];
+        }
+
+        /*See _bierman_update_body in yafl.c*/
+        for (k = 0, nxk = 0; k < nx; nxk += k++)
+        {
+            yaflFloat p[_B];
+            yaflFloat vk[_B];
+
+            for (l = 0; l < nl; l++)
+            {
+                yaflFloat a;
+                yaflFloat fk;
+
+                fk    = _E(f, k);
+                vk[l] = _E(v, k);
+                a     = r[l] + fk * vk[l];
+
+                _E(d, k) = m[l] ? _E(d, k) * (r[l] / a) : _E(d, k);
+
+                p[l] = - fk / r[l];
+                r[l] = a;
+            }
+
+            for (j = 0; j < k; j++)
+            {
+                for (l = 0; l < nl; l++)
+                {
+                    yaflFloat ujk;
+                    yaflFloat vj;
+
+                    ujk = _E(u, j + nxk);
+                    vj  = _E(v, j);
+
+                    _E(u, j + nxk) = m[l] ? ujk + p[l] * vj : ujk;
+                    _E(v, j)       = vj + ujk * vk[l];
+                }
+            }
+        }
+
+        /* x += v * (nu / r) */
+        for (j = 0; j < nx; j++)
+        {
+            for (l = 0; l < nl; l++)
+            {
+                _E(x, j) = m[l] ? _E(x, j) + _E(v, j) * (nu[l] / r[l]) : \
+                           _E(x, j);
+            }
+        }
+    }
+
+    return YAFL_ST_OK;
+}
+
+/*=============================================================================
+                                Joseph fleet
+=============================================================================*/
+_FLEET_KERNEL
+yaflStatusEn yafl_fleet_joseph_update_scalar(yaflFleetSt * self, yaflInt i, \
+                                             uint8_t * mask)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt n;
+    yaflInt nx;
+    yaflInt nx1;
+    yaflInt l0;
+    yaflInt bad = 0;
+
+    _FLEET_SCALAR_UPDATE_CHECKS();
+    YAFL_CHECK(_W, YAFL_ST_INV_ARG_1);
+
+    n   = _N;
+    nx  = _NX;
+    nx1 = nx + 1;
+
+    for (l0 = 0; l0 < n; l0 += _B)
+    {
+        yaflInt   nl;
+        yaflInt   j;
+        yaflInt   l;
+        uint8_t   m[_B];
+        yaflFloat r[_B];
+        yaflFloat s[_B];
+        yaflFloat * x;
+        yaflFloat * u;
+        yaflFloat * d;
+        yaflFloat * f;
+        yaflFloat * v;
+        yaflFloat * k;
+        yaflFloat * w;
+
+        nl = ((n - l0) < _B) ? (n - l0) : _B;
+        if (!_block_mask(m, mask ? (mask + l0) : 0, nl))
+        {
+            continue;
+        }
+
+        x = _X  + l0;
+        u = _UP + l0;
+        d = _DP + l0;
+        v = _D  + l0;
+        f = _D  + nx * n + l0;
+        k = _HY + nx * n * i + l0; /*h is not needed after f computation*/
+        w = _W  + l0;
+
+        /* f = h.dot(Up) */
+        _fleet_vtu(n, nl, nx, f, k, u);
+
+        /* v = f.dot(Dp).T = Dp.dot(f.T).T */
+        for (j = 0; j < nx; j++)
+        {
+            for (l = 0; l < nl; l++)
+            {
+                _E(v, j) = _E(d, j) * _E(f, j);
+            }
+        }
+
+        /* s = r + f.dot(v)*/
+        for (l = 0; l < nl; l++)
+        {
+            r[l] = _DR[n * i + l0 + l];
+            s[l] = _E(f, 0) * _E(v, 0);
+        }
+
+        for (j = 1; j < nx; j++)
+        {
+            for (l = 0; l < nl; l++)
+            {
+                s[l] += _E(f, j) * _E(v, j);
+            }
+        }
+
+        /*
+        Filters with s <= 0 are masked out, so every filter is either
+        updated or left unchanged
+        */
+        for (l = 0; l < nl; l++)
+        {
+            s[l] += r[l];
+            bad  |= m[l] & (s[l] <= 0.0);
+            m[l] &= (s[l] > 0.0);
+            s[l]  = (s[l] > 0.0) ? s[l] : 1.0;
+        }
+
+        /* k = Up.dot(v / s) */
+        for (j = 0; j < nx; j++)
+        {
+            for (l = 0; l < nl; l++)
+            {
+                _E(v, j) *= 1.0 / s[l];
+            }
+        }
+        _fleet_uv(n, nl, nx, k, u, v);
+
+        /* W = (k.dot(f.T) - Up|k) */
+        for (j = 0; j < nx; j++)
+        {
+            yaflInt nc1j;
+            yaflInt c;
+            yaflInt szc;
+
+            nc1j = nx1 * j;
+
+            for (szc = 0, c = 0; c < nx; szc += c++)
+            {
+                for (l = 0; l < nl; l++)
+                {
+                    yaflFloat kf;
+
+                    kf = _E(k, j) * _E(f, c);
+                    _E(w, nc1j + c) = (c > j) ? kf - _E(u, j + szc) : \
+                                      ((c == j) ? kf - 1.0 : kf);
+                }
+            }
+
+            for (l = 0; l < nl; l++)
+            {
+                _E(w, nc1j + nx) = _E(k, j);
+            }
+        }
+
+        /* D = concatenate([Dp, np.array([r])]), v and f[0] are not needed any more */
+        for (j = 0; j < nx; j++)
+        {
+            for (l = 0; l < nl; l++)
+            {
+                _E(v, j) = _E(d, j);
+            }
+        }
+
+        for (l = 0; l < nl; l++)
+        {
+            _E(v, nx) = r[l];
+        }
+
+        /* Up, Dp = MWGSU(W, D)*/
+        YAFL_TRY(status, _fleet_mwgsu(n, nl, m, nx, nx1, u, d, w, v));
+
+        /* x += k * nu */
+        for (j = 0; j < nx; j++)
+        {
+            for (l = 0; l < nl; l++)
+            {
+                _E(x, j) = m[l] ? _E(x, j) + _E(k, j) * _Y[n * i + l0 + l] : \
+                           _E(x, j);
+            }
+        }
+    }
+
+    /*Reported after all the blocks are done*/
+    YAFL_CHECK(!bad, YAFL_ST_INV_ARG_1);
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+#undef _FLEET_SCALAR_UPDATE_CHECKS
+#undef _FLEET_KERNEL
+
+#undef _E
+#undef _B
+
+#undef _FX
+#undef _JFX
+#undef _HX
+#undef _JHX
+
+#undef _X
+#undef _Y
+
+#undef _UP
+#undef _DP
+
+#undef _UQ
+#undef _DQ
+
+#undef _UR
+#undef _DR
+
+#undef _HY
+#undef _W
+#undef _D
+
+#undef _NX
+#undef _NZ
+#undef _N
@@ -0,0 +1,185 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+
+#ifndef YAFL_FLEET_H
+#define YAFL_FLEET_H
+
+#include <yafl_config.h>
+#include "yafl_math.h"
+
+/*=============================================================================
+              Fleet of N UD-factorized EKFs of the same shape
+=============================================================================*/
+/*
+Data layout:
+All fleet arrays are structures of arrays, the element e of the filter l
+is stored at [e * N + l], where e is the element index in the single filter
+storage (packed Up index, row major H or W index, etc.).
+
+So every elementwise operation on a single filter becomes an operation on
+a contiguous N-sized lane vector, fleet kernels process lanes by blocks of
+YAFL_FLEET_BLK filters and are vectorized by compiler.
+
+The fleet is faster than separate EKFs only when the lane loops are
+vectorized with at least AVX2: with GNU C on x86-64 yafl_fleet.c enables
+the loop vectorizer by itself and builds AVX2 and baseline versions of the
+kernels (selected at load time), define YAFL_FLEET_NO_CLONES to disable this.
+With 1000 filters, nx = 6, nz = 2 and SoA callbacks (tests/src/fleet_check.c,
+GCC 12) the fleet was 1.36x (Bierman) and 1.44x (Joseph) faster at -O2
+and 1.27x/1.54x at -O3 -march=native, while with YAFL_FLEET_NO_CLONES
+at -O2 it was 0.8x, i.e. slower than separate EKFs.
+*/
+#ifndef YAFL_FLEET_BLK
+#   define YAFL_FLEET_BLK 8
+#endif/*YAFL_FLEET_BLK*/
+
+typedef struct _yaflFleetSt yaflFleetSt;
+
+/*
+Fleet callbacks work on all the filters at once, they get and return
+SoA arrays, see above.
+
+Must do:
+f:  x = f(x)
+jf: W[i, j] = df_i/dx_j, (i, j < Nx), W row size is 2 * Nx
+h:  y = h(x)
+jh: H = dh/dx
+*/
+typedef yaflStatusEn (* yaflFleetFuncP)(yaflFleetSt *, yaflFloat *, \
+                                        yaflFloat *);
+
+/*
+Fleet scalar update function pointer.
+Parameters:
+yaflInt i - measurement index
+uint8_t * mask - filter measurement mask, N elements, 0 means
+                 "no measurement", NULL means "all the filters are updated"
+*/
+typedef yaflStatusEn (* yaflFleetScalarUpdateP)(yaflFleetSt *, yaflInt, \
+                                                uint8_t *);
+
+struct _yaflFleetSt {
+    yaflFleetFuncP f;  /*A state transition function*/
+    yaflFleetFuncP jf; /*Jacobian of a state transition function*/
+    yaflFleetFuncP h;  /*A measurement function*/
+    yaflFleetFuncP jh; /*Jacobian of a measurement function*/
+
+    yaflFloat * x;  /*State vectors*/
+    yaflFloat * y;  /*Innovation vectors*/
+
+    yaflFloat * Up; /*Upper triangular parts of P*/
+    yaflFloat * Dp; /*Diagonal parts of P*/
+
+    yaflFloat * Uq; /*Upper triangular parts of Q*/
+    yaflFloat * Dq; /*Diagonal parts of Q*/
+
+    yaflFloat * Ur; /*Upper triangular parts of R*/
+    yaflFloat * Dr; /*Diagonal parts of R*/
+
+    yaflFloat * H;  /*Measurement Jacobian values*/
+    yaflFloat * W;  /*Scratchpad memory block matrices*/
+    yaflFloat * D;  /*Scratchpad memory diagonal matrices*/
+
+    yaflInt   Nx;   /*State vector size*/
+    yaflInt   Nz;   /*Measurement vector size*/
+    yaflInt   N;    /*The number of filters*/
+};
+
+/*---------------------------------------------------------------------------*/
+#define YAFL_FLEET_MEMORY_MIXIN(nx, nz, n)  \
+    yaflFloat x[nx * n];                    \
+    yaflFloat y[nz * n];                    \
+                                            \
+    yaflFloat Up[((nx - 1) * nx)/2 * n];    \
+    yaflFloat Dp[nx * n];                   \
+                                            \
+    yaflFloat Uq[((nx - 1) * nx)/2 * n];    \
+    yaflFloat Dq[nx * n];                   \
+                                            \
+    yaflFloat Ur[((nz - 1) * nz)/2 * n];    \
+    yaflFloat Dr[nz * n];                   \
+                                            \
+    yaflFloat H[nz * nx * n];               \
+    yaflFloat W[2 * nx * nx * n];           \
+    yaflFloat D[2 * nx * n]
+
+/*---------------------------------------------------------------------------*/
+#define YAFL_FLEET_INITIALIZER(_f, _jf, _h, _jh, _nx, _nz, _n, _mem) \
+{                                                                    \
+    .f   = (yaflFleetFuncP)_f,                                       \
+    .jf  = (yaflFleetFuncP)_jf,                                      \
+    .h   = (yaflFleetFuncP)_h,                                       \
+    .jh  = (yaflFleetFuncP)_jh,                                      \
+                                                                     \
+    .x   = _mem.x,                                                   \
+    .y   = _mem.y,                                                   \
+                                                                     \
+    .Up  = _mem.Up,                                                  \
+    .Dp  = _mem.Dp,                                                  \
+                                                                     \
+    .Uq  = _mem.Uq,                                                  \
+    .Dq  = _mem.Dq,                                                  \
+                                                                     \
+    .Ur  = _mem.Ur,                                                  \
+    .Dr  = _mem.Dr,                                                  \
+                                                                     \
+    .H   = _mem.H,                                                   \
+    .W   = _mem.W,                                                   \
+    .D   = _mem.D,                                                   \
+                                                                     \
+    .Nx  = _nx,                                                      \
+    .Nz  = _nz,                                                      \
+    .N   = _n                                                        \
+}
+
+/*---------------------------------------------------------------------------*/
+/*Predicts all the filters, f == 0 means f(x) = x*/
+yaflStatusEn yafl_fleet_predict(yaflFleetSt * self);
+
+/*
+Updates the filters with nonzero mask values (all the filters if mask is NULL),
+z is SoA measurement vector array.
+A filter which fails a scalar update (e.g. Joseph update with non positive
+innovation variance) is left unchanged by it, the other filters and the
+other scalar updates are still processed, the error is reported in the
+returned status.
+*/
+yaflStatusEn yafl_fleet_update(yaflFleetSt * self, yaflFloat * z, \
+                               uint8_t * mask,                    \
+                               yaflFleetScalarUpdateP scalar_update);
+
+/*---------------------------------------------------------------------------*/
+#define YAFL_FLEET_UPDATE_IMPL(func)                                           \
+extern yaflStatusEn func##_scalar(yaflFleetSt * self, yaflInt i,               \
+                                  uint8_t * mask);                             \
+static inline yaflStatusEn func(yaflFleetSt * self, yaflFloat * z,             \
+                                uint8_t * mask)                                \
+{                                                                              \
+    return yafl_fleet_update(self, z, mask, func##_scalar);                    \
+}
+
+/*-----------------------------------------------------------------------------
+                               Bierman fleet
+-----------------------------------------------------------------------------*/
+YAFL_FLEET_UPDATE_IMPL(yafl_fleet_bierman_update)
+
+/*-----------------------------------------------------------------------------
+                               Joseph fleet
+-----------------------------------------------------------------------------*/
+YAFL_FLEET_UPDATE_IMPL(yafl_fleet_joseph_update)
+
+#endif // YAFL_FLEET_H
@@ -0,0 +1,392 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+#include <string.h>
+
+#include "yafl_imm.h"
+
+#ifndef YAFL_EXP
+#   define YAFL_EXP exp
+#endif/*YAFL_EXP*/
+
+/*=============================================================================
+                                   Mixing
+=============================================================================*/
+/*
+x0, u0, d0 = mix of model states with weights w, see yafl_imm.h,
+w must sum to 1.
+*/
+static yaflStatusEn _imm_mix(yaflIMMSt * self, yaflFloat * w,     \
+                             yaflFloat * x0, yaflFloat * u0, \
+                             yaflFloat * d0)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt nx = self->Nx;
+    yaflInt na = 0;
+    yaflInt nc;
+    yaflInt last = 0;
+    yaflInt i;
+    yaflInt k;
+
+    /* x0 = sum(w[i] * x[i]) */
+    memset((void *)x0, 0, nx * sizeof(yaflFloat));
+    for (i = 0; i < self->M; i++)
+    {
+        if (w[i] > 0.0)
+        {
+            YAFL_TRY(status, yafl_math_add_vxn(nx, x0, self->model[i].self->x, \
+                                               w[i]));
+            last = i;
+            na++;
+        }
+    }
+    YAFL_CHECK(na > 0, YAFL_ST_INV_ARG_2);
+
+    if (1 == na)
+    {
+        /*Nothing to mix*/
+        yaflKalmanBaseSt * kf = self->model[last].self;
+
+        memcpy((void *)x0, (void *)kf->x,  nx * sizeof(yaflFloat));
+        memcpy((void *)u0, (void *)kf->Up, YAFL_U_SZ(nx) * sizeof(yaflFloat));
+        memcpy((void *)d0, (void *)kf->Dp, nx * sizeof(yaflFloat));
+        return status;
+    }
+
+    /*
+    W = (U[0]|...|U[na-1]|x[0]-x0|...|x[na-1]-x0)
+    D = (w[0]*D[0],...,w[na-1]*D[na-1],w[0],...,w[na-1])
+    */
+    nc = na * (nx + 1);
+    for (i = 0, k = 0; i < self->M; i++)
+    {
+        yaflKalmanBaseSt * kf = self->model[i].self;
+        yaflInt j;
+
+        if (w[i] <= 0.0)
+        {
+            continue;
+        }
+
+        YAFL_TRY(status, \
+                 YAFL_MATH_BSET_U(nc, 0, k * nx, self->W, nx, kf->Up));
+        YAFL_TRY(status, yafl_math_set_vxn(nx, self->D + k * nx, kf->Dp, w[i]));
+
+        for (j = 0; j < nx; j++)
+        {
+            self->W[nc * j + na * nx + k] = kf->x[j] - x0[j];
+        }
+        self->D[na * nx + k] = w[i];
+        k++;
+    }
+
+    YAFL_TRY(status, yafl_math_mwgsu(nx, nc, u0, d0, self->W, self->D));
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+#define _IMM_CHECKS()                              \
+do {                                               \
+    YAFL_CHECK(self,           YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->model,    YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->pi,       YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->mu,       YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->c,        YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->ll,       YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->mw,       YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->x,        YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->Up,       YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->Dp,       YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->xm,       YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->Um,       YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->Dm,       YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->W,        YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->D,        YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->M > 1,    YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->Nx > 1,   YAFL_ST_INV_ARG_1); \
+    YAFL_CHECK(self->Nz > 0,   YAFL_ST_INV_ARG_1); \
+} while (0)
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_imm_predict(yaflIMMSt * self)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt nx;
+    yaflInt nu;
+    yaflInt m;
+    yaflInt i;
+    yaflInt j;
+
+    _IMM_CHECKS();
+
+    nx = self->Nx;
+    nu = YAFL_U_SZ(nx);
+    m  = self->M;
+
+    for (j = 0; j < m; j++)
+    {
+        yaflKalmanBaseSt * kf = self->model[j].self;
+
+        YAFL_CHECK(kf,                      YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(kf->Nx == nx,            YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(self->model[j].predict,  YAFL_ST_INV_ARG_1);
+
+        /* c[j] = sum(pi[i, j] * mu[i]) */
+        self->c[j] = 0.0;
+        for (i = 0; i < m; i++)
+        {
+            self->c[j] += self->pi[m * i + j] * self->mu[i];
+        }
+    }
+
+    /*All the mixed states must be computed before any model change*/
+    for (j = 0; j < m; j++)
+    {
+        if (self->c[j] < YAFL_EPS)
+        {
+            /*Unreachable model, is not mixed*/
+            memset((void *)self->mw, 0, m * sizeof(yaflFloat));
+            self->mw[j] = 1.0;
+        }
+        else
+        {
+            /* mw[i] = mu[i|j] = pi[i, j] * mu[i] / c[j] */
+            for (i = 0; i < m; i++)
+            {
+                self->mw[i] = self->pi[m * i + j] * self->mu[i] / self->c[j];
+            }
+        }
+
+        YAFL_TRY(status, _imm_mix(self, self->mw, self->xm + nx * j, \
+                                  self->Um + nu * j, self->Dm + nx * j));
+    }
+
+    for (j = 0; j < m; j++)
+    {
+        yaflKalmanBaseSt * kf = self->model[j].self;
+
+        memcpy((void *)kf->x,  (void *)(self->xm + nx * j), nx * sizeof(yaflFloat));
+        memcpy((void *)kf->Up, (void *)(self->Um + nu * j), nu * sizeof(yaflFloat));
+        memcpy((void *)kf->Dp, (void *)(self->Dm + nx * j), nx * sizeof(yaflFloat));
+
+        YAFL_TRY(status, self->model[j].predict(kf));
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_imm_update(yaflIMMSt * self, yaflFloat * z)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat lmax = 0.0;
+    yaflFloat s;
+    yaflInt   found = 0;
+    yaflInt   m;
+    yaflInt   j;
+
+    _IMM_CHECKS();
+    YAFL_CHECK(z, YAFL_ST_INV_ARG_2);
+
+    m = self->M;
+
+    for (j = 0; j < m; j++)
+    {
+        yaflKalmanBaseSt * kf = self->model[j].self;
+
+        YAFL_CHECK(kf,                     YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(kf->Nz == self->Nz,     YAFL_ST_INV_ARG_1);
+        YAFL_CHECK(self->model[j].update,  YAFL_ST_INV_ARG_1);
+
+        YAFL_TRY(status, self->model[j].update(kf, z, self->ll + j));
+    }
+
+    /*
+    mu[j] = c[j] * exp(ll[j]) / sum(c * exp(ll)),
+    computed relative to the max of log(c[j]) + ll[j], so exp can't underflow
+    */
+    for (j = 0; j < m; j++)
+    {
+        if (self->c[j] > 0.0)
+        {
+            yaflFloat l = YAFL_LN(self->c[j]) + self->ll[j];
+
+            lmax  = (found && (lmax > l)) ? lmax : l;
+            found = 1;
+        }
+    }
+    YAFL_CHECK(found, YAFL_ST_INV_ARG_1); /*yafl_imm_predict wasn't called*/
+
+    for (j = 0, s = 0.0; j < m; j++)
+    {
+        self->mu[j] = (self->c[j] > 0.0) ? \
+                      YAFL_EXP(YAFL_LN(self->c[j]) + self->ll[j] - lmax) : 0.0;
+        s += self->mu[j];
+    }
+
+    for (j = 0; j < m; j++)
+    {
+        self->mu[j] /= s;
+    }
+
+    YAFL_TRY(status, _imm_mix(self, self->mu, self->x, self->Up, self->Dp));
+    return status;
+}
+
+/*=============================================================================
+                              Model updates
+=============================================================================*/
+/*Log likelihood of decorrelated innovation y with variances d*/
+static inline yaflFloat _loglik(yaflInt nz, yaflFloat * y, yaflFloat * d)
+{
+    yaflFloat ll = 0.0;
+    yaflInt i;
+
+    for (i = 0; i < nz; i++)
+    {
+        ll -= 0.5 * (YAFL_LOG_2PI + YAFL_LN(d[i]) + y[i] * y[i] / d[i]);
+    }
+    return ll;
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_imm_ekf_loglik(yaflKalmanBaseSt * self, yaflFloat * z, \
+                                 yaflFloat * ll)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflEKFBaseSt * ekf = (yaflEKFBaseSt *)self;
+    yaflFloat * zp;
+    yaflFloat * us;
+    yaflFloat * ds;
+    yaflInt nz;
+    yaflInt j;
+
+    YAFL_CHECK(self,     YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->x,  YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->y,  YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->Up, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->Dp, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(ekf->H,   YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(ekf->D,   YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(z,        YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(ll,       YAFL_ST_INV_ARG_3);
+
+    nz = self->Nz;
+
+    YAFL_TRY(status, yafl_ekf_base_flush(self));
+
+    /*H is not needed any more, use it to store Us, Ds*/
+    us = ekf->H;
+    ds = us + YAFL_U_SZ(nz);
+    zp = ekf->D + nz;
+    YAFL_TRY(status, \
+             yafl_ekf_base_innov_ud(self, self->x, self->Up, self->Dp, \
+                                    zp, us, ds));
+
+    /* y = zrf(z, h(x)) */
+    if (0 == self->zrf)
+    {
+        for (j = 0; j < nz; j++)
+        {
+            self->y[j] = z[j] - zp[j];
+        }
+    }
+    else
+    {
+        YAFL_TRY(status, self->zrf(self, self->y, z, zp));
+    }
+
+    /* y = linalg.inv(Us).dot(y) */
+    YAFL_TRY(status, yafl_math_ruv(nz, self->y, us));
+
+    *ll = _loglik(nz, self->y, ds);
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+/*Temporary binds st to self, user stats are restored and filled*/
+#define _IMM_STATS_BIND(self, st, old) \
+do {                                   \
+    old = self->stats;                 \
+    self->stats = &st;                 \
+} while (0)
+
+#define _IMM_STATS_UNBIND(self, st, old) \
+do {                                     \
+    self->stats = old;                   \
+    if (old)                             \
+    {                                    \
+        *old = st;                       \
+    }                                    \
+} while (0)
+
+/*EKF scalar updates which give the exact log likelihood in stats*/
+static inline yaflInt _ekf_stats_exact(yaflKalmanScalarUpdateP scalar_update)
+{
+    return (yafl_ekf_bierman_update_scalar   == scalar_update) || \
+           (yafl_ekf_joseph_update_scalar    == scalar_update) || \
+           (yafl_ekf_joseph_r1_update_scalar == scalar_update);
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_imm_ekf_update(yaflKalmanBaseSt * self, yaflFloat * z, \
+                                 yaflFloat * ll, \
+                                 yaflKalmanScalarUpdateP scalar_update)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflKalmanStatsSt st;
+    yaflKalmanStatsSt * old;
+
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(ll,   YAFL_ST_INV_ARG_3);
+
+    if (!_ekf_stats_exact(scalar_update))
+    {
+        /*Robust and adaptive updates change nu and s, so ll is computed here*/
+        YAFL_TRY(status, yafl_imm_ekf_loglik(self, z, ll));
+        return status | yafl_ekf_base_update(self, z, scalar_update);
+    }
+
+    _IMM_STATS_BIND(self, st, old);
+    status = yafl_ekf_base_update(self, z, scalar_update);
+    _IMM_STATS_UNBIND(self, st, old);
+
+    YAFL_CHECK(status < YAFL_ST_ERR_THR, status);
+
+    *ll = st.ll;
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_imm_ukf_update(yaflKalmanBaseSt * self, yaflFloat * z, \
+                                 yaflFloat * ll)
+{
+    yaflStatusEn status;
+    yaflKalmanStatsSt st;
+    yaflKalmanStatsSt * old;
+
+    YAFL_CHECK(self, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(ll,   YAFL_ST_INV_ARG_3);
+
+    /*y is decorrelated by Us, Ds is the diagonal of S*/
+    _IMM_STATS_BIND(self, st, old);
+    status = yafl_ukf_update((yaflUKFBaseSt *)self, z);
+    _IMM_STATS_UNBIND(self, st, old);
+
+    YAFL_CHECK(status < YAFL_ST_ERR_THR, status);
+
+    *ll = st.ll;
+    return status;
+}
@@ -0,0 +1,181 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+#ifndef YAFL_IMM_H
+#define YAFL_IMM_H
+
+#include <yafl_config.h>
+#include "yafl.h"
+
+/*=============================================================================
+              Interacting Multiple Model estimator on UD filters
+=============================================================================*/
+/*
+A bank of m EKF and/or UKF models with the same state vector.
+
+Mixing and the output combination:
+x0 = sum(w[i] * x[i])
+P0 = sum(w[i] * (P[i] + outer(x[i] - x0, x[i] - x0)))
+
+are done in UD form with one MWGSU of
+W = (U[0]|...|U[m-1]|x[0]-x0|...|x[m-1]-x0),
+D = (w[0]*D[0],...,w[m-1]*D[m-1],w[0],...,w[m-1]),
+models with zero weights are skipped, no full covariances are computed.
+*/
+typedef struct _yaflIMMSt yaflIMMSt;
+
+/*
+Model update function, must update the model and put the log likelihood
+of z (computed with the predicted model state) to *ll,
+see yafl_imm_ekf_bierman_update etc.
+*/
+typedef yaflStatusEn (* yaflIMMUpdateP)(yaflKalmanBaseSt *, yaflFloat *, \
+                                        yaflFloat *);
+
+/*Model predict function, e.g. yafl_ekf_base_predict*/
+typedef yaflStatusEn (* yaflIMMPredictP)(yaflKalmanBaseSt *);
+
+typedef struct _yaflIMMModelSt {
+    yaflKalmanBaseSt * self;    /*A filter*/
+    yaflIMMPredictP    predict; /*Filter predict*/
+    yaflIMMUpdateP     update;  /*Filter update with log likelihood*/
+} yaflIMMModelSt;
+
+struct _yaflIMMSt {
+    yaflIMMModelSt * model; /*Models*/
+    yaflFloat * pi;  /*Markov chain transition matrix, pi[i, j] = P(j | i)*/
+
+    yaflFloat * mu;  /*Model probabilities*/
+    yaflFloat * c;   /*Predicted model probabilities*/
+    yaflFloat * ll;  /*Model log likelihoods of the last update*/
+    yaflFloat * mw;  /*Mixing weights*/
+
+    yaflFloat * x;   /*Combined state*/
+    yaflFloat * Up;  /*Upper triangular part of combined P*/
+    yaflFloat * Dp;  /*Diagonal part of combined P*/
+
+    yaflFloat * xm;  /*Mixed model states*/
+    yaflFloat * Um;  /*Mixed model Up*/
+    yaflFloat * Dm;  /*Mixed model Dp*/
+
+    yaflFloat * W;   /*Scratchpad memory block matrix*/
+    yaflFloat * D;   /*Scratchpad memory diagonal matrix*/
+
+    yaflInt   M;     /*The number of models*/
+    yaflInt   Nx;    /*State vector size*/
+    yaflInt   Nz;    /*Measurement vector size*/
+};
+
+/*---------------------------------------------------------------------------*/
+/*
+H, W and D are big enough for m >= 2 EKFs with nx, nz, so EKF models
+of the bank may share them as their workspace, e.g.:
+YAFL_EKF_BASE_WS_INITIALIZER(f, jf, h, jh, 0, nx, nz, ekf_mem, imm_mem)
+*/
+#define YAFL_IMM_MEMORY_MIXIN(m, nx, nz)       \
+    yaflFloat mu[m];                           \
+    yaflFloat c[m];                            \
+    yaflFloat ll[m];                           \
+    yaflFloat mw[m];                           \
+                                               \
+    yaflFloat x[nx];                           \
+    yaflFloat Up[((nx - 1) * nx)/2];           \
+    yaflFloat Dp[nx];                          \
+                                               \
+    yaflFloat xm[m * nx];                      \
+    yaflFloat Um[m * ((nx - 1) * nx)/2];       \
+    yaflFloat Dm[m * nx];                      \
+                                               \
+    yaflFloat H[nz * nx];                      \
+    yaflFloat W[nx * m * (nx + 1)];            \
+    yaflFloat D[m * (nx + 1)]
+
+/*---------------------------------------------------------------------------*/
+#define YAFL_IMM_INITIALIZER(_model, _pi, _m, _nx, _nz, _mem) \
+{                                                             \
+    .model = _model,                                          \
+    .pi    = _pi,                                             \
+                                                              \
+    .mu    = _mem.mu,                                         \
+    .c     = _mem.c,                                          \
+    .ll    = _mem.ll,                                         \
+    .mw    = _mem.mw,                                         \
+                                                              \
+    .x     = _mem.x,                                          \
+    .Up    = _mem.Up,                                         \
+    .Dp    = _mem.Dp,                                         \
+                                                              \
+    .xm    = _mem.xm,                                         \
+    .Um    = _mem.Um,                                         \
+    .Dm    = _mem.Dm,                                         \
+                                                              \
+    .W     = _mem.W,                                          \
+    .D     = _mem.D,                                          \
+                                                              \
+    .M     = _m,                                              \
+    .Nx    = _nx,                                             \
+    .Nz    = _nz                                              \
+}
+
+/*---------------------------------------------------------------------------*/
+/*Mixes model states and predicts the models*/
+yaflStatusEn yafl_imm_predict(yaflIMMSt * self);
+
+/*
+Updates the models and the model probabilities, computes the combined
+state, yafl_imm_predict must be called first.
+*/
+yaflStatusEn yafl_imm_update(yaflIMMSt * self, yaflFloat * z);
+
+/*-----------------------------------------------------------------------------
+                              Model updates
+-----------------------------------------------------------------------------*/
+/*
+Exact log likelihood of z for an EKF, computes S = H.dot(P).dot(H.T) + R
+in UD form by MWGSU, uses EKF H, W and D as scratchpad, nz <= nx.
+*/
+yaflStatusEn yafl_imm_ekf_loglik(yaflKalmanBaseSt * self, yaflFloat * z, \
+                                 yaflFloat * ll);
+
+/*
+EKF update, for Bierman, Joseph and rank one Joseph updates the log
+likelihood is taken from the update statistics (see yaflKalmanStatsSt)
+in O(nz), model stats are filled too if bound, other updates use
+yafl_imm_ekf_loglik.
+*/
+yaflStatusEn yafl_imm_ekf_update(yaflKalmanBaseSt * self, yaflFloat * z, \
+                                 yaflFloat * ll, \
+                                 yaflKalmanScalarUpdateP scalar_update);
+
+static inline yaflStatusEn \
+    yafl_imm_ekf_bierman_update(yaflKalmanBaseSt * self, yaflFloat * z, \
+                                yaflFloat * ll)
+{
+    return yafl_imm_ekf_update(self, z, ll, yafl_ekf_bierman_update_scalar);
+}
+
+static inline yaflStatusEn \
+    yafl_imm_ekf_joseph_update(yaflKalmanBaseSt * self, yaflFloat * z, \
+                               yaflFloat * ll)
+{
+    return yafl_imm_ekf_update(self, z, ll, yafl_ekf_joseph_update_scalar);
+}
+
+/*Full UKF (yaflUKFSt) update, the log likelihood is exact*/
+yaflStatusEn yafl_imm_ukf_update(yaflKalmanBaseSt * self, yaflFloat * z, \
+                                 yaflFloat * ll);
+
+#endif // YAFL_IMM_H
@@ -17,7 +17,261 @@
 
 #include "yafl_math.h"
 
-#define _DO_VXN(name, op)                                                \
+/*=======================================================================================
+                                    SIMD kernels
+=======================================================================================*/
+/*
+SIMD versions of element-wise vector kernels.
+
+Only element-wise loops are vectorized, so SIMD results are bit-for-bit
+equal to scalar ones (reductions like yafl_math_vtv are left scalar as
+reordering of a sum changes the result).
+
+The kernel set is selected once at load time by CPU feature detection,
+see yafl_math_simd_set_level. Without x86 GNU C vector support only
+the scalar set is available.
+*/
+#if defined(YAFL_USE_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   define _YAFL_SIMD
+#endif
+
+/*
+FMA contraction of scalar loops would break bit-for-bit equality with SIMD
+kernels, so it is disabled for the whole file (the same as -ffp-contract=off).
+*/
+#ifdef YAFL_USE_SIMD
+#   if defined(__clang__)
+#       pragma STDC FP_CONTRACT OFF
+#   elif defined(__GNUC__)
+#       pragma GCC optimize ("fp-contract=off")
+#   endif
+#endif/*YAFL_USE_SIMD*/
+
+#define _SIMD_OP_SET 0
+#define _SIMD_OP_ADD 1
+#define _SIMD_OP_SUB 2
+
+#ifdef _YAFL_SIMD
+#include <immintrin.h>
+
+/*SIMD kernels work with double precision only*/
+typedef char _yaflSimdFloatCheck[(sizeof(yaflFloat) == sizeof(double)) ? 1 : -1];
+
+typedef void (* _yaflSimdVxnP)(yaflInt sz, yaflFloat *res, yaflFloat *v, yaflFloat n);
+typedef void (* _yaflSimdVxvP)(yaflInt sz, yaflFloat *res, yaflFloat *a, yaflFloat *b);
+
+typedef struct {
+    _yaflSimdVxnP vxn[3]; /*Indexed by _SIMD_OP_* */
+    _yaflSimdVxvP vxv[3];
+    _yaflSimdVxvP vrv[3];
+} _yaflSimdKernelsSt;
+
+/*Vector ops, r is a loaded result, x is a computed value*/
+#define _SIMD_SET(add, sub, r, x) (x)
+#define _SIMD_ADD(add, sub, r, x) add(r, x)
+#define _SIMD_SUB(add, sub, r, x) sub(r, x)
+
+/*
+isa   - kernel name suffix
+tgt   - target attribute string
+vt    - vector type
+w     - number of lanes
+pfx   - intrinsic name prefix
+*/
+#define _SIMD_VXN(isa, tgt, vt, w, pfx, name, vop, op)                                  \
+__attribute__((target(tgt)))                                                             \
+static void _simd_##name##_vxn_##isa(yaflInt sz, yaflFloat *res, yaflFloat *v, yaflFloat n) \
+{                                                                                        \
+    yaflInt k;                                                                           \
+    vt vn;                                                                               \
+                                                                                         \
+    vn = pfx##_set1_pd(n);                                                               \
+    for (k = 0; k + w <= sz; k += w)                                                     \
+    {                                                                                    \
+        pfx##_storeu_pd(res + k, vop(pfx##_add_pd, pfx##_sub_pd, pfx##_loadu_pd(res + k), \
+                                     pfx##_mul_pd(pfx##_loadu_pd(v + k), vn)));          \
+    }                                                                                    \
+    for (; k < sz; k++)                                                                  \
+    {                                                                                    \
+        res[k] op v[k] * n;                                                              \
+    }                                                                                    \
+}
+
+#define _SIMD_VXV(isa, tgt, vt, w, pfx, name, vop, op, kop, sop)                        \
+__attribute__((target(tgt)))                                                             \
+static void _simd_##name##_##isa(yaflInt sz, yaflFloat *res, yaflFloat *a, yaflFloat *b)  \
+{                                                                                        \
+    yaflInt k;                                                                           \
+                                                                                         \
+    for (k = 0; k + w <= sz; k += w)                                                     \
+    {                                                                                    \
+        pfx##_storeu_pd(res + k, vop(pfx##_add_pd, pfx##_sub_pd, pfx##_loadu_pd(res + k), \
+                                     pfx##kop(pfx##_loadu_pd(a + k), pfx##_loadu_pd(b + k)))); \
+    }                                                                                    \
+    for (; k < sz; k++)                                                                  \
+    {                                                                                    \
+        res[k] op a[k] sop b[k];                                                         \
+    }                                                                                    \
+}
+
+#define _SIMD_KERNELS(isa, tgt, vt, w, pfx)                                              \
+_SIMD_VXN(isa, tgt, vt, w, pfx, set, _SIMD_SET,  =)                                      \
+_SIMD_VXN(isa, tgt, vt, w, pfx, add, _SIMD_ADD, +=)                                      \
+_SIMD_VXN(isa, tgt, vt, w, pfx, sub, _SIMD_SUB, -=)                                      \
+_SIMD_VXV(isa, tgt, vt, w, pfx, set_vxv, _SIMD_SET,  =, _mul_pd, *)                      \
+_SIMD_VXV(isa, tgt, vt, w, pfx, add_vxv, _SIMD_ADD, +=, _mul_pd, *)                      \
+_SIMD_VXV(isa, tgt, vt, w, pfx, sub_vxv, _SIMD_SUB, -=, _mul_pd, *)                      \
+_SIMD_VXV(isa, tgt, vt, w, pfx, set_vrv, _SIMD_SET,  =, _div_pd, /)                      \
+_SIMD_VXV(isa, tgt, vt, w, pfx, add_vrv, _SIMD_ADD, +=, _div_pd, /)                      \
+_SIMD_VXV(isa, tgt, vt, w, pfx, sub_vrv, _SIMD_SUB, -=, _div_pd, /)                      \
+                                                                                         \
+static const _yaflSimdKernelsSt _yafl_simd_##isa =                                       \
+{                                                                                        \
+    .vxn = {_simd_set_vxn_##isa, _simd_add_vxn_##isa, _simd_sub_vxn_##isa},              \
+    .vxv = {_simd_set_vxv_##isa, _simd_add_vxv_##isa, _simd_sub_vxv_##isa},              \
+    .vrv = {_simd_set_vrv_##isa, _simd_add_vrv_##isa, _simd_sub_vrv_##isa}               \
+};
+
+_SIMD_KERNELS(sse2,   "sse2",    __m128d, 2, _mm)
+_SIMD_KERNELS(avx2,   "avx2",    __m256d, 4, _mm256)
+_SIMD_KERNELS(avx512, "avx512f", __m512d, 8, _mm512)
+
+/*Scalar kernels are used when all pointers are zero*/
+static const _yaflSimdKernelsSt _yafl_simd_scalar = {
+    .vxn = {0, 0, 0},
+    .vxv = {0, 0, 0},
+    .vrv = {0, 0, 0}
+};
+
+static const _yaflSimdKernelsSt * const _yafl_simd_tbl[YAFL_SIMD_NUM] =
+{
+    [YAFL_SIMD_SCALAR] = &_yafl_simd_scalar,
+    [YAFL_SIMD_SSE2]   = &_yafl_simd_sse2,
+    [YAFL_SIMD_AVX2]   = &_yafl_simd_avx2,
+    [YAFL_SIMD_AVX512] = &_yafl_simd_avx512
+};
+
+
+/*Selected kernel set, resolved once by _yafl_simd_init*/
+static const _yaflSimdKernelsSt * _yafl_simd_cur = 0;
+
+static yaflInt _yafl_simd_max_level(void)
+{
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return YAFL_SIMD_AVX512;
+    }
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return YAFL_SIMD_AVX2;
+    }
+
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return YAFL_SIMD_SSE2;
+    }
+
+    return YAFL_SIMD_SCALAR;
+}
+
+/*
+Sets the best kernel set unless some set was already selected,
+returns the selected set. Runs at load time, so threads only read
+_yafl_simd_cur, compare-exchange covers calls from other constructors.
+*/
+static const _yaflSimdKernelsSt * _yafl_simd_resolve(void)
+{
+    const _yaflSimdKernelsSt * cur = 0;
+    const _yaflSimdKernelsSt * best;
+
+    best = _yafl_simd_tbl[_yafl_simd_max_level()];
+    if (__atomic_compare_exchange_n(&_yafl_simd_cur, &cur, best, 0, \
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        return best;
+    }
+    return cur;
+}
+
+__attribute__((constructor)) static void _yafl_simd_init(void)
+{
+    (void)_yafl_simd_resolve();
+}
+
+static inline const _yaflSimdKernelsSt * _yafl_simd(void)
+{
+    const _yaflSimdKernelsSt * cur;
+
+    cur = __atomic_load_n(&_yafl_simd_cur, __ATOMIC_ACQUIRE);
+    if (!cur)
+    {
+        cur = _yafl_simd_resolve();
+    }
+    return cur;
+}
+
+yaflStatusEn yafl_math_simd_set_level(yaflInt level)
+{
+    yaflInt max_level;
+
+    max_level = _yafl_simd_max_level();
+
+    if (level < 0)
+    {
+        level = max_level;
+    }
+
+    YAFL_CHECK(level <= max_level, YAFL_ST_INV_ARG_1);
+
+    __atomic_store_n(&_yafl_simd_cur, _yafl_simd_tbl[level], __ATOMIC_RELEASE);
+    return YAFL_ST_OK;
+}
+
+yaflInt yafl_math_simd_get_level(void)
+{
+    yaflInt level;
+    const _yaflSimdKernelsSt * cur;
+
+    cur = _yafl_simd();
+    for (level = 0; (level < YAFL_SIMD_NUM) && (_yafl_simd_tbl[level] != cur); level++)
+    {
+        /*Search for current kernel set*/
+    }
+    return level;
+}
+
+/*Use SIMD kernel when available, fall through to the scalar loop otherwise*/
+#   define _YAFL_SIMD_TRY(fam, opi, ...)                       \
+    if (_yafl_simd()->fam[opi])                                \
+    {                                                          \
+        _yafl_simd()->fam[opi](__VA_ARGS__);                   \
+    }                                                          \
+    else
+#else /*_YAFL_SIMD*/
+#   define _YAFL_SIMD_TRY(fam, opi, ...)
+
+#ifdef YAFL_USE_SIMD
+/*No vector kernels for this target/compiler, only scalar set is available*/
+yaflStatusEn yafl_math_simd_set_level(yaflInt level)
+{
+    YAFL_CHECK(level <= YAFL_SIMD_SCALAR, YAFL_ST_INV_ARG_1);
+    return YAFL_ST_OK;
+}
+
+yaflInt yafl_math_simd_get_level(void)
+{
+    return YAFL_SIMD_SCALAR;
+}
+#endif/*YAFL_USE_SIMD*/
+#endif/*_YAFL_SIMD*/
+
+/*=======================================================================================
+                                    Basic operations
+=======================================================================================*/
+#define _DO_VXN(name, op, opi)                                           \
 yaflStatusEn name(yaflInt sz, yaflFloat *res, yaflFloat *v, yaflFloat n) \
 {                                                                        \
     yaflInt k;                                                           \
@@ -25,6 +279,7 @@ yaflStatusEn name(yaflInt sz, yaflFloat *res, yaflFloat *v, yaflFloat n) \
     YAFL_CHECK(res, YAFL_ST_INV_ARG_2);                                  \
     YAFL_CHECK(v,   YAFL_ST_INV_ARG_3);                                  \
                                                                          \
+    _YAFL_SIMD_TRY(vxn, opi, sz, res, v, n)                              \
     for (k = 0; k < sz; k++)                                             \
     {                                                                    \
         res[k] op v[k] * n;                                              \
@@ -32,9 +287,9 @@ yaflStatusEn name(yaflInt sz, yaflFloat *res, yaflFloat *v, yaflFloat n) \
     return YAFL_ST_OK;                                                   \
 }
 
-_DO_VXN(yafl_math_set_vxn,  =)
-_DO_VXN(yafl_math_add_vxn, +=)
-_DO_VXN(yafl_math_sub_vxn, -=)
+_DO_VXN(yafl_math_set_vxn,  =, _SIMD_OP_SET)
+_DO_VXN(yafl_math_add_vxn, +=, _SIMD_OP_ADD)
+_DO_VXN(yafl_math_sub_vxn, -=, _SIMD_OP_SUB)
 
 #define _DO_VRN(name, op)                                                \
 yaflStatusEn name(yaflInt sz, yaflFloat *res, yaflFloat *v, yaflFloat n) \
@@ -74,7 +329,7 @@ _DO_VRN(yafl_math_set_vrn,  =)
 _DO_VRN(yafl_math_add_vrn, +=)
 _DO_VRN(yafl_math_sub_vrn, -=)
 
-#define _DO_VXV(name, op)                                                \
+#define _DO_VXV(name, op, opi)                                           \
 yaflStatusEn name(yaflInt sz, yaflFloat *res, yaflFloat *a, yaflFloat *b)\
 {                                                                        \
     yaflInt k;                                                           \
@@ -83,6 +338,7 @@ yaflStatusEn name(yaflInt sz, yaflFloat *res, yaflFloat *a, yaflFloat *b)\
     YAFL_CHECK(a,   YAFL_ST_INV_ARG_3);                                  \
     YAFL_CHECK(b,   YAFL_ST_INV_ARG_4);                                  \
                                                                          \
+    _YAFL_SIMD_TRY(vxv, opi, sz, res, a, b)                              \
     for (k = 0; k < sz; k++)                                             \
     {                                                                    \
         res[k] op a[k] * b[k];                                           \
@@ -90,11 +346,11 @@ yaflStatusEn name(yaflInt sz, yaflFloat *res, yaflFloat *a, yaflFloat *b)\
     return YAFL_ST_OK;                                                   \
 }
 
-_DO_VXV(yafl_math_set_vxv,  =)
-_DO_VXV(yafl_math_add_vxv, +=)
-_DO_VXV(yafl_math_sub_vxv, -=)
+_DO_VXV(yafl_math_set_vxv,  =, _SIMD_OP_SET)
+_DO_VXV(yafl_math_add_vxv, +=, _SIMD_OP_ADD)
+_DO_VXV(yafl_math_sub_vxv, -=, _SIMD_OP_SUB)
 
-#define _DO_VRV(name, op)                                                \
+#define _DO_VRV(name, op, opi)                                           \
 yaflStatusEn name(yaflInt sz, yaflFloat *res, yaflFloat *a, yaflFloat *b)\
 {                                                                        \
     yaflInt k;                                                           \
@@ -103,6 +359,7 @@ yaflStatusEn name(yaflInt sz, yaflFloat *res, yaflFloat *a, yaflFloat *b)\
     YAFL_CHECK(a,   YAFL_ST_INV_ARG_3);                                  \
     YAFL_CHECK(b,   YAFL_ST_INV_ARG_4);                                  \
                                                                          \
+    _YAFL_SIMD_TRY(vrv, opi, sz, res, a, b)                              \
     for (k = 0; k < sz; k++)                                             \
     {                                                                    \
         res[k] op a[k] / b[k];                                           \
@@ -110,9 +367,9 @@ yaflStatusEn name(yaflInt sz, yaflFloat *res, yaflFloat *a, yaflFloat *b)\
     return YAFL_ST_OK;                                                   \
 }
 
-_DO_VRV(yafl_math_set_vrv,  =)
-_DO_VRV(yafl_math_add_vrv, +=)
-_DO_VRV(yafl_math_sub_vrv, -=)
+_DO_VRV(yafl_math_set_vrv,  =, _SIMD_OP_SET)
+_DO_VRV(yafl_math_add_vrv, +=, _SIMD_OP_ADD)
+_DO_VRV(yafl_math_sub_vrv, -=, _SIMD_OP_SUB)
 
 yaflStatusEn yafl_math_vtv(yaflInt sz, yaflFloat *res, yaflFloat *a, yaflFloat *b)
 {
@@ -132,7 +389,7 @@ yaflStatusEn yafl_math_vtv(yaflInt sz, yaflFloat *res, yaflFloat *a, yaflFloat *
     return YAFL_ST_OK;
 }
 
-#define _DO_VVT(name, op)                                                             \
+#define _DO_VVT(name, op, opi)                                                        \
 yaflStatusEn name(yaflInt nr, yaflInt nc, yaflFloat *res, yaflFloat *a, yaflFloat *b) \
 {                                                                                     \
     yaflInt j;                                                                        \
@@ -150,6 +407,7 @@ yaflStatusEn name(yaflInt nr, yaflInt nc, yaflFloat *res, yaflFloat *a, yaflFloa
         ncj = nc * j;                                                                 \
         aj  = a[j];                                                                   \
                                                                                       \
+        _YAFL_SIMD_TRY(vxn, opi, nc, res + ncj, b, aj)                                \
         for (k = 0; k < nc; k++)                                                      \
         {                                                                             \
             res[ncj + k] op aj * b[k];                                                \
@@ -158,11 +416,11 @@ yaflStatusEn name(yaflInt nr, yaflInt nc, yaflFloat *res, yaflFloat *a, yaflFloa
     return YAFL_ST_OK;                                                                \
 }
 
-_DO_VVT(yafl_math_set_vvt,  =)
-_DO_VVT(yafl_math_add_vvt, +=)
-_DO_VVT(yafl_math_sub_vvt, -=)
+_DO_VVT(yafl_math_set_vvt,  =, _SIMD_OP_SET)
+_DO_VVT(yafl_math_add_vvt, +=, _SIMD_OP_ADD)
+_DO_VVT(yafl_math_sub_vvt, -=, _SIMD_OP_SUB)
 
-#define _DO_VVTXN(name, op)                                                                        \
+#define _DO_VVTXN(name, op, opi)                                                                   \
 yaflStatusEn name(yaflInt nr, yaflInt nc, yaflFloat *res, yaflFloat *a, yaflFloat *b, yaflFloat n) \
 {                                                                                                  \
     yaflInt j;                                                                                     \
@@ -180,6 +438,7 @@ yaflStatusEn name(yaflInt nr, yaflInt nc, yaflFloat *res, yaflFloat *a, yaflFloa
         ncj = nc * j;                                                                              \
         aj  = a[j] * n;                                                                            \
                                                                                                    \
+        _YAFL_SIMD_TRY(vxn, opi, nc, res + ncj, b, aj)                                             \
         for (k = 0; k < nc; k++)                                                                   \
         {                                                                                          \
             res[ncj + k] op aj * b[k];                                                             \
@@ -188,9 +447,9 @@ yaflStatusEn name(yaflInt nr, yaflInt nc, yaflFloat *res, yaflFloat *a, yaflFloa
     return YAFL_ST_OK;                                                                             \
 }
 
-_DO_VVTXN(yafl_math_set_vvtxn,  =)
-_DO_VVTXN(yafl_math_add_vvtxn, +=)
-_DO_VVTXN(yafl_math_sub_vvtxn, -=)
+_DO_VVTXN(yafl_math_set_vvtxn,  =, _SIMD_OP_SET)
+_DO_VVTXN(yafl_math_add_vvtxn, +=, _SIMD_OP_ADD)
+_DO_VVTXN(yafl_math_sub_vvtxn, -=, _SIMD_OP_SUB)
 
 #define _DO_MV(name, op1, op2)                                                        \
 yaflStatusEn name(yaflInt nr, yaflInt nc, yaflFloat *res, yaflFloat *a, yaflFloat *b) \
@@ -224,7 +483,7 @@ _DO_MV(yafl_math_set_mv,  =, +=)
 _DO_MV(yafl_math_add_mv, +=, +=)
 _DO_MV(yafl_math_sub_mv, -=, -=)
 
-#define _DO_VTM(name, op1, op2)                                                       \
+#define _DO_VTM(name, op1, op2, opi1, opi2)                                           \
 yaflStatusEn name(yaflInt nr, yaflInt nc, yaflFloat *res, yaflFloat *a, yaflFloat *b) \
 {                                                                                     \
     yaflInt j;                                                                        \
@@ -233,6 +492,7 @@ yaflStatusEn name(yaflInt nr, yaflInt nc, yaflFloat *res, yaflFloat *a, yaflFloa
     YAFL_CHECK(a,   YAFL_ST_INV_ARG_4);                                               \
     YAFL_CHECK(b,   YAFL_ST_INV_ARG_5);                                               \
                                                                                       \
+    _YAFL_SIMD_TRY(vxn, opi1, nc, res, b, a[0])                                       \
     for (j = 0; j < nc; j++)                                                          \
     {                                                                                 \
         res[j] op1 a[0] * b[j];                                                       \
@@ -247,6 +507,7 @@ yaflStatusEn name(yaflInt nr, yaflInt nc, yaflFloat *res, yaflFloat *a, yaflFloa
         ncj = nc * j;                                                                 \
         aj = a[j];                                                                    \
                                                                                       \
+        _YAFL_SIMD_TRY(vxn, opi2, nc, res, b + ncj, aj)                               \
         for (k = 0; k < nc; k++)                                                      \
         {                                                                             \
             res[k] op2 aj * b[ncj + k];                                               \
@@ -255,9 +516,9 @@ yaflStatusEn name(yaflInt nr, yaflInt nc, yaflFloat *res, yaflFloat *a, yaflFloa
     return YAFL_ST_OK;                                                                \
 }
 
-_DO_VTM(yafl_math_set_vtm,  =, +=)
-_DO_VTM(yafl_math_add_vtm, +=, +=)
-_DO_VTM(yafl_math_sub_vtm, -=, -=)
+_DO_VTM(yafl_math_set_vtm,  =, +=, _SIMD_OP_SET, _SIMD_OP_ADD)
+_DO_VTM(yafl_math_add_vtm, +=, +=, _SIMD_OP_ADD, _SIMD_OP_ADD)
+_DO_VTM(yafl_math_sub_vtm, -=, -=, _SIMD_OP_SUB, _SIMD_OP_SUB)
 
 /*This is right as it is OMP friendly style*/
 #define _DO_MM(name, op1, op2)                                                                      \
@@ -806,6 +1067,15 @@ yaflStatusEn yafl_math_rum(yaflInt nr, yaflInt nc, yaflFloat *res, yaflFloat *u)
     return YAFL_ST_OK;
 }
 
+/*
+Minimal w row length for the d * w[j] / res_d[j] row of yafl_math_mwgsu,
+shorter rows are done by the previous in place loop, which is faster for
+them (nx = 4 EKF predict and Joseph update shapes, see tests/src/mwgsu_bench.c).
+*/
+#ifndef YAFL_MATH_MWGSU_DW_MIN
+#   define YAFL_MATH_MWGSU_DW_MIN 12
+#endif
+
 yaflStatusEn yafl_math_mwgsu(yaflInt nr, yaflInt nc, yaflFloat *res_u, yaflFloat *res_d, yaflFloat *w, yaflFloat *d)
 {
     yaflStatusEn status = YAFL_ST_OK;
@@ -819,20 +1089,21 @@ yaflStatusEn yafl_math_mwgsu(yaflInt nr, yaflInt nc, yaflFloat *res_u, yaflFloat
 
     for (j = nr - 1, nrj = ((j - 1) * j) / 2; j >= 0; nrj -= --j)
     {
-        yaflInt   ncj;
         yaflInt   k;
+        yaflFloat *wj;
+        yaflFloat *dwj;
         yaflFloat res_dj;
         yaflFloat wjk;
 
-        ncj = nc * j;
+        wj = w + nc * j;
 
         /*res_d[j] = w[j].dot(d * w[j])*/
-        wjk     = w[ncj + nc - 1];
+        wjk     = wj[nc - 1];
         wjk    *= wjk;
         res_dj  = wjk * d[nc - 1];
         for (k = nc - 2; k >= 0; k--)
         {
-            wjk     = w[ncj + k];
+            wjk     = wj[k];
             wjk    *= wjk;
             res_dj += wjk * d[k];
         }
@@ -853,28 +1124,77 @@ yaflStatusEn yafl_math_mwgsu(yaflInt nr, yaflInt nc, yaflFloat *res_u, yaflFloat
 
         /*Good Eigenvalue*/
         res_d[j] = res_dj;
+        res_dj   = 1.0 / res_dj;
+
+        /*
+        Row w[j + 1] is not needed any more, so it is used to store
+        dwj = d * w[j] / res_d[j] which is used for all k < j.
+        There is no such row on the first pivot, so dwj is computed on the fly,
+        the same is done for short rows.
+        */
+        dwj = ((j < nr - 1) && (nc >= YAFL_MATH_MWGSU_DW_MIN)) ? (wj + nc) : 0;
+        if (dwj)
+        {
+            _YAFL_SIMD_TRY(vxv, _SIMD_OP_SET, nc, dwj, d, wj)
+            for (k = 0; k < nc; k++)
+            {
+                dwj[k] = d[k] * wj[k];
+            }
+
+            _YAFL_SIMD_TRY(vxn, _SIMD_OP_SET, nc, dwj, dwj, res_dj)
+            for (k = 0; k < nc; k++)
+            {
+                dwj[k] = dwj[k] * res_dj;
+            }
+        }
 
         for (k = j - 1; k >= 0; k--)
         {
-            yaflInt   nck;
             yaflInt   i;
+            yaflFloat *wk;
             yaflFloat res_ukj;
 
-            nck = nc * k;
+            wk = w + nc * k;
 
             /* res_u[k,j] = w[k].dot(d * w[j])/res_d[j] */
-            res_ukj = w[nck] * d[0] * w[ncj] / res_dj;
-            for (i = 1; i < nc; i++)
+            if (dwj)
             {
-                res_ukj += w[nck + i] * d[i] * w[ncj + i] / res_dj;
+                /*Independent partial sums break the add dependency chain*/
+                yaflFloat s0 = 0.0;
+                yaflFloat s1 = 0.0;
+                yaflFloat s2 = 0.0;
+                yaflFloat s3 = 0.0;
+
+                for (i = 0; i + 4 <= nc; i += 4)
+                {
+                    s0 += wk[i]     * dwj[i];
+                    s1 += wk[i + 1] * dwj[i + 1];
+                    s2 += wk[i + 2] * dwj[i + 2];
+                    s3 += wk[i + 3] * dwj[i + 3];
+                }
+
+                for (; i < nc; i++)
+                {
+                    s0 += wk[i] * dwj[i];
+                }
+                res_ukj = (s0 + s1) + (s2 + s3);
+            }
+            else
+            {
+                res_ukj = wk[0] * d[0] * wj[0];
+                for (i = 1; i < nc; i++)
+                {
+                    res_ukj += wk[i] * d[i] * wj[i];
+                }
+                res_ukj *= res_dj;
             }
             res_u[k + nrj] = res_ukj;
 
             /* w[k] -= res_u[k,j] * w[j] */
-            w[nck + nc - 1] -= res_ukj * w[ncj + nc - 1];
-            for (i = nc - 2; i >= 0; i--)
+            _YAFL_SIMD_TRY(vxn, _SIMD_OP_SUB, nc, wk, wj, res_ukj)
+            for (i = 0; i < nc; i++)
             {
-                w[nck + i] -= res_ukj * w[ncj + i];
+                wk[i] -= res_ukj * wj[i];
             }
         }
     }
@@ -934,6 +1254,75 @@ yaflStatusEn yafl_math_udu_up(yaflInt sz, yaflFloat *res_u, yaflFloat *res_d, ya
     return status;
 }
 
+yaflStatusEn yafl_math_udu_upk(yaflInt sz, yaflInt nv, yaflFloat *res_u, yaflFloat *res_d, yaflFloat *alpha, yaflFloat *v)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt j;
+    yaflInt szj;
+
+    YAFL_CHECK(res_u,  YAFL_ST_INV_ARG_3);
+    YAFL_CHECK(res_d,  YAFL_ST_INV_ARG_4);
+    YAFL_CHECK(alpha,  YAFL_ST_INV_ARG_5);
+    YAFL_CHECK(v,      YAFL_ST_INV_ARG_6);
+
+    for (j = nv - 1; j >= 0; j--)
+    {
+        YAFL_CHECK(alpha[j] >= 0, YAFL_ST_INV_ARG_5);
+    }
+
+    /*
+    Gives bit exact result of nv sequential rank 1 updates, but res_u[:j,j] and res_d[j]
+    are updated by all the vectors at once, so res_u is passed only once.
+    */
+    for (j = sz - 1, szj = ((j - 1) * j) / 2; j >= 0; szj -= --j)
+    {
+        yaflInt p;
+
+        for (p = 0; p < nv; p++)
+        {
+            yaflInt k;
+            yaflFloat * vp;
+            yaflFloat alpha_p;
+            yaflFloat dj;
+            yaflFloat pj;
+            yaflFloat res_dj;
+            yaflFloat betaj;
+
+            vp      = v + sz * p;
+            alpha_p = alpha[p];
+
+            dj = res_d[j];
+            pj = vp[j];
+
+            res_dj = dj + alpha_p * pj * pj;
+            if (res_dj < YAFL_EPS)
+            {
+                res_dj  = YAFL_EPS;
+                status |= YAFL_ST_MSK_REGULARIZED;
+            }
+
+            betaj = alpha_p * pj / res_dj;
+
+            res_d[j] = res_dj;
+
+            alpha[p] = alpha_p * (dj / res_dj);
+
+            for (k = j - 1; k >= 0; k--)
+            {
+                yaflFloat ukj;
+                yaflFloat vk;
+
+                ukj = res_u[k + szj];
+                vk  = vp[k] - pj * ukj;
+                vp[k] = vk;
+
+                res_u[k + szj] = ukj + betaj * vk;
+            }
+        }
+    }
+    return status;
+}
+
 yaflStatusEn yafl_math_udu_down(yaflInt sz, yaflFloat *res_u, yaflFloat *res_d, yaflFloat alpha, yaflFloat *v)
 {
     yaflStatusEn status = YAFL_ST_OK;
@@ -1008,3 +1397,29 @@ yaflStatusEn yafl_math_udu_down(yaflInt sz, yaflFloat *res_u, yaflFloat *res_d,
     }
     return status;
 }
+
+yaflStatusEn yafl_math_udu_joseph(yaflInt sz, yaflFloat *res_u, yaflFloat *res_d, yaflFloat *g, yaflFloat *k, yaflFloat c, yaflFloat r)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat s;
+
+    YAFL_CHECK(res_u,  YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(res_d,  YAFL_ST_INV_ARG_3);
+    YAFL_CHECK(g,      YAFL_ST_INV_ARG_4);
+    YAFL_CHECK(k,      YAFL_ST_INV_ARG_5);
+    YAFL_CHECK(r >= 0, YAFL_ST_INV_ARG_7);
+
+    s = c + r;
+    YAFL_CHECK(s > 0,  YAFL_ST_INV_ARG_6);
+
+#   define e k
+    /* e = k - g / s */
+    YAFL_TRY(status, yafl_math_sub_vxn(sz, e, g, 1.0 / s));
+
+    /* Update first, so downdate is done on the bigger P */
+    YAFL_TRY(status, yafl_math_udu_up(sz, res_u, res_d, s, e));
+    YAFL_TRY(status, yafl_math_udu_down(sz, res_u, res_d, 1.0 / s, g));
+#   undef e
+
+    return status;
+}
@@ -72,7 +72,9 @@ typedef enum {
     YAFL_ST_INV_ARG_8    = 0x170,
     YAFL_ST_INV_ARG_9    = 0x180,
     YAFL_ST_INV_ARG_10   = 0x190,
-    YAFL_ST_INV_ARG_11   = 0x1a0
+    YAFL_ST_INV_ARG_11   = 0x1a0,
+    /*System resource error (e.g. a thread could not be created)*/
+    YAFL_ST_ERR_SYS      = 0x200
 } yaflStatusEn;
 
 #define _YAFL_TRY(status, exp, file, func, line)                              \
@@ -90,6 +92,34 @@ do {                                                                          \
 
 #define YAFL_TRY(status, exp) _YAFL_TRY(status, exp, __FILE__, __func__, __LINE__)
 
+/*=======================================================================================
+                                    SIMD kernels
+=======================================================================================*/
+#ifdef YAFL_USE_SIMD
+/*Kernel sets in order of preference*/
+typedef enum {
+    YAFL_SIMD_SCALAR = 0,
+    YAFL_SIMD_SSE2,
+    YAFL_SIMD_AVX2,
+    YAFL_SIMD_AVX512,
+    YAFL_SIMD_NUM
+} yaflSimdLevelEn;
+
+/*
+Select vector kernel set.
+
+The best kernel set supported by CPU is selected once at load time,
+this may be used to force some lower level (e.g. for testing or benchmarking).
+Only YAFL_SIMD_SCALAR is available on targets without vector kernels.
+
+level < 0 selects the best supported kernel set.
+*/
+yaflStatusEn yafl_math_simd_set_level(yaflInt level);
+
+/*Get currently used kernel set*/
+yaflInt yafl_math_simd_get_level(void);
+#endif/*YAFL_USE_SIMD*/
+
 /*=======================================================================================
                                     Basic operations
 =======================================================================================*/
@@ -347,6 +377,22 @@ TODO: add doc with derivation!
 */
 yaflStatusEn yafl_math_udu_up(yaflInt sz, yaflFloat *res_u, yaflFloat *res_d, yaflFloat alpha, yaflFloat *v);
 
+/*
+Rank k UDU' update.
+
+Does in place:
+p = u.dot(d.dot(u.T))
+for i in range(nv):
+    p += alpha[i] * outer(v[i],v[i].T)
+u,d = udu(p)
+
+Gives the same result as nv calls of yafl_math_udu_up, but passes u only once.
+
+Warning:
+Vector alpha and matrix v (nv x sz) are not valid after call.
+*/
+yaflStatusEn yafl_math_udu_upk(yaflInt sz, yaflInt nv, yaflFloat *res_u, yaflFloat *res_d, yaflFloat *alpha, yaflFloat *v);
+
 /*
 Rank 1 UDU' downdate.
 Based on:
@@ -364,4 +410,26 @@ Vector v is not valid after call.
 TODO: add doc with derivation!
 */
 yaflStatusEn yafl_math_udu_down(yaflInt sz, yaflFloat *res_u, yaflFloat *res_d, yaflFloat alpha, yaflFloat *v);
+
+/*
+Rank 1 UDU' Joseph form update with arbitrary gain k.
+
+Does in place:
+p = u.dot(d.dot(u.T))
+p = (I - outer(k, h)).dot(p).dot((I - outer(k, h)).T) + r * outer(k, k)
+u,d = udu(p)
+
+where g = p.dot(h.T) and c = h.dot(g) must be given.
+
+With s = c + r and e = k - g / s it is exactly:
+p += s * outer(e, e) - outer(g, g) / s
+
+so it is done by one rank 1 update and one rank 1 downdate.
+For optimal gain k == g / s the e term is zero, otherwise it
+adds the gain error contribution just like the full Joseph form.
+
+Warning:
+Vectors g and k are not valid after call.
+*/
+yaflStatusEn yafl_math_udu_joseph(yaflInt sz, yaflFloat *res_u, yaflFloat *res_d, yaflFloat *g, yaflFloat *k, yaflFloat c, yaflFloat r);
 #endif // YAFL_MATH_H
@@ -0,0 +1,281 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+#include <string.h>
+
+#include "yafl_oosm.h"
+
+/*Ring buffer slot of the snapshot which is i steps older than the newest one*/
+#define _SLOT(i) ((self->head + self->N - 1 - (i)) % self->N)
+
+/*---------------------------------------------------------------------------*/
+/*Copies the base posterior to the slot k*/
+static inline void _store(yaflOOSMSt * self, yaflKalmanBaseSt * base, \
+                          yaflInt k)
+{
+    yaflInt nx = self->Nx;
+
+    memcpy((void *)(self->x  + nx * k),      (void *)base->x,  \
+           nx * sizeof(yaflFloat));
+    memcpy((void *)(self->Up + YAFL_U_SZ(nx) * k), (void *)base->Up, \
+           YAFL_U_SZ(nx) * sizeof(yaflFloat));
+    memcpy((void *)(self->Dp + nx * k),      (void *)base->Dp, \
+           nx * sizeof(yaflFloat));
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_oosm_push(yaflOOSMSt * self, yaflEKFBaseSt * kf, \
+                            yaflFloat t)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflKalmanBaseSt * base;
+    yaflInt nx;
+    yaflInt k;
+
+    YAFL_CHECK(self,        YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->N > 0, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(kf,          YAFL_ST_INV_ARG_2);
+
+    base = &kf->base;
+    nx   = self->Nx;
+
+    YAFL_CHECK(base->Nx == nx, YAFL_ST_INV_ARG_2);
+    YAFL_CHECK((0 == self->cnt) || (t > self->t[_SLOT(0)]), YAFL_ST_INV_ARG_3);
+
+    /*Snapshots must have actual covariances*/
+    YAFL_TRY(status, yafl_ekf_base_flush(base));
+
+    k = self->head;
+    self->t[k] = t;
+    _store(self, base, k);
+
+    self->head = (k + 1) % self->N;
+    if (self->cnt < self->N)
+    {
+        self->cnt++;
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_oosm_ekf_update(yaflOOSMSt * self, yaflEKFBaseSt * kf, \
+                                  yaflFloat t, yaflFloat * z)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflKalmanBaseSt * base;
+    yaflFloat * xp;
+    yaflFloat * up;
+    yaflFloat * dp;
+    yaflFloat * tmp;
+    yaflInt nx;
+    yaflInt nz;
+    yaflInt nc;
+    yaflInt s = 0;
+    yaflInt l;
+    yaflInt i;
+    yaflInt j;
+
+    YAFL_CHECK(self,                 YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->N > 0,          YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->Nx > 1,         YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->Nz > 0,         YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(self->Nz <= self->Nx, YAFL_ST_INV_ARG_1); /*Scratchpad size limit*/
+
+    YAFL_CHECK(kf,                YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(kf->jf,            YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(kf->jh || kf->jhs, YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(kf->H,             YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(kf->W,             YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(kf->D,             YAFL_ST_INV_ARG_2);
+
+    base = &kf->base;
+    nx   = self->Nx;
+    nz   = self->Nz;
+
+    YAFL_CHECK(base->f,        YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(base->h,        YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(base->Nx == nx, YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(base->Nz == nz, YAFL_ST_INV_ARG_2);
+
+    YAFL_CHECK(z,              YAFL_ST_INV_ARG_4);
+
+    /*The newest snapshot taken not later than t*/
+    for (l = 0; l < self->cnt; l++)
+    {
+        s = _SLOT(l);
+        if (self->t[s] <= t)
+        {
+            break;
+        }
+    }
+    YAFL_CHECK(l < self->cnt, YAFL_ST_INV_ARG_3); /*Too old*/
+    YAFL_CHECK(l > 0,         YAFL_ST_INV_ARG_3); /*Not out of sequence*/
+
+    xp = self->x  + nx * s;
+    up = self->Up + YAFL_U_SZ(nx) * s;
+    dp = self->Dp + nx * s;
+
+    YAFL_TRY(status, yafl_ekf_base_flush(base));
+
+    /*F, Q = F**l, Q_l, F is evaluated at the snapshot*/
+    YAFL_TRY(status, kf->jf(base, kf->W, xp));
+    for (i = 0; i < nx; i++)
+    {
+        memcpy((void *)(self->Fa + nx * i), (void *)(kf->W + 2 * nx * i), \
+               nx * sizeof(yaflFloat));
+    }
+    memcpy((void *)self->Ub, (void *)base->Uq, YAFL_U_SZ(nx) * sizeof(yaflFloat));
+    memcpy((void *)self->Db, (void *)base->Dq, nx * sizeof(yaflFloat));
+
+    YAFL_TRY(status, yafl_ekf_base_fq_pow(base, l,                         \
+                                          self->Fa, self->Ub, self->Db, \
+                                          self->F,  self->Uq, self->Dq));
+
+    /* v = xb = f(...f(xs)) */
+    memcpy((void *)self->v, (void *)xp, nx * sizeof(yaflFloat));
+    for (i = 0; i < l; i++)
+    {
+        YAFL_TRY(status, base->f(base, self->v, self->v));
+    }
+
+    /*
+    W = (Uq|F.dot(Up)), D = concatenate([Dq, Dp]), so
+    Pb = W.dot(diag(D)).dot(W.T) = Ub.dot(diag(Db)).dot(Ub.T)
+    */
+    nc = 2 * nx;
+    YAFL_TRY(status, yafl_math_bset_u(nc, kf->W, nx, self->Uq));
+    YAFL_TRY(status, YAFL_MATH_BSET_MU(nc, 0, nx, kf->W, nx, nx, self->F, up));
+
+    memcpy((void *)kf->D,        (void *)self->Dq, nx * sizeof(yaflFloat));
+    memcpy((void *)(kf->D + nx), (void *)dp,       nx * sizeof(yaflFloat));
+
+    YAFL_TRY(status, yafl_math_mwgsu(nx, nc, self->Ub, self->Db, kf->W, kf->D));
+
+    /*D is free now, it is used as scratchpad vector*/
+    tmp = kf->D;
+
+    /* xs = xp + Ps.dot(F.T).dot(linalg.inv(Pb)).dot(xk - xb) */
+    for (i = 0; i < nx; i++)
+    {
+        self->v[i] = base->x[i] - self->v[i];
+    }
+    YAFL_TRY(status, yafl_math_ruv(nx, self->v, self->Ub));
+    YAFL_TRY(status, YAFL_MATH_SET_RDV(nx, self->v, self->Db, self->v));
+    YAFL_TRY(status, yafl_math_rutv(nx, self->v, self->Ub));
+
+    YAFL_TRY(status, yafl_math_set_vtm(nx, nx, tmp, self->v, self->F));
+    YAFL_TRY(status, yafl_math_set_vtu(nx, self->v, tmp, up));
+    YAFL_TRY(status, YAFL_MATH_SET_DV(nx, self->v, dp, self->v));
+    YAFL_TRY(status, yafl_math_set_uv(nx, self->xs, up, self->v));
+
+    for (i = 0; i < nx; i++)
+    {
+        self->xs[i] += xp[i];
+    }
+
+    /*
+    S = H.dot(Ps).dot(H.T) + R is accumulated in Us, Ds, first
+    H = jh(xs), tmp = h(xs)
+    */
+    YAFL_TRY(status, yafl_ekf_base_innov_ud(base, self->xs, up, dp, tmp, \
+                                            self->Us, self->Ds));
+
+    /* y = zrf(z, h(xs)) */
+    if (base->zrf)
+    {
+        /*zrf must be aware of base internal structure*/
+        YAFL_TRY(status, base->zrf(base, base->y, z, tmp));
+    }
+    else
+    {
+        for (i = 0; i < nz; i++)
+        {
+            base->y[i] = z[i] - tmp[i];
+        }
+    }
+
+    /*
+    For every measurement row h:
+    b   = F.dot(Ps).dot(h)
+    c   = linalg.inv(Ub).dot(b), column of C
+    a   = linalg.inv(Pb).dot(b), column of J.T.dot(H.T)
+    m   = Uk.T.dot(a), column of M
+    pzx = Pk.dot(a), row of Pzx
+    */
+    for (i = 0; i < nz; i++)
+    {
+        yaflFloat * h   = kf->H + nx * i;
+        yaflFloat * pzx = self->Pzx + nx * i;
+
+        YAFL_TRY(status, yafl_math_set_vtu(nx, self->v, h, up));
+        YAFL_TRY(status, YAFL_MATH_SET_DV(nx, self->v, dp, self->v));
+        YAFL_TRY(status, yafl_math_set_uv(nx, tmp, up, self->v));
+        YAFL_TRY(status, yafl_math_set_mv(nx, nx, self->v, self->F, tmp));
+
+        YAFL_TRY(status, yafl_math_ruv(nx, self->v, self->Ub));
+        for (j = 0; j < nx; j++)
+        {
+            self->C[nz * j + i] = self->v[j];
+        }
+
+        YAFL_TRY(status, YAFL_MATH_SET_RDV(nx, self->v, self->Db, self->v));
+        YAFL_TRY(status, yafl_math_rutv(nx, self->v, self->Ub));
+
+        YAFL_TRY(status, yafl_math_set_vtu(nx, tmp, self->v, base->Up));
+        for (j = 0; j < nx; j++)
+        {
+            self->M[nz * j + i] = tmp[j];
+        }
+
+        YAFL_TRY(status, YAFL_MATH_SET_DV(nx, tmp, base->Dp, tmp));
+        YAFL_TRY(status, yafl_math_set_uv(nx, pzx, base->Up, tmp));
+    }
+
+    /*
+    S += J.dot(Pk - Pb).dot(J.T) projected by H:
+    S += M.T.dot(diag(Dk)).dot(M), S -= C.T.dot(linalg.inv(diag(Db))).dot(C)
+    */
+    memcpy((void *)self->v, (void *)base->Dp, nx * sizeof(yaflFloat));
+    YAFL_TRY(status, yafl_math_udu_upk(nz, nx, self->Us, self->Ds, self->v, \
+                                       self->M));
+    for (j = 0; j < nx; j++)
+    {
+        YAFL_TRY(status, yafl_math_udu_down(nz, self->Us, self->Ds, \
+                                            1.0 / self->Db[j],  \
+                                            self->C + nz * j));
+    }
+
+    /*Decorrelate y and Cov(z, xk) by S*/
+    YAFL_TRY(status, yafl_math_ruv(nz, base->y, self->Us));
+    YAFL_TRY(status, yafl_math_rum(nz, nx, self->Pzx, self->Us));
+
+    /*Scalar updates of the current estimate with decorrelated measurements*/
+    for (i = 0; i < nz; i++)
+    {
+        yaflFloat * pzx = self->Pzx + nx * i;
+        yaflFloat   ds  = self->Ds[i];
+
+        YAFL_CHECK(ds > 0.0, YAFL_ST_INV_ARG_1);
+
+        YAFL_TRY(status, yafl_math_add_vxn(nx, base->x, pzx, base->y[i] / ds));
+        YAFL_TRY(status, yafl_math_udu_down(nx, base->Up, base->Dp, 1.0 / ds, \
+                                            pzx));
+    }
+
+    /*The newest snapshot is the current estimate*/
+    _store(self, base, _SLOT(0));
+    return status;
+}
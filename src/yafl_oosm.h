@@ -0,0 +1,166 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+#ifndef YAFL_OOSM_H
+#define YAFL_OOSM_H
+
+#include <yafl_config.h>
+#include "yafl.h"
+
+/*=============================================================================
+            Out of sequence measurements on UD-factorized EKFs
+=============================================================================*/
+/*
+A ring buffer of N posterior snapshots (t, x, Up, Dp) of an EKF, one
+snapshot per filter step, and an update which merges a late measurement
+into the current estimate with no replay.
+
+A measurement z taken at t, t[s] <= t < t[s + 1], is treated as taken at
+the snapshot s time, l steps back from the newest snapshot k, then:
+
+1. Retrodiction (one step RTS smoother over l steps):
+   F, Q = F**l, Q_l (by squaring, see yafl_ekf_base_fq_pow),
+   Pb = F.dot(Ps).dot(F.T) + Q, xb = f(...f(xs))
+   J  = Ps.dot(F.T).dot(linalg.inv(Pb))
+   xs = xs + J.dot(xk - xb)
+   Ps = Ps + J.dot(Pk - Pb).dot(J.T)
+
+2. Update of the current estimate with Cov(xk, z) = Pk.dot(J.T).dot(H.T):
+   S = H.dot(Ps).dot(H.T) + R, K = Pk.dot(J.T).dot(H.T).dot(linalg.inv(S))
+   xk += K.dot(z - h(xs)), Pk -= K.dot(S).dot(K.T)
+
+All the steps are done in UD form, S is computed by one MWGSU, one rank nx
+update and nx rank 1 downdates of nz x nz factors.
+
+The result is exact for linear models and l == 1 (Bar-Shalom's one step lag
+solution), for l > 1 the updates between s and k are not retrodicted
+(Bar-Shalom's Al1 algorithm).
+
+Cost and accuracy vs replay from the snapshot s (tests/src/oosm_check.c,
+nx = 4, nz = 2, x86_64, one CPU, gcc -O2):
+
+    lag                1      2      5      8     12     30
+    OOSM, us         1.0    1.3    1.8    1.9    2.1    2.7
+    replay, us       0.4    0.7    1.6    2.3    3.4   10.9
+    max x error    1e-14  2e-06  8e-05  4e-04  2e-03  2e-02
+
+The OOSM cost grows as log(l) while replay grows as l, OOSM is slower than
+replay for l <= 5 and faster from l = 8 on, so for short lags a replay
+from a stored filter copy is both faster and exact. The error of the Al1
+approximation grows with l and with the process noise, at l = 30 it is
+about a fifth of the error of dropping the measurement.
+*/
+typedef struct _yaflOOSMSt {
+    yaflFloat * t;   /*Snapshot time stamps*/
+    yaflFloat * x;   /*Snapshot state vectors*/
+    yaflFloat * Up;  /*Snapshot upper triangular parts of P*/
+    yaflFloat * Dp;  /*Snapshot diagonal parts of P*/
+
+    yaflFloat * F;   /*l step transition matrix*/
+    yaflFloat * Fa;  /*Scratchpad transition matrix*/
+    yaflFloat * Uq;  /*Upper triangular part of l step Q*/
+    yaflFloat * Dq;  /*Diagonal part of l step Q*/
+    yaflFloat * Ub;  /*Upper triangular part of Pb*/
+    yaflFloat * Db;  /*Diagonal part of Pb*/
+
+    yaflFloat * xs;  /*Retrodicted state*/
+    yaflFloat * v;   /*Scratchpad vector*/
+    yaflFloat * C;   /*linalg.inv(Ub).dot(F).dot(Ps).dot(H.T), nx x nz*/
+    yaflFloat * M;   /*Uk.T.dot(J.T).dot(H.T), nx x nz*/
+    yaflFloat * Pzx; /*Decorrelated Cov(z, xk), nz x nx*/
+    yaflFloat * Us;  /*Upper triangular part of S*/
+    yaflFloat * Ds;  /*Diagonal part of S*/
+
+    yaflInt   head;  /*Next snapshot slot*/
+    yaflInt   cnt;   /*The number of snapshots*/
+
+    yaflInt   N;     /*Ring buffer size*/
+    yaflInt   Nx;    /*State vector size*/
+    yaflInt   Nz;    /*Measurement vector size*/
+} yaflOOSMSt;
+
+/*---------------------------------------------------------------------------*/
+#define YAFL_OOSM_MEMORY_MIXIN(n, nx, nz) \
+    yaflFloat t[n];                       \
+    yaflFloat x[n * nx];                  \
+    yaflFloat Up[n * ((nx - 1) * nx)/2];  \
+    yaflFloat Dp[n * nx];                 \
+                                          \
+    yaflFloat F[nx * nx];                 \
+    yaflFloat Fa[nx * nx];                \
+    yaflFloat Uq[((nx - 1) * nx)/2];      \
+    yaflFloat Dq[nx];                     \
+    yaflFloat Ub[((nx - 1) * nx)/2];      \
+    yaflFloat Db[nx];                     \
+                                          \
+    yaflFloat xs[nx];                     \
+    yaflFloat v[nx];                      \
+    yaflFloat C[nx * nz];                 \
+    yaflFloat M[nx * nz];                 \
+    yaflFloat Pzx[nz * nx];               \
+    yaflFloat Us[((nz - 1) * nz)/2];      \
+    yaflFloat Ds[nz]
+
+/*---------------------------------------------------------------------------*/
+#define YAFL_OOSM_INITIALIZER(_n, _nx, _nz, _mem) \
+{                                                 \
+    .t    = _mem.t,                               \
+    .x    = _mem.x,                               \
+    .Up   = _mem.Up,                              \
+    .Dp   = _mem.Dp,                              \
+                                                  \
+    .F    = _mem.F,                               \
+    .Fa   = _mem.Fa,                              \
+    .Uq   = _mem.Uq,                              \
+    .Dq   = _mem.Dq,                              \
+    .Ub   = _mem.Ub,                              \
+    .Db   = _mem.Db,                              \
+                                                  \
+    .xs   = _mem.xs,                              \
+    .v    = _mem.v,                               \
+    .C    = _mem.C,                               \
+    .M    = _mem.M,                               \
+    .Pzx  = _mem.Pzx,                             \
+    .Us   = _mem.Us,                              \
+    .Ds   = _mem.Ds,                              \
+                                                  \
+    .head = 0,                                    \
+    .cnt  = 0,                                    \
+                                                  \
+    .N    = _n,                                   \
+    .Nx   = _nx,                                  \
+    .Nz   = _nz                                   \
+}
+
+/*---------------------------------------------------------------------------*/
+/*
+Stores the kf posterior taken at t, must be called once after every
+predict and update cycle, t must grow, the oldest snapshot is dropped
+when the buffer is full.
+*/
+yaflStatusEn yafl_oosm_push(yaflOOSMSt * self, yaflEKFBaseSt * kf, \
+                            yaflFloat t);
+
+/*
+Merges measurement z taken at t into the current kf estimate, see above.
+kf must have dense jf and f, nz <= nx, EKF H, W and D are used as
+scratchpad, t must be older than the newest snapshot time and not older
+than the oldest one. The newest snapshot is replaced with the result.
+*/
+yaflStatusEn yafl_oosm_ekf_update(yaflOOSMSt * self, yaflEKFBaseSt * kf, \
+                                  yaflFloat t, yaflFloat * z);
+
+#endif // YAFL_OOSM_H
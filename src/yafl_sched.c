@@ -0,0 +1,351 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*Need pthread_setaffinity_np*/
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE
+#endif/*_GNU_SOURCE*/
+
+#include <sched.h>
+#include <unistd.h>
+
+#include "yafl_sched.h"
+
+/*---------------------------------------------------------------------------*/
+static void _run_task(yaflSchedWorkerSt * w, yaflSchedTaskSt * t)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+
+    /*Bind per thread scratchpad*/
+    if (t->W)
+    {
+        *t->W = w->W;
+    }
+
+    if (t->D)
+    {
+        *t->D = w->D;
+    }
+
+    if (t->H)
+    {
+        *t->H = w->H;
+    }
+
+    if (t->predict)
+    {
+        status |= t->predict(t->self);
+    }
+
+    if ((status < YAFL_ST_ERR_THR) && t->update && t->z)
+    {
+        status |= t->update(t->self, t->z);
+    }
+
+    t->status  = status;
+    w->status |= status;
+}
+
+/*---------------------------------------------------------------------------*/
+static inline void _run(yaflSchedWorkerSt * w, yaflInt i)
+{
+    yaflSchedSt * sched;
+
+    sched = w->sched;
+    if (sched->body)
+    {
+        w->status |= sched->body(sched->arg, i);
+    }
+    else
+    {
+        _run_task(w, sched->tasks + i);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*Claims a task from the worker range, returns -1 when the range is done*/
+static inline yaflInt _claim(yaflSchedWorkerSt * w)
+{
+    yaflInt i;
+
+    /*Don't touch the cache line for nothing*/
+    if (__atomic_load_n(&w->next, __ATOMIC_RELAXED) >= w->end)
+    {
+        return -1;
+    }
+
+    i = __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED);
+    return (i < w->end) ? i : -1;
+}
+
+/*---------------------------------------------------------------------------*/
+static void _work(yaflSchedWorkerSt * w)
+{
+    yaflSchedSt * sched;
+    yaflInt i;
+    yaflInt v;
+
+    sched = w->sched;
+
+    /*Own range first*/
+    while ((i = _claim(w)) >= 0)
+    {
+        _run(w, i);
+    }
+
+    /*Then steal from the others*/
+    for (v = 1; v < sched->nthreads; v++)
+    {
+        yaflSchedWorkerSt * victim;
+
+        victim = sched->worker + (w->id + v) % sched->nthreads;
+        while ((i = _claim(victim)) >= 0)
+        {
+            _run(w, i);
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+static void * _worker_thread(void * arg)
+{
+    yaflSchedWorkerSt * w;
+    yaflSchedSt * sched;
+    yaflInt gen = 0;
+
+    w     = (yaflSchedWorkerSt *)arg;
+    sched = w->sched;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&sched->lock);
+        while (!sched->stop && (sched->gen == gen))
+        {
+            pthread_cond_wait(&sched->start, &sched->lock);
+        }
+
+        if (sched->stop)
+        {
+            pthread_mutex_unlock(&sched->lock);
+            break;
+        }
+
+        gen = sched->gen;
+        pthread_mutex_unlock(&sched->lock);
+
+        _work(w);
+
+        pthread_mutex_lock(&sched->lock);
+        if (0 == --sched->running)
+        {
+            pthread_cond_signal(&sched->done);
+        }
+        pthread_mutex_unlock(&sched->lock);
+    }
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+static void _stop(yaflSchedSt * self, yaflInt nthreads)
+{
+    yaflInt i;
+
+    pthread_mutex_lock(&self->lock);
+    self->stop = 1;
+    pthread_cond_broadcast(&self->start);
+    pthread_mutex_unlock(&self->lock);
+
+    for (i = 1; i < nthreads; i++)
+    {
+        pthread_join(self->worker[i].thread, 0);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_sched_init(yaflSchedSt * self, yaflInt nthreads,    \
+                             yaflFloat * scratch, yaflInt w_sz,       \
+                             yaflInt d_sz, yaflInt h_sz, yaflInt pin)
+{
+    yaflInt ncpu;
+    yaflInt i;
+
+    YAFL_CHECK(self,                                 YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(nthreads > 0,                         YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(nthreads <= YAFL_SCHED_MAX_THREADS,   YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(scratch || (0 == w_sz + d_sz + h_sz), YAFL_ST_INV_ARG_3);
+    YAFL_CHECK(w_sz >= 0,                            YAFL_ST_INV_ARG_4);
+    YAFL_CHECK(d_sz >= 0,                            YAFL_ST_INV_ARG_5);
+    YAFL_CHECK(h_sz >= 0,                            YAFL_ST_INV_ARG_6);
+
+    pthread_mutex_init(&self->lock, 0);
+    pthread_cond_init(&self->start, 0);
+    pthread_cond_init(&self->done,  0);
+
+    self->tasks    = 0;
+    self->ntasks   = 0;
+    self->body     = 0;
+    self->arg      = 0;
+    self->nthreads = nthreads;
+    self->gen      = 0;
+    self->running  = 0;
+    self->stop     = 0;
+
+    ncpu = (yaflInt)sysconf(_SC_NPROCESSORS_ONLN);
+    ncpu = (ncpu > 0) ? ncpu : 1;
+
+    for (i = 0; i < nthreads; i++)
+    {
+        yaflSchedWorkerSt * w;
+
+        w = self->worker + i;
+
+        w->sched  = self;
+        w->id     = i;
+        w->next   = 0;
+        w->end    = 0;
+        w->status = YAFL_ST_OK;
+
+        w->W = scratch ? (scratch + (w_sz + d_sz + h_sz) * i) : 0;
+        w->D = scratch ? (w->W + w_sz)                        : 0;
+        w->H = scratch ? (w->D + d_sz)                        : 0;
+
+        /*The calling thread is the worker 0*/
+        if (0 == i)
+        {
+            continue;
+        }
+
+        if (pthread_create(&w->thread, 0, _worker_thread, w))
+        {
+            YAFL_LOG("YAFL:Could not create worker thread %d\n", i);
+            _stop(self, i);
+
+            /*deinit refuses a stopped pool, so clean up here*/
+            pthread_cond_destroy(&self->done);
+            pthread_cond_destroy(&self->start);
+            pthread_mutex_destroy(&self->lock);
+            return YAFL_ST_ERR_SYS;
+        }
+
+        /*The calling thread affinity is left as is*/
+        if (pin)
+        {
+            cpu_set_t cpus;
+
+            CPU_ZERO(&cpus);
+            CPU_SET(i % ncpu, &cpus);
+            pthread_setaffinity_np(w->thread, sizeof(cpus), &cpus);
+        }
+    }
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/*Runs n jobs on the pool*/
+static yaflStatusEn _dispatch(yaflSchedSt * self, yaflInt n)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt nthreads;
+    yaflInt i;
+
+    nthreads = self->nthreads;
+
+    /*Split jobs into equal ranges*/
+    for (i = 0; i < nthreads; i++)
+    {
+        self->worker[i].next   = (n * i) / nthreads;
+        self->worker[i].end    = (n * (i + 1)) / nthreads;
+        self->worker[i].status = YAFL_ST_OK;
+    }
+
+    /*Start workers*/
+    pthread_mutex_lock(&self->lock);
+    self->running = nthreads - 1;
+    self->gen++;
+    pthread_cond_broadcast(&self->start);
+    pthread_mutex_unlock(&self->lock);
+
+    _work(self->worker);
+
+    /*Wait for the rest*/
+    pthread_mutex_lock(&self->lock);
+    while (self->running > 0)
+    {
+        pthread_cond_wait(&self->done, &self->lock);
+    }
+    pthread_mutex_unlock(&self->lock);
+
+    for (i = 0; i < nthreads; i++)
+    {
+        status |= self->worker[i].status;
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_sched_run(yaflSchedSt * self, yaflSchedTaskSt * tasks, \
+                            yaflInt ntasks)
+{
+    YAFL_CHECK(self,        YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(!self->stop, YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(tasks,       YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(ntasks >= 0, YAFL_ST_INV_ARG_3);
+
+    /*Workers read these under the lock*/
+    self->tasks  = tasks;
+    self->ntasks = ntasks;
+    self->body   = 0;
+    self->arg    = 0;
+
+    return _dispatch(self, ntasks);
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_sched_parfor(void * self, yaflInt n, yaflSchedBodyP body, \
+                               void * arg)
+{
+    yaflSchedSt * sched;
+
+    YAFL_CHECK(self,   YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(n >= 0, YAFL_ST_INV_ARG_2);
+    YAFL_CHECK(body,   YAFL_ST_INV_ARG_3);
+
+    sched = (yaflSchedSt *)self;
+    YAFL_CHECK(!sched->stop, YAFL_ST_INV_ARG_1);
+
+    /*Workers read these under the lock*/
+    sched->tasks  = 0;
+    sched->ntasks = n;
+    sched->body   = body;
+    sched->arg    = arg;
+
+    return _dispatch(sched, n);
+}
+
+/*---------------------------------------------------------------------------*/
+yaflStatusEn yafl_sched_deinit(yaflSchedSt * self)
+{
+    YAFL_CHECK(self,        YAFL_ST_INV_ARG_1);
+    YAFL_CHECK(!self->stop, YAFL_ST_INV_ARG_1);
+
+    _stop(self, self->nthreads);
+
+    pthread_cond_destroy(&self->done);
+    pthread_cond_destroy(&self->start);
+    pthread_mutex_destroy(&self->lock);
+
+    return YAFL_ST_OK;
+}
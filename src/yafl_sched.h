@@ -0,0 +1,169 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+
+#ifndef YAFL_SCHED_H
+#define YAFL_SCHED_H
+
+#include <pthread.h>
+
+#include <yafl_config.h>
+#include "yafl_math.h"
+
+/*=============================================================================
+           Multi-threaded work stealing scheduler for independent filters
+=============================================================================*/
+/*
+Runs predict/update steps of a set of independent filters of any types and
+shapes on a thread pool. The calling thread is the worker 0.
+
+Tasks are split into equal contiguous ranges, one range per worker, every
+worker claims tasks from its own range and steals tasks from other ranges
+when its own range is done.
+
+Needs POSIX threads, GCC compatible atomics, link with -pthread.
+*/
+#ifndef YAFL_SCHED_MAX_THREADS
+#   define YAFL_SCHED_MAX_THREADS 64
+#endif/*YAFL_SCHED_MAX_THREADS*/
+
+/*
+Worker hot fields are aligned to cache lines, so yaflSchedSt must be
+allocated with at least this alignment (static, automatic or aligned_alloc)
+*/
+#ifndef YAFL_SCHED_CACHE_LINE
+#   define YAFL_SCHED_CACHE_LINE 64
+#endif/*YAFL_SCHED_CACHE_LINE*/
+
+/*
+Filter entry points, any predict/update function or wrapper which takes
+a filter pointer may be used, e.g.:
+yafl_ekf_base_predict, yafl_ukf_base_predict, yafl_ekf_bierman_update,
+yafl_ukf_update, etc.
+*/
+typedef yaflStatusEn (* yaflSchedPredictP)(void *);
+typedef yaflStatusEn (* yaflSchedUpdateP)(void *, yaflFloat *);
+
+typedef struct _yaflSchedTaskSt {
+    void * self;               /*A filter*/
+    yaflSchedPredictP predict; /*Predict function, NULL means "no predict"*/
+    yaflSchedUpdateP  update;  /*Update function, NULL means "no update"*/
+    yaflFloat * z;             /*Measurement, NULL means "no update"*/
+
+    /*
+    Per thread scratchpad binding: when not NULL, *W, *D and *H are pointed
+    to the worker scratchpad memory before the task is run, so W, D and H
+    of a filter (e.g. &ekf.W, &ekf.D, &ekf.H) may be shared by all filters
+    run by the worker.
+    */
+    yaflFloat ** W;
+    yaflFloat ** D;
+    yaflFloat ** H;
+
+    yaflStatusEn status;       /*The last step status*/
+} yaflSchedTaskSt;
+
+/*
+Parallel for loop body, called as body(arg, i), see yafl_sched_parfor.
+Has the same signature as yaflUKFParForBodyP.
+*/
+typedef yaflStatusEn (* yaflSchedBodyP)(void *, yaflInt);
+
+/*---------------------------------------------------------------------------*/
+typedef struct _yaflSchedSt yaflSchedSt;
+
+/*
+Worker info, must not be used directly.
+next and end are claimed by all workers, status is written by the owner,
+so both have own cache lines, other fields are read only after init.
+*/
+typedef struct _yaflSchedWorkerSt {
+    yaflSchedSt * sched;
+    pthread_t     thread;
+
+    yaflInt     id;
+
+    yaflFloat * W;    /*Worker scratchpad memory*/
+    yaflFloat * D;
+    yaflFloat * H;
+
+    /*Next task to claim in the worker range*/
+    yaflInt     next __attribute__((aligned(YAFL_SCHED_CACHE_LINE)));
+    yaflInt     end;  /*Worker range end*/
+
+    yaflStatusEn status __attribute__((aligned(YAFL_SCHED_CACHE_LINE)));
+} yaflSchedWorkerSt;
+
+struct _yaflSchedSt {
+    pthread_mutex_t   lock;
+    pthread_cond_t    start;
+    pthread_cond_t    done;
+
+    yaflSchedTaskSt * tasks;
+    yaflInt           ntasks;
+
+    yaflSchedBodyP    body;    /*Parallel for body, NULL when tasks are run*/
+    void            * arg;     /*Parallel for body argument*/
+
+    yaflInt           nthreads;
+    yaflInt           gen;     /*Step generation, incremented on every run*/
+    yaflInt           running; /*The number of busy workers*/
+    yaflInt           stop;
+
+    yaflSchedWorkerSt worker[YAFL_SCHED_MAX_THREADS];
+};
+
+/*---------------------------------------------------------------------------*/
+/*
+Initializes the scheduler and starts nthreads - 1 worker threads.
+Parameters:
+nthreads - the number of workers including the calling thread
+scratch  - the scratchpad memory, nthreads * (w_sz + d_sz + h_sz)
+           elements, may be NULL if w_sz == d_sz == h_sz == 0
+pin      - nonzero means "pin the worker i to the CPU i"
+
+Returns YAFL_ST_ERR_SYS when a worker thread can not be created, the started
+workers are joined and the pool is released, yafl_sched_deinit must not be
+called in this case.
+*/
+yaflStatusEn yafl_sched_init(yaflSchedSt * self, yaflInt nthreads,    \
+                             yaflFloat * scratch, yaflInt w_sz,       \
+                             yaflInt d_sz, yaflInt h_sz, yaflInt pin);
+
+/*
+Runs one step: predict and then update of every task, returns
+OR-ed statuses of the tasks, see tasks[i].status for the task status.
+*/
+yaflStatusEn yafl_sched_run(yaflSchedSt * self, yaflSchedTaskSt * tasks, \
+                            yaflInt ntasks);
+
+/*
+Runs body(arg, i) for i in [0, n) on the pool, returns OR-ed statuses
+of the calls. The signature matches yaflUKFParForP, so the scheduler may be
+used as a UKF sigma point propagation pool:
+
+ukf.base.pfor     = yafl_sched_parfor;
+ukf.base.pfor_ctx = &sched;
+
+Must not be called from a task or a body run by the same scheduler.
+*/
+yaflStatusEn yafl_sched_parfor(void * self, yaflInt n, yaflSchedBodyP body, \
+                               void * arg);
+
+/*Stops and joins the worker threads*/
+yaflStatusEn yafl_sched_deinit(yaflSchedSt * self);
+
+#endif // YAFL_SCHED_H
@@ -67,6 +67,8 @@ cdef extern from "yafl_math.c":
         YAFL_ST_INV_ARG_9    = 0x180
         YAFL_ST_INV_ARG_10   = 0x190
         YAFL_ST_INV_ARG_11   = 0x1a0
+        # System resource error
+        YAFL_ST_ERR_SYS      = 0x200
 
     #--------------------------------------------------------------------------
     #cdef yaflStatusEn yafl_math_set_u(yaflInt sz, yaflFloat *res, yaflFloat *u)
@@ -198,6 +200,9 @@ cdef extern from "yafl.c":
     ctypedef struct yaflUKFSigmaSt:
         yaflInt     np
         yaflUKFSigmaAddP addf
+        yaflInt     ver
+
+    cdef yaflStatusEn yafl_ukf_sigma_touch(yaflUKFSigmaSt * self) #static inline
 
     #--------------------------------------------------------------------------
     ctypedef yaflStatusEn (* yaflUKFSigmaGenWeigthsP)(yaflUKFBaseSt *)
@@ -207,6 +212,15 @@ cdef extern from "yafl.c":
         yaflUKFSigmaGenWeigthsP   wf
         yaflUKFSigmaGenSigmasP  spgf
 
+    #--------------------------------------------------------------------------
+    ctypedef yaflStatusEn (* yaflUKFBatchFuncP)(yaflUKFBaseSt *, yaflFloat *, \
+                                                yaflFloat *, yaflInt)
+
+    #--------------------------------------------------------------------------
+    ctypedef enum yaflUKFUTModeEn:
+        YAFL_UKF_UT_SEQ   = 0
+        YAFL_UKF_UT_MWGSU = 1
+
     #--------------------------------------------------------------------------
 
     ctypedef struct _yaflUKFBaseSt:
@@ -221,6 +235,11 @@ cdef extern from "yafl.c":
         yaflKalmanFuncP    zmf
         yaflFloat * zp
 
+        yaflUKFBatchFuncP fb
+        yaflUKFBatchFuncP hb
+
+        yaflUKFUTModeEn ut_mode
+
         yaflFloat * Sx
         yaflFloat * Pzx
 
@@ -229,6 +248,9 @@ cdef extern from "yafl.c":
         yaflFloat * wm
         yaflFloat * wc
 
+        yaflFloat * W
+        yaflFloat * D
+
     #--------------------------------------------------------------------------
     cdef yaflStatusEn yafl_ukf_post_init(yaflUKFBaseSt * self)  #static inline
 
@@ -302,6 +324,17 @@ cdef extern from "yafl.c":
 
     cdef const yaflUKFSigmaMethodsSt yafl_ukf_merwe_spm
 
+    #==========================================================================
+    #                Simplex and cubature sigma point generators
+    #==========================================================================
+    ctypedef struct yaflUKFSphericalSt:
+        yaflUKFSigmaSt base
+        yaflFloat w0
+
+    cdef const yaflUKFSigmaMethodsSt yafl_ukf_simplex_spm
+    cdef const yaflUKFSigmaMethodsSt yafl_ukf_spherical_spm
+    cdef const yaflUKFSigmaMethodsSt yafl_ukf_cubature_spm
+
 #==============================================================================
 #Extension API
 #==============================================================================
@@ -341,6 +374,12 @@ ST_INV_ARG_8  = YAFL_ST_INV_ARG_8
 ST_INV_ARG_9  = YAFL_ST_INV_ARG_9
 ST_INV_ARG_10 = YAFL_ST_INV_ARG_10
 ST_INV_ARG_11 = YAFL_ST_INV_ARG_11
+# System call failure
+ST_ERR_SYS    = YAFL_ST_ERR_SYS
+
+#Unscented transform modes
+UT_SEQ   = YAFL_UKF_UT_SEQ
+UT_MWGSU = YAFL_UKF_UT_MWGSU
 
 #==============================================================================
 #                          UD-factorized EKF API
@@ -1005,8 +1044,9 @@ cdef class AdaptiveRobustJoseph(yaflAdaptiveRobustBase):
 #                   Sigma points generator basic definitions
 #------------------------------------------------------------------------------
 ctypedef union yaflPySigmaBaseUn:
-    yaflUKFSigmaSt base
-    yaflUKFMerweSt merwe
+    yaflUKFSigmaSt     base
+    yaflUKFMerweSt     merwe
+    yaflUKFSphericalSt spherical
 
 #------------------------------------------------------------------------------
 ctypedef struct yaflPySigmaSt:
@@ -1042,6 +1082,7 @@ cdef class yaflSigmaBase:
         pnum = self.get_np(dim_x)
 
         self.c_self.base.base.np = pnum
+        self.c_self.base.base.ver = 1
 
     cdef yaflInt get_np(self, int dim_x):
         raise NotImplementedError('yaflSigmaBase is the base class!')
@@ -1073,6 +1114,9 @@ cdef class yaflUnscentedBase(yaflKalmanBase):
     cdef yaflFloat [::1]    v_wm
     cdef yaflFloat [::1]    v_wc
 
+    cdef yaflFloat [::1]    v_W
+    cdef yaflFloat [::1]    v_D
+
     # Kalman filter numpy arrays
     cdef np.ndarray  _zp
 
@@ -1084,6 +1128,9 @@ cdef class yaflUnscentedBase(yaflKalmanBase):
     cdef np.ndarray  _wm
     cdef np.ndarray  _wc
 
+    cdef np.ndarray  _W
+    cdef np.ndarray  _D
+
     # Callback info
     cdef object    _points
 
@@ -1097,10 +1144,23 @@ cdef class yaflUnscentedBase(yaflKalmanBase):
 
     def __init__(self, int dim_x, int dim_z, yaflFloat dt, hx, fx, points,\
                  x_mean_fn=None, z_mean_fn=None, \
-                 residual_x=None, residual_z=None):
+                 residual_x=None, residual_z=None, \
+                 fx_batch=False, hx_batch=False):
 
         super().__init__(dim_x, dim_z, dt, fx, hx, residual_z)
 
+        #Batch callbacks get and return all the sigma points at once:
+        #fx(sigmas_x, dt, **fx_args) -> (pnum, dim_x) array
+        #hx(sigmas_x, **hx_args)     -> (pnum, dim_z) array
+        if fx_batch:
+            self.c_self.base.ukf.fb = <yaflUKFBatchFuncP>yafl_py_ukf_fb
+        else:
+            self.c_self.base.ukf.fb = <yaflUKFBatchFuncP>0
+
+        if hx_batch:
+            self.c_self.base.ukf.hb = <yaflUKFBatchFuncP>yafl_py_ukf_hb
+        else:
+            self.c_self.base.ukf.hb = <yaflUKFBatchFuncP>0
 
         if x_mean_fn:
             if not callable(x_mean_fn):
@@ -1159,6 +1219,17 @@ cdef class yaflUnscentedBase(yaflKalmanBase):
         self.v_sigmas_z = self._sigmas_z
         self.c_self.base.ukf.sigmas_z = &self.v_sigmas_z[0, 0]
 
+        # Unscented transform scratchpad
+        max_sz = max(dim_x, dim_z)
+
+        self._W  = np.zeros(((pnum + max_sz) * max_sz,), dtype=np.float64)
+        self.v_W = self._W
+        self.c_self.base.ukf.W = &self.v_W[0]
+
+        self._D  = np.zeros((pnum + max_sz,), dtype=np.float64)
+        self.v_D = self._D
+        self.c_self.base.ukf.D = &self.v_D[0]
+
         #Rest of rhe UKF
         self._zp  = np.zeros((dim_z,), dtype=np.float64)
         self.v_zp = self._zp
@@ -1219,6 +1290,16 @@ cdef class yaflUnscentedBase(yaflKalmanBase):
     @wm.setter
     def wm(self, value):
         raise AttributeError('yaflUnscentedBase does not support this!')
+    #--------------------------------------------------------------------------
+    @property
+    def ut_mode(self):
+        return self.c_self.base.ukf.ut_mode
+
+    @ut_mode.setter
+    def ut_mode(self, value):
+        if value not in (UT_SEQ, UT_MWGSU):
+            raise ValueError('Invalid ut_mode value!')
+        self.c_self.base.ukf.ut_mode = value
 
     #==========================================================================
     def _predict(self):
@@ -1256,6 +1337,84 @@ cdef yaflStatusEn yafl_py_sigma_addf(yaflPyKalmanBaseSt * self, yaflFloat * delt
         print(tb.format_exc())
         return YAFL_ST_INV_ARG_1
 
+#------------------------------------------------------------------------------
+cdef yaflStatusEn yafl_py_ukf_fb(yaflPyKalmanBaseSt * self, yaflFloat * res, \
+                                 yaflFloat * sigmas, yaflInt pnum):
+    try:
+        if not isinstance(<object>(self.py_self), yaflUnscentedBase):
+            raise ValueError('Invalid py_self type (must be subclass of yaflUnscentedBase)!')
+
+        py_self = <yaflUnscentedBase>(self.py_self)
+
+        fx = py_self._fx
+        if not callable(fx):
+            raise ValueError('fx must be callable!')
+
+        dt = py_self._dt
+        if np.isnan(dt):
+            raise ValueError('Invalid dt value (nan)!')
+
+        fx_args = py_self._fx_args
+        if not isinstance(fx_args, dict):
+            raise ValueError('Invalid fx_args type (must be dict)!')
+
+        nx = self.base.base.Nx
+        if nx <= 0:
+            raise ValueError('nx must be > 0!')
+
+        if pnum <= 0:
+            raise ValueError('pnum must be > 0!')
+
+        _res    = np.asarray(<yaflFloat[:pnum, :nx]> res)    #np.float64_t
+        _sigmas = np.asarray(<yaflFloat[:pnum, :nx]> sigmas) #np.float64_t
+
+        _res[:, :] = fx(_sigmas, dt, **fx_args)
+
+        return YAFL_ST_OK
+
+    except Exception as e:
+        print(tb.format_exc())
+        return YAFL_ST_INV_ARG_1
+
+#------------------------------------------------------------------------------
+cdef yaflStatusEn yafl_py_ukf_hb(yaflPyKalmanBaseSt * self, yaflFloat * res, \
+                                 yaflFloat * sigmas, yaflInt pnum):
+    try:
+        if not isinstance(<object>(self.py_self), yaflUnscentedBase):
+            raise ValueError('Invalid py_self type (must be subclass of yaflUnscentedBase)!')
+
+        py_self = <yaflUnscentedBase>(self.py_self)
+
+        hx = py_self._hx
+        if not callable(hx):
+            raise ValueError('hx must be callable!')
+
+        hx_args = py_self._hx_args
+        if not isinstance(hx_args, dict):
+            raise ValueError('Invalid hx_args type (must be dict)!')
+
+        nx = self.base.base.Nx
+        if nx <= 0:
+            raise ValueError('nx must be > 0!')
+
+        nz = self.base.base.Nz
+        if nz <= 0:
+            raise ValueError('nz must be > 0!')
+
+        if pnum <= 0:
+            raise ValueError('pnum must be > 0!')
+
+        _res    = np.asarray(<yaflFloat[:pnum, :nz]> res)    #np.float64_t
+        _sigmas = np.asarray(<yaflFloat[:pnum, :nx]> sigmas) #np.float64_t
+
+        _res[:, :] = hx(_sigmas, **hx_args)
+
+        return YAFL_ST_OK
+
+    except Exception as e:
+        print(tb.format_exc())
+        return YAFL_ST_INV_ARG_1
+
 #------------------------------------------------------------------------------
 cdef yaflStatusEn yafl_py_ukf_xmf(yaflPyKalmanBaseSt * self, \
                           yaflFloat * res, yaflFloat * sigmas):
@@ -1617,7 +1776,8 @@ cdef class MerweSigmaPoints(yaflSigmaBase):
 
     @alpha.setter
     def alpha(self, value):
-        raise AttributeError('MerweSigmaPoints does not support this!')
+        self.c_self.base.merwe.alpha = <yaflFloat>value
+        yafl_ukf_sigma_touch(&self.c_self.base.base)
 
     @property
     def beta(self):
@@ -1625,7 +1785,8 @@ cdef class MerweSigmaPoints(yaflSigmaBase):
 
     @beta.setter
     def beta(self, value):
-        raise AttributeError('MerweSigmaPoints does not support this!')
+        self.c_self.base.merwe.beta = <yaflFloat>value
+        yafl_ukf_sigma_touch(&self.c_self.base.base)
 
     @property
     def kappa(self):
@@ -1633,4 +1794,65 @@ cdef class MerweSigmaPoints(yaflSigmaBase):
 
     @kappa.setter
     def kappa(self, value):
-        raise AttributeError('MerweSigmaPoints does not support this!')
+        self.c_self.base.merwe.kappa = <yaflFloat>value
+        yafl_ukf_sigma_touch(&self.c_self.base.base)
+
+#==============================================================================
+cdef class SimplexSigmaPoints(yaflSigmaBase):
+    """
+    Julier minimal skew simplex sigma point generator implementation
+    (dim_x + 1 points), use SphericalSigmaPoints for large dim_x
+    """
+    def __init__(self, yaflInt dim_x, **kwargs):
+        super().__init__(dim_x, **kwargs)
+
+    cdef yaflInt get_np(self, int dim_x):
+        return (dim_x + 1)
+
+    cdef const yaflUKFSigmaMethodsSt * get_spm(self):
+        return &yafl_ukf_simplex_spm
+
+#==============================================================================
+cdef class SphericalSigmaPoints(yaflSigmaBase):
+    """
+    Julier spherical simplex sigma point generator implementation
+    (dim_x + 2 points), 0 <= w0 < 1 is the center point weight
+    """
+    def __init__(self, yaflInt dim_x, yaflFloat w0=0.0, **kwargs):
+        if w0 < 0.0 or w0 >= 1.0:
+            raise ValueError('w0 must be in [0, 1)!')
+        super().__init__(dim_x, **kwargs)
+        self.c_self.base.spherical.w0 = w0
+
+    cdef yaflInt get_np(self, int dim_x):
+        return (dim_x + 2)
+
+    cdef const yaflUKFSigmaMethodsSt * get_spm(self):
+        return &yafl_ukf_spherical_spm
+
+    #==========================================================================
+    #Decorators
+    @property
+    def w0(self):
+        return self.c_self.base.spherical.w0
+
+    @w0.setter
+    def w0(self, value):
+        if value < 0.0 or value >= 1.0:
+            raise ValueError('w0 must be in [0, 1)!')
+        self.c_self.base.spherical.w0 = <yaflFloat>value
+        yafl_ukf_sigma_touch(&self.c_self.base.base)
+
+#==============================================================================
+cdef class CubatureSigmaPoints(yaflSigmaBase):
+    """
+    Cubature rule sigma point generator implementation (2 * dim_x points)
+    """
+    def __init__(self, yaflInt dim_x, **kwargs):
+        super().__init__(dim_x, **kwargs)
+
+    cdef yaflInt get_np(self, int dim_x):
+        return (2 * dim_x)
+
+    cdef const yaflUKFSigmaMethodsSt * get_spm(self):
+        return &yafl_ukf_cubature_spm
@@ -0,0 +1,229 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Runtime allocation check: EKFs created in pool slots and a Van der Merwe
+UKF created in an arena must give the same results as the filters
+created with the memory mixins and initializers, all the filter arrays
+must be cache line aligned, pool slots must be recycled.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy alloc_check.c ../../src/yafl.c ../../src/yafl_math.c ../../src/yafl_alloc.c -lm -o alloc_check
+./alloc_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <yafl_alloc.h>
+
+#define NX 4
+#define NZ 2
+
+#define NSLOTS 3
+
+#define STEPS 100
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+static void init(yaflKalmanBaseSt * kf)
+{
+    yaflInt i;
+
+    for (i = 0; i < NX; i++)
+    {
+        kf->x[i]  = 0.1 * (i + 1);
+        kf->Dp[i] = 0.1;
+        kf->Dq[i] = 1.0e-4;
+    }
+
+    memset(kf->Up, 0, sizeof(yaflFloat) * (NX * (NX - 1)) / 2);
+    memset(kf->Uq, 0, sizeof(yaflFloat) * (NX * (NX - 1)) / 2);
+
+    kf->Dr[0] = 1.0e-2;
+    kf->Dr[1] = 1.0e-2;
+    kf->Ur[0] = 0.0;
+}
+
+static void measure(yaflFloat * z, yaflInt s)
+{
+    z[0] = 0.3 * sin(0.05 * s);
+    z[1] = 0.2 + 0.01 * s;
+}
+
+static int same(yaflKalmanBaseSt * a, yaflKalmanBaseSt * b)
+{
+    return !memcmp(a->x,  b->x,  sizeof(yaflFloat) * NX) && \
+           !memcmp(a->Dp, b->Dp, sizeof(yaflFloat) * NX) && \
+           !memcmp(a->Up, b->Up, sizeof(yaflFloat) * (NX * (NX - 1)) / 2);
+}
+
+#define ALIGNED(p) (0 == ((uintptr_t)(p) % YAFL_ALIGN))
+
+static int aligned(yaflKalmanBaseSt * kf)
+{
+    return ALIGNED(kf) && ALIGNED(kf->x)  && ALIGNED(kf->y)  && \
+           ALIGNED(kf->Up) && ALIGNED(kf->Dp) && ALIGNED(kf->Uq) && \
+           ALIGNED(kf->Dq) && ALIGNED(kf->Dr);
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_EKF_BASE_MEMORY_MIXIN(NX, NZ);
+} ekfMemSt;
+
+static ekfMemSt      ekf_mem;
+static yaflEKFBaseSt ekf = YAFL_EKF_BASE_INITIALIZER(yafl_test_nl_fx,  \
+                                                     yafl_test_nl_jfx, \
+                                                     yafl_test_nl_hx,  \
+                                                     yafl_test_nl_jhx, 0, \
+                                                     NX, NZ, ekf_mem);
+
+static int ekf_check(void)
+{
+    static uint8_t pool_mem[NSLOTS * 2048 + YAFL_ALIGN];
+    yaflEKFBaseSt * kf[NSLOTS];
+    yaflPoolSt pool;
+    yaflStatusEn st_s = YAFL_ST_OK;
+    yaflStatusEn st_p = YAFL_ST_OK;
+    size_t sz = yafl_ekf_mem_size(NX, NZ);
+    void * freed;
+    yaflInt s;
+    yaflInt i;
+    int fails = 0;
+    int ok;
+
+    /*Unaligned memory for NSLOTS slots*/
+    st_p |= yafl_pool_init(&pool, pool_mem + 1, NSLOTS * sz + YAFL_ALIGN - 1, \
+                           sz);
+    printf("EKF block size: %u bytes, pool slots: %d\n", (unsigned)sz, pool.n);
+    fails += (NSLOTS != pool.n);
+
+    for (i = 0; i < NSLOTS; i++)
+    {
+        kf[i] = yafl_ekf_create(yafl_pool_alloc(&pool), \
+                                yafl_test_nl_fx, yafl_test_nl_jfx, \
+                                yafl_test_nl_hx, yafl_test_nl_jhx, 0, NX, NZ);
+        fails += !kf[i] || !aligned(&kf[i]->base) || !ALIGNED(kf[i]->H) || \
+                 !ALIGNED(kf[i]->W) || !ALIGNED(kf[i]->D);
+    }
+    /*No free slots*/
+    fails += (0 != yafl_pool_alloc(&pool));
+
+    /*Track churn: the slot must be reused*/
+    freed = kf[1];
+    st_p |= yafl_pool_free(&pool, kf[1]);
+    kf[1] = yafl_ekf_create(yafl_pool_alloc(&pool), \
+                            yafl_test_nl_fx, yafl_test_nl_jfx, \
+                            yafl_test_nl_hx, yafl_test_nl_jhx, 0, NX, NZ);
+    ok = (freed == (void *)kf[1]);
+    printf("Pool slot reuse: %s\n", ok ? "yes" : "NO");
+    fails += !ok;
+
+    init(&ekf.base);
+    init(&kf[1]->base);
+    for (s = 0; s < STEPS; s++)
+    {
+        yaflFloat z[NZ];
+
+        measure(z, s);
+        st_s |= yafl_ekf_base_predict(&ekf.base);
+        st_s |= yafl_ekf_bierman_update(&ekf, z);
+        st_p |= yafl_ekf_base_predict(&kf[1]->base);
+        st_p |= yafl_ekf_bierman_update(kf[1], z);
+    }
+
+    ok = same(&ekf.base, &kf[1]->base);
+    printf("EKF results: %s, status: 0x%x/0x%x\n", ok ? "same" : "DIFFERENT", \
+           st_s, st_p);
+    fails += !ok || (st_s >= YAFL_ST_ERR_THR) || (st_p >= YAFL_ST_ERR_THR);
+    return fails;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_UKF_MEMORY_MIXIN(NX, NZ);
+    YAFL_UKF_MERWE_MEMORY_MIXIN(NX, NZ);
+} ukfMemSt;
+
+static ukfMemSt       ukf_mem;
+static yaflUKFMerweSt ukf_sp = YAFL_UKF_MERWE_INITIALIZER(NX, 0, 0.1, 2.0, \
+                                                          0.0, ukf_mem);
+static yaflUKFSt      ukf = YAFL_UKF_INITIALIZER(&ukf_sp.base, \
+                                                 &yafl_ukf_merwe_spm, \
+                                                 yafl_test_nl_fx, 0, 0, \
+                                                 yafl_test_nl_hx, 0, 0, \
+                                                 NX, NZ, ukf_mem);
+
+static int ukf_check(void)
+{
+    static uint8_t arena_mem[8192];
+    yaflArenaSt arena;
+    yaflUKFSt * kf;
+    yaflStatusEn st_s = YAFL_ST_OK;
+    yaflStatusEn st_a = YAFL_ST_OK;
+    size_t sz = yafl_ukf_merwe_mem_size(NX, NZ);
+    yaflInt s;
+    int fails = 0;
+    int ok;
+
+    st_a |= yafl_arena_init(&arena, arena_mem + 3, sizeof(arena_mem) - 3);
+    kf = yafl_ukf_merwe_create(yafl_arena_alloc(&arena, sz), \
+                               yafl_test_nl_fx, 0, 0, yafl_test_nl_hx, \
+                               0, 0, NX, NZ, 0.1, 2.0, 0.0);
+    printf("Merwe UKF block size: %u bytes, arena used: %u bytes\n", \
+           (unsigned)sz, (unsigned)arena.used);
+    if (!kf)
+    {
+        return 1;
+    }
+    fails += !aligned(&kf->base.base) || !ALIGNED(kf->base.sigmas_x) || \
+             !ALIGNED(kf->base.sigmas_z) || !ALIGNED(kf->base.W) ||     \
+             !ALIGNED(kf->base.D) || !ALIGNED(kf->base.wm);
+
+    st_s |= yafl_ukf_post_init(&ukf.base);
+    init(&ukf.base.base);
+    init(&kf->base.base);
+    for (s = 0; s < STEPS; s++)
+    {
+        yaflFloat z[NZ];
+
+        measure(z, s);
+        st_s |= yafl_ukf_predict(&ukf);
+        st_s |= yafl_ukf_update(&ukf.base, z);
+        st_a |= yafl_ukf_predict(kf);
+        st_a |= yafl_ukf_update(&kf->base, z);
+    }
+
+    ok = same(&ukf.base.base, &kf->base.base);
+    printf("UKF results: %s, status: 0x%x/0x%x\n", ok ? "same" : "DIFFERENT", \
+           st_s, st_a);
+    fails += !ok || (st_s >= YAFL_ST_ERR_THR) || (st_a >= YAFL_ST_ERR_THR);
+    return fails;
+}
+
+int main(void)
+{
+    int fails = 0;
+
+    fails += ekf_check();
+    fails += ukf_check();
+
+    return yafl_test_report(fails);
+}
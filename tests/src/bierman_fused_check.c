@@ -0,0 +1,245 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Fused Bierman update check and benchmark: an EKF with 24 states and
+12 correlated measurements is updated by the fused Bierman kernel and by
+the same scalar update called through a wrapper, which forces the
+sequential path. Dense and sparse H are checked. x, Up, Dp and the
+update statistics must be bit-identical.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy bierman_fused_check.c ../../src/yafl.c ../../src/yafl_math.c -lm -o bierman_fused_check
+./bierman_fused_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl.h>
+
+#define NX 24
+#define NZ 12
+#define NU ((NX * (NX - 1)) / 2)
+
+#define DT 0.01
+
+#define STEPS 20000
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+static yaflStatusEn fx(yaflKalmanBaseSt * self, yaflFloat * x, yaflFloat * xz)
+{
+    yaflInt i;
+
+    (void)self;
+    (void)xz;
+
+    for (i = 0; i < NX; i += 2)
+    {
+        x[i] += DT * x[i + 1];
+    }
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn jfx(yaflKalmanBaseSt * self, yaflFloat * w, yaflFloat * x)
+{
+    yaflInt i;
+
+    (void)self;
+    (void)x;
+
+    for (i = 0; i < NX; i++)
+    {
+        yaflInt j;
+
+        for (j = 0; j < NX; j++)
+        {
+            w[2 * NX * i + j] = (i == j) ? 1.0 : 0.0;
+        }
+    }
+
+    for (i = 0; i < NX; i += 2)
+    {
+        w[2 * NX * i + i + 1] = DT;
+    }
+    return YAFL_ST_OK;
+}
+
+/*Range like sensors*/
+static yaflStatusEn hx(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    yaflInt i;
+
+    (void)self;
+
+    for (i = 0; i < NZ; i++)
+    {
+        y[i] = x[i] + 0.1 * x[(i + 2) % NX] * x[(i + 2) % NX];
+    }
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn jhx(yaflKalmanBaseSt * self, yaflFloat * h, yaflFloat * x)
+{
+    yaflInt i;
+
+    (void)self;
+
+    memset(h, 0, sizeof(yaflFloat) * NZ * NX);
+    for (i = 0; i < NZ; i++)
+    {
+        h[NX * i + i]            = 1.0;
+        h[NX * i + (i + 2) % NX] = 0.2 * x[(i + 2) % NX];
+    }
+    return YAFL_ST_OK;
+}
+
+/*The same H, nonzeros are i and i + 2 as NZ + 2 <= NX*/
+static yaflStatusEn jhs(yaflKalmanBaseSt * self, yaflFloat * h, \
+                        yaflInt * nnz, yaflInt * idx, yaflFloat * x)
+{
+    yaflInt i;
+
+    (void)self;
+
+    for (i = 0; i < NZ; i++)
+    {
+        h[NX * i + i]     = 1.0;
+        h[NX * i + i + 2] = 0.2 * x[i + 2];
+        nnz[i] = 2;
+        idx[NX * i]     = i;
+        idx[NX * i + 1] = i + 2;
+    }
+    return YAFL_ST_OK;
+}
+
+/*Different pointer, so the sequential path is taken*/
+static yaflStatusEn seq_scalar(yaflKalmanBaseSt * self, yaflInt i)
+{
+    return yafl_ekf_bierman_update_scalar(self, i);
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_EKF_BASE_MEMORY_MIXIN(NX, NZ);
+    YAFL_EKF_SPARSE_H_MEMORY_MIXIN(NX, NZ);
+} ekfMemSt;
+
+static ekfMemSt          ekf_mem[2];
+static yaflEKFBaseSt     ekf[2];
+static yaflKalmanStatsSt stats[2];
+
+static void init(yaflInt k, yaflInt sparse)
+{
+    yaflEKFBaseSt tmp = YAFL_EKF_BASE_INITIALIZER(fx, jfx, hx, jhx, 0, NX, NZ, \
+                                                  ekf_mem[k]);
+    yaflInt i;
+
+    ekf[k] = tmp;
+    if (sparse)
+    {
+        yafl_ekf_set_sparse_h(&ekf[k], jhs, ekf_mem[k].Hnnz, ekf_mem[k].Hidx);
+    }
+    yafl_kalman_set_stats(&ekf[k].base, &stats[k]);
+
+    for (i = 0; i < NX; i++)
+    {
+        ekf_mem[k].x[i]  = 0.1 * i;
+        ekf_mem[k].Dp[i] = 1.0;
+        ekf_mem[k].Dq[i] = 1.0e-4;
+    }
+
+    memset(ekf_mem[k].Up, 0, sizeof(ekf_mem[k].Up));
+    memset(ekf_mem[k].Uq, 0, sizeof(ekf_mem[k].Uq));
+
+    for (i = 0; i < NZ; i++)
+    {
+        ekf_mem[k].Dr[i] = 1.0e-2;
+    }
+    for (i = 0; i < (NZ * (NZ - 1)) / 2; i++)
+    {
+        ekf_mem[k].Ur[i] = 0.05 * (i % 3);
+    }
+}
+
+/*Returns update time only*/
+static double run(yaflInt k, yaflKalmanScalarUpdateP scalar, yaflStatusEn * status)
+{
+    double t = 0.0;
+    yaflInt s;
+
+    for (s = 0; s < STEPS; s++)
+    {
+        struct timespec t0;
+        struct timespec t1;
+        yaflFloat z[NZ];
+        yaflInt i;
+
+        for (i = 0; i < NZ; i++)
+        {
+            z[i] = sin(0.001 * s + i);
+        }
+
+        *status |= yafl_ekf_base_predict(&ekf[k].base);
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        *status |= yafl_ekf_base_update(&ekf[k].base, z, scalar);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        t += yafl_test_ms(&t0, &t1);
+    }
+    return t;
+}
+
+static int check(yaflInt sparse)
+{
+    yaflStatusEn st_s = YAFL_ST_OK;
+    yaflStatusEn st_f = YAFL_ST_OK;
+    double t_s;
+    double t_f;
+    int same;
+
+    init(0, sparse);
+    init(1, sparse);
+
+    t_s = run(0, seq_scalar, &st_s);
+    t_f = run(1, yafl_ekf_bierman_update_scalar, &st_f);
+
+    same = !memcmp(ekf_mem[0].x,  ekf_mem[1].x,  sizeof(ekf_mem[0].x))  && \
+           !memcmp(ekf_mem[0].Up, ekf_mem[1].Up, sizeof(ekf_mem[0].Up)) && \
+           !memcmp(ekf_mem[0].Dp, ekf_mem[1].Dp, sizeof(ekf_mem[0].Dp)) && \
+           (stats[0].ll == stats[1].ll) && (stats[0].nis == stats[1].nis);
+
+    printf("%s H: update sequential: %6.1f ms, fused: %6.1f ms, status: 0x%x/0x%x, %s\n", \
+           sparse ? "sparse" : "dense ", t_s, t_f, st_s, st_f, \
+           same ? "same" : "DIFFERENT");
+
+    return !same || (st_s >= YAFL_ST_ERR_THR) || (st_f >= YAFL_ST_ERR_THR);
+}
+
+int main(void)
+{
+    int fails = 0;
+
+    fails += check(0);
+    fails += check(1);
+
+    return yafl_test_report(fails);
+}
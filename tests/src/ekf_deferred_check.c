@@ -0,0 +1,263 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Deferred covariance predict check and benchmark: 9 state constant
+acceleration model (3 axes x (p, v, a)), the state is predicted at 1 kHz,
+measurements come at 50 Hz. An EKF with full predicts is compared with
+EKFs with state only predicts, which must give the same results when
+every predict is followed by an update. With exact Q fold the results
+must be the same for any update rate, the default Nd * Q fold error
+is reported. A deferred EKF with sparse F = I + S must match the dense one.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy ekf_deferred_check.c ../../src/yafl.c ../../src/yafl_math.c -lm -o ekf_deferred_check
+./ekf_deferred_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl.h>
+
+#define NX 9
+#define NZ 3
+#define NU ((NX * (NX - 1)) / 2)
+
+#define DT 0.001
+
+#define STEPS 100000
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+/*Axis k position, velocity and acceleration are x[3k], x[3k + 1], x[3k + 2]*/
+static yaflStatusEn hx(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+
+    y[0] = x[0];
+    y[1] = x[3];
+    y[2] = x[6];
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn jhx(yaflKalmanBaseSt * self, yaflFloat * h, yaflFloat * x)
+{
+    (void)self;
+    (void)x;
+
+    memset(h, 0, sizeof(yaflFloat) * NZ * NX);
+    h[0]          = 1.0;
+    h[NX + 3]     = 1.0;
+    h[2 * NX + 6] = 1.0;
+    return YAFL_ST_OK;
+}
+
+/*S = F - I: row 3k has 2 nonzeros, row 3k + 1 has 1 nonzero*/
+static yaflStatusEn jfs(yaflKalmanBaseSt * self, yaflFloat * w, \
+                        yaflInt * nnz, yaflInt * idx, yaflFloat * x)
+{
+    yaflInt k;
+
+    (void)self;
+    (void)x;
+
+    for (k = 0; k < 3; k++)
+    {
+        yaflInt p = 3 * k;
+        yaflInt v = 3 * k + 1;
+
+        nnz[p] = 2;
+        idx[NX * p]     = p + 1;
+        idx[NX * p + 1] = p + 2;
+        w[2 * NX * p + p + 1] = DT;
+        w[2 * NX * p + p + 2] = 0.5 * DT * DT;
+
+        nnz[v] = 1;
+        idx[NX * v] = v + 1;
+        w[2 * NX * v + v + 1] = DT;
+
+        nnz[v + 1] = 0;
+    }
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_EKF_BASE_MEMORY_MIXIN(NX, NZ);
+    YAFL_EKF_SPARSE_F_MEMORY_MIXIN(NX);
+    YAFL_EKF_DEFERRED_MEMORY_MIXIN(NX);
+    YAFL_EKF_DEFERRED_EXACT_MEMORY_MIXIN(NX);
+} ekfMemSt;
+
+static ekfMemSt      ekf_mem[4];
+static yaflEKFBaseSt ekf[4];
+
+static void init(yaflInt k)
+{
+    yaflEKFBaseSt tmp = YAFL_EKF_BASE_INITIALIZER(yafl_test_ca_fx,  \
+                                                  yafl_test_ca_jfx, \
+                                                  hx, jhx, 0, NX, NZ, \
+                                                  ekf_mem[k]);
+    yaflInt i;
+
+    ekf[k] = tmp;
+    yafl_ekf_set_deferred(&ekf[k], ekf_mem[k].Phi);
+    if (2 == k)
+    {
+        yafl_ekf_set_deferred_exact(&ekf[k], ekf_mem[k].Fd,  \
+                                    ekf_mem[k].Uqd, ekf_mem[k].Dqd, \
+                                    ekf_mem[k].Uqs, ekf_mem[k].Dqs);
+    }
+    if (3 == k)
+    {
+        yafl_ekf_set_sparse_f(&ekf[k], jfs, ekf_mem[k].Fnnz, ekf_mem[k].Fidx);
+    }
+
+    for (i = 0; i < NX; i++)
+    {
+        ekf_mem[k].x[i]  = 0.0;
+        ekf_mem[k].Dp[i] = 1.0;
+        ekf_mem[k].Dq[i] = 1.0e-8;
+    }
+
+    for (i = 0; i < NU; i++)
+    {
+        ekf_mem[k].Up[i] = 0.0;
+        ekf_mem[k].Uq[i] = 0.0;
+    }
+
+    for (i = 0; i < NZ; i++)
+    {
+        ekf_mem[k].Dr[i] = 1.0e-2;
+    }
+    memset(ekf_mem[k].Ur, 0, sizeof(ekf_mem[k].Ur));
+}
+
+/*
+Filter 0 does full predicts, filters 1, 2 and 3 do state only predicts,
+filter 2 folds Q exactly, filter 3 has sparse F
+*/
+static double run(yaflInt k, yaflInt rate, yaflStatusEn * status)
+{
+    clock_t t;
+    yaflInt s;
+
+    t = clock();
+    for (s = 0; s < STEPS; s++)
+    {
+        if (k)
+        {
+            *status |= yafl_ekf_predict_x(&ekf[k]);
+        }
+        else
+        {
+            *status |= yafl_ekf_base_predict(&ekf[k].base);
+        }
+
+        if (0 == s % rate)
+        {
+            yaflFloat z[NZ];
+
+            z[0] = sin(0.0001 * s);
+            z[1] = cos(0.0002 * s);
+            z[2] = 0.0001 * s;
+
+            *status |= yafl_ekf_bierman_update(&ekf[k], z);
+        }
+    }
+    *status |= yafl_ekf_flush(&ekf[k]);
+    return (double)(clock() - t) * 1.0e3 / CLOCKS_PER_SEC;
+}
+
+/*Max x and P differences of filter k from filter 0*/
+static void diff(yaflInt k, yaflFloat * dx, yaflFloat * dp)
+{
+    yaflInt i;
+
+    *dx = 0.0;
+    *dp = 0.0;
+    for (i = 0; i < NX; i++)
+    {
+        *dx = fmax(*dx, fabs(ekf_mem[0].x[i] - ekf_mem[k].x[i]));
+        *dp = fmax(*dp, fabs(ekf_mem[0].Dp[i] - ekf_mem[k].Dp[i]) / ekf_mem[0].Dp[i]);
+    }
+    for (i = 0; i < NU; i++)
+    {
+        *dp = fmax(*dp, fabs(ekf_mem[0].Up[i] - ekf_mem[k].Up[i]));
+    }
+}
+
+static int check(yaflInt rate, yaflFloat tol, yaflFloat tol_exact)
+{
+    yaflStatusEn st_f = YAFL_ST_OK;
+    yaflStatusEn st_d = YAFL_ST_OK;
+    yaflStatusEn st_e = YAFL_ST_OK;
+    yaflStatusEn st_s = YAFL_ST_OK;
+    yaflFloat dx;
+    yaflFloat dp;
+    yaflFloat ex;
+    yaflFloat ep;
+    yaflFloat sx;
+    yaflFloat sp;
+    double t_f;
+    double t_d;
+    double t_e;
+    double t_s;
+
+    init(0);
+    init(1);
+    init(2);
+    init(3);
+
+    t_f = run(0, rate, &st_f);
+    t_d = run(1, rate, &st_d);
+    t_e = run(2, rate, &st_e);
+    t_s = run(3, rate, &st_s);
+
+    diff(1, &dx, &dp);
+    diff(2, &ex, &ep);
+    diff(3, &sx, &sp);
+
+    printf("Update every %2d predicts: full: %6.1f ms, deferred: %6.1f ms, "
+           "x diff: %.3e, P diff: %.3e, status: 0x%x/0x%x\n", \
+           rate, t_f, t_d, dx, dp, st_f, st_d);
+    printf("                          exact fold: %6.1f ms, "
+           "x diff: %.3e, P diff: %.3e, status: 0x%x\n", \
+           t_e, ex, ep, st_e);
+    printf("                          sparse F:   %6.1f ms, "
+           "x diff: %.3e, P diff: %.3e, status: 0x%x\n", \
+           t_s, sx, sp, st_s);
+
+    /*Sparse F is exact, so filter 3 has the dense deferred error*/
+    return (dx > tol) || (dp > tol) || (ex > tol_exact) || (ep > tol_exact) || \
+           (fabs(sx - dx) > 1.0e-12) || (fabs(sp - dp) > 1.0e-9) || \
+           (st_f >= YAFL_ST_ERR_THR) || (st_d >= YAFL_ST_ERR_THR) || \
+           (st_e >= YAFL_ST_ERR_THR) || (st_s >= YAFL_ST_ERR_THR);
+}
+
+int main(void)
+{
+    int fails = 0;
+
+    fails += check(1,  1.0e-12, 1.0e-12);
+    fails += check(20, 1.0e-2,  1.0e-10);
+
+    return yafl_test_report(fails);
+}
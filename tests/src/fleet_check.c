@@ -0,0 +1,446 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Filter fleet check against NF separate EKFs and benchmark.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy fleet_check.c ../../src/yafl_fleet.c ../../src/yafl.c ../../src/yafl_math.c -lm -o fleet_check
+./fleet_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl.h>
+#include <yafl_fleet.h>
+
+#define NX 6
+#define NZ 2
+#define NF 1000
+
+#define NU ((NX * (NX - 1)) / 2)
+#define NR ((NZ * (NZ - 1)) / 2)
+
+#define DT 0.1
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+/*Single filter model: coupled oscillators, range like measurements*/
+static void f1(yaflFloat * x)
+{
+    yaflInt i;
+
+    for (i = 0; i < NX; i += 2)
+    {
+        yaflFloat p = x[i];
+        x[i]     += DT * x[i + 1];
+        x[i + 1] -= DT * sin(p);
+    }
+}
+
+static void jf1(yaflFloat * w, yaflInt nc, yaflFloat * x)
+{
+    yaflInt i;
+
+    for (i = 0; i < NX; i++)
+    {
+        yaflInt j;
+        for (j = 0; j < NX; j++)
+        {
+            w[nc * i + j] = (i == j) ? 1.0 : 0.0;
+        }
+    }
+
+    /*x is already predicted, but the model is smooth, it's OK for a test*/
+    for (i = 0; i < NX; i += 2)
+    {
+        w[nc * i + i + 1] = DT;
+        w[nc * (i + 1) + i] = -DT * cos(x[i]);
+    }
+}
+
+static void h1(yaflFloat * y, yaflFloat * x)
+{
+    y[0] = x[0] * x[0] + x[2];
+    y[1] = x[4] + 0.1 * x[1];
+}
+
+static void jh1(yaflFloat * h, yaflFloat * x)
+{
+    memset(h, 0, sizeof(yaflFloat) * NZ * NX);
+    h[0] = 2.0 * x[0];
+    h[2] = 1.0;
+    h[NX + 4] = 1.0;
+    h[NX + 1] = 0.1;
+}
+
+/*---------------------------------------------------------------------------*/
+/*EKF callbacks*/
+static yaflStatusEn ekf_f(yaflKalmanBaseSt * self, yaflFloat * x, yaflFloat * xz)
+{
+    (void)self;
+    (void)xz;
+    f1(x);
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn ekf_jf(yaflKalmanBaseSt * self, yaflFloat * w, yaflFloat * x)
+{
+    (void)self;
+    jf1(w, 2 * NX, x);
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn ekf_h(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+    h1(y, x);
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn ekf_jh(yaflKalmanBaseSt * self, yaflFloat * h, yaflFloat * x)
+{
+    (void)self;
+    jh1(h, x);
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/*Lane gather/scatter for the setup and the checks*/
+#define GATHER(dst, src, sz, l)  \
+do {                             \
+    yaflInt _e;                  \
+    for (_e = 0; _e < sz; _e++)  \
+    {                            \
+        dst[_e] = src[_e * NF + l]; \
+    }                            \
+} while (0)
+
+#define SCATTER(dst, src, sz, l) \
+do {                             \
+    yaflInt _e;                  \
+    for (_e = 0; _e < sz; _e++)  \
+    {                            \
+        dst[_e * NF + l] = src[_e]; \
+    }                            \
+} while (0)
+
+/*Fleet callbacks are the same models written as lane loops*/
+#define L(p, e) ((p)[(e) * NF + l])
+
+static yaflStatusEn fleet_f(yaflFleetSt * self, yaflFloat * x, yaflFloat * xz)
+{
+    yaflInt i;
+
+    (void)self;
+    (void)xz;
+
+    for (i = 0; i < NX; i += 2)
+    {
+        yaflInt l;
+
+        for (l = 0; l < NF; l++)
+        {
+            yaflFloat p = L(x, i);
+            L(x, i)     += DT * L(x, i + 1);
+            L(x, i + 1) -= DT * sin(p);
+        }
+    }
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn fleet_jf(yaflFleetSt * self, yaflFloat * w, yaflFloat * x)
+{
+    yaflInt i;
+
+    (void)self;
+
+    for (i = 0; i < NX; i++)
+    {
+        yaflInt j;
+
+        for (j = 0; j < NX; j++)
+        {
+            yaflInt l;
+
+            for (l = 0; l < NF; l++)
+            {
+                L(w, 2 * NX * i + j) = (i == j) ? 1.0 : 0.0;
+            }
+        }
+    }
+
+    for (i = 0; i < NX; i += 2)
+    {
+        yaflInt l;
+
+        for (l = 0; l < NF; l++)
+        {
+            L(w, 2 * NX * i + i + 1)   = DT;
+            L(w, 2 * NX * (i + 1) + i) = -DT * cos(L(x, i));
+        }
+    }
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn fleet_h(yaflFleetSt * self, yaflFloat * y, yaflFloat * x)
+{
+    yaflInt l;
+
+    (void)self;
+
+    for (l = 0; l < NF; l++)
+    {
+        L(y, 0) = L(x, 0) * L(x, 0) + L(x, 2);
+        L(y, 1) = L(x, 4) + 0.1 * L(x, 1);
+    }
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn fleet_jh(yaflFleetSt * self, yaflFloat * h, yaflFloat * x)
+{
+    yaflInt l;
+
+    (void)self;
+
+    memset(h, 0, sizeof(yaflFloat) * NZ * NX * NF);
+    for (l = 0; l < NF; l++)
+    {
+        L(h, 0)      = 2.0 * L(x, 0);
+        L(h, 2)      = 1.0;
+        L(h, NX + 4) = 1.0;
+        L(h, NX + 1) = 0.1;
+    }
+    return YAFL_ST_OK;
+}
+
+#undef L
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_EKF_BASE_MEMORY_MIXIN(NX, NZ);
+} ekfMemSt;
+
+static ekfMemSt      ekf_mem[NF];
+static yaflEKFBaseSt ekf[NF];
+
+static struct {
+    YAFL_FLEET_MEMORY_MIXIN(NX, NZ, NF);
+} fleet_mem;
+
+static yaflFleetSt fleet = YAFL_FLEET_INITIALIZER(fleet_f, fleet_jf,  \
+                                                  fleet_h, fleet_jh,  \
+                                                  NX, NZ, NF, fleet_mem);
+
+static yaflFloat z[NZ * NF];
+static uint8_t   mask[NF];
+
+static void init(void)
+{
+    yaflInt l;
+
+    srand(1);
+
+    for (l = 0; l < NF; l++)
+    {
+        yaflEKFBaseSt tmp = YAFL_EKF_BASE_INITIALIZER(ekf_f, ekf_jf, ekf_h,    \
+                                                      ekf_jh, 0, NX, NZ,      \
+                                                      ekf_mem[l]);
+        yaflInt e;
+
+        ekf[l] = tmp;
+
+        for (e = 0; e < NX; e++)
+        {
+            ekf_mem[l].x[e]  = (yaflFloat)rand() / RAND_MAX - 0.5;
+            ekf_mem[l].Dp[e] = 1.0;
+            ekf_mem[l].Dq[e] = 1.0e-4 * (1.0 + e);
+        }
+
+        for (e = 0; e < NU; e++)
+        {
+            ekf_mem[l].Up[e] = 0.0;
+            ekf_mem[l].Uq[e] = 0.01 * e;
+        }
+
+        ekf_mem[l].Dr[0] = 0.01;
+        ekf_mem[l].Dr[1] = 0.02;
+        ekf_mem[l].Ur[0] = 0.3;
+
+        SCATTER(fleet_mem.x,  ekf_mem[l].x,  NX, l);
+        SCATTER(fleet_mem.Up, ekf_mem[l].Up, NU, l);
+        SCATTER(fleet_mem.Dp, ekf_mem[l].Dp, NX, l);
+        SCATTER(fleet_mem.Uq, ekf_mem[l].Uq, NU, l);
+        SCATTER(fleet_mem.Dq, ekf_mem[l].Dq, NX, l);
+        SCATTER(fleet_mem.Ur, ekf_mem[l].Ur, NR, l);
+        SCATTER(fleet_mem.Dr, ekf_mem[l].Dr, NZ, l);
+    }
+}
+
+static void gen_z(yaflInt s)
+{
+    yaflInt l;
+
+    for (l = 0; l < NF; l++)
+    {
+        z[l]      = sin(0.1 * s + l);
+        z[NF + l] = cos(0.05 * s + 0.5 * l);
+        mask[l]   = (rand() & 3) != 0;
+    }
+}
+
+static yaflFloat max_diff(void)
+{
+    yaflFloat diff = 0.0;
+    yaflInt l;
+
+    for (l = 0; l < NF; l++)
+    {
+        yaflInt e;
+
+        for (e = 0; e < NX; e++)
+        {
+            yaflFloat dx = fabs(ekf_mem[l].x[e] - fleet_mem.x[e * NF + l]);
+            yaflFloat dd = fabs(ekf_mem[l].Dp[e] - fleet_mem.Dp[e * NF + l]) / \
+                           ekf_mem[l].Dp[e];
+            diff = (dx > diff) ? dx : diff;
+            diff = (dd > diff) ? dd : diff;
+        }
+    }
+    return diff;
+}
+
+#define STEPS 100
+
+static int check(const char * name, yaflKalmanScalarUpdateP ekf_scalar, \
+                 yaflFleetScalarUpdateP fleet_scalar)
+{
+    clock_t t;
+    double t_ekf = 0.0;
+    double t_fleet = 0.0;
+    yaflFloat diff;
+    yaflInt s;
+
+    init();
+
+    for (s = 0; s < STEPS; s++)
+    {
+        yaflInt l;
+
+        gen_z(s);
+
+        t = clock();
+        for (l = 0; l < NF; l++)
+        {
+            yaflFloat zl[NZ];
+
+            yafl_ekf_base_predict((yaflKalmanBaseSt *)&ekf[l]);
+            if (mask[l])
+            {
+                GATHER(zl, z, NZ, l);
+                yafl_ekf_base_update((yaflKalmanBaseSt *)&ekf[l], zl, ekf_scalar);
+            }
+        }
+        t_ekf += clock() - t;
+
+        t = clock();
+        yafl_fleet_predict(&fleet);
+        yafl_fleet_update(&fleet, z, mask, fleet_scalar);
+        t_fleet += clock() - t;
+    }
+
+    diff = max_diff();
+    printf("%s: %d filters, %d steps, separate: %.1f ms, fleet: %.1f ms, max diff: %.3e\n", \
+           name, NF, STEPS, t_ekf * 1.0e3 / CLOCKS_PER_SEC,                          \
+           t_fleet * 1.0e3 / CLOCKS_PER_SEC, diff);
+    return diff > 1.0e-9;
+}
+
+/*A Joseph update with s <= 0 in one filter must not touch the others*/
+#define BAD 3
+
+static struct {
+    YAFL_FLEET_MEMORY_MIXIN(NX, NZ, NF);
+} fleet_prior, fleet_ref;
+
+static int bad_filter_check(void)
+{
+    yaflStatusEn st;
+    yaflInt l;
+    yaflInt e;
+    int fails = 0;
+
+    init();
+    gen_z(0);
+    yafl_fleet_predict(&fleet);
+    memcpy(&fleet_prior, &fleet_mem, sizeof(fleet_mem));
+
+    yafl_fleet_joseph_update(&fleet, z, 0);
+    memcpy(&fleet_ref, &fleet_mem, sizeof(fleet_mem));
+
+    memcpy(&fleet_mem, &fleet_prior, sizeof(fleet_mem));
+    fleet_mem.Dr[BAD] = -1.0e6;
+
+    fprintf(stderr, "Expected YAFL_CHECK message:\n");
+    st = yafl_fleet_joseph_update(&fleet, z, 0);
+
+    for (l = 0; l < NF; l++)
+    {
+        if (BAD == l)
+        {
+            continue;
+        }
+
+        for (e = 0; e < NX; e++)
+        {
+            fails += fleet_mem.x[e * NF + l]  != fleet_ref.x[e * NF + l];
+            fails += fleet_mem.Dp[e * NF + l] != fleet_ref.Dp[e * NF + l];
+        }
+
+        for (e = 0; e < NU; e++)
+        {
+            fails += fleet_mem.Up[e * NF + l] != fleet_ref.Up[e * NF + l];
+        }
+    }
+
+    for (e = 0; e < NX; e++)
+    {
+        fails += !isfinite(fleet_mem.x[e * NF + BAD]);
+        fails += !isfinite(fleet_mem.Dp[e * NF + BAD]);
+    }
+
+    fails += (st < YAFL_ST_ERR_THR);
+    printf("Joseph, s <= 0 in filter %d: status: 0x%x, other filters %s\n", \
+           BAD, st, fails ? "CHANGED" : "same");
+    return fails;
+}
+
+int main(void)
+{
+    int fails = 0;
+
+    fails += check("Bierman", yafl_ekf_bierman_update_scalar, \
+                   yafl_fleet_bierman_update_scalar);
+    fails += check("Joseph",  yafl_ekf_joseph_update_scalar,  \
+                   yafl_fleet_joseph_update_scalar);
+    fails += bad_filter_check();
+
+    return yafl_test_report(fails);
+}
@@ -0,0 +1,466 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Gating check: a 2D constant velocity target is tracked by a range and
+bearing EKF and by a position measuring full UKF, sensor noise is
+correlated. Candidate measurements are gated before every update.
+
+Checks:
+- EKF distances against a dense S = H.dot(P).dot(H.T) + R computation,
+- UKF distance of the applied measurement against the update NIS,
+- gating does not change x, y, Up and Dp,
+- gating with deferred predicts against gating of a flushed copy, it must
+  not change Up, Dp, Nd, Phi and Fd,
+- gating time against updates of filter copies.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy gate_check.c ../../src/yafl.c ../../src/yafl_math.c -lm -o gate_check
+./gate_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl.h>
+
+#define NX 4 /*px, vx, py, vy*/
+#define NZ 2
+#define NU ((NX * (NX - 1)) / 2)
+
+#define DT    0.1
+#define SIGMA 0.1
+
+#define STEPS 100
+#define NCAND 256
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+/*Range and bearing sensor*/
+static yaflStatusEn hrb(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+
+    y[0] = sqrt(x[0] * x[0] + x[2] * x[2]);
+    y[1] = atan2(x[2], x[0]);
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn jhrb(yaflKalmanBaseSt * self, yaflFloat * h, yaflFloat * x)
+{
+    yaflFloat r2 = x[0] * x[0] + x[2] * x[2];
+    yaflFloat r  = sqrt(r2);
+
+    (void)self;
+
+    memset(h, 0, sizeof(yaflFloat) * NZ * NX);
+    h[0]      = x[0] / r;
+    h[2]      = x[2] / r;
+    h[NX]     = -x[2] / r2;
+    h[NX + 2] = x[0] / r2;
+    return YAFL_ST_OK;
+}
+
+/*Position sensor*/
+static yaflStatusEn hp(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+
+    y[0] = x[0];
+    y[1] = x[2];
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_EKF_BASE_MEMORY_MIXIN(NX, NZ);
+} ekfMemSt;
+
+typedef struct {
+    YAFL_UKF_MEMORY_MIXIN(NX, NZ);
+    YAFL_UKF_MERWE_MEMORY_MIXIN(NX, NZ);
+} ukfMemSt;
+
+static ekfMemSt       ekf_mem;
+static yaflEKFBaseSt  ekf = YAFL_EKF_BASE_INITIALIZER(yafl_test_cv_fx,  \
+                                                      yafl_test_cv_jfx, \
+                                                      hrb, jhrb, 0,     \
+                                                      NX, NZ, ekf_mem);
+
+static ukfMemSt       ukf_mem;
+static yaflUKFMerweSt ukf_sp = YAFL_UKF_MERWE_INITIALIZER(NX, 0, 0.1, 2.0, \
+                                                          0.0, ukf_mem);
+static yaflUKFSt      ukf = YAFL_UKF_INITIALIZER(&ukf_sp.base,          \
+                                                 &yafl_ukf_merwe_spm,   \
+                                                 yafl_test_cv_fx, 0, 0, \
+                                                 hp, 0, 0,              \
+                                                 NX, NZ, ukf_mem);
+
+/*Filter copies for the reference gating by updates*/
+static ekfMemSt       ekf_tmp_mem;
+static yaflEKFBaseSt  ekf_tmp = YAFL_EKF_BASE_INITIALIZER(yafl_test_cv_fx,  \
+                                                          yafl_test_cv_jfx, \
+                                                          hrb, jhrb,        \
+                                                          0, NX, NZ,        \
+                                                          ekf_tmp_mem);
+
+/*Deferred predicts, gating must not flush*/
+typedef struct {
+    YAFL_EKF_BASE_MEMORY_MIXIN(NX, NZ);
+    YAFL_EKF_DEFERRED_MEMORY_MIXIN(NX);
+    YAFL_EKF_DEFERRED_EXACT_MEMORY_MIXIN(NX);
+} ekfDefMemSt;
+
+static ekfDefMemSt    ekf_def_mem;
+static yaflEKFBaseSt  ekf_def = YAFL_EKF_BASE_INITIALIZER(yafl_test_cv_fx,  \
+                                                          yafl_test_cv_jfx, \
+                                                          hrb, jhrb,        \
+                                                          0, NX, NZ,        \
+                                                          ekf_def_mem);
+
+static ekfDefMemSt    ekf_def_tmp_mem;
+static yaflEKFBaseSt  ekf_def_tmp = YAFL_EKF_BASE_INITIALIZER(yafl_test_cv_fx,  \
+                                                              yafl_test_cv_jfx, \
+                                                              hrb, jhrb,        \
+                                                              0, NX, NZ,        \
+                                                              ekf_def_tmp_mem);
+
+static yaflKalmanStatsSt stats;
+
+static yaflFloat cand[NCAND * NZ];
+static yaflFloat d2[NCAND];
+
+/*---------------------------------------------------------------------------*/
+static void init_kalman(yaflKalmanBaseSt * kf)
+{
+    yaflInt i;
+
+    for (i = 0; i < NX; i++)
+    {
+        kf->x[i]  = 0.0;
+        kf->Dp[i] = 0.1;
+        kf->Dq[i] = 1.0e-3;
+    }
+    kf->x[0] = 10.0;
+    kf->x[2] = 5.0;
+    kf->x[1] = 1.0;
+
+    memset(kf->Up, 0, sizeof(yaflFloat) * NU);
+    memset(kf->Uq, 0, sizeof(yaflFloat) * NU);
+
+    kf->Dr[0] = SIGMA * SIGMA;
+    kf->Dr[1] = SIGMA * SIGMA;
+    kf->Ur[0] = 0.3;
+}
+
+static void true_pos(yaflInt s, yaflFloat * p)
+{
+    p[0] = 10.0 + DT * s + 0.1 * sin(0.05 * s);
+    p[1] = 5.0 + 0.2 * cos(0.03 * s);
+}
+
+/*Candidates around z, the first one is z*/
+static void set_cand(yaflFloat * z, yaflFloat scale)
+{
+    yaflInt k;
+
+    for (k = 0; k < NCAND; k++)
+    {
+        cand[NZ * k]     = z[0] + (k ? scale * (rand() / (double)RAND_MAX - 0.5) : 0.0);
+        cand[NZ * k + 1] = z[1] + (k ? scale * (rand() / (double)RAND_MAX - 0.5) : 0.0);
+    }
+}
+
+/*Dense S and distances for the range and bearing EKF*/
+static yaflFloat dense_diff(yaflKalmanBaseSt * kf)
+{
+    yaflFloat a[NX][NX];
+    yaflFloat h[NZ * NX];
+    yaflFloat g[NZ][NX];
+    yaflFloat s[NZ][NZ];
+    yaflFloat hx[NZ];
+    yaflFloat det;
+    yaflFloat diff = 0.0;
+    yaflInt i;
+    yaflInt j;
+    yaflInt k;
+
+    for (i = 0; i < NX; i++)
+    {
+        for (j = 0; j < NX; j++)
+        {
+            a[i][j] = (i == j) ? 1.0 : \
+                      ((j > i) ? kf->Up[i + ((j - 1) * j) / 2] : 0.0);
+        }
+    }
+
+    hrb(kf, hx, kf->x);
+    jhrb(kf, h, kf->x);
+
+    /* g = H.dot(U) */
+    for (i = 0; i < NZ; i++)
+    {
+        for (j = 0; j < NX; j++)
+        {
+            g[i][j] = 0.0;
+            for (k = 0; k < NX; k++)
+            {
+                g[i][j] += h[NX * i + k] * a[k][j];
+            }
+        }
+    }
+
+    /* S = g.dot(D).dot(g.T) + Ur.dot(Dr).dot(Ur.T) */
+    for (i = 0; i < NZ; i++)
+    {
+        for (j = 0; j < NZ; j++)
+        {
+            s[i][j] = 0.0;
+            for (k = 0; k < NX; k++)
+            {
+                s[i][j] += g[i][k] * kf->Dp[k] * g[j][k];
+            }
+        }
+    }
+    s[0][0] += kf->Dr[0] + kf->Ur[0] * kf->Ur[0] * kf->Dr[1];
+    s[0][1] += kf->Ur[0] * kf->Dr[1];
+    s[1][0] += kf->Ur[0] * kf->Dr[1];
+    s[1][1] += kf->Dr[1];
+
+    det = s[0][0] * s[1][1] - s[0][1] * s[1][0];
+
+    for (k = 0; k < NCAND; k++)
+    {
+        yaflFloat y0 = cand[NZ * k]     - hx[0];
+        yaflFloat y1 = cand[NZ * k + 1] - hx[1];
+        yaflFloat md = (s[1][1] * y0 * y0 - 2.0 * s[0][1] * y0 * y1 + \
+                        s[0][0] * y1 * y1) / det;
+
+        diff = fmax(diff, fabs(d2[k] - md) / md);
+    }
+    return diff;
+}
+
+/*---------------------------------------------------------------------------*/
+/*Snapshot of x, y, Up, Dp*/
+typedef struct {
+    yaflFloat x[NX];
+    yaflFloat y[NZ];
+    yaflFloat Up[NU];
+    yaflFloat Dp[NX];
+} snapSt;
+
+static void snap(snapSt * sn, yaflKalmanBaseSt * kf)
+{
+    memcpy(sn->x,  kf->x,  sizeof(sn->x));
+    memcpy(sn->y,  kf->y,  sizeof(sn->y));
+    memcpy(sn->Up, kf->Up, sizeof(sn->Up));
+    memcpy(sn->Dp, kf->Dp, sizeof(sn->Dp));
+}
+
+static int same(snapSt * sn, yaflKalmanBaseSt * kf)
+{
+    return !memcmp(sn->x,  kf->x,  sizeof(sn->x))  && \
+           !memcmp(sn->y,  kf->y,  sizeof(sn->y))  && \
+           !memcmp(sn->Up, kf->Up, sizeof(sn->Up)) && \
+           !memcmp(sn->Dp, kf->Dp, sizeof(sn->Dp));
+}
+
+/*---------------------------------------------------------------------------*/
+static yaflFloat check_ekf(yaflInt * changed, yaflStatusEn * status)
+{
+    yaflFloat diff = 0.0;
+    double t_gate = 0.0;
+    double t_copy = 0.0;
+    yaflInt s;
+
+    init_kalman(&ekf.base);
+    *status |= yafl_kalman_set_stats(&ekf_tmp.base, &stats);
+
+    for (s = 0; s < STEPS; s++)
+    {
+        struct timespec t0;
+        struct timespec t1;
+        yaflFloat p[2];
+        yaflFloat z[NZ];
+        snapSt sn;
+        yaflInt k;
+
+        true_pos(s, p);
+        z[0] = sqrt(p[0] * p[0] + p[1] * p[1]) + 0.05 * sin(0.7 * s);
+        z[1] = atan2(p[1], p[0]) + 0.01 * cos(0.9 * s);
+        set_cand(z, 1.0);
+
+        *status |= yafl_ekf_base_predict(&ekf.base);
+        snap(&sn, &ekf.base);
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        *status |= yafl_ekf_base_gate(&ekf.base, cand, NCAND, d2);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        t_gate += yafl_test_ms(&t0, &t1);
+
+        *changed += !same(&sn, &ekf.base);
+        diff = fmax(diff, dense_diff(&ekf.base));
+
+        /*The old way: update a copy of the filter for every candidate*/
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (k = 0; k < NCAND; k++)
+        {
+            ekf_tmp_mem = ekf_mem;
+            *status |= yafl_ekf_bierman_update(&ekf_tmp, cand + NZ * k);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        t_copy += yafl_test_ms(&t0, &t1);
+
+        *status |= yafl_ekf_bierman_update(&ekf, z);
+    }
+
+    printf("EKF: %d candidates, gate: %6.2f ms, update copies: %6.2f ms, max rel. diff: %.3e\n", \
+           NCAND, t_gate, t_copy, diff);
+    return diff;
+}
+
+static yaflFloat check_ukf(yaflInt * changed, yaflStatusEn * status)
+{
+    yaflFloat diff = 0.0;
+    yaflInt s;
+
+    init_kalman(&ukf.base.base);
+    yafl_ukf_post_init(&ukf.base);
+    *status |= yafl_kalman_set_stats(&ukf.base.base, &stats);
+
+    for (s = 0; s < STEPS; s++)
+    {
+        yaflFloat z[NZ];
+        snapSt sn;
+
+        true_pos(s, z);
+        z[0] += 0.05 * sin(0.7 * s);
+        z[1] += 0.05 * cos(0.9 * s);
+        set_cand(z, 1.0);
+
+        *status |= yafl_ukf_base_predict(&ukf.base);
+        snap(&sn, &ukf.base.base);
+
+        *status |= yafl_ukf_base_gate(&ukf.base, cand, NCAND, d2);
+        *changed += !same(&sn, &ukf.base.base);
+
+        /*The full UKF NIS is exact*/
+        *status |= yafl_ukf_update(&ukf.base, z);
+        diff = fmax(diff, fabs(d2[0] - stats.nis) / stats.nis);
+    }
+
+    printf("UKF: max rel. diff from NIS: %.3e\n", diff);
+    return diff;
+}
+
+/*
+Gating with 1..4 deferred predicts against gating of a flushed copy,
+Up, Dp, Nd, Phi and Fd must not change
+*/
+static yaflFloat check_deferred(int exact, yaflInt * changed, \
+                                yaflStatusEn * status)
+{
+    static ekfDefMemSt sn;
+    yaflFloat d2_ref[NCAND];
+    yaflFloat diff = 0.0;
+    yaflInt s;
+
+    memset(&ekf_def_mem, 0, sizeof(ekf_def_mem));
+    init_kalman(&ekf_def.base);
+    *status |= yafl_ekf_set_deferred(&ekf_def, ekf_def_mem.Phi);
+    *status |= yafl_ekf_set_deferred(&ekf_def_tmp, ekf_def_tmp_mem.Phi);
+    if (exact)
+    {
+        *status |= yafl_ekf_set_deferred_exact(&ekf_def, ekf_def_mem.Fd, \
+                                               ekf_def_mem.Uqd,          \
+                                               ekf_def_mem.Dqd,          \
+                                               ekf_def_mem.Uqs,          \
+                                               ekf_def_mem.Dqs);
+        *status |= yafl_ekf_set_deferred_exact(&ekf_def_tmp,             \
+                                               ekf_def_tmp_mem.Fd,       \
+                                               ekf_def_tmp_mem.Uqd,      \
+                                               ekf_def_tmp_mem.Dqd,      \
+                                               ekf_def_tmp_mem.Uqs,      \
+                                               ekf_def_tmp_mem.Dqs);
+    }
+
+    for (s = 0; s < STEPS; s++)
+    {
+        yaflFloat p[2];
+        yaflFloat z[NZ];
+        yaflInt nd;
+        yaflInt k;
+
+        true_pos(s, p);
+        z[0] = sqrt(p[0] * p[0] + p[1] * p[1]) + 0.05 * sin(0.7 * s);
+        z[1] = atan2(p[1], p[0]) + 0.01 * cos(0.9 * s);
+        set_cand(z, 1.0);
+
+        for (nd = 0; nd <= s % 4; nd++)
+        {
+            *status |= yafl_ekf_base_predict_x(&ekf_def.base);
+        }
+
+        sn = ekf_def_mem;
+        nd = ekf_def.Nd;
+        *status |= yafl_ekf_base_gate(&ekf_def.base, cand, NCAND, d2);
+        *changed += (nd != ekf_def.Nd)                                      || \
+                    memcmp(sn.x,   ekf_def_mem.x,   sizeof(sn.x))           || \
+                    memcmp(sn.Up,  ekf_def_mem.Up,  sizeof(sn.Up))          || \
+                    memcmp(sn.Dp,  ekf_def_mem.Dp,  sizeof(sn.Dp))          || \
+                    memcmp(sn.Phi, ekf_def_mem.Phi, sizeof(sn.Phi))         || \
+                    memcmp(sn.Fd,  ekf_def_mem.Fd,  sizeof(sn.Fd));
+
+        /*Reference: flush a copy, then gate it*/
+        ekf_def_tmp_mem = sn;
+        ekf_def_tmp.Nd  = nd;
+        *status |= yafl_ekf_base_flush(&ekf_def_tmp.base);
+        *status |= yafl_ekf_base_gate(&ekf_def_tmp.base, cand, NCAND, d2_ref);
+
+        for (k = 0; k < NCAND; k++)
+        {
+            diff = fmax(diff, fabs(d2[k] - d2_ref[k]) / d2_ref[k]);
+        }
+
+        *status |= yafl_ekf_bierman_update(&ekf_def, z);
+    }
+
+    printf("EKF, %s deferred fold: max rel. diff from flushed gate: %.3e\n", \
+           exact ? "exact" : "default", diff);
+    return diff;
+}
+
+int main(void)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt changed = 0;
+    yaflFloat diff;
+    int fails;
+
+    diff = check_ekf(&changed, &status);
+    diff = fmax(diff, check_ukf(&changed, &status));
+    diff = fmax(diff, check_deferred(0, &changed, &status));
+    diff = fmax(diff, check_deferred(1, &changed, &status));
+
+    printf("State changed by gating: %d times, status: 0x%x\n", changed, status);
+
+    fails = (diff > 1.0e-9) || changed || (status >= YAFL_ST_ERR_THR);
+    return yafl_test_report(fails);
+}
@@ -0,0 +1,349 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+IMM check: a 2D target flies straight, turns and flies straight again,
+position is measured. The bank has a low noise constant velocity EKF,
+a high noise constant velocity EKF and a coordinated turn UKF,
+the EKFs use the IMM memory as their workspace.
+
+Checks:
+- EKF log likelihoods which are used by yafl_imm_update and the one of
+  yafl_imm_ekf_loglik against a dense S = H.dot(P).dot(H.T) + R computation,
+- the combined covariance against a dense mixture computation,
+- the mode probabilities follow the maneuver.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy imm_check.c ../../src/yafl.c ../../src/yafl_math.c ../../src/yafl_imm.c -lm -o imm_check
+./imm_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl_imm.h>
+
+#define NX 4 /*px, vx, py, vy*/
+#define NZ 2
+#define NM 3
+#define NU ((NX * (NX - 1)) / 2)
+
+#define DT    0.1
+#define OMEGA 0.3
+#define SIGMA 0.1
+
+#define STEPS 300
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+/*Coordinated turn with known turn rate*/
+static void ct(yaflFloat * x, yaflFloat omega)
+{
+    yaflFloat s  = sin(omega * DT);
+    yaflFloat c  = cos(omega * DT);
+    yaflFloat vx = x[1];
+    yaflFloat vy = x[3];
+
+    x[0] += (s * vx - (1.0 - c) * vy) / omega;
+    x[2] += ((1.0 - c) * vx + s * vy) / omega;
+    x[1]  = c * vx - s * vy;
+    x[3]  = s * vx + c * vy;
+}
+
+static yaflStatusEn fct(yaflKalmanBaseSt * self, yaflFloat * x, yaflFloat * xz)
+{
+    (void)self;
+    (void)xz;
+
+    ct(x, OMEGA);
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_EKF_STATE_MEMORY_MIXIN(NX, NZ);
+} ekfMemSt;
+
+typedef struct {
+    YAFL_UKF_MEMORY_MIXIN(NX, NZ);
+    YAFL_UKF_MERWE_MEMORY_MIXIN(NX, NZ);
+} ukfMemSt;
+
+typedef struct {
+    YAFL_IMM_MEMORY_MIXIN(NM, NX, NZ);
+} immMemSt;
+
+static immMemSt       imm_mem;
+
+static ekfMemSt       ekf_mem[2];
+static yaflEKFBaseSt  ekf[2] = {
+    YAFL_EKF_BASE_WS_INITIALIZER(yafl_test_cv_fx, yafl_test_cv_jfx, \
+                                 yafl_test_cv_hx, yafl_test_cv_jhx, \
+                                 0, NX, NZ, ekf_mem[0], imm_mem),
+    YAFL_EKF_BASE_WS_INITIALIZER(yafl_test_cv_fx, yafl_test_cv_jfx, \
+                                 yafl_test_cv_hx, yafl_test_cv_jhx, \
+                                 0, NX, NZ, ekf_mem[1], imm_mem)
+};
+
+static ukfMemSt       ukf_mem;
+static yaflUKFMerweSt ukf_sp = YAFL_UKF_MERWE_INITIALIZER(NX, 0, 0.1, 2.0, \
+                                                          0.0, ukf_mem);
+static yaflUKFSt      ukf = YAFL_UKF_INITIALIZER(&ukf_sp.base,          \
+                                                 &yafl_ukf_merwe_spm,   \
+                                                 fct, 0, 0,             \
+                                                 yafl_test_cv_hx, 0, 0, \
+                                                 NX, NZ, ukf_mem);
+
+static yaflIMMModelSt model[NM] = {
+    {&ekf[0].base,     yafl_ekf_base_predict,                   \
+     yafl_imm_ekf_bierman_update},
+    {&ekf[1].base,     yafl_ekf_base_predict,                   \
+     yafl_imm_ekf_bierman_update},
+    {&ukf.base.base,   (yaflIMMPredictP)yafl_ukf_base_predict,  \
+     yafl_imm_ukf_update}
+};
+
+static yaflFloat pi[NM * NM] = {
+    0.95,  0.025, 0.025,
+    0.025, 0.95,  0.025,
+    0.025, 0.025, 0.95
+};
+
+static yaflIMMSt imm = YAFL_IMM_INITIALIZER(model, pi, NM, NX, NZ, imm_mem);
+
+/*---------------------------------------------------------------------------*/
+static void init_kalman(yaflKalmanBaseSt * kf, yaflFloat q)
+{
+    yaflInt i;
+
+    for (i = 0; i < NX; i++)
+    {
+        kf->x[i]  = 0.0;
+        kf->Dp[i] = 1.0;
+    }
+    kf->x[1] = 1.0;
+
+    memset(kf->Up, 0, sizeof(yaflFloat) * NU);
+    memset(kf->Uq, 0, sizeof(yaflFloat) * NU);
+
+    kf->Dq[0] = 0.25 * DT * DT * q;
+    kf->Dq[1] = q;
+    kf->Dq[2] = 0.25 * DT * DT * q;
+    kf->Dq[3] = q;
+
+    kf->Dr[0] = SIGMA * SIGMA;
+    kf->Dr[1] = SIGMA * SIGMA;
+    kf->Ur[0] = 0.0;
+}
+
+/*Dense P = U.dot(D).dot(U.T)*/
+static void dense_p(yaflFloat p[NX][NX], yaflFloat * u, yaflFloat * d)
+{
+    yaflFloat a[NX][NX];
+    yaflInt i;
+    yaflInt j;
+    yaflInt k;
+
+    for (i = 0; i < NX; i++)
+    {
+        for (j = 0; j < NX; j++)
+        {
+            a[i][j] = (i == j) ? 1.0 : ((j > i) ? u[i + ((j - 1) * j) / 2] : 0.0);
+        }
+    }
+
+    for (i = 0; i < NX; i++)
+    {
+        for (j = 0; j < NX; j++)
+        {
+            p[i][j] = 0.0;
+            for (k = 0; k < NX; k++)
+            {
+                p[i][j] += a[i][k] * d[k] * a[j][k];
+            }
+        }
+    }
+}
+
+/*Dense log likelihood of z for a position sensor*/
+static yaflFloat dense_ll(yaflKalmanBaseSt * kf, yaflFloat * z)
+{
+    yaflFloat p[NX][NX];
+    yaflFloat s00;
+    yaflFloat s01;
+    yaflFloat s11;
+    yaflFloat det;
+    yaflFloat y0;
+    yaflFloat y1;
+
+    dense_p(p, kf->Up, kf->Dp);
+    s00 = p[0][0] + kf->Dr[0];
+    s01 = p[0][2];
+    s11 = p[2][2] + kf->Dr[1];
+    det = s00 * s11 - s01 * s01;
+    y0  = z[0] - kf->x[0];
+    y1  = z[1] - kf->x[2];
+
+    return -0.5 * (2.0 * log(2.0 * M_PI) + log(det) + \
+                   (s11 * y0 * y0 - 2.0 * s01 * y0 * y1 + s00 * y1 * y1) / det);
+}
+
+/*Max relative difference of the combined P and the dense mixture*/
+static yaflFloat mix_diff(void)
+{
+    yaflFloat pm[NX][NX];
+    yaflFloat p[NX][NX];
+    yaflFloat x[NX];
+    yaflFloat diff = 0.0;
+    yaflInt i;
+    yaflInt j;
+    yaflInt k;
+
+    memset(pm, 0, sizeof(pm));
+    memset(x,  0, sizeof(x));
+    for (k = 0; k < NM; k++)
+    {
+        for (i = 0; i < NX; i++)
+        {
+            x[i] += imm.mu[k] * model[k].self->x[i];
+        }
+    }
+
+    for (k = 0; k < NM; k++)
+    {
+        yaflKalmanBaseSt * kf = model[k].self;
+
+        dense_p(p, kf->Up, kf->Dp);
+        for (i = 0; i < NX; i++)
+        {
+            for (j = 0; j < NX; j++)
+            {
+                pm[i][j] += imm.mu[k] * (p[i][j] + (kf->x[i] - x[i]) * \
+                                         (kf->x[j] - x[j]));
+            }
+        }
+    }
+
+    dense_p(p, imm.Up, imm.Dp);
+    for (i = 0; i < NX; i++)
+    {
+        diff = fmax(diff, fabs(x[i] - imm.x[i]));
+        for (j = 0; j < NX; j++)
+        {
+            diff = fmax(diff, fabs(p[i][j] - pm[i][j]) / \
+                              sqrt(pm[i][i] * pm[j][j]));
+        }
+    }
+    return diff;
+}
+
+/*Uniform noise with SIGMA standard deviation*/
+static yaflFloat noise(void)
+{
+    return SIGMA * sqrt(12.0) * ((yaflFloat)rand() / RAND_MAX - 0.5);
+}
+
+int main(void)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat truth[NX] = {0.0, 1.0, 0.0, 0.0};
+    yaflFloat mu_turn = 0.0;
+    yaflFloat mu_line = 0.0;
+    yaflFloat ll_diff = 0.0;
+    yaflFloat p_diff  = 0.0;
+    double t = 0.0;
+    yaflInt s;
+    int fails;
+
+    srand(1);
+
+    init_kalman(&ekf[0].base,    1.0e-4);
+    init_kalman(&ekf[1].base,    1.0e-1);
+    init_kalman(&ukf.base.base,  1.0e-3);
+    status |= yafl_ukf_post_init(&ukf.base);
+
+    imm_mem.mu[0] = 1.0 / 3.0;
+    imm_mem.mu[1] = 1.0 / 3.0;
+    imm_mem.mu[2] = 1.0 / 3.0;
+
+    for (s = 0; s < STEPS; s++)
+    {
+        struct timespec t0;
+        struct timespec t1;
+        yaflFloat z[NZ];
+        yaflFloat ll_ref[2];
+
+        /*Turn in the middle*/
+        if ((s >= STEPS / 3) && (s < 2 * STEPS / 3))
+        {
+            ct(truth, OMEGA);
+        }
+        else
+        {
+            truth[0] += DT * truth[1];
+            truth[2] += DT * truth[3];
+        }
+        z[0] = truth[0] + noise();
+        z[1] = truth[2] + noise();
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        status |= yafl_imm_predict(&imm);
+
+        /*Must be computed before the update*/
+        ll_ref[0] = dense_ll(model[0].self, z);
+        ll_ref[1] = dense_ll(model[1].self, z);
+
+        if (0 == s % 10)
+        {
+            yaflFloat ll = 0.0;
+            status |= yafl_imm_ekf_loglik(model[1].self, z, &ll);
+            ll_diff = fmax(ll_diff, fabs(ll - ll_ref[1]));
+        }
+
+        status |= yafl_imm_update(&imm, z);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        t += yafl_test_ms(&t0, &t1);
+
+        /*The EKF likelihoods which are used by the update*/
+        ll_diff = fmax(ll_diff, fabs(imm.ll[0] - ll_ref[0]));
+        ll_diff = fmax(ll_diff, fabs(imm.ll[1] - ll_ref[1]));
+
+        p_diff = fmax(p_diff, mix_diff());
+
+        if ((s >= STEPS / 2) && (s < 2 * STEPS / 3))
+        {
+            mu_turn += imm.mu[0] / (2 * STEPS / 3 - STEPS / 2);
+        }
+        if (s >= 5 * STEPS / 6)
+        {
+            mu_line += imm.mu[0] / (STEPS - 5 * STEPS / 6);
+        }
+    }
+
+    printf("IMM step: %.2f us, status: 0x%x\n", t * 1.0e3 / STEPS, status);
+    printf("Log likelihood max diff: %.3e, combined P max rel. diff: %.3e\n", \
+           ll_diff, p_diff);
+    printf("Mean low noise CV probability: turn: %.3f, straight line: %.3f\n", \
+           mu_turn, mu_line);
+    printf("Position error: %.3f %.3f\n", imm.x[0] - truth[0], imm.x[2] - truth[2]);
+
+    fails = (status >= YAFL_ST_ERR_THR) || (ll_diff > 1.0e-9) || \
+            (p_diff > 1.0e-9) || (mu_turn > 0.5) || (mu_line < 0.5);
+    return yafl_test_report(fails);
+}
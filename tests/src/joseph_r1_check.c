@@ -0,0 +1,319 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Rank one Joseph update check and benchmark: 15 state constant acceleration
+model (3 axes x (p, v, a) + 6 biases), position only sensor.
+EKFs with MWGSU based and rank one Joseph updates are compared,
+updates are timed. yafl_math_udu_joseph is also checked against dense
+Joseph form with a perturbed (not optimal) gain.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy joseph_r1_check.c ../../src/yafl.c ../../src/yafl_math.c -lm -o joseph_r1_check
+./joseph_r1_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl.h>
+
+#define NX 15
+#define NZ 3
+#define NU ((NX * (NX - 1)) / 2)
+
+#define DT 0.01
+
+#define STEPS 20000
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+/*Axis k position, velocity and acceleration are x[3k], x[3k + 1], x[3k + 2]*/
+/*Slightly nonlinear position sensor with a bias on the last axis*/
+static yaflStatusEn hx(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+
+    y[0] = x[0] + 0.01 * x[0] * x[0];
+    y[1] = x[3];
+    y[2] = x[6] + x[14];
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn jhx(yaflKalmanBaseSt * self, yaflFloat * h, yaflFloat * x)
+{
+    (void)self;
+
+    memset(h, 0, sizeof(yaflFloat) * NZ * NX);
+    h[0]           = 1.0 + 0.02 * x[0];
+    h[NX + 3]      = 1.0;
+    h[2 * NX + 6]  = 1.0;
+    h[2 * NX + 14] = 1.0;
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_EKF_BASE_MEMORY_MIXIN(NX, NZ);
+} ekfMemSt;
+
+static ekfMemSt      ekf_mem[2];
+static yaflEKFBaseSt ekf[2];
+
+static void init(yaflInt k, yaflInt corr)
+{
+    yaflEKFBaseSt tmp = YAFL_EKF_BASE_INITIALIZER(yafl_test_ca_fx,  \
+                                                  yafl_test_ca_jfx, \
+                                                  hx, jhx, 0, NX, NZ, \
+                                                  ekf_mem[k]);
+    yaflInt i;
+
+    ekf[k] = tmp;
+
+    for (i = 0; i < NX; i++)
+    {
+        ekf_mem[k].x[i]  = 0.0;
+        ekf_mem[k].Dp[i] = 1.0;
+        ekf_mem[k].Dq[i] = 1.0e-6;
+    }
+
+    for (i = 0; i < NU; i++)
+    {
+        ekf_mem[k].Up[i] = 0.0;
+        ekf_mem[k].Uq[i] = 0.0;
+    }
+
+    for (i = 0; i < NZ; i++)
+    {
+        ekf_mem[k].Dr[i] = 1.0e-2;
+    }
+
+    /*Correlated sensor noise: Ur[0, 1], Ur[0, 2], Ur[1, 2]*/
+    ekf_mem[k].Ur[0] = corr ? 0.2  : 0.0;
+    ekf_mem[k].Ur[1] = corr ? -0.1 : 0.0;
+    ekf_mem[k].Ur[2] = corr ? 0.3  : 0.0;
+}
+
+/*Returns update time only*/
+static double run(yaflInt k, yaflKalmanScalarUpdateP scalar, yaflStatusEn * status)
+{
+    double t = 0.0;
+    yaflInt s;
+
+    for (s = 0; s < STEPS; s++)
+    {
+        struct timespec t0;
+        struct timespec t1;
+        yaflFloat z[NZ];
+
+        z[0] = sin(0.001 * s);
+        z[1] = cos(0.002 * s);
+        z[2] = 0.001 * s;
+
+        *status |= yafl_ekf_base_predict(&ekf[k].base);
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        *status |= yafl_ekf_base_update(&ekf[k].base, z, scalar);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        t += yafl_test_ms(&t0, &t1);
+    }
+    return t;
+}
+
+/*Compares P = Up.dot(Dp).dot(Up.T), as UDU' factors are unique this is enough*/
+static yaflFloat max_diff(void)
+{
+    yaflFloat diff = 0.0;
+    yaflInt i;
+
+    for (i = 0; i < NX; i++)
+    {
+        diff = fmax(diff, fabs(ekf_mem[0].x[i] - ekf_mem[1].x[i]));
+        diff = fmax(diff, fabs(ekf_mem[0].Dp[i] - ekf_mem[1].Dp[i]) / ekf_mem[0].Dp[i]);
+    }
+    for (i = 0; i < NU; i++)
+    {
+        diff = fmax(diff, fabs(ekf_mem[0].Up[i] - ekf_mem[1].Up[i]));
+    }
+    return diff;
+}
+
+static int check(yaflInt corr)
+{
+    yaflStatusEn st_j = YAFL_ST_OK;
+    yaflStatusEn st_r = YAFL_ST_OK;
+    double t_j;
+    double t_r;
+    yaflFloat diff;
+
+    init(0, corr);
+    init(1, corr);
+
+    t_j = run(0, yafl_ekf_joseph_update_scalar,    &st_j);
+    t_r = run(1, yafl_ekf_joseph_r1_update_scalar, &st_r);
+    diff = max_diff();
+
+    printf("%s R: update Joseph: %6.1f ms, rank one Joseph: %6.1f ms, status: 0x%x/0x%x, max diff: %.3e\n", \
+           corr ? "corr." : "diag.", t_j, t_r, st_j, st_r, diff);
+
+    return (diff > 1.0e-9) || (st_j >= YAFL_ST_ERR_THR) || (st_r >= YAFL_ST_ERR_THR);
+}
+
+/*---------------------------------------------------------------------------*/
+/*Unit upper triangular packed U element (i, j)*/
+static yaflFloat u_at(yaflFloat * u, yaflInt i, yaflInt j)
+{
+    if (i == j)
+    {
+        return 1.0;
+    }
+    return (i < j) ? u[i + ((j - 1) * j) / 2] : 0.0;
+}
+
+static void udu_to_p(yaflFloat * p, yaflFloat * u, yaflFloat * d)
+{
+    yaflInt i;
+
+    for (i = 0; i < NX; i++)
+    {
+        yaflInt j;
+
+        for (j = 0; j < NX; j++)
+        {
+            yaflInt k;
+
+            p[NX * i + j] = 0.0;
+            for (k = 0; k < NX; k++)
+            {
+                p[NX * i + j] += u_at(u, i, k) * d[k] * u_at(u, j, k);
+            }
+        }
+    }
+}
+
+static int check_gain(void)
+{
+    yaflStatusEn status;
+    yaflFloat u[NU];
+    yaflFloat d[NX];
+    yaflFloat h[NX];
+    yaflFloat g[NX];
+    yaflFloat k[NX];
+    yaflFloat p[NX * NX];
+    yaflFloat a[NX * NX];
+    yaflFloat pj[NX * NX];
+    yaflFloat c = 0.0;
+    yaflFloat r = 0.05;
+    yaflFloat s;
+    yaflFloat diff = 0.0;
+    yaflFloat gerr = 0.0;
+    yaflInt i;
+
+    for (i = 0; i < NU; i++)
+    {
+        u[i] = 0.3 * sin(1.7 * i + 0.4);
+    }
+    for (i = 0; i < NX; i++)
+    {
+        d[i] = 1.0 + 0.5 * cos(0.9 * i);
+        h[i] = sin(0.7 * i + 1.1);
+    }
+    udu_to_p(p, u, d);
+
+    for (i = 0; i < NX; i++)
+    {
+        yaflInt j;
+
+        g[i] = 0.0;
+        for (j = 0; j < NX; j++)
+        {
+            g[i] += p[NX * i + j] * h[j];
+        }
+        c += h[i] * g[i];
+    }
+    s = c + r;
+
+    /*Perturbed gain*/
+    for (i = 0; i < NX; i++)
+    {
+        k[i] = 1.2 * g[i] / s + 0.05 * cos(2.3 * i);
+    }
+
+    /*a = I - outer(k, h), pj = a.dot(p).dot(a.T) + r * outer(k, k)*/
+    for (i = 0; i < NX; i++)
+    {
+        yaflInt j;
+
+        for (j = 0; j < NX; j++)
+        {
+            a[NX * i + j] = ((i == j) ? 1.0 : 0.0) - k[i] * h[j];
+        }
+    }
+    for (i = 0; i < NX; i++)
+    {
+        yaflInt j;
+
+        for (j = 0; j < NX; j++)
+        {
+            yaflInt l;
+            yaflInt m;
+
+            pj[NX * i + j] = r * k[i] * k[j];
+            for (l = 0; l < NX; l++)
+            {
+                for (m = 0; m < NX; m++)
+                {
+                    pj[NX * i + j] += a[NX * i + l] * p[NX * l + m] * a[NX * j + m];
+                }
+            }
+        }
+    }
+
+    /*The gain error term: p - outer(g, g) / s differs from pj*/
+    for (i = 0; i < NX * NX; i++)
+    {
+        gerr = fmax(gerr, fabs(p[i] - g[i / NX] * g[i % NX] / s - pj[i]));
+    }
+
+    status = yafl_math_udu_joseph(NX, u, d, g, k, c, r);
+    udu_to_p(p, u, d);
+
+    for (i = 0; i < NX * NX; i++)
+    {
+        diff = fmax(diff, fabs(p[i] - pj[i]));
+    }
+
+    printf("perturbed gain: status: 0x%x, max diff: %.3e (optimal gain form: %.3e)\n", \
+           status, diff, gerr);
+
+    return (diff > 1.0e-12) || (gerr < 1.0e-3) || (status >= YAFL_ST_ERR_THR);
+}
+
+int main(void)
+{
+    int fails = 0;
+
+    fails += check_gain();
+
+    fails += check(0);
+    fails += check(1);
+
+    return yafl_test_report(fails);
+}
@@ -0,0 +1,246 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Linear Kalman filter check and benchmark: 15 state constant acceleration
+model (3 axes x (p, v, a) + 6 biases) with correlated sensor noise. An LKF
+is compared with an EKF which has linear f, h and constant jf, jh, then H
+is changed in the middle of the run to check the decorrelated H cache.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy lkf_check.c ../../src/yafl.c ../../src/yafl_math.c -lm -o lkf_check
+./lkf_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl.h>
+
+#define NX 15
+#define NZ 3
+#define NU ((NX * (NX - 1)) / 2)
+
+#define DT 0.01
+
+#define STEPS 20000
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+static yaflFloat F[NX * NX];
+static yaflFloat H[NZ * NX];
+
+static void set_f(yaflFloat * f)
+{
+    yaflInt i;
+    yaflInt k;
+
+    memset(f, 0, sizeof(yaflFloat) * NX * NX);
+    for (i = 0; i < NX; i++)
+    {
+        f[NX * i + i] = 1.0;
+    }
+
+    for (k = 0; k < 3; k++)
+    {
+        f[NX * (3 * k) + 3 * k + 1]     = DT;
+        f[NX * (3 * k) + 3 * k + 2]     = 0.5 * DT * DT;
+        f[NX * (3 * k + 1) + 3 * k + 2] = DT;
+    }
+}
+
+/*Position sensor with a bias on the last axis, g is the last axis gain*/
+static void set_h(yaflFloat * h, yaflFloat g)
+{
+    memset(h, 0, sizeof(yaflFloat) * NZ * NX);
+    h[0]           = 1.0;
+    h[NX + 3]      = 1.0;
+    h[2 * NX + 6]  = g;
+    h[2 * NX + 14] = 1.0;
+}
+
+/*EKF callbacks*/
+static yaflStatusEn fx(yaflKalmanBaseSt * self, yaflFloat * x, yaflFloat * xz)
+{
+    yaflFloat tmp[NX];
+
+    (void)self;
+    (void)xz;
+
+    yafl_math_set_mv(NX, NX, tmp, F, x);
+    memcpy(x, tmp, sizeof(tmp));
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn jfx(yaflKalmanBaseSt * self, yaflFloat * w, yaflFloat * x)
+{
+    yaflInt i;
+
+    (void)self;
+    (void)x;
+
+    for (i = 0; i < NX; i++)
+    {
+        memcpy(w + 2 * NX * i, F + NX * i, sizeof(yaflFloat) * NX);
+    }
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn hx(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+    return yafl_math_set_mv(NZ, NX, y, H, x);
+}
+
+static yaflStatusEn jhx(yaflKalmanBaseSt * self, yaflFloat * h, yaflFloat * x)
+{
+    (void)self;
+    (void)x;
+
+    memcpy(h, H, sizeof(H));
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_EKF_BASE_MEMORY_MIXIN(NX, NZ);
+} ekfMemSt;
+
+typedef struct {
+    YAFL_LKF_MEMORY_MIXIN(NX, NZ);
+} lkfMemSt;
+
+static ekfMemSt      ekf_mem;
+static yaflEKFBaseSt ekf;
+
+static lkfMemSt  lkf_mem;
+static yaflLKFSt lkf;
+
+/*Same initial values for both filters*/
+#define INIT_MEM(m)                                 \
+do {                                                \
+    yaflInt i;                                      \
+    for (i = 0; i < NX; i++)                        \
+    {                                               \
+        m.x[i]  = 0.0;                              \
+        m.Dp[i] = 1.0;                              \
+        m.Dq[i] = 1.0e-6;                           \
+    }                                               \
+    for (i = 0; i < NU; i++)                        \
+    {                                               \
+        m.Up[i] = 0.0;                              \
+        m.Uq[i] = 0.0;                              \
+    }                                               \
+    for (i = 0; i < NZ; i++)                        \
+    {                                               \
+        m.Dr[i] = 1.0e-2;                           \
+    }                                               \
+    m.Ur[0] = 0.2;                                  \
+    m.Ur[1] = -0.1;                                 \
+    m.Ur[2] = 0.3;                                  \
+} while (0)
+
+static void init(void)
+{
+    yaflEKFBaseSt tmp_e = YAFL_EKF_BASE_INITIALIZER(fx, jfx, hx, jhx, 0, \
+                                                    NX, NZ, ekf_mem);
+    yaflLKFSt tmp_l = YAFL_LKF_INITIALIZER(0, NX, NZ, lkf_mem);
+
+    ekf = tmp_e;
+    lkf = tmp_l;
+
+    INIT_MEM(ekf_mem);
+    INIT_MEM(lkf_mem);
+
+    set_f(F);
+    set_h(H, 1.0);
+
+    set_f(lkf_mem.F);
+    set_h(lkf_mem.Hm, 1.0);
+}
+
+static yaflStatusEn run(yaflInt k, yaflInt s0, yaflInt s1, double * t)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    clock_t t0;
+    yaflInt s;
+
+    t0 = clock();
+    for (s = s0; s < s1; s++)
+    {
+        yaflFloat z[NZ];
+
+        z[0] = sin(0.001 * s);
+        z[1] = cos(0.002 * s);
+        z[2] = 0.001 * s;
+
+        if (k)
+        {
+            status |= yafl_lkf_predict(&lkf);
+            status |= yafl_lkf_bierman_update(&lkf, z);
+        }
+        else
+        {
+            status |= yafl_ekf_base_predict(&ekf.base);
+            status |= yafl_ekf_bierman_update(&ekf, z);
+        }
+    }
+    *t += (double)(clock() - t0) * 1.0e3 / CLOCKS_PER_SEC;
+    return status;
+}
+
+int main(void)
+{
+    yaflStatusEn st_e = YAFL_ST_OK;
+    yaflStatusEn st_l = YAFL_ST_OK;
+    double t_e = 0.0;
+    double t_l = 0.0;
+    yaflFloat diff = 0.0;
+    yaflInt i;
+    int fails;
+
+    init();
+
+    st_e |= run(0, 0, STEPS / 2, &t_e);
+    st_l |= run(1, 0, STEPS / 2, &t_l);
+
+    /*Model change*/
+    set_h(H, 0.5);
+    set_h(lkf_mem.Hm, 0.5);
+    yafl_lkf_touch(&lkf);
+
+    st_e |= run(0, STEPS / 2, STEPS, &t_e);
+    st_l |= run(1, STEPS / 2, STEPS, &t_l);
+
+    for (i = 0; i < NX; i++)
+    {
+        diff = fmax(diff, fabs(ekf_mem.x[i] - lkf_mem.x[i]));
+        diff = fmax(diff, fabs(ekf_mem.Dp[i] - lkf_mem.Dp[i]) / ekf_mem.Dp[i]);
+    }
+    for (i = 0; i < NU; i++)
+    {
+        diff = fmax(diff, fabs(ekf_mem.Up[i] - lkf_mem.Up[i]));
+    }
+
+    printf("EKF: %6.1f ms, LKF: %6.1f ms, status: 0x%x/0x%x, max diff: %.3e\n", \
+           t_e, t_l, st_e, st_l, diff);
+
+    fails = (diff > 1.0e-9) || (st_e >= YAFL_ST_ERR_THR) || (st_l >= YAFL_ST_ERR_THR);
+    return yafl_test_report(fails);
+}
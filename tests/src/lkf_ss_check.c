@@ -0,0 +1,206 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Steady state LKF check and benchmark: 9 state constant acceleration model
+(3 axes x (p, v, a)) with correlated position sensor noise. An LKF in steady state mode is compared with
+a plain LKF, then R is changed and an outlier is injected to check fallbacks
+to full updates.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy lkf_ss_check.c ../../src/yafl.c ../../src/yafl_math.c -lm -o lkf_ss_check
+./lkf_ss_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl.h>
+
+#define NX 9
+#define NZ 3
+#define NU ((NX * (NX - 1)) / 2)
+
+#define DT 0.01
+
+#define STEPS 20000
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+static void set_f(yaflFloat * f)
+{
+    yaflInt i;
+    yaflInt k;
+
+    memset(f, 0, sizeof(yaflFloat) * NX * NX);
+    for (i = 0; i < NX; i++)
+    {
+        f[NX * i + i] = 1.0;
+    }
+
+    for (k = 0; k < 3; k++)
+    {
+        f[NX * (3 * k) + 3 * k + 1]     = DT;
+        f[NX * (3 * k) + 3 * k + 2]     = 0.5 * DT * DT;
+        f[NX * (3 * k + 1) + 3 * k + 2] = DT;
+    }
+}
+
+static void set_h(yaflFloat * h)
+{
+    memset(h, 0, sizeof(yaflFloat) * NZ * NX);
+    h[0]           = 1.0;
+    h[NX + 3]      = 1.0;
+    h[2 * NX + 6]  = 1.0;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_LKF_MEMORY_MIXIN(NX, NZ);
+    YAFL_LKF_SS_MEMORY_MIXIN(NX, NZ);
+} lkfMemSt;
+
+static lkfMemSt  lkf_mem[2];
+static yaflLKFSt lkf[2];
+
+static void init(yaflInt k)
+{
+    yaflLKFSt tmp = YAFL_LKF_INITIALIZER(0, NX, NZ, lkf_mem[k]);
+    yaflInt i;
+
+    lkf[k] = tmp;
+    if (k)
+    {
+        yafl_lkf_set_ss(&lkf[k], 1.0e-9, lkf_mem[k].Kss, lkf_mem[k].Sss, \
+                        lkf_mem[k].Uph, lkf_mem[k].Dph);
+    }
+
+    for (i = 0; i < NX; i++)
+    {
+        lkf_mem[k].x[i]  = 0.0;
+        lkf_mem[k].Dp[i] = 1.0;
+        lkf_mem[k].Dq[i] = 1.0e-6;
+    }
+
+    for (i = 0; i < NU; i++)
+    {
+        lkf_mem[k].Up[i] = 0.0;
+        lkf_mem[k].Uq[i] = 0.0;
+    }
+
+    for (i = 0; i < NZ; i++)
+    {
+        lkf_mem[k].Dr[i] = 1.0e-2;
+    }
+    lkf_mem[k].Ur[0] = 0.2;
+    lkf_mem[k].Ur[1] = -0.1;
+    lkf_mem[k].Ur[2] = 0.3;
+
+    set_f(lkf_mem[k].F);
+    set_h(lkf_mem[k].Hm);
+}
+
+/*Returns the number of frozen gain steps*/
+static yaflInt run(yaflInt k, yaflInt s0, yaflInt s1, yaflFloat outlier, \
+                   yaflStatusEn * status, double * t)
+{
+    clock_t t0;
+    yaflInt frozen = 0;
+    yaflInt s;
+
+    t0 = clock();
+    for (s = s0; s < s1; s++)
+    {
+        yaflFloat z[NZ];
+
+        z[0] = sin(0.001 * s);
+        z[1] = cos(0.002 * s) + ((s == s0) ? outlier : 0.0);
+        z[2] = 0.001 * s;
+
+        *status |= yafl_lkf_predict(&lkf[k]);
+        frozen += (2 == lkf[k].ss);
+        *status |= yafl_lkf_bierman_update(&lkf[k], z);
+    }
+    *t += (double)(clock() - t0) * 1.0e3 / CLOCKS_PER_SEC;
+    return frozen;
+}
+
+static yaflFloat max_diff(void)
+{
+    yaflFloat diff = 0.0;
+    yaflInt i;
+
+    for (i = 0; i < NX; i++)
+    {
+        diff = fmax(diff, fabs(lkf_mem[0].x[i] - lkf_mem[1].x[i]));
+    }
+    return diff;
+}
+
+int main(void)
+{
+    yaflStatusEn st[2] = {YAFL_ST_OK, YAFL_ST_OK};
+    double t[2] = {0.0, 0.0};
+    yaflInt frozen;
+    yaflFloat diff;
+    int fails = 0;
+    yaflInt k;
+
+    init(0);
+    init(1);
+
+    /*Convergence*/
+    for (k = 0; k < 2; k++)
+    {
+        frozen = run(k, 0, STEPS, 0.0, st + k, t + k);
+    }
+    diff = max_diff();
+    printf("Full: %6.1f ms, steady state: %6.1f ms, frozen steps: %d, max x diff: %.3e\n", \
+           t[0], t[1], frozen, diff);
+    fails += (frozen < STEPS / 2) || (diff > 1.0e-6);
+
+    /*R change must unfreeze the gains*/
+    for (k = 0; k < 2; k++)
+    {
+        lkf_mem[k].Dr[1] = 4.0e-2;
+        yafl_lkf_touch(&lkf[k]);
+    }
+    for (k = 0; k < 2; k++)
+    {
+        frozen = run(k, STEPS, STEPS + 100, 0.0, st + k, t + k);
+    }
+    diff = max_diff();
+    printf("After R change: frozen steps: %d of 100, max x diff: %.3e\n", frozen, diff);
+    fails += (frozen > 90) || (diff > 1.0e-6);
+
+    /*Let it converge again, then check an outlier*/
+    for (k = 0; k < 2; k++)
+    {
+        run(k, STEPS + 100, 2 * STEPS, 0.0, st + k, t + k);
+    }
+    fails += (2 != lkf[1].ss);
+
+    st[1] = YAFL_ST_OK;
+    run(1, 2 * STEPS, 2 * STEPS + 1, 10.0, st + 1, t + 1);
+    printf("Outlier: status: 0x%x, steady state: %d\n", st[1], lkf[1].ss);
+    fails += !(st[1] & YAFL_ST_MSK_ANOMALY) || (2 == lkf[1].ss);
+
+    fails += (st[0] >= YAFL_ST_ERR_THR) || (st[1] >= YAFL_ST_ERR_THR);
+    return yafl_test_report(fails);
+}
@@ -0,0 +1,212 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Low memory EKF check: 9 state constant acceleration model tracks with
+persistent state only memory share one scratchpad workspace, in the second
+half of the run the workspaces are passed at call time and alternate
+between steps, as if the tracks were run by different threads.
+The results must be the same as the ones of the filters with the default
+memory layout.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy lowmem_check.c ../../src/yafl.c ../../src/yafl_math.c -lm -o lowmem_check
+./lowmem_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <yafl.h>
+
+#define NX 9
+#define NZ 3
+#define NU ((NX * (NX - 1)) / 2)
+
+#define DT 0.01
+
+#define NT 4
+#define STEPS 1000
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+/*Axis k position, velocity and acceleration are x[3k], x[3k + 1], x[3k + 2]*/
+static yaflStatusEn hx(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+
+    y[0] = x[0];
+    y[1] = x[3];
+    y[2] = x[6];
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn jhx(yaflKalmanBaseSt * self, yaflFloat * h, yaflFloat * x)
+{
+    (void)self;
+    (void)x;
+
+    memset(h, 0, sizeof(yaflFloat) * NZ * NX);
+    h[0]          = 1.0;
+    h[NX + 3]     = 1.0;
+    h[2 * NX + 6] = 1.0;
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_EKF_BASE_MEMORY_MIXIN(NX, NZ);
+} ekfMemSt;
+
+typedef struct {
+    YAFL_EKF_STATE_MEMORY_MIXIN(NX, NZ);
+} ekfStateMemSt;
+
+typedef struct {
+    YAFL_EKF_WORKSPACE_MEMORY_MIXIN(NX, NZ);
+} ekfWorkspaceMemSt;
+
+static ekfMemSt       ref_mem[NT];
+static yaflEKFBaseSt  ref[NT];
+
+static ekfStateMemSt  low_mem[NT];
+static ekfWorkspaceMemSt ws_mem[2];
+static yaflEKFWorkspaceSt ws[2] = {
+    YAFL_EKF_WORKSPACE_INITIALIZER(NX, NZ, ws_mem[0]),
+    YAFL_EKF_WORKSPACE_INITIALIZER(NX, NZ, ws_mem[1])
+};
+static yaflEKFBaseSt  low[NT];
+
+/*Same initial state for the same track*/
+#define INIT_MEM(_mem, _t)                                   \
+do {                                                         \
+    yaflInt _i;                                              \
+    for (_i = 0; _i < NX; _i++)                              \
+    {                                                        \
+        (_mem).x[_i]  = 0.1 * (_t);                          \
+        (_mem).Dp[_i] = 1.0;                                 \
+        (_mem).Dq[_i] = 1.0e-6;                              \
+    }                                                        \
+    memset((_mem).Up, 0, sizeof((_mem).Up));                 \
+    memset((_mem).Uq, 0, sizeof((_mem).Uq));                 \
+    memset((_mem).Ur, 0, sizeof((_mem).Ur));                 \
+    for (_i = 0; _i < NZ; _i++)                              \
+    {                                                        \
+        (_mem).Dr[_i] = 1.0e-2;                              \
+    }                                                        \
+} while (0)
+
+static void init(void)
+{
+    yaflInt t;
+
+    for (t = 0; t < NT; t++)
+    {
+        yaflEKFBaseSt tmp_ref = YAFL_EKF_BASE_INITIALIZER(yafl_test_ca_fx,  \
+                                                          yafl_test_ca_jfx, \
+                                                          hx, jhx, 0,       \
+                                                          NX, NZ, ref_mem[t]);
+        yaflEKFBaseSt tmp_low = YAFL_EKF_BASE_WS_INITIALIZER(yafl_test_ca_fx,  \
+                                                             yafl_test_ca_jfx, \
+                                                             hx, jhx,          \
+                                                             0, NX, NZ,        \
+                                                             low_mem[t], ws_mem[0]);
+        ref[t] = tmp_ref;
+        low[t] = tmp_low;
+
+        INIT_MEM(ref_mem[t], t);
+        INIT_MEM(low_mem[t], t);
+    }
+}
+
+static void measure(yaflFloat * z, yaflInt t, yaflInt s)
+{
+    z[0] = sin(0.001 * s + t);
+    z[1] = cos(0.002 * s + t);
+    z[2] = 0.001 * s * t;
+}
+
+/*Bound workspace*/
+static yaflStatusEn step(yaflEKFBaseSt * kf, yaflInt t, yaflInt s)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat z[NZ];
+
+    measure(z, t, s);
+    status |= yafl_ekf_base_predict(&kf->base);
+    status |= yafl_ekf_bierman_update(kf, z);
+    return status;
+}
+
+/*Workspace passed at call time*/
+static yaflStatusEn step_ws(yaflEKFBaseSt * kf, yaflEKFWorkspaceSt * w, \
+                            yaflInt t, yaflInt s)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat z[NZ];
+
+    measure(z, t, s);
+    status |= yafl_ekf_ws_predict(&kf->base, w);
+    status |= yafl_ekf_ws_update(&kf->base, w, z, \
+                                 yafl_ekf_bierman_update_scalar);
+    return status;
+}
+
+int main(void)
+{
+    yaflStatusEn st_r = YAFL_ST_OK;
+    yaflStatusEn st_l = YAFL_ST_OK;
+    yaflInt s;
+    yaflInt t;
+    int same = 1;
+    int fails;
+
+    init();
+
+    for (s = 0; s < STEPS; s++)
+    {
+        for (t = 0; t < NT; t++)
+        {
+            st_r |= step(&ref[t], t, s);
+            if (s < STEPS / 2)
+            {
+                st_l |= step(&low[t], t, s);
+            }
+            else
+            {
+                st_l |= step_ws(&low[t], ws + ((s + t) & 1), t, s);
+            }
+        }
+    }
+
+    for (t = 0; t < NT; t++)
+    {
+        same &= !memcmp(ref_mem[t].x,  low_mem[t].x,  sizeof(low_mem[t].x));
+        same &= !memcmp(ref_mem[t].Up, low_mem[t].Up, sizeof(low_mem[t].Up));
+        same &= !memcmp(ref_mem[t].Dp, low_mem[t].Dp, sizeof(low_mem[t].Dp));
+    }
+
+    printf("Per filter memory: default: %u bytes, low memory: %u bytes, workspace: %u bytes\n", \
+           (unsigned)sizeof(ekfMemSt), (unsigned)sizeof(ekfStateMemSt),                        \
+           (unsigned)sizeof(ekfWorkspaceMemSt));
+    printf("Results: %s, status: 0x%x/0x%x\n", same ? "same" : "DIFFERENT", st_r, st_l);
+
+    fails = !same || (st_r >= YAFL_ST_ERR_THR) || (st_l >= YAFL_ST_ERR_THR) || \
+            (2 * sizeof(ekfStateMemSt) >= sizeof(ekfMemSt));
+    return yafl_test_report(fails);
+}
@@ -0,0 +1,242 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+yafl_math_mwgsu benchmark against the previous per-element division version,
+the regularization path (YAFL_ST_MSK_REGULARIZED) of both versions is
+checked to give the same results.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy mwgsu_bench.c ../../src/yafl_math.c -lm -o mwgsu_bench
+./mwgsu_bench
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl_math.h>
+
+#define NX_MAX 64
+#define NC_MAX (2 * NX_MAX)
+
+#define REPS 9
+
+/*Previous implementation*/
+static yaflStatusEn mwgsu_ref(yaflInt nr, yaflInt nc, yaflFloat *res_u, yaflFloat *res_d, yaflFloat *w, yaflFloat *d)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt j;
+    yaflInt nrj;
+
+    for (j = nr - 1, nrj = ((j - 1) * j) / 2; j >= 0; nrj -= --j)
+    {
+        yaflInt   ncj;
+        yaflInt   k;
+        yaflFloat res_dj;
+        yaflFloat wjk;
+
+        ncj = nc * j;
+
+        wjk     = w[ncj + nc - 1];
+        wjk    *= wjk;
+        res_dj  = wjk * d[nc - 1];
+        for (k = nc - 2; k >= 0; k--)
+        {
+            wjk     = w[ncj + k];
+            wjk    *= wjk;
+            res_dj += wjk * d[k];
+        }
+
+        if (res_dj < YAFL_EPS)
+        {
+            res_d[j] = YAFL_EPS;
+
+            for (k = j - 1; k >= 0; k--)
+            {
+                res_u[k + nrj] = 0;
+            }
+
+            status |= YAFL_ST_MSK_REGULARIZED;
+            continue;
+        }
+
+        res_d[j] = res_dj;
+
+        for (k = j - 1; k >= 0; k--)
+        {
+            yaflInt   nck;
+            yaflInt   i;
+            yaflFloat res_ukj;
+
+            nck = nc * k;
+
+            res_ukj = w[nck] * d[0] * w[ncj] / res_dj;
+            for (i = 1; i < nc; i++)
+            {
+                res_ukj += w[nck + i] * d[i] * w[ncj + i] / res_dj;
+            }
+            res_u[k + nrj] = res_ukj;
+
+            w[nck + nc - 1] -= res_ukj * w[ncj + nc - 1];
+            for (i = nc - 2; i >= 0; i--)
+            {
+                w[nck + i] -= res_ukj * w[ncj + i];
+            }
+        }
+    }
+    return status;
+}
+
+typedef yaflStatusEn (* mwgsuP)(yaflInt, yaflInt, yaflFloat *, yaflFloat *, yaflFloat *, yaflFloat *);
+
+static yaflFloat w0[NX_MAX * NC_MAX];
+static yaflFloat w[NX_MAX * NC_MAX];
+static yaflFloat w1[NX_MAX * NC_MAX];
+static yaflFloat d[NC_MAX];
+static yaflFloat u[2][NX_MAX * NX_MAX / 2];
+static yaflFloat ud[2][NX_MAX];
+
+static double bench(mwgsuP f, yaflInt nr, yaflInt nc, yaflInt n, yaflFloat *res_u, yaflFloat *res_d)
+{
+    clock_t t;
+    yaflInt i;
+
+    t = clock();
+    for (i = 0; i < n; i++)
+    {
+        memcpy(w, w0, sizeof(yaflFloat) * nr * nc);
+        f(nr, nc, res_u, res_d, w, d);
+    }
+    return (double)(clock() - t) / CLOCKS_PER_SEC / n * 1.0e9;
+}
+
+/*Max relative res_d and absolute res_u differences of the two versions*/
+static yaflFloat max_diff(yaflInt nx)
+{
+    yaflFloat diff = 0.0;
+    yaflInt i;
+
+    for (i = 0; i < nx; i++)
+    {
+        yaflFloat e = (ud[1][i] - ud[0][i]) / ud[0][i];
+        e = (e < 0) ? -e : e;
+        diff = (e > diff) ? e : diff;
+    }
+
+    for (i = 0; i < (nx * (nx - 1)) / 2; i++)
+    {
+        yaflFloat e = u[1][i] - u[0][i];
+        e = (e < 0) ? -e : e;
+        diff = (e > diff) ? e : diff;
+    }
+    return diff;
+}
+
+/*
+Regularization check: row 0 is a copy of row 1 and row nx / 2 is zero,
+so two pivots are regularized, both versions must report
+YAFL_ST_MSK_REGULARIZED and give the same factors.
+*/
+static int check_regularized(yaflInt nx, yaflInt nc)
+{
+    yaflStatusEn st_old;
+    yaflStatusEn st_new;
+    yaflFloat diff;
+    yaflInt i;
+
+    memcpy(w, w0, sizeof(yaflFloat) * nx * nc);
+    memcpy(w, w + nc, sizeof(yaflFloat) * nc);
+    memset(w + nc * (nx / 2), 0, sizeof(yaflFloat) * nc);
+    memcpy(w1, w, sizeof(yaflFloat) * nx * nc);
+
+    st_old = mwgsu_ref(nx, nc, u[0], ud[0], w,  d);
+    st_new = yafl_math_mwgsu(nx, nc, u[1], ud[1], w1, d);
+
+    diff = max_diff(nx);
+    for (i = 0; i < nx; i++)
+    {
+        /*Regularized pivots must match exactly*/
+        if ((YAFL_EPS == ud[0][i]) != (YAFL_EPS == ud[1][i]))
+        {
+            diff = 1.0;
+        }
+    }
+
+    printf("%4d  %4d  regularized: status 0x%x/0x%x, max diff: %.3e\n", \
+           nx, nc, st_old, st_new, diff);
+
+    return (st_old != st_new) || !(st_new & YAFL_ST_MSK_REGULARIZED) || \
+           (diff > 1.0e-12);
+}
+
+int main(void)
+{
+    static const yaflInt sizes[] = {4, 6, 8, 12, 16, 32, 64};
+    yaflInt s;
+    yaflInt i;
+    int fails = 0;
+
+    for (i = 0; i < NX_MAX * NC_MAX; i++)
+    {
+        w0[i] = (yaflFloat)rand() / RAND_MAX - 0.5;
+    }
+
+    for (i = 0; i < NC_MAX; i++)
+    {
+        d[i] = (yaflFloat)rand() / RAND_MAX + 0.1;
+    }
+
+    printf("Min of %d runs\n", REPS);
+    printf("  nx    nc    old, ns    new, ns  speedup  max rel diff\n");
+    for (s = 0; s < (yaflInt)(sizeof(sizes) / sizeof(sizes[0])); s++)
+    {
+        yaflInt nx = sizes[s];
+        yaflInt k;
+
+        for (k = 0; k < 2; k++)
+        {
+            /*Predict (nx x 2nx) and Joseph update (nx x nx+1) shapes*/
+            yaflInt nc = k ? (nx + 1) : (2 * nx);
+            yaflInt n  = 20000000 / (nx * nx * nc) + 10;
+            double t_old = 1.0e300;
+            double t_new = 1.0e300;
+            yaflInt r;
+
+            for (r = 0; r < REPS; r++)
+            {
+                double t;
+
+                t = bench(mwgsu_ref,       nx, nc, n, u[0], ud[0]);
+                t_old = (t < t_old) ? t : t_old;
+                t = bench(yafl_math_mwgsu, nx, nc, n, u[1], ud[1]);
+                t_new = (t < t_new) ? t : t_new;
+            }
+
+            printf("%4d  %4d  %9.1f  %9.1f  %7.2f  %.3e\n", nx, nc, \
+                   t_old, t_new, t_old / t_new, max_diff(nx));
+        }
+    }
+
+    for (s = 0; s < (yaflInt)(sizeof(sizes) / sizeof(sizes[0])); s++)
+    {
+        fails += check_regularized(sizes[s], 2 * sizes[s]);
+        fails += check_regularized(sizes[s], sizes[s] + 1);
+    }
+
+    printf(fails ? "FAILED\n" : "PASSED\n");
+    return fails ? 1 : 0;
+}
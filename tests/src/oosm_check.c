@@ -0,0 +1,299 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Out of sequence measurement check and benchmark: 2D constant velocity
+model, position sensor, 10 ms step. A measurement is delivered l steps late
+and merged by yafl_oosm_ekf_update, the result is compared with a replay
+from the stored filter copy and with the filter which drops it.
+Axes are independent, so sequential replay updates are exact.
+The timings are the yafl_oosm.h cost table source. The last checks pass
+invalid times, the YAFL_CHECK messages they print are expected.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy oosm_check.c ../../src/yafl.c ../../src/yafl_math.c ../../src/yafl_oosm.c -lm -o oosm_check
+./oosm_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl_oosm.h>
+
+#define NX 4
+#define NZ 2
+#define NU ((NX * (NX - 1)) / 2)
+
+#define DT 0.01
+
+#define NS    32
+#define S0    200
+#define STEPS (S0 + NS)
+
+#define REPEAT 10000
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_EKF_BASE_MEMORY_MIXIN(NX, NZ);
+} ekfMemSt;
+
+typedef struct {
+    YAFL_OOSM_MEMORY_MIXIN(NS, NX, NZ);
+} oosmMemSt;
+
+static ekfMemSt      ekf_mem;
+static yaflEKFBaseSt ekf = YAFL_EKF_BASE_INITIALIZER(yafl_test_cv_fx,  \
+                                                     yafl_test_cv_jfx, \
+                                                     yafl_test_cv_hx,  \
+                                                     yafl_test_cv_jhx, 0, \
+                                                     NX, NZ, ekf_mem);
+
+static oosmMemSt  oosm_mem;
+static yaflOOSMSt oosm = YAFL_OOSM_INITIALIZER(NS, NX, NZ, oosm_mem);
+
+static yaflFloat z[STEPS][NZ];
+static yaflFloat z_late[NZ];
+
+static ekfMemSt filt[STEPS]; /*Filter copies for replays*/
+
+/*---------------------------------------------------------------------------*/
+static yaflFloat noise(void)
+{
+    yaflFloat u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    yaflFloat u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+    return sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2);
+}
+
+static void init(void)
+{
+    yaflInt i;
+
+    memset(&ekf_mem, 0, sizeof(ekf_mem));
+    for (i = 0; i < NX; i++)
+    {
+        ekf_mem.Dp[i] = 100.0;
+    }
+    ekf_mem.Dq[0] = 1.0e-6;
+    ekf_mem.Dq[1] = 1.0e-2;
+    ekf_mem.Dq[2] = 1.0e-6;
+    ekf_mem.Dq[3] = 1.0e-2;
+    ekf_mem.Dr[0] = 0.25;
+    ekf_mem.Dr[1] = 0.25;
+
+    oosm.head = 0;
+    oosm.cnt  = 0;
+}
+
+/*Measurements of a circular motion*/
+static void gen(void)
+{
+    yaflInt s;
+
+    srand(1);
+    for (s = 0; s < STEPS; s++)
+    {
+        yaflFloat t = s * DT;
+
+        z[s][0] = 10.0 * cos(0.5 * t) + 0.5 * noise();
+        z[s][1] = 10.0 * sin(0.5 * t) + 0.5 * noise();
+    }
+    z_late[0] = 10.0 * cos(0.5 * (S0 - 1) * DT) + 0.5 * noise();
+    z_late[1] = 10.0 * sin(0.5 * (S0 - 1) * DT) + 0.5 * noise();
+}
+
+static yaflStatusEn step(yaflInt s)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+
+    status |= yafl_ekf_base_predict(&ekf.base);
+    status |= yafl_ekf_bierman_update(&ekf, z[s]);
+    return status;
+}
+
+/*Replays steps from s0 + 1 to k with the late measurement taken at s0*/
+static yaflStatusEn replay(yaflInt s0, yaflInt k)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt s;
+
+    ekf_mem = filt[s0];
+    status |= yafl_ekf_bierman_update(&ekf, z_late);
+    for (s = s0 + 1; s <= k; s++)
+    {
+        status |= step(s);
+    }
+    return status;
+}
+
+/*P = U.dot(D).dot(U.T)*/
+static void full_p(yaflFloat * p, yaflFloat * u, yaflFloat * d)
+{
+    yaflInt i;
+    yaflInt j;
+
+    for (i = 0; i < NX; i++)
+    {
+        for (j = 0; j < NX; j++)
+        {
+            yaflFloat sum = 0.0;
+            yaflInt k;
+
+            for (k = (i > j) ? i : j; k < NX; k++)
+            {
+                yaflFloat uik = (k == i) ? 1.0 : u[i + ((k - 1) * k) / 2];
+                yaflFloat ujk = (k == j) ? 1.0 : u[j + ((k - 1) * k) / 2];
+
+                sum += uik * d[k] * ujk;
+            }
+            p[NX * i + j] = sum;
+        }
+    }
+}
+
+/*Max relative differences of x and P*/
+static void diff(ekfMemSt * a, ekfMemSt * b, yaflFloat * dx, yaflFloat * dp)
+{
+    yaflFloat pa[NX * NX];
+    yaflFloat pb[NX * NX];
+    yaflInt i;
+
+    full_p(pa, a->Up, a->Dp);
+    full_p(pb, b->Up, b->Dp);
+
+    *dx = 0.0;
+    *dp = 0.0;
+    for (i = 0; i < NX; i++)
+    {
+        *dx = fmax(*dx, fabs(a->x[i] - b->x[i]) / sqrt(pb[(NX + 1) * i]));
+    }
+    for (i = 0; i < NX * NX; i++)
+    {
+        *dp = fmax(*dp, fabs(pa[i] - pb[i]) / \
+                   sqrt(pb[(NX + 1) * (i / NX)] * pb[(NX + 1) * (i % NX)]));
+    }
+}
+
+static double now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1.0e3 + t.tv_nsec * 1.0e-6;
+}
+
+/*---------------------------------------------------------------------------*/
+static int check(yaflInt lag)
+{
+    yaflStatusEn st = YAFL_ST_OK;
+    yaflInt s0 = S0 - 1;
+    yaflInt k  = s0 + lag;
+    ekfMemSt drop;
+    ekfMemSt ref;
+    ekfMemSt res;
+    yaflFloat dx_o;
+    yaflFloat dp_o;
+    yaflFloat dx_d;
+    yaflFloat dp_d;
+    double t_o;
+    double t_r;
+    yaflInt s;
+    int fail;
+
+    init();
+    for (s = 0; s <= k; s++)
+    {
+        if (s)
+        {
+            st |= step(s);
+        }
+        filt[s] = ekf_mem;
+        st |= yafl_oosm_push(&oosm, &ekf, s * DT);
+    }
+
+    drop = ekf_mem;
+
+    /*
+    Taken between s0 and s0 + 1 steps, only the newest snapshot is changed
+    by the update, so the ring need not be restored
+    */
+    t_o = now();
+    for (s = 0; s < REPEAT; s++)
+    {
+        ekf_mem = drop;
+        st |= yafl_oosm_ekf_update(&oosm, &ekf, (s0 + 0.5) * DT, z_late);
+    }
+    t_o = now() - t_o;
+    res = ekf_mem;
+
+    t_r = now();
+    for (s = 0; s < REPEAT; s++)
+    {
+        st |= replay(s0, k);
+    }
+    t_r = now() - t_r;
+    ref = ekf_mem;
+
+    diff(&res,  &ref, &dx_o, &dp_o);
+    diff(&drop, &ref, &dx_d, &dp_d);
+
+    printf("lag %2d: OOSM %6.2f us, replay %6.2f us, status: 0x%x, "      \
+           "max diff x/P OOSM: %.3e/%.3e, dropped: %.3e/%.3e\n",          \
+           (int)lag, t_o * 1.0e3 / REPEAT, t_r * 1.0e3 / REPEAT, st,       \
+           dx_o, dp_o, dx_d, dp_d);
+
+    fail = (st >= YAFL_ST_ERR_THR);
+    if (1 == lag)
+    {
+        /*Exact for one step lag*/
+        fail |= (dx_o > 1.0e-9) || (dp_o > 1.0e-9);
+    }
+    else
+    {
+        fail |= (dx_o >= dx_d) || (dp_o >= dp_d);
+    }
+    return fail;
+}
+
+int main(void)
+{
+    yaflStatusEn st;
+    int fails = 0;
+
+    gen();
+
+    fails += check(1);
+    fails += check(2);
+    fails += check(5);
+    fails += check(8);
+    fails += check(12);
+    fails += check(30);
+
+    /*Not out of sequence and too old measurements*/
+    init();
+    st = yafl_oosm_push(&oosm, &ekf, 0.0);
+    fprintf(stderr, "Expected YAFL_CHECK messages:\n");
+    fails += (YAFL_ST_INV_ARG_3 != yafl_oosm_ekf_update(&oosm, &ekf, 0.5 * DT, z_late));
+    fails += (YAFL_ST_INV_ARG_3 != yafl_oosm_ekf_update(&oosm, &ekf, -DT, z_late));
+    fails += (st >= YAFL_ST_ERR_THR);
+
+    return yafl_test_report(fails);
+}
@@ -0,0 +1,195 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+k step predict check and benchmark: 9 state constant acceleration model
+(3 axes x (p, v, a)) with measurement dropouts. An LKF with cached F**k
+and Qk is compared with an LKF which does k predicts. Gaps alternating
+between two values miss the single k cache on every predict.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy predict_n_check.c ../../src/yafl.c ../../src/yafl_math.c -lm -o predict_n_check
+./predict_n_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl.h>
+
+#define NX 9
+#define NZ 3
+#define NU ((NX * (NX - 1)) / 2)
+
+#define DT 0.01
+
+#define GAPS 200
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+static void set_f(yaflFloat * f)
+{
+    yaflInt i;
+    yaflInt k;
+
+    memset(f, 0, sizeof(yaflFloat) * NX * NX);
+    for (i = 0; i < NX; i++)
+    {
+        f[NX * i + i] = 1.0;
+    }
+
+    for (k = 0; k < 3; k++)
+    {
+        f[NX * (3 * k) + 3 * k + 1]     = DT;
+        f[NX * (3 * k) + 3 * k + 2]     = 0.5 * DT * DT;
+        f[NX * (3 * k + 1) + 3 * k + 2] = DT;
+    }
+}
+
+static void set_h(yaflFloat * h)
+{
+    memset(h, 0, sizeof(yaflFloat) * NZ * NX);
+    h[0]          = 1.0;
+    h[NX + 3]     = 1.0;
+    h[2 * NX + 6] = 1.0;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_LKF_MEMORY_MIXIN(NX, NZ);
+    YAFL_LKF_PREDICT_N_MEMORY_MIXIN(NX);
+} lkfMemSt;
+
+static lkfMemSt  lkf_mem[2];
+static yaflLKFSt lkf[2];
+
+static void init(yaflInt k)
+{
+    yaflLKFSt tmp = YAFL_LKF_INITIALIZER(0, NX, NZ, lkf_mem[k]);
+    yaflInt i;
+
+    lkf[k] = tmp;
+    if (k)
+    {
+        yafl_lkf_set_predict_n(&lkf[k], lkf_mem[k].Fk, lkf_mem[k].Uqk, \
+                               lkf_mem[k].Dqk, lkf_mem[k].Fa,          \
+                               lkf_mem[k].Uqa, lkf_mem[k].Dqa);
+    }
+
+    for (i = 0; i < NX; i++)
+    {
+        lkf_mem[k].x[i]  = 0.0;
+        lkf_mem[k].Dp[i] = 1.0;
+        lkf_mem[k].Dq[i] = 1.0e-6 * (i % 3 + 1);
+    }
+
+    for (i = 0; i < NU; i++)
+    {
+        lkf_mem[k].Up[i] = 0.0;
+        lkf_mem[k].Uq[i] = 0.0;
+    }
+    /*Correlated process noise*/
+    lkf_mem[k].Uq[0] = 0.5;
+    lkf_mem[k].Uq[1] = 0.1;
+    lkf_mem[k].Uq[2] = 0.2;
+
+    for (i = 0; i < NZ; i++)
+    {
+        lkf_mem[k].Dr[i] = 1.0e-2;
+    }
+    memset(lkf_mem[k].Ur, 0, sizeof(lkf_mem[k].Ur));
+
+    set_f(lkf_mem[k].F);
+    set_h(lkf_mem[k].Hm);
+}
+
+/*Returns the max relative difference of the filters*/
+static yaflFloat max_diff(void)
+{
+    yaflFloat diff = 0.0;
+    yaflInt i;
+
+    for (i = 0; i < NX; i++)
+    {
+        diff = fmax(diff, fabs(lkf_mem[0].x[i] - lkf_mem[1].x[i]) / \
+                          fmax(1.0, fabs(lkf_mem[0].x[i])));
+        diff = fmax(diff, fabs(lkf_mem[0].Dp[i] - lkf_mem[1].Dp[i]) / lkf_mem[0].Dp[i]);
+    }
+    for (i = 0; i < NU; i++)
+    {
+        diff = fmax(diff, fabs(lkf_mem[0].Up[i] - lkf_mem[1].Up[i]));
+    }
+    return diff;
+}
+
+/*Gaps alternate between gap and gap2*/
+static int check(yaflInt gap, yaflInt gap2)
+{
+    yaflStatusEn st[2] = {YAFL_ST_OK, YAFL_ST_OK};
+    double t[2];
+    yaflFloat diff;
+    yaflInt k;
+
+    init(0);
+    init(1);
+
+    for (k = 0; k < 2; k++)
+    {
+        clock_t t0;
+        yaflInt s;
+
+        t0 = clock();
+        for (s = 0; s < GAPS; s++)
+        {
+            yaflFloat z[NZ];
+
+            z[0] = sin(0.1 * s);
+            z[1] = cos(0.2 * s);
+            z[2] = 0.1 * s;
+
+            /*Filter 0 has no cache, so it does k predicts*/
+            st[k] |= yafl_lkf_predict_n(&lkf[k], (s & 1) ? gap2 : gap);
+            st[k] |= yafl_lkf_bierman_update(&lkf[k], z);
+        }
+        t[k] = (double)(clock() - t0) * 1.0e3 / CLOCKS_PER_SEC;
+    }
+
+    diff = max_diff();
+    printf("Gap %4d/%4d: k predicts: %7.2f ms, cached: %7.2f ms, max diff: %.3e, status: 0x%x/0x%x\n", \
+           gap, gap2, t[0], t[1], diff, st[0], st[1]);
+
+    return (diff > 1.0e-9) || (st[0] >= YAFL_ST_ERR_THR) || (st[1] >= YAFL_ST_ERR_THR);
+}
+
+int main(void)
+{
+    int fails = 0;
+
+    fails += check(1,   1);
+    fails += check(7,   7);
+    fails += check(64,  64);
+    fails += check(300, 300);
+
+    /*Cache misses*/
+    fails += check(2,   3);
+    fails += check(7,   8);
+    fails += check(64,  65);
+
+    return yafl_test_report(fails);
+}
@@ -0,0 +1,293 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Work stealing scheduler check: a mix of Bierman EKFs, Joseph EKFs and UKFs
+is run by the scheduler with different thread numbers and compared
+bit-for-bit with a single threaded run.
+
+Build and run:
+gcc -O2 -pthread -I../../src -I../../src/configpy sched_check.c ../../src/yafl_sched.c ../../src/yafl.c ../../src/yafl_math.c -lm -o sched_check
+./sched_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl.h>
+#include <yafl_sched.h>
+
+#define NZ 2
+
+#define NB 300 /*Bierman EKFs, nx = 4*/
+#define NJ 300 /*Joseph EKFs,  nx = 6*/
+#define NU 100 /*UKFs,         nx = 5*/
+
+#define NT (NB + NJ + NU)
+
+#define NX_MAX 6
+#define NP_MAX (2 * 5 + 1)
+
+/*Max scratchpad sizes: EKF W: 2 * nx * nx, UKF W: (np + nx) * nx, EKF H*/
+#define W_SZ 80
+#define D_SZ 16
+#define H_SZ (NZ * NX_MAX)
+
+#define STEPS 50
+#define THR_MAX 4
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+/*The same model for all the filters: x[i] += 0.1 * sin(x[i + 1])*/
+static yaflStatusEn fx(yaflKalmanBaseSt * self, yaflFloat * x, yaflFloat * xz)
+{
+    yaflInt i;
+
+    (void)xz;
+
+    for (i = 0; i < self->Nx - 1; i++)
+    {
+        x[i] += 0.1 * sin(x[i + 1]);
+    }
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn jfx(yaflKalmanBaseSt * self, yaflFloat * w, yaflFloat * x)
+{
+    yaflInt nx;
+    yaflInt i;
+
+    nx = self->Nx;
+    for (i = 0; i < nx; i++)
+    {
+        yaflInt j;
+
+        for (j = 0; j < nx; j++)
+        {
+            w[2 * nx * i + j] = (i == j) ? 1.0 : 0.0;
+        }
+
+        if (i < nx - 1)
+        {
+            w[2 * nx * i + i + 1] = 0.1 * cos(x[i + 1]);
+        }
+    }
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn hx(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+
+    y[0] = x[0] + 0.1 * x[1] * x[1];
+    y[1] = x[2];
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn jhx(yaflKalmanBaseSt * self, yaflFloat * h, yaflFloat * x)
+{
+    yaflInt nx;
+
+    nx = self->Nx;
+    memset(h, 0, sizeof(yaflFloat) * NZ * nx);
+    h[0]      = 1.0;
+    h[1]      = 0.2 * x[1];
+    h[nx + 2] = 1.0;
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_EKF_BASE_MEMORY_MIXIN(NX_MAX, NZ);
+} ekfMemSt;
+
+typedef struct {
+    YAFL_UKF_MEMORY_MIXIN(5, NZ);
+    YAFL_UKF_MERWE_MEMORY_MIXIN(5, NZ);
+} ukfMemSt;
+
+static ekfMemSt       ekf_mem[NB + NJ];
+static yaflEKFBaseSt  ekf[NB + NJ];
+
+static ukfMemSt       ukf_mem[NU];
+static yaflUKFMerweSt ukf_sp[NU];
+static yaflUKFSt      ukf[NU];
+
+static yaflSchedTaskSt task[NT];
+static yaflFloat       z[NT][NZ];
+
+static yaflFloat       scratch[THR_MAX * (W_SZ + D_SZ + H_SZ)];
+static yaflFloat       ref[NT][NX_MAX];
+
+/*Separate W and D memory for the reference run*/
+static yaflFloat       own_w[NT][W_SZ];
+static yaflFloat       own_d[NT][D_SZ];
+
+static void init_kalman(yaflKalmanBaseSt * kb, yaflInt l)
+{
+    yaflInt i;
+
+    for (i = 0; i < kb->Nx; i++)
+    {
+        kb->x[i]  = 0.01 * l + 0.1 * i;
+        kb->Dp[i] = 1.0;
+        kb->Dq[i] = 1.0e-4;
+    }
+
+    memset(kb->Up, 0, sizeof(yaflFloat) * ((kb->Nx * (kb->Nx - 1)) / 2));
+    memset(kb->Uq, 0, sizeof(yaflFloat) * ((kb->Nx * (kb->Nx - 1)) / 2));
+
+    kb->Dr[0] = 0.01;
+    kb->Dr[1] = 0.01;
+    kb->Ur[0] = 0.0;
+}
+
+static void init(yaflInt bind)
+{
+    yaflInt l;
+
+    for (l = 0; l < NB + NJ; l++)
+    {
+        yaflInt nx = (l < NB) ? 4 : 6;
+        yaflEKFBaseSt tmp = YAFL_EKF_BASE_INITIALIZER(fx, jfx, hx, jhx, 0, nx, \
+                                                      NZ, ekf_mem[l]);
+        ekf[l] = tmp;
+        ekf[l].W = own_w[l];
+        ekf[l].D = own_d[l];
+        init_kalman(&ekf[l].base, l);
+
+        task[l].self    = &ekf[l];
+        task[l].predict = (yaflSchedPredictP)yafl_ekf_base_predict;
+        task[l].update  = (l < NB) ? (yaflSchedUpdateP)yafl_ekf_bierman_update : \
+                                     (yaflSchedUpdateP)yafl_ekf_joseph_update;
+        task[l].W       = bind ? &ekf[l].W : 0;
+        task[l].D       = bind ? &ekf[l].D : 0;
+        task[l].H       = bind ? &ekf[l].H : 0;
+    }
+
+    for (l = 0; l < NU; l++)
+    {
+        yaflInt t = NB + NJ + l;
+        yaflUKFMerweSt tmp_sp = YAFL_UKF_MERWE_INITIALIZER(5, 0, 0.1, 2.0, 0.0, \
+                                                           ukf_mem[l]);
+        yaflUKFSt tmp = YAFL_UKF_INITIALIZER(&ukf_sp[l].base, &yafl_ukf_merwe_spm, \
+                                             fx, 0, 0, hx, 0, 0, 5, NZ,         \
+                                             ukf_mem[l]);
+        ukf_sp[l] = tmp_sp;
+        ukf[l]    = tmp;
+        ukf[l].base.W = own_w[t];
+        ukf[l].base.D = own_d[t];
+        init_kalman(&ukf[l].base.base, t);
+        yafl_ukf_post_init(&ukf[l].base);
+
+        task[t].self    = &ukf[l];
+        task[t].predict = (yaflSchedPredictP)yafl_ukf_base_predict;
+        task[t].update  = (yaflSchedUpdateP)yafl_ukf_update;
+        task[t].W       = bind ? &ukf[l].base.W : 0;
+        task[t].D       = bind ? &ukf[l].base.D : 0;
+        task[t].H       = 0;
+    }
+}
+
+static void gen_z(yaflInt s)
+{
+    yaflInt t;
+
+    for (t = 0; t < NT; t++)
+    {
+        z[t][0] = sin(0.1 * s + 0.01 * t);
+        z[t][1] = cos(0.1 * s);
+
+        /*Every third filter has no measurement at every second step*/
+        task[t].z = ((t % 3) || (s & 1)) ? z[t] : 0;
+    }
+}
+
+static void get_x(yaflFloat (*res)[NX_MAX])
+{
+    yaflInt t;
+
+    for (t = 0; t < NT; t++)
+    {
+        yaflKalmanBaseSt * kb = (yaflKalmanBaseSt *)task[t].self;
+        memcpy(res[t], kb->x, sizeof(yaflFloat) * kb->Nx);
+    }
+}
+
+int main(void)
+{
+    static yaflFloat x[NT][NX_MAX];
+    static yaflSchedSt sched;
+    yaflInt nthr;
+    yaflInt s;
+    int fails = 0;
+    clock_t t;
+
+    /*Single threaded reference run, own W and D*/
+    init(0);
+    t = clock();
+    for (s = 0; s < STEPS; s++)
+    {
+        yaflInt i;
+
+        gen_z(s);
+        for (i = 0; i < NT; i++)
+        {
+            task[i].status = task[i].predict(task[i].self);
+            if (task[i].z)
+            {
+                task[i].status |= task[i].update(task[i].self, task[i].z);
+            }
+        }
+    }
+    printf("Reference: %.1f ms\n", (double)(clock() - t) * 1.0e3 / CLOCKS_PER_SEC);
+    memset(ref, 0, sizeof(ref));
+    get_x(ref);
+
+    for (nthr = 1; nthr <= THR_MAX; nthr++)
+    {
+        struct timespec t0;
+        struct timespec t1;
+        yaflStatusEn status = YAFL_ST_OK;
+
+        init(1);
+        yafl_sched_init(&sched, nthr, scratch, W_SZ, D_SZ, H_SZ, 1);
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (s = 0; s < STEPS; s++)
+        {
+            gen_z(s);
+            status |= yafl_sched_run(&sched, task, NT);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        yafl_sched_deinit(&sched);
+
+        memset(x, 0, sizeof(x));
+        get_x(x);
+
+        printf("%d threads: %.1f ms, status: 0x%x, %s\n", nthr,                 \
+               yafl_test_ms(&t0, &t1), \
+               status, memcmp(x, ref, sizeof(x)) ? "DIFFERENT" : "same");
+
+        fails += (0 != memcmp(x, ref, sizeof(x))) || (status >= YAFL_ST_ERR_THR);
+    }
+
+    return yafl_test_report(fails);
+}
@@ -0,0 +1,291 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Sequential innovation check: pins the EKF filter output for nz > 1.
+
+EKF scalar updates i > 0 use nu[i] = y[i] - h[i].dot(x - x0), where y and h
+are decorrelated by Ur and x0 is the prior state. Before that change they
+used the prior residuals y[i], which gives a different x when
+H.dot(P).dot(H.T) is not diagonal (P is the same in both cases).
+
+A 2D constant velocity target is tracked by position measuring EKFs
+with correlated P and R. Every step the updated state is compared with
+the dense sequential update which uses:
+- new: sequential innovations, the EKF must match it,
+- old: prior residuals, the EKF must differ from it.
+
+Checked updates:
+- Bierman (fused kernel), Joseph and rank one Joseph,
+- robust Bierman and Joseph with g(nu) = nu, so g sees the innovations,
+- adaptive Bierman and Joseph with the divergence test switched off.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy seq_innov_check.c ../../src/yafl.c ../../src/yafl_math.c -lm -o seq_innov_check
+./seq_innov_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <yafl.h>
+
+#define NX 4 /*px, vx, py, vy*/
+#define NZ 2 /*px, py*/
+#define NU ((NX * (NX - 1)) / 2)
+
+#define DT    0.1
+#define SIGMA 0.1
+
+#define STEPS 200
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+/*Gaussian influence function, so robust updates are the plain ones*/
+static yaflFloat g_lin(yaflKalmanBaseSt * self, yaflFloat nu)
+{
+    (void)self;
+    return nu;
+}
+
+static yaflFloat gdot_lin(yaflKalmanBaseSt * self, yaflFloat nu)
+{
+    (void)self;
+    (void)nu;
+    return 1.0;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_EKF_BASE_MEMORY_MIXIN(NX, NZ);
+} ekfMemSt;
+
+static ekfMemSt        ekf_mem;
+static yaflEKFBaseSt   ekf = YAFL_EKF_BASE_INITIALIZER(yafl_test_cv_fx,  \
+                                                       yafl_test_cv_jfx, \
+                                                       yafl_test_cv_hx,  \
+                                                       yafl_test_cv_jhx, \
+                                                       0, NX, NZ, ekf_mem);
+
+static ekfMemSt        rob_mem;
+static yaflEKFRobustSt rob = YAFL_EKF_ROBUST_INITIALIZER(yafl_test_cv_fx,  \
+                                                         yafl_test_cv_jfx, \
+                                                         yafl_test_cv_hx,  \
+                                                         yafl_test_cv_jhx, \
+                                                         0, g_lin, gdot_lin, \
+                                                         NX, NZ, rob_mem);
+
+static ekfMemSt          ada_mem;
+static yaflEKFAdaptiveSt ada = YAFL_EKF_ADAPTIVE_INITIALIZER(yafl_test_cv_fx, \
+                                                            yafl_test_cv_jfx, \
+                                                            yafl_test_cv_hx,  \
+                                                            yafl_test_cv_jhx, \
+                                                            0, NX, NZ,        \
+                                                            ada_mem);
+
+/*---------------------------------------------------------------------------*/
+/*Robust filters store alpha = r**0.5 in Dr*/
+static void init_kalman(yaflKalmanBaseSt * kf, yaflInt robust)
+{
+    yaflInt i;
+
+    for (i = 0; i < NX; i++)
+    {
+        kf->x[i]  = 0.0;
+        kf->Dp[i] = 1.0;
+        kf->Dq[i] = 1.0e-3;
+    }
+    kf->x[0] = 10.0;
+    kf->x[1] = 1.0;
+    kf->x[2] = 5.0;
+
+    memset(kf->Up, 0, sizeof(yaflFloat) * NU);
+    memset(kf->Uq, 0, sizeof(yaflFloat) * NU);
+    kf->Up[1] = 0.9; /* P[0, 2] */
+
+    kf->Dr[0] = robust ? SIGMA : SIGMA * SIGMA;
+    kf->Dr[1] = robust ? SIGMA : SIGMA * SIGMA;
+    kf->Ur[0] = 0.3; /*Correlated sensor noise*/
+}
+
+/*
+Dense sequential update of the prior kf->x, kf->Up, kf->Dp by z,
+r is R diagonal after decorrelation by Ur, nu[i] = y[i] - h[i].dot(x - x0)
+if seq is nonzero and nu[i] = y[i] otherwise.
+*/
+static void dense_update(yaflKalmanBaseSt * kf, yaflFloat * z, yaflFloat * r, \
+                         yaflInt seq, yaflFloat * xu)
+{
+    yaflFloat p[NX][NX];
+    yaflFloat h[NZ][NX];
+    yaflFloat y[NZ];
+    yaflFloat u = kf->Ur[0];
+    yaflInt i;
+    yaflInt j;
+    yaflInt k;
+
+    /*P = U.dot(D).dot(U.T)*/
+    for (i = 0; i < NX; i++)
+    {
+        xu[i] = kf->x[i];
+        for (j = 0; j < NX; j++)
+        {
+            p[i][j] = 0.0;
+            for (k = (i > j) ? i : j; k < NX; k++)
+            {
+                yaflFloat uik = (k == i) ? 1.0 : kf->Up[i + ((k - 1) * k) / 2];
+                yaflFloat ujk = (k == j) ? 1.0 : kf->Up[j + ((k - 1) * k) / 2];
+
+                p[i][j] += uik * kf->Dp[k] * ujk;
+            }
+        }
+    }
+
+    /* y = inv(Ur).dot(z - H.dot(x)), h = inv(Ur).dot(H), H selects x[0], x[2] */
+    y[0] = (z[0] - kf->x[0]) - u * (z[1] - kf->x[2]);
+    y[1] =  z[1] - kf->x[2];
+
+    memset(h, 0, sizeof(h));
+    h[0][0] = 1.0;
+    h[0][2] = -u;
+    h[1][2] = 1.0;
+
+    for (i = 0; i < NZ; i++)
+    {
+        yaflFloat ph[NX];
+        yaflFloat nu = y[i];
+        yaflFloat s  = r[i];
+
+        for (k = 0; seq && (k < NX); k++)
+        {
+            nu -= h[i][k] * (xu[k] - kf->x[k]);
+        }
+
+        for (j = 0; j < NX; j++)
+        {
+            ph[j] = 0.0;
+            for (k = 0; k < NX; k++)
+            {
+                ph[j] += p[j][k] * h[i][k];
+            }
+            s += h[i][j] * ph[j];
+        }
+
+        for (j = 0; j < NX; j++)
+        {
+            xu[j] += ph[j] * nu / s;
+            for (k = 0; k < NX; k++)
+            {
+                p[j][k] -= ph[j] * ph[k] / s;
+            }
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*
+Runs STEPS predict + update steps, returns the max x diff against the new
+reference, *old is the min over the steps of the max x diff against
+the old one.
+*/
+static yaflFloat check(const char * name, yaflKalmanBaseSt * kf, \
+                       yaflInt robust, yaflKalmanScalarUpdateP scalar, \
+                       yaflFloat * old, yaflStatusEn * status)
+{
+    yaflFloat diff  = 0.0;
+    yaflFloat dold  = 1.0e300;
+    yaflInt s;
+
+    init_kalman(kf, robust);
+
+    for (s = 0; s < STEPS; s++)
+    {
+        yaflFloat xn[NX];
+        yaflFloat xo[NX];
+        yaflFloat r[NZ];
+        yaflFloat z[NZ];
+        yaflFloat d = 0.0;
+        yaflInt i;
+
+        z[0] = 10.0 + DT * s + 0.3 * sin(0.7 * s);
+        z[1] = 5.0 + 0.2 * cos(0.03 * s) - 0.3 * cos(0.9 * s);
+
+        *status |= yafl_ekf_base_predict(kf);
+
+        for (i = 0; i < NZ; i++)
+        {
+            r[i] = robust ? kf->Dr[i] * kf->Dr[i] : kf->Dr[i];
+        }
+        dense_update(kf, z, r, 1, xn);
+        dense_update(kf, z, r, 0, xo);
+
+        *status |= yafl_ekf_base_update(kf, z, scalar);
+
+        for (i = 0; i < NX; i++)
+        {
+            diff = fmax(diff, fabs(kf->x[i] - xn[i]));
+            d    = fmax(d,    fabs(kf->x[i] - xo[i]));
+        }
+        dold = fmin(dold, d);
+    }
+
+    printf("%-24s max x diff: %.3e, old behaviour diff: >= %.3e\n", \
+           name, diff, dold);
+
+    *old = fmin(*old, dold);
+    return diff;
+}
+
+/*---------------------------------------------------------------------------*/
+int main(void)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat diff = 0.0;
+    yaflFloat old  = 1.0e300;
+    int fails;
+
+    /*Divergence test off*/
+    ada.chi2 = 1.0e300;
+
+    diff = fmax(diff, check("Bierman", &ekf.base, 0, \
+                            yafl_ekf_bierman_update_scalar, \
+                            &old, &status));
+    diff = fmax(diff, check("Joseph", &ekf.base, 0, \
+                            yafl_ekf_joseph_update_scalar, \
+                            &old, &status));
+    diff = fmax(diff, check("Rank 1 Joseph", &ekf.base, 0, \
+                            yafl_ekf_joseph_r1_update_scalar, \
+                            &old, &status));
+    diff = fmax(diff, check("Robust Bierman", &rob.base.base, 1, \
+                            yafl_ekf_robust_bierman_update_scalar, \
+                            &old, &status));
+    diff = fmax(diff, check("Robust Joseph", &rob.base.base, 1, \
+                            yafl_ekf_robust_joseph_update_scalar, \
+                            &old, &status));
+    diff = fmax(diff, check("Adaptive Bierman", &ada.base.base, 0, \
+                            yafl_ekf_adaptive_bierman_update_scalar, \
+                            &old, &status));
+    diff = fmax(diff, check("Adaptive Joseph", &ada.base.base, 0, \
+                            yafl_ekf_adaptive_joseph_update_scalar, \
+                            &old, &status));
+
+    printf("Status: 0x%x\n", status);
+
+    fails = (diff > 1.0e-12) || (old < 1.0e-6) || (status >= YAFL_ST_ERR_THR);
+    return yafl_test_report(fails);
+}
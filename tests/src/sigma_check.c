@@ -0,0 +1,307 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Sigma point generators check: weighted sample mean and covariance of
+the generated points must be equal to x and Up * diag(Dp) * Up.T,
+the minimal skew simplex unit points must have zero marginal third
+moments (the spherical simplex ones do not), then UKFs with all
+the generators are run on the same data and compared with the Merwe UKF.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy sigma_check.c ../../src/yafl.c ../../src/yafl_math.c -lm -o sigma_check
+./sigma_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl.h>
+
+#define NX 5
+#define NZ 2
+#define NU ((NX * (NX - 1)) / 2)
+
+#define DT 0.05
+
+#define STEPS 200
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+static yaflInt n_fx; /*f calls counter*/
+
+static yaflStatusEn fx(yaflKalmanBaseSt * self, yaflFloat * x, yaflFloat * xz)
+{
+    (void)self;
+    (void)xz;
+
+    n_fx++;
+    x[0] += DT * x[1];
+    x[1] -= DT * sin(x[0]);
+    x[2] += DT * x[3];
+    x[3] += DT * 0.1 * x[4];
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn hx(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+
+    y[0] = x[0] + 0.1 * x[2] * x[2];
+    y[1] = x[2] + x[4];
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_UKF_MEMORY_MIXIN(NX, NZ);
+    /*The largest set*/
+    YAFL_UKF_MERWE_MEMORY_MIXIN(NX, NZ);
+} ukfMemSt;
+
+enum {
+    SP_MERWE = 0,
+    SP_SIMPLEX,
+    SP_SPHERICAL,
+    SP_CUBATURE,
+    SP_NUM
+};
+
+static const char * sp_name[SP_NUM] = {"Merwe", "Simplex", "Spherical", "Cubature"};
+
+static ukfMemSt ukf_mem[SP_NUM];
+static yaflUKFSt ukf[SP_NUM];
+
+static yaflUKFMerweSt     merwe;
+static yaflUKFSigmaSt     simplex;
+static yaflUKFSphericalSt spherical;
+static yaflUKFSigmaSt     cubature;
+
+static void init(void)
+{
+    yaflUKFMerweSt     tmp_m  = YAFL_UKF_MERWE_INITIALIZER(NX, 0, 0.1, 2.0, 0.0, \
+                                                           ukf_mem[SP_MERWE]);
+    yaflUKFSigmaSt     tmp_s  = YAFL_UKF_SIMPLEX_INITIALIZER(NX, 0,             \
+                                                           ukf_mem[SP_SIMPLEX]);
+    yaflUKFSphericalSt tmp_ss = YAFL_UKF_SPHERICAL_INITIALIZER(NX, 0, 0.2,      \
+                                                           ukf_mem[SP_SPHERICAL]);
+    yaflUKFSigmaSt     tmp_c  = YAFL_UKF_CUBATURE_INITIALIZER(NX, 0,            \
+                                                           ukf_mem[SP_CUBATURE]);
+    yaflUKFSigmaSt * sp[SP_NUM];
+    const yaflUKFSigmaMethodsSt * spm[SP_NUM] = {
+        &yafl_ukf_merwe_spm,
+        &yafl_ukf_simplex_spm,
+        &yafl_ukf_spherical_spm,
+        &yafl_ukf_cubature_spm
+    };
+    yaflInt k;
+
+    merwe     = tmp_m;
+    simplex   = tmp_s;
+    spherical = tmp_ss;
+    cubature  = tmp_c;
+
+    sp[SP_MERWE]     = &merwe.base;
+    sp[SP_SIMPLEX]   = &simplex;
+    sp[SP_SPHERICAL] = &spherical.base;
+    sp[SP_CUBATURE]  = &cubature;
+
+    for (k = 0; k < SP_NUM; k++)
+    {
+        yaflUKFSt tmp = YAFL_UKF_INITIALIZER(sp[k], spm[k], fx, 0, 0, hx, 0, 0, \
+                                             NX, NZ, ukf_mem[k]);
+        yaflInt i;
+
+        ukf[k] = tmp;
+
+        for (i = 0; i < NX; i++)
+        {
+            ukf_mem[k].x[i]  = 0.1 * (i + 1);
+            ukf_mem[k].Dp[i] = 0.5 + 0.1 * i;
+            ukf_mem[k].Dq[i] = 1.0e-4;
+        }
+
+        for (i = 0; i < NU; i++)
+        {
+            ukf_mem[k].Up[i] = 0.1 * (i % 3) - 0.05;
+            ukf_mem[k].Uq[i] = 0.0;
+        }
+
+        ukf_mem[k].Dr[0] = 1.0e-2;
+        ukf_mem[k].Dr[1] = 1.0e-2;
+        ukf_mem[k].Ur[0] = 0.0;
+
+        yafl_ukf_post_init(&ukf[k].base);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*Max abs error of the sigma point mean and covariance*/
+static yaflFloat check_moments(yaflUKFBaseSt * self)
+{
+    yaflFloat u[NX][NX];
+    yaflFloat p[NX][NX];
+    yaflFloat err = 0.0;
+    yaflInt np;
+    yaflInt i;
+    yaflInt j;
+    yaflInt k;
+
+    yafl_ukf_gen_sigmas(self);
+    np = self->sp_info->np;
+
+    /*Unpack Up*/
+    for (i = 0; i < NX; i++)
+    {
+        for (j = 0; j < NX; j++)
+        {
+            u[i][j] = (i == j) ? 1.0 : ((j > i) ? self->base.Up[i + ((j - 1) * j) / 2] : 0.0);
+        }
+    }
+
+    for (i = 0; i < NX; i++)
+    {
+        yaflFloat m = 0.0;
+
+        for (k = 0; k < np; k++)
+        {
+            m += self->wm[k] * self->sigmas_x[NX * k + i];
+        }
+        err = fmax(err, fabs(m - self->base.x[i]));
+
+        for (j = 0; j < NX; j++)
+        {
+            p[i][j] = 0.0;
+            for (k = 0; k < np; k++)
+            {
+                p[i][j] += self->wc[k] * (self->sigmas_x[NX * k + i] - self->base.x[i]) * \
+                                         (self->sigmas_x[NX * k + j] - self->base.x[j]);
+            }
+        }
+    }
+
+    for (i = 0; i < NX; i++)
+    {
+        for (j = 0; j < NX; j++)
+        {
+            yaflFloat r = 0.0;
+
+            for (k = 0; k < NX; k++)
+            {
+                r += u[i][k] * self->base.Dp[k] * u[j][k];
+            }
+            err = fmax(err, fabs(p[i][j] - r));
+        }
+    }
+    return err;
+}
+
+/*Max abs marginal third moment of the unit points: Up = 0, Dp = 1*/
+static yaflFloat check_skew(yaflUKFBaseSt * self)
+{
+    yaflFloat skew = 0.0;
+    yaflInt np;
+    yaflInt i;
+    yaflInt k;
+
+    memset(self->base.Up, 0, sizeof(yaflFloat) * NU);
+    for (i = 0; i < NX; i++)
+    {
+        self->base.Dp[i] = 1.0;
+    }
+
+    yafl_ukf_gen_sigmas(self);
+    np = self->sp_info->np;
+
+    for (i = 0; i < NX; i++)
+    {
+        yaflFloat m = 0.0;
+
+        for (k = 0; k < np; k++)
+        {
+            yaflFloat e = self->sigmas_x[NX * k + i] - self->base.x[i];
+
+            m += self->wm[k] * e * e * e;
+        }
+        skew = fmax(skew, fabs(m));
+    }
+    return skew;
+}
+
+int main(void)
+{
+    yaflFloat x_err[SP_NUM] = {0};
+    yaflStatusEn status[SP_NUM] = {YAFL_ST_OK};
+    yaflInt calls[SP_NUM] = {0};
+    int fails = 0;
+    yaflInt k;
+
+    init();
+
+    for (k = 0; k < SP_NUM; k++)
+    {
+        yaflFloat err;
+
+        yaflFloat skew;
+
+        err  = check_moments(&ukf[k].base);
+        skew = check_skew(&ukf[k].base);
+        printf("%-10s np = %2d, moments error: %.3e, unit skew: %.3e\n", \
+               sp_name[k], ukf[k].base.sp_info->np, err, skew);
+        fails += err > 1.0e-12;
+        fails += (SP_SIMPLEX   == k) && (skew > 1.0e-12);
+        fails += (SP_SPHERICAL == k) && (skew < 1.0e-3);
+    }
+
+    init();
+
+    for (k = 0; k < SP_NUM; k++)
+    {
+        yaflInt s;
+
+        n_fx = 0;
+        for (s = 0; s < STEPS; s++)
+        {
+            yaflFloat z[NZ];
+
+            z[0] = 0.3 * sin(0.05 * s);
+            z[1] = 0.5 + 0.01 * s;
+
+            status[k] |= yafl_ukf_base_predict(&ukf[k].base);
+            status[k] |= yafl_ukf_update(&ukf[k].base, z);
+        }
+        calls[k] = n_fx;
+    }
+
+    for (k = 0; k < SP_NUM; k++)
+    {
+        yaflInt i;
+
+        for (i = 0; i < NX; i++)
+        {
+            x_err[k] = fmax(x_err[k], fabs(ukf_mem[k].x[i] - ukf_mem[SP_MERWE].x[i]));
+        }
+
+        printf("%-10s f calls: %5d, status: 0x%x, state diff from Merwe: %.3e\n", \
+               sp_name[k], calls[k], status[k], x_err[k]);
+        fails += (status[k] >= YAFL_ST_ERR_THR) || (x_err[k] > 1.0e-2);
+    }
+
+    return yafl_test_report(fails);
+}
@@ -0,0 +1,116 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Bit-for-bit check of SIMD vector kernels against scalar ones.
+
+Build and run:
+gcc -O2 -DYAFL_USE_SIMD -I../../src -I../../src/configpy simd_check.c ../../src/yafl_math.c -lm -o simd_check
+./simd_check
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <yafl_math.h>
+
+#define SZ_MAX 67
+#define NR     5
+
+#include "yafl_test.h"
+
+static yaflFloat a[NR * SZ_MAX];
+static yaflFloat b[NR * SZ_MAX];
+static yaflFloat ref[NR * SZ_MAX];
+static yaflFloat res[NR * SZ_MAX];
+static yaflFloat init[NR * SZ_MAX];
+
+static void rnd_fill(yaflFloat * v, yaflInt sz)
+{
+    yaflInt i;
+    for (i = 0; i < sz; i++)
+    {
+        /*Avoid zeros as b is used as divisor*/
+        v[i] = ((yaflFloat)rand() / RAND_MAX - 0.5) * 1.0e3 + 1.0e-3;
+    }
+}
+
+typedef yaflStatusEn (* vxnP)(yaflInt, yaflFloat *, yaflFloat *, yaflFloat);
+typedef yaflStatusEn (* vxvP)(yaflInt, yaflFloat *, yaflFloat *, yaflFloat *);
+typedef yaflStatusEn (* mvP)(yaflInt, yaflInt, yaflFloat *, yaflFloat *, yaflFloat *);
+typedef yaflStatusEn (* vvtxnP)(yaflInt, yaflInt, yaflFloat *, yaflFloat *, yaflFloat *, yaflFloat);
+
+#define CHECK(name, call)                                         \
+do {                                                              \
+    memcpy(res, init, sizeof(res));                               \
+    yafl_math_simd_set_level(YAFL_SIMD_SCALAR);                   \
+    call;                                                         \
+    memcpy(ref, res, sizeof(res));                                \
+                                                                  \
+    memcpy(res, init, sizeof(res));                               \
+    yafl_math_simd_set_level(level);                              \
+    call;                                                         \
+    if (memcmp(ref, res, sizeof(res)))                            \
+    {                                                             \
+        printf("FAIL: %s level=%d sz=%d\n", name, level, sz);     \
+        fails++;                                                  \
+    }                                                             \
+} while (0)
+
+int main(void)
+{
+    static const vxnP   vxn[]   = {yafl_math_set_vxn,   yafl_math_add_vxn,   yafl_math_sub_vxn};
+    static const vxvP   vxv[]   = {yafl_math_set_vxv,   yafl_math_add_vxv,   yafl_math_sub_vxv};
+    static const vxvP   vrv[]   = {yafl_math_set_vrv,   yafl_math_add_vrv,   yafl_math_sub_vrv};
+    static const mvP    vvt[]   = {yafl_math_set_vvt,   yafl_math_add_vvt,   yafl_math_sub_vvt};
+    static const mvP    vtm[]   = {yafl_math_set_vtm,   yafl_math_add_vtm,   yafl_math_sub_vtm};
+    static const vvtxnP vvtxn[] = {yafl_math_set_vvtxn, yafl_math_add_vvtxn, yafl_math_sub_vvtxn};
+
+    yaflInt level;
+    yaflInt max_level;
+    int fails = 0;
+
+    yafl_math_simd_set_level(-1);
+    max_level = yafl_math_simd_get_level();
+    printf("Best SIMD level: %d\n", max_level);
+
+    rnd_fill(a,    NR * SZ_MAX);
+    rnd_fill(b,    NR * SZ_MAX);
+    rnd_fill(init, NR * SZ_MAX);
+
+    for (level = YAFL_SIMD_SSE2; level <= max_level; level++)
+    {
+        yaflInt sz;
+
+        for (sz = 1; sz <= SZ_MAX; sz++)
+        {
+            int op;
+
+            for (op = 0; op < 3; op++)
+            {
+                CHECK("vxn",   vxn[op](sz, res, a, b[0]));
+                CHECK("vxv",   vxv[op](sz, res, a, b));
+                CHECK("vrv",   vrv[op](sz, res, a, b));
+                CHECK("vvt",   vvt[op](NR, sz, res, a, b));
+                CHECK("vtm",   vtm[op](NR, sz, res, a, b));
+                CHECK("vvtxn", vvtxn[op](NR, sz, res, a, b, b[1]));
+            }
+        }
+        printf("Level %d checked\n", level);
+    }
+
+    return yafl_test_report(fails);
+}
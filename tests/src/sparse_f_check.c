@@ -0,0 +1,206 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Sparse F check and benchmark: 15 state constant acceleration model
+(3 axes x (p, v, a) + 6 biases), F = I + S with 9 nonzeros in S.
+EKFs with dense jf and sparse jfs are compared, predicts are timed.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy sparse_f_check.c ../../src/yafl.c ../../src/yafl_math.c -lm -o sparse_f_check
+./sparse_f_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl.h>
+
+#define NX 15
+#define NZ 3
+#define NU ((NX * (NX - 1)) / 2)
+
+#define DT 0.01
+
+#define STEPS 20000
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+/*Axis k position, velocity and acceleration are x[3k], x[3k + 1], x[3k + 2]*/
+/*S = F - I: row 3k has 2 nonzeros, row 3k + 1 has 1 nonzero*/
+static yaflStatusEn jfs(yaflKalmanBaseSt * self, yaflFloat * w, \
+                        yaflInt * nnz, yaflInt * idx, yaflFloat * x)
+{
+    yaflInt i;
+    yaflInt k;
+
+    (void)self;
+    (void)x;
+
+    for (i = 0; i < NX; i++)
+    {
+        nnz[i] = 0;
+    }
+
+    for (k = 0; k < 3; k++)
+    {
+        yaflInt p = 3 * k;
+        yaflInt v = 3 * k + 1;
+
+        nnz[p] = 2;
+        idx[NX * p]     = p + 1;
+        idx[NX * p + 1] = p + 2;
+        w[2 * NX * p + p + 1] = DT;
+        w[2 * NX * p + p + 2] = 0.5 * DT * DT;
+
+        nnz[v] = 1;
+        idx[NX * v] = v + 1;
+        w[2 * NX * v + v + 1] = DT;
+    }
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn hx(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+
+    y[0] = x[0];
+    y[1] = x[3];
+    y[2] = x[6] + x[14];
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn jhx(yaflKalmanBaseSt * self, yaflFloat * h, yaflFloat * x)
+{
+    (void)self;
+    (void)x;
+
+    memset(h, 0, sizeof(yaflFloat) * NZ * NX);
+    h[0]           = 1.0;
+    h[NX + 3]      = 1.0;
+    h[2 * NX + 6]  = 1.0;
+    h[2 * NX + 14] = 1.0;
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_EKF_BASE_MEMORY_MIXIN(NX, NZ);
+    YAFL_EKF_SPARSE_F_MEMORY_MIXIN(NX);
+} ekfMemSt;
+
+static ekfMemSt      ekf_mem[2];
+static yaflEKFBaseSt ekf[2];
+
+static void init(yaflInt k, yaflKalmanFuncP jf)
+{
+    yaflEKFBaseSt tmp = YAFL_EKF_BASE_INITIALIZER(yafl_test_ca_fx, jf, \
+                                                  hx, jhx, 0, NX, NZ, \
+                                                  ekf_mem[k]);
+    yaflInt i;
+
+    ekf[k] = tmp;
+
+    for (i = 0; i < NX; i++)
+    {
+        ekf_mem[k].x[i]  = 0.0;
+        ekf_mem[k].Dp[i] = 1.0;
+        ekf_mem[k].Dq[i] = 1.0e-6;
+    }
+
+    for (i = 0; i < NU; i++)
+    {
+        ekf_mem[k].Up[i] = 0.0;
+        ekf_mem[k].Uq[i] = 0.0;
+    }
+
+    for (i = 0; i < NZ; i++)
+    {
+        ekf_mem[k].Dr[i] = 1.0e-2;
+    }
+    memset(ekf_mem[k].Ur, 0, sizeof(ekf_mem[k].Ur));
+}
+
+/*Returns predict time only*/
+static double run(yaflInt k, yaflStatusEn * status)
+{
+    double t = 0.0;
+    yaflInt s;
+
+    for (s = 0; s < STEPS; s++)
+    {
+        struct timespec t0;
+        struct timespec t1;
+        yaflFloat z[NZ];
+
+        z[0] = sin(0.001 * s);
+        z[1] = cos(0.002 * s);
+        z[2] = 0.001 * s;
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        *status |= yafl_ekf_base_predict(&ekf[k].base);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        *status |= yafl_ekf_bierman_update(&ekf[k], z);
+
+        t += yafl_test_ms(&t0, &t1);
+    }
+    return t;
+}
+
+static yaflFloat max_diff(void)
+{
+    yaflFloat diff = 0.0;
+    yaflInt i;
+
+    for (i = 0; i < NX; i++)
+    {
+        diff = fmax(diff, fabs(ekf_mem[0].x[i] - ekf_mem[1].x[i]));
+        diff = fmax(diff, fabs(ekf_mem[0].Dp[i] - ekf_mem[1].Dp[i]) / ekf_mem[0].Dp[i]);
+    }
+    for (i = 0; i < NU; i++)
+    {
+        diff = fmax(diff, fabs(ekf_mem[0].Up[i] - ekf_mem[1].Up[i]));
+    }
+    return diff;
+}
+
+int main(void)
+{
+    yaflStatusEn st_d = YAFL_ST_OK;
+    yaflStatusEn st_s = YAFL_ST_OK;
+    double t_d;
+    double t_s;
+    yaflFloat diff;
+    int fails;
+
+    init(0, yafl_test_ca_jfx);
+    init(1, 0);
+    yafl_ekf_set_sparse_f(&ekf[1], jfs, ekf_mem[1].Fnnz, ekf_mem[1].Fidx);
+
+    t_d = run(0, &st_d);
+    t_s = run(1, &st_s);
+    diff = max_diff();
+
+    printf("Predict dense F: %6.1f ms, F = I + S: %6.1f ms, status: 0x%x/0x%x, max diff: %.3e\n", \
+           t_d, t_s, st_d, st_s, diff);
+
+    fails = (diff > 1.0e-9) || (st_d >= YAFL_ST_ERR_THR) || (st_s >= YAFL_ST_ERR_THR);
+    return yafl_test_report(fails);
+}
@@ -0,0 +1,208 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Sparse H check and benchmark: 15 state constant acceleration model
+(3 axes x (p, v, a) + 6 biases), position only sensor with correlated
+noise. EKFs with dense jh and sparse jhs are compared, updates are timed.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy sparse_h_check.c ../../src/yafl.c ../../src/yafl_math.c -lm -o sparse_h_check
+./sparse_h_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl.h>
+
+#define NX 15
+#define NZ 3
+#define NU ((NX * (NX - 1)) / 2)
+
+#define DT 0.01
+
+#define STEPS 20000
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+/*Axis k position, velocity and acceleration are x[3k], x[3k + 1], x[3k + 2]*/
+/*Slightly nonlinear position sensor with a bias on the last axis*/
+static yaflStatusEn hx(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+
+    y[0] = x[0] + 0.01 * x[0] * x[0];
+    y[1] = x[3];
+    y[2] = x[6] + x[14];
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn jhx(yaflKalmanBaseSt * self, yaflFloat * h, yaflFloat * x)
+{
+    (void)self;
+
+    memset(h, 0, sizeof(yaflFloat) * NZ * NX);
+    h[0]           = 1.0 + 0.02 * x[0];
+    h[NX + 3]      = 1.0;
+    h[2 * NX + 6]  = 1.0;
+    h[2 * NX + 14] = 1.0;
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn jhs(yaflKalmanBaseSt * self, yaflFloat * h, \
+                        yaflInt * nnz, yaflInt * idx, yaflFloat * x)
+{
+    (void)self;
+
+    h[0] = 1.0 + 0.02 * x[0];
+    nnz[0] = 1;
+    idx[0] = 0;
+
+    h[NX + 3] = 1.0;
+    nnz[1] = 1;
+    idx[NX] = 3;
+
+    h[2 * NX + 6]  = 1.0;
+    h[2 * NX + 14] = 1.0;
+    nnz[2] = 2;
+    idx[2 * NX]     = 6;
+    idx[2 * NX + 1] = 14;
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_EKF_BASE_MEMORY_MIXIN(NX, NZ);
+    YAFL_EKF_SPARSE_H_MEMORY_MIXIN(NX, NZ);
+} ekfMemSt;
+
+static ekfMemSt      ekf_mem[2];
+static yaflEKFBaseSt ekf[2];
+
+static void init(yaflInt k, yaflInt corr)
+{
+    yaflEKFBaseSt tmp = YAFL_EKF_BASE_INITIALIZER(yafl_test_ca_fx,  \
+                                                  yafl_test_ca_jfx, \
+                                                  hx, jhx, 0, NX, NZ, \
+                                                  ekf_mem[k]);
+    yaflInt i;
+
+    ekf[k] = tmp;
+    if (k)
+    {
+        yafl_ekf_set_sparse_h(&ekf[k], jhs, ekf_mem[k].Hnnz, ekf_mem[k].Hidx);
+    }
+
+    for (i = 0; i < NX; i++)
+    {
+        ekf_mem[k].x[i]  = 0.0;
+        ekf_mem[k].Dp[i] = 1.0;
+        ekf_mem[k].Dq[i] = 1.0e-6;
+    }
+
+    for (i = 0; i < NU; i++)
+    {
+        ekf_mem[k].Up[i] = 0.0;
+        ekf_mem[k].Uq[i] = 0.0;
+    }
+
+    for (i = 0; i < NZ; i++)
+    {
+        ekf_mem[k].Dr[i] = 1.0e-2;
+    }
+
+    /*Correlated sensor noise: Ur[0, 1], Ur[0, 2], Ur[1, 2]*/
+    ekf_mem[k].Ur[0] = corr ? 0.2  : 0.0;
+    ekf_mem[k].Ur[1] = corr ? -0.1 : 0.0;
+    ekf_mem[k].Ur[2] = corr ? 0.3  : 0.0;
+}
+
+/*Returns update time only*/
+static double run(yaflInt k, yaflKalmanScalarUpdateP scalar, yaflStatusEn * status)
+{
+    double t = 0.0;
+    yaflInt s;
+
+    for (s = 0; s < STEPS; s++)
+    {
+        struct timespec t0;
+        struct timespec t1;
+        yaflFloat z[NZ];
+
+        z[0] = sin(0.001 * s);
+        z[1] = cos(0.002 * s);
+        z[2] = 0.001 * s;
+
+        *status |= yafl_ekf_base_predict(&ekf[k].base);
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        *status |= yafl_ekf_base_update(&ekf[k].base, z, scalar);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        t += yafl_test_ms(&t0, &t1);
+    }
+    return t;
+}
+
+static yaflFloat max_diff(void)
+{
+    yaflFloat diff = 0.0;
+    yaflInt i;
+
+    for (i = 0; i < NX; i++)
+    {
+        diff = fmax(diff, fabs(ekf_mem[0].x[i] - ekf_mem[1].x[i]));
+        diff = fmax(diff, fabs(ekf_mem[0].Dp[i] - ekf_mem[1].Dp[i]) / ekf_mem[0].Dp[i]);
+    }
+    return diff;
+}
+
+static int check(const char * name, yaflKalmanScalarUpdateP scalar, yaflInt corr)
+{
+    yaflStatusEn st_d = YAFL_ST_OK;
+    yaflStatusEn st_s = YAFL_ST_OK;
+    double t_d;
+    double t_s;
+    yaflFloat diff;
+
+    init(0, corr);
+    init(1, corr);
+
+    t_d = run(0, scalar, &st_d);
+    t_s = run(1, scalar, &st_s);
+    diff = max_diff();
+
+    printf("%-8s %s R: update dense: %6.1f ms, sparse: %6.1f ms, status: 0x%x/0x%x, max diff: %.3e\n", \
+           name, corr ? "corr." : "diag.", t_d, t_s, st_d, st_s, diff);
+
+    return (diff > 1.0e-9) || (st_d >= YAFL_ST_ERR_THR) || (st_s >= YAFL_ST_ERR_THR);
+}
+
+int main(void)
+{
+    int fails = 0;
+
+    fails += check("Bierman", yafl_ekf_bierman_update_scalar, 0);
+    fails += check("Bierman", yafl_ekf_bierman_update_scalar, 1);
+    fails += check("Joseph",  yafl_ekf_joseph_update_scalar,  0);
+    fails += check("Joseph",  yafl_ekf_joseph_update_scalar,  1);
+
+    return yafl_test_report(fails);
+}
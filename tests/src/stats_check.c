@@ -0,0 +1,461 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Update statistics check: a 2D constant velocity target is tracked
+by range only EKFs and by a position measuring full UKF.
+
+Checks:
+- EKF log likelihood and NIS against a dense S = H.dot(P).dot(H.T) + R
+  computation for Bierman, Joseph and rank one Joseph updates,
+- the same for a position measuring EKF with correlated P and R,
+  the updated state is checked against x + P.dot(H.T).dot(linalg.inv(S)).dot(y),
+- full UKF log likelihood and NIS against the ones computed from y and Ds,
+- the cost of statistics against yafl_imm_ekf_loglik.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy stats_check.c ../../src/yafl.c ../../src/yafl_math.c ../../src/yafl_imm.c -lm -o stats_check
+./stats_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl_imm.h>
+
+#define NX 4 /*px, vx, py, vy*/
+#define NU ((NX * (NX - 1)) / 2)
+
+#define DT    0.1
+#define SIGMA 0.1
+
+#define STEPS 200
+#define BENCH 100000
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+/*Range sensor*/
+static yaflStatusEn hr(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+
+    y[0] = sqrt(x[0] * x[0] + x[2] * x[2]);
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn jhr(yaflKalmanBaseSt * self, yaflFloat * h, yaflFloat * x)
+{
+    yaflFloat r = sqrt(x[0] * x[0] + x[2] * x[2]);
+
+    (void)self;
+
+    h[0] = x[0] / r;
+    h[1] = 0.0;
+    h[2] = x[2] / r;
+    h[3] = 0.0;
+    return YAFL_ST_OK;
+}
+
+/*Position sensor*/
+static yaflStatusEn hp(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+
+    y[0] = x[0];
+    y[1] = x[2];
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn jhp(yaflKalmanBaseSt * self, yaflFloat * h, yaflFloat * x)
+{
+    (void)self;
+    (void)x;
+
+    memset(h, 0, sizeof(yaflFloat) * 2 * NX);
+    h[0]      = 1.0;
+    h[NX + 2] = 1.0;
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_EKF_BASE_MEMORY_MIXIN(NX, 1);
+} ekfMemSt;
+
+typedef struct {
+    YAFL_EKF_BASE_MEMORY_MIXIN(NX, 2);
+} ekf2MemSt;
+
+typedef struct {
+    YAFL_UKF_MEMORY_MIXIN(NX, 2);
+    YAFL_UKF_MERWE_MEMORY_MIXIN(NX, 2);
+} ukfMemSt;
+
+static ekfMemSt       ekf_mem;
+static yaflEKFBaseSt  ekf = YAFL_EKF_BASE_INITIALIZER(yafl_test_cv_fx,  \
+                                                      yafl_test_cv_jfx, \
+                                                      hr, jhr, 0,       \
+                                                      NX, 1, ekf_mem);
+
+static ekf2MemSt      ekf2_mem;
+static yaflEKFBaseSt  ekf2 = YAFL_EKF_BASE_INITIALIZER(yafl_test_cv_fx,  \
+                                                       yafl_test_cv_jfx, \
+                                                       hp, jhp, 0,       \
+                                                       NX, 2, ekf2_mem);
+
+static ukfMemSt       ukf_mem;
+static yaflUKFMerweSt ukf_sp = YAFL_UKF_MERWE_INITIALIZER(NX, 0, 0.1, 2.0, \
+                                                          0.0, ukf_mem);
+static yaflUKFSt      ukf = YAFL_UKF_INITIALIZER(&ukf_sp.base,          \
+                                                 &yafl_ukf_merwe_spm,   \
+                                                 yafl_test_cv_fx, 0, 0, \
+                                                 hp, 0, 0,              \
+                                                 NX, 2, ukf_mem);
+
+static yaflKalmanStatsSt stats;
+
+/*---------------------------------------------------------------------------*/
+static void init_kalman(yaflKalmanBaseSt * kf)
+{
+    yaflInt i;
+
+    for (i = 0; i < NX; i++)
+    {
+        kf->x[i]  = 0.0;
+        kf->Dp[i] = 1.0;
+        kf->Dq[i] = 1.0e-3;
+    }
+    kf->x[0] = 10.0;
+    kf->x[2] = 5.0;
+    kf->x[1] = 1.0;
+
+    memset(kf->Up, 0, sizeof(yaflFloat) * NU);
+    memset(kf->Uq, 0, sizeof(yaflFloat) * NU);
+
+    kf->Dr[0] = SIGMA * SIGMA;
+    if (kf->Nz > 1)
+    {
+        kf->Dr[1] = SIGMA * SIGMA;
+        kf->Ur[0] = 0.3; /*Correlated sensor noise*/
+    }
+}
+
+static void true_pos(yaflInt s, yaflFloat * p)
+{
+    p[0] = 10.0 + DT * s + 0.1 * sin(0.05 * s);
+    p[1] = 5.0 + 0.2 * cos(0.03 * s);
+}
+
+/*Dense S, log likelihood and NIS of a range measurement z*/
+static void dense_stats(yaflKalmanBaseSt * kf, yaflFloat z, \
+                        yaflFloat * ll, yaflFloat * nis)
+{
+    yaflFloat a[NX][NX];
+    yaflFloat g[NX];
+    yaflFloat h[NX];
+    yaflFloat y;
+    yaflFloat s;
+    yaflInt i;
+    yaflInt j;
+
+    for (i = 0; i < NX; i++)
+    {
+        for (j = 0; j < NX; j++)
+        {
+            a[i][j] = (i == j) ? 1.0 : \
+                      ((j > i) ? kf->Up[i + ((j - 1) * j) / 2] : 0.0);
+        }
+    }
+
+    hr(kf, &y, kf->x);
+    y = z - y;
+    jhr(kf, h, kf->x);
+
+    /* s = h.dot(U).dot(D).dot(U.T).dot(h.T) + r */
+    s = kf->Dr[0];
+    for (j = 0; j < NX; j++)
+    {
+        g[j] = 0.0;
+        for (i = 0; i < NX; i++)
+        {
+            g[j] += h[i] * a[i][j];
+        }
+        s += g[j] * kf->Dp[j] * g[j];
+    }
+
+    *nis = y * y / s;
+    *ll  = -0.5 * (log(2.0 * M_PI * s) + *nis);
+}
+
+/*P = U.dot(D).dot(U.T)*/
+static void dense_p(yaflKalmanBaseSt * kf, yaflFloat p[NX][NX])
+{
+    yaflInt i;
+    yaflInt j;
+    yaflInt k;
+
+    for (i = 0; i < NX; i++)
+    {
+        for (j = 0; j < NX; j++)
+        {
+            p[i][j] = 0.0;
+            for (k = (i > j) ? i : j; k < NX; k++)
+            {
+                yaflFloat uik = (k == i) ? 1.0 : kf->Up[i + ((k - 1) * k) / 2];
+                yaflFloat ujk = (k == j) ? 1.0 : kf->Up[j + ((k - 1) * k) / 2];
+
+                p[i][j] += uik * kf->Dp[k] * ujk;
+            }
+        }
+    }
+}
+
+/*
+Dense log likelihood and NIS of a position measurement z,
+xu is the exact updated state
+*/
+static void dense_stats2(yaflKalmanBaseSt * kf, yaflFloat * z, \
+                         yaflFloat * ll, yaflFloat * nis, yaflFloat * xu)
+{
+    yaflFloat p[NX][NX];
+    yaflFloat s[2][2];
+    yaflFloat si[2][2];
+    yaflFloat y[2];
+    yaflFloat w[2];
+    yaflFloat u  = kf->Ur[0];
+    yaflFloat r0 = kf->Dr[0];
+    yaflFloat r1 = kf->Dr[1];
+    yaflFloat det;
+    yaflInt i;
+
+    dense_p(kf, p);
+
+    /* S = H.dot(P).dot(H.T) + Ur.dot(Dr).dot(Ur.T), H selects x[0], x[2] */
+    s[0][0] = p[0][0] + r0 + u * u * r1;
+    s[0][1] = p[0][2] + u * r1;
+    s[1][0] = s[0][1];
+    s[1][1] = p[2][2] + r1;
+
+    det = s[0][0] * s[1][1] - s[0][1] * s[1][0];
+    si[0][0] =  s[1][1] / det;
+    si[0][1] = -s[0][1] / det;
+    si[1][0] = -s[1][0] / det;
+    si[1][1] =  s[0][0] / det;
+
+    y[0] = z[0] - kf->x[0];
+    y[1] = z[1] - kf->x[2];
+
+    w[0] = si[0][0] * y[0] + si[0][1] * y[1];
+    w[1] = si[1][0] * y[0] + si[1][1] * y[1];
+
+    *nis = y[0] * w[0] + y[1] * w[1];
+    *ll  = -0.5 * (2.0 * log(2.0 * M_PI) + log(det) + *nis);
+
+    /* xu = x + P.dot(H.T).dot(w) */
+    for (i = 0; i < NX; i++)
+    {
+        xu[i] = kf->x[i] + p[i][0] * w[0] + p[i][2] * w[1];
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+static yaflFloat check_ekf(const char * name, yaflKalmanScalarUpdateP scalar, \
+                           yaflStatusEn * status)
+{
+    yaflFloat diff = 0.0;
+    yaflInt s;
+
+    init_kalman(&ekf.base);
+    *status |= yafl_kalman_set_stats(&ekf.base, &stats);
+
+    for (s = 0; s < STEPS; s++)
+    {
+        yaflFloat p[2];
+        yaflFloat z;
+        yaflFloat ll;
+        yaflFloat nis;
+
+        true_pos(s, p);
+        z = sqrt(p[0] * p[0] + p[1] * p[1]) + 0.05 * sin(0.7 * s);
+
+        *status |= yafl_ekf_base_predict(&ekf.base);
+
+        dense_stats(&ekf.base, z, &ll, &nis);
+        *status |= yafl_ekf_base_update(&ekf.base, &z, scalar);
+
+        diff = fmax(diff, fabs(stats.ll - ll));
+        diff = fmax(diff, fabs(stats.nis - nis));
+        if (1 != stats.n)
+        {
+            diff = 1.0;
+        }
+    }
+
+    printf("%-16s max ll/NIS diff: %.3e\n", name, diff);
+    return diff;
+}
+
+/*Correlated P and R, so H.dot(P).dot(H.T) is not diagonal*/
+static yaflFloat check_ekf2(const char * name, yaflKalmanScalarUpdateP scalar, \
+                            yaflStatusEn * status)
+{
+    yaflFloat diff = 0.0;
+    yaflInt s;
+
+    init_kalman(&ekf2.base);
+    ekf2_mem.Up[1] = 0.9; /* P[0, 2] */
+    *status |= yafl_kalman_set_stats(&ekf2.base, &stats);
+
+    for (s = 0; s < STEPS; s++)
+    {
+        yaflFloat xu[NX];
+        yaflFloat z[2];
+        yaflFloat ll;
+        yaflFloat nis;
+        yaflInt i;
+
+        true_pos(s, z);
+        z[0] += 0.05 * sin(0.7 * s);
+        z[1] -= 0.05 * cos(0.9 * s);
+
+        *status |= yafl_ekf_base_predict(&ekf2.base);
+
+        dense_stats2(&ekf2.base, z, &ll, &nis, xu);
+        *status |= yafl_ekf_base_update(&ekf2.base, z, scalar);
+
+        diff = fmax(diff, fabs(stats.ll - ll));
+        diff = fmax(diff, fabs(stats.nis - nis));
+        for (i = 0; i < NX; i++)
+        {
+            diff = fmax(diff, fabs(ekf2_mem.x[i] - xu[i]));
+        }
+        if (2 != stats.n)
+        {
+            diff = 1.0;
+        }
+    }
+
+    printf("%-16s max ll/NIS/x diff, nz = 2: %.3e\n", name, diff);
+    return diff;
+}
+
+static yaflFloat check_ukf(yaflStatusEn * status)
+{
+    yaflFloat diff = 0.0;
+    yaflInt s;
+
+    init_kalman(&ukf.base.base);
+    yafl_ukf_post_init(&ukf.base);
+    *status |= yafl_kalman_set_stats(&ukf.base.base, &stats);
+
+    for (s = 0; s < STEPS; s++)
+    {
+        yaflFloat z[2];
+        yaflFloat ll  = 0.0;
+        yaflFloat nis = 0.0;
+        yaflInt i;
+
+        true_pos(s, z);
+        z[0] += 0.05 * sin(0.7 * s);
+        z[1] += 0.05 * cos(0.9 * s);
+
+        *status |= yafl_ukf_base_predict(&ukf.base);
+        *status |= yafl_ukf_update(&ukf.base, z);
+
+        /*y is decorrelated by Us, Ds is the diagonal of S*/
+        for (i = 0; i < 2; i++)
+        {
+            yaflFloat e = ukf_mem.y[i] * ukf_mem.y[i] / ukf_mem.Ds[i];
+
+            nis += e;
+            ll  -= 0.5 * (log(2.0 * M_PI * ukf_mem.Ds[i]) + e);
+        }
+
+        diff = fmax(diff, fabs(stats.ll - ll));
+        diff = fmax(diff, fabs(stats.nis - nis));
+        if (2 != stats.n)
+        {
+            diff = 1.0;
+        }
+    }
+
+    printf("%-16s max ll/NIS diff: %.3e\n", "Full UKF", diff);
+    return diff;
+}
+
+/*Returns the time of BENCH updates*/
+static double bench(yaflInt use_loglik, yaflStatusEn * status)
+{
+    struct timespec t0;
+    struct timespec t1;
+    yaflFloat ll = 0.0;
+    yaflInt s;
+
+    init_kalman(&ekf.base);
+    *status |= yafl_kalman_set_stats(&ekf.base, use_loglik ? 0 : &stats);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (s = 0; s < BENCH; s++)
+    {
+        yaflFloat z = 11.0;
+
+        *status |= yafl_ekf_base_predict(&ekf.base);
+        if (use_loglik)
+        {
+            *status |= yafl_imm_ekf_loglik(&ekf.base, &z, &ll);
+        }
+        *status |= yafl_ekf_bierman_update(&ekf, &z);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    return yafl_test_ms(&t0, &t1);
+}
+
+int main(void)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflFloat diff = 0.0;
+    double t_ll;
+    double t_st;
+    int fails;
+
+    diff = fmax(diff, check_ekf("Bierman",  yafl_ekf_bierman_update_scalar, \
+                                &status));
+    diff = fmax(diff, check_ekf("Joseph",   yafl_ekf_joseph_update_scalar,  \
+                                &status));
+    diff = fmax(diff, check_ekf("Rank 1 Joseph", \
+                                yafl_ekf_joseph_r1_update_scalar, &status));
+    diff = fmax(diff, check_ekf2("Bierman",  yafl_ekf_bierman_update_scalar, \
+                                 &status));
+    diff = fmax(diff, check_ekf2("Joseph",   yafl_ekf_joseph_update_scalar,  \
+                                 &status));
+    diff = fmax(diff, check_ekf2("Rank 1 Joseph", \
+                                 yafl_ekf_joseph_r1_update_scalar, &status));
+    diff = fmax(diff, check_ukf(&status));
+
+    t_ll = bench(1, &status);
+    t_st = bench(0, &status);
+    printf("Predict + update with likelihood: yafl_imm_ekf_loglik: %6.1f ms, stats: %6.1f ms\n", \
+           t_ll, t_st);
+
+    printf("Status: 0x%x\n", status);
+
+    fails = (diff > 1.0e-9) || (status >= YAFL_ST_ERR_THR);
+    return yafl_test_report(fails);
+}
@@ -0,0 +1,196 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Batch sigma point callbacks check: a UKF with per point f and h is compared
+bit-for-bit with the same UKF with batch fb and hb, both are timed.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy ukf_batch_check.c ../../src/yafl.c ../../src/yafl_math.c -lm -o ukf_batch_check
+./ukf_batch_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl.h>
+
+#define NX 6
+#define NZ 3
+#define NP (2 * NX + 1)
+
+#define DT 0.1
+
+#define STEPS 20000
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+static void f1(yaflFloat * x)
+{
+    yaflInt i;
+
+    for (i = 0; i < NX; i += 2)
+    {
+        yaflFloat p = x[i];
+        x[i]     += DT * x[i + 1];
+        x[i + 1] -= DT * sin(p);
+    }
+}
+
+static void h1(yaflFloat * y, yaflFloat * x)
+{
+    y[0] = x[0] * x[0] + x[2];
+    y[1] = x[4] + 0.1 * x[1];
+    y[2] = cos(x[3]);
+}
+
+/*Per point callbacks*/
+static yaflStatusEn fx(yaflKalmanBaseSt * self, yaflFloat * x, yaflFloat * xz)
+{
+    (void)self;
+    (void)xz;
+    f1(x);
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn hx(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+    h1(y, x);
+    return YAFL_ST_OK;
+}
+
+/*Batch callbacks*/
+static yaflStatusEn fb(yaflUKFBaseSt * self, yaflFloat * res, \
+                       yaflFloat * sigmas, yaflInt np)
+{
+    yaflInt i;
+
+    (void)self;
+    (void)sigmas; /*In place*/
+
+    for (i = 0; i < np; i++)
+    {
+        f1(res + NX * i);
+    }
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn hb(yaflUKFBaseSt * self, yaflFloat * res, \
+                       yaflFloat * sigmas, yaflInt np)
+{
+    yaflInt i;
+
+    (void)self;
+
+    for (i = 0; i < np; i++)
+    {
+        h1(res + NZ * i, sigmas + NX * i);
+    }
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_UKF_MEMORY_MIXIN(NX, NZ);
+    YAFL_UKF_MERWE_MEMORY_MIXIN(NX, NZ);
+} ukfMemSt;
+
+static ukfMemSt       ukf_mem[2];
+static yaflUKFMerweSt ukf_sp[2];
+static yaflUKFSt      ukf[2];
+
+static void init(yaflInt k)
+{
+    yaflUKFMerweSt tmp_sp = YAFL_UKF_MERWE_INITIALIZER(NX, 0, 0.1, 2.0, 0.0, \
+                                                       ukf_mem[k]);
+    yaflUKFSt tmp = YAFL_UKF_INITIALIZER(&ukf_sp[k].base, &yafl_ukf_merwe_spm, \
+                                         fx, 0, 0, hx, 0, 0, NX, NZ,          \
+                                         ukf_mem[k]);
+    yaflInt i;
+
+    ukf_sp[k] = tmp_sp;
+    ukf[k]    = tmp;
+
+    for (i = 0; i < NX; i++)
+    {
+        ukf_mem[k].x[i]  = 0.1 * (i + 1);
+        ukf_mem[k].Dp[i] = 0.1;
+        ukf_mem[k].Dq[i] = 1.0e-5;
+    }
+
+    memset(ukf_mem[k].Up, 0, sizeof(ukf_mem[k].Up));
+    memset(ukf_mem[k].Uq, 0, sizeof(ukf_mem[k].Uq));
+    memset(ukf_mem[k].Ur, 0, sizeof(ukf_mem[k].Ur));
+
+    for (i = 0; i < NZ; i++)
+    {
+        ukf_mem[k].Dr[i] = 1.0e-3;
+    }
+
+    yafl_ukf_post_init(&ukf[k].base);
+}
+
+static double run(yaflInt k, yaflStatusEn * status)
+{
+    clock_t t;
+    yaflInt s;
+
+    t = clock();
+    for (s = 0; s < STEPS; s++)
+    {
+        yaflFloat z[NZ];
+
+        z[0] = 0.5 * sin(0.01 * s);
+        z[1] = 0.3 + 0.1 * cos(0.02 * s);
+        z[2] = 0.9;
+
+        *status |= yafl_ukf_base_predict(&ukf[k].base);
+        *status |= yafl_ukf_update(&ukf[k].base, z);
+    }
+    return (double)(clock() - t) * 1.0e3 / CLOCKS_PER_SEC;
+}
+
+int main(void)
+{
+    yaflStatusEn st_pp = YAFL_ST_OK;
+    yaflStatusEn st_b  = YAFL_ST_OK;
+    double t_pp;
+    double t_b;
+    int same;
+
+    init(0);
+    init(1);
+    ukf[1].base.fb = fb;
+    ukf[1].base.hb = hb;
+
+    t_pp = run(0, &st_pp);
+    t_b  = run(1, &st_b);
+
+    same = !memcmp(ukf_mem[0].x,  ukf_mem[1].x,  sizeof(ukf_mem[0].x)) && \
+           !memcmp(ukf_mem[0].Up, ukf_mem[1].Up, sizeof(ukf_mem[0].Up)) && \
+           !memcmp(ukf_mem[0].Dp, ukf_mem[1].Dp, sizeof(ukf_mem[0].Dp));
+
+    printf("Per point: %.1f ms, status: 0x%x\n", t_pp, st_pp);
+    printf("Batch:     %.1f ms, status: 0x%x, %s\n", t_b, st_b, \
+           same ? "same" : "DIFFERENT");
+
+    same = same && (st_pp < YAFL_ST_ERR_THR) && (st_b < YAFL_ST_ERR_THR);
+    return yafl_test_report(!same);
+}
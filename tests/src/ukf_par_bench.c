@@ -0,0 +1,193 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Parallel sigma point propagation benchmark: a UKF with expensive process and
+measurement functions (fine step numeric integration) is run with
+sequential propagation and with yafl_sched_parfor on 1..THR_MAX threads,
+the results are compared bit-for-bit.
+
+Build and run:
+gcc -O2 -pthread -I../../src -I../../src/configpy ukf_par_bench.c ../../src/yafl_sched.c ../../src/yafl.c ../../src/yafl_math.c -lm -o ukf_par_bench
+./ukf_par_bench
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl.h>
+#include <yafl_sched.h>
+
+#define NX 8
+#define NZ 2
+
+#define DT    0.1
+#define NSUB  2000 /*Integration substeps, makes f expensive*/
+
+#define STEPS   50
+#define THR_MAX 4
+
+/*---------------------------------------------------------------------------*/
+/*
+Coupled pendulums, the callbacks write their output vectors only,
+so they follow the UKF reentrancy contract.
+*/
+static yaflStatusEn fx(yaflKalmanBaseSt * self, yaflFloat * x, yaflFloat * xz)
+{
+    yaflFloat h = DT / NSUB;
+    yaflInt k;
+
+    (void)self;
+    (void)xz;
+
+    for (k = 0; k < NSUB; k++)
+    {
+        yaflInt i;
+
+        for (i = 0; i < NX; i += 2)
+        {
+            yaflFloat c = 0.05 * (x[(i + 2) % NX] - x[i]);
+            x[i + 1] += h * (c - sin(x[i]));
+            x[i]     += h * x[i + 1];
+        }
+    }
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn hx(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    yaflFloat s = 0.0;
+    yaflInt k;
+
+    (void)self;
+
+    /*Some expensive measurement model*/
+    for (k = 0; k < NSUB; k++)
+    {
+        s += sin(x[0] + 1.0e-4 * k) * cos(x[2]);
+    }
+
+    y[0] = s / NSUB;
+    y[1] = x[4] + 0.1 * x[6] * x[6];
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_UKF_MEMORY_MIXIN(NX, NZ);
+    YAFL_UKF_MERWE_MEMORY_MIXIN(NX, NZ);
+} ukfMemSt;
+
+static ukfMemSt       ukf_mem;
+static yaflUKFMerweSt ukf_sp;
+static yaflUKFSt      ukf;
+
+static void init(void)
+{
+    yaflUKFMerweSt tmp_sp = YAFL_UKF_MERWE_INITIALIZER(NX, 0, 0.1, 2.0, 0.0, \
+                                                       ukf_mem);
+    yaflUKFSt tmp = YAFL_UKF_INITIALIZER(&ukf_sp.base, &yafl_ukf_merwe_spm, \
+                                         fx, 0, 0, hx, 0, 0, NX, NZ, ukf_mem);
+    yaflInt i;
+
+    ukf_sp = tmp_sp;
+    ukf    = tmp;
+
+    for (i = 0; i < NX; i++)
+    {
+        ukf_mem.x[i]  = 0.1 * (i + 1);
+        ukf_mem.Dp[i] = 0.1;
+        ukf_mem.Dq[i] = 1.0e-5;
+    }
+
+    memset(ukf_mem.Up, 0, sizeof(ukf_mem.Up));
+    memset(ukf_mem.Uq, 0, sizeof(ukf_mem.Uq));
+
+    ukf_mem.Dr[0] = 1.0e-3;
+    ukf_mem.Dr[1] = 1.0e-3;
+    ukf_mem.Ur[0] = 0.0;
+
+    yafl_ukf_post_init(&ukf.base);
+}
+
+static double run(yaflStatusEn * status)
+{
+    struct timespec t0;
+    struct timespec t1;
+    yaflInt s;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (s = 0; s < STEPS; s++)
+    {
+        yaflFloat z[NZ];
+
+        z[0] = 0.5 * sin(0.1 * s);
+        z[1] = 0.3 + 0.01 * s;
+
+        *status |= yafl_ukf_base_predict(&ukf.base);
+        *status |= yafl_ukf_update(&ukf.base, z);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    return (t1.tv_sec - t0.tv_sec) * 1.0e3 + (t1.tv_nsec - t0.tv_nsec) * 1.0e-6;
+}
+
+int main(void)
+{
+    static yaflSchedSt sched;
+    yaflFloat ref[NX];
+    yaflFloat ref_d[NX];
+    yaflStatusEn status = YAFL_ST_OK;
+    double t_seq;
+    yaflInt nthr;
+    int fails = 0;
+
+    init();
+    t_seq = run(&status);
+    memcpy(ref,   ukf_mem.x,  sizeof(ref));
+    memcpy(ref_d, ukf_mem.Dp, sizeof(ref_d));
+    printf("Sequential: %.1f ms, status: 0x%x\n", t_seq, status);
+    fails += status >= YAFL_ST_ERR_THR;
+
+    for (nthr = 1; nthr <= THR_MAX; nthr++)
+    {
+        double t;
+        int same;
+
+        init();
+        yafl_sched_init(&sched, nthr, 0, 0, 0, 0, 1);
+        ukf.base.pfor     = yafl_sched_parfor;
+        ukf.base.pfor_ctx = &sched;
+
+        status = YAFL_ST_OK;
+        t = run(&status);
+
+        yafl_sched_deinit(&sched);
+
+        same = !memcmp(ref, ukf_mem.x, sizeof(ref)) && \
+               !memcmp(ref_d, ukf_mem.Dp, sizeof(ref_d));
+
+        printf("%d threads: %.1f ms, speedup: %.2f, status: 0x%x, %s\n", nthr, \
+               t, t_seq / t, status, same ? "same" : "DIFFERENT");
+
+        fails += !same || (status >= YAFL_ST_ERR_THR);
+    }
+
+    printf("%s\n", fails ? "FAILED" : "PASSED");
+    return fails;
+}
@@ -0,0 +1,246 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Parallel sigma point propagation check: a Merwe UKF with full and Bierman
+updates is run with sequential propagation and with pfor set to:
+- yafl_sched_parfor on 1..THR_MAX threads,
+- a sequential loop which calls the bodies in reverse order,
+x, Up and Dp must be the same bit-for-bit. The reverse order loop checks
+that the results do not depend on the body call order on any machine,
+the thread pool runs need several CPUs to really run the bodies
+concurrently, see ukf_par_bench.c for the timings.
+
+Build and run:
+gcc -O2 -pthread -I../../src -I../../src/configpy ukf_par_check.c ../../src/yafl_sched.c ../../src/yafl.c ../../src/yafl_math.c -lm -o ukf_par_check
+./ukf_par_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <yafl.h>
+#include <yafl_sched.h>
+
+#define NX 8
+#define NZ 2
+
+#define DT    0.1
+#define NSUB  20 /*Integration substeps*/
+
+#define STEPS   50
+#define THR_MAX 4
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+/*Coupled pendulums, the callbacks write their output vectors only*/
+static yaflStatusEn fx(yaflKalmanBaseSt * self, yaflFloat * x, yaflFloat * xz)
+{
+    yaflFloat h = DT / NSUB;
+    yaflInt k;
+
+    (void)self;
+    (void)xz;
+
+    for (k = 0; k < NSUB; k++)
+    {
+        yaflInt i;
+
+        for (i = 0; i < NX; i += 2)
+        {
+            yaflFloat c = 0.05 * (x[(i + 2) % NX] - x[i]);
+            x[i + 1] += h * (c - sin(x[i]));
+            x[i]     += h * x[i + 1];
+        }
+    }
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn hx(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+
+    y[0] = sin(x[0]) * cos(x[2]);
+    y[1] = x[4] + 0.1 * x[6] * x[6];
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/*Sequential loop in reverse order, counts the calls*/
+static yaflInt rev_calls;
+
+static yaflStatusEn rev_pfor(void * ctx, yaflInt n, yaflUKFParForBodyP body, \
+                             void * arg)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt i;
+
+    (void)ctx;
+
+    for (i = n - 1; i >= 0; i--)
+    {
+        status |= body(arg, i);
+    }
+    rev_calls++;
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_UKF_MEMORY_MIXIN(NX, NZ);
+    YAFL_UKF_MERWE_MEMORY_MIXIN(NX, NZ);
+} ukfMemSt;
+
+static ukfMemSt       ukf_mem;
+static yaflUKFMerweSt ukf_sp;
+static yaflUKFSt      ukf;
+
+static void init(void)
+{
+    yaflUKFMerweSt tmp_sp = YAFL_UKF_MERWE_INITIALIZER(NX, 0, 0.1, 2.0, 0.0, \
+                                                       ukf_mem);
+    yaflUKFSt tmp = YAFL_UKF_INITIALIZER(&ukf_sp.base, &yafl_ukf_merwe_spm, \
+                                         fx, 0, 0, hx, 0, 0, NX, NZ, ukf_mem);
+    yaflInt i;
+
+    ukf_sp = tmp_sp;
+    ukf    = tmp;
+
+    for (i = 0; i < NX; i++)
+    {
+        ukf_mem.x[i]  = 0.1 * (i + 1);
+        ukf_mem.Dp[i] = 0.1;
+        ukf_mem.Dq[i] = 1.0e-5;
+    }
+
+    memset(ukf_mem.Up, 0, sizeof(ukf_mem.Up));
+    memset(ukf_mem.Uq, 0, sizeof(ukf_mem.Uq));
+
+    ukf_mem.Dr[0] = 1.0e-3;
+    ukf_mem.Dr[1] = 1.0e-3;
+    ukf_mem.Ur[0] = 0.2;
+
+    yafl_ukf_post_init(&ukf.base);
+}
+
+/*Full UKF updates if full is nonzero, Bierman updates otherwise*/
+static void run(yaflInt full, yaflStatusEn * status)
+{
+    yaflInt s;
+
+    for (s = 0; s < STEPS; s++)
+    {
+        yaflFloat z[NZ];
+
+        z[0] = 0.5 * sin(0.1 * s);
+        z[1] = 0.3 + 0.01 * s;
+
+        *status |= yafl_ukf_base_predict(&ukf.base);
+        if (full)
+        {
+            *status |= yafl_ukf_update(&ukf.base, z);
+        }
+        else
+        {
+            *status |= yafl_ukf_bierman_update(&ukf.base, z);
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+static int check(yaflInt full)
+{
+    static yaflSchedSt sched;
+    const char * name = full ? "Full UKF" : "Bierman UKF";
+    yaflFloat ref_x[NX];
+    yaflFloat ref_u[(NX * (NX - 1)) / 2];
+    yaflFloat ref_d[NX];
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt nthr;
+    int fails = 0;
+
+    init();
+    run(full, &status);
+    memcpy(ref_x, ukf_mem.x,  sizeof(ref_x));
+    memcpy(ref_u, ukf_mem.Up, sizeof(ref_u));
+    memcpy(ref_d, ukf_mem.Dp, sizeof(ref_d));
+    fails += status >= YAFL_ST_ERR_THR;
+
+    /*nthr == 0 is the reverse order loop*/
+    for (nthr = 0; nthr <= THR_MAX; nthr++)
+    {
+        yaflStatusEn st_s = YAFL_ST_OK;
+        int same;
+
+        init();
+        status = YAFL_ST_OK;
+        if (nthr)
+        {
+            st_s = yafl_sched_init(&sched, nthr, 0, 0, 0, 0, 0);
+            ukf.base.pfor     = yafl_sched_parfor;
+            ukf.base.pfor_ctx = &sched;
+        }
+        else
+        {
+            rev_calls = 0;
+            ukf.base.pfor     = rev_pfor;
+            ukf.base.pfor_ctx = 0;
+        }
+
+        run(full, &status);
+
+        if (nthr)
+        {
+            st_s |= yafl_sched_deinit(&sched);
+        }
+        else
+        {
+            /*Every predict and update propagates the sigma points*/
+            fails += rev_calls < 2 * STEPS;
+        }
+
+        same = !memcmp(ref_x, ukf_mem.x,  sizeof(ref_x)) && \
+               !memcmp(ref_u, ukf_mem.Up, sizeof(ref_u)) && \
+               !memcmp(ref_d, ukf_mem.Dp, sizeof(ref_d));
+
+        if (nthr)
+        {
+            printf("%-12s %d threads:     status: 0x%x/0x%x, %s\n", name, \
+                   nthr, status, st_s, same ? "same" : "DIFFERENT");
+        }
+        else
+        {
+            printf("%-12s reverse order: status: 0x%x, %s\n", name, \
+                   status, same ? "same" : "DIFFERENT");
+        }
+
+        fails += !same || (status >= YAFL_ST_ERR_THR) || \
+                 (st_s >= YAFL_ST_ERR_THR);
+    }
+    return fails;
+}
+
+int main(void)
+{
+    int fails = 0;
+
+    fails += check(1);
+    fails += check(0);
+
+    return yafl_test_report(fails);
+}
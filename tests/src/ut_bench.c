@@ -0,0 +1,166 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Unscented transform modes benchmark: YAFL_UKF_UT_SEQ vs YAFL_UKF_UT_MWGSU.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy ut_bench.c ../../src/yafl.c ../../src/yafl_math.c -lm -o ut_bench
+./ut_bench
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl.h>
+
+#define NZ 3
+
+static yaflStatusEn fx(yaflKalmanBaseSt * self, yaflFloat * x, yaflFloat * xz)
+{
+    yaflInt i;
+    yaflFloat x0;
+
+    (void)xz;
+
+    x0 = x[0];
+    for (i = 0; i < self->Nx - 1; i++)
+    {
+        x[i] += 0.1 * x[i + 1] + 0.01 * sin(x[i]);
+    }
+    x[i] += 0.1 * x0 + 0.01 * sin(x[i]);
+    return YAFL_ST_OK;
+}
+
+static yaflStatusEn hx(yaflKalmanBaseSt * self, yaflFloat * y, yaflFloat * x)
+{
+    yaflInt i;
+
+    (void)self;
+
+    for (i = 0; i < NZ; i++)
+    {
+        y[i] = x[i] + 0.1 * x[i + 1] * x[i + 1];
+    }
+    return YAFL_ST_OK;
+}
+
+/*Runs n predict/update steps, returns mean step time in ns*/
+static double run(yaflUKFSt * kf, yaflInt n, yaflUKFUTModeEn mode)
+{
+    yaflKalmanBaseSt * kb;
+    clock_t t;
+    yaflInt s;
+    yaflInt i;
+
+    kb = (yaflKalmanBaseSt *)kf;
+    kf->base.ut_mode = mode;
+
+    for (i = 0; i < kb->Nx; i++)
+    {
+        kb->x[i]  = 0.1 * i;
+        kb->Dp[i] = 1.0;
+        kb->Dq[i] = 1.0e-3;
+    }
+    memset(kb->Up, 0, sizeof(yaflFloat) * ((kb->Nx * (kb->Nx - 1)) / 2));
+
+    for (i = 0; i < NZ; i++)
+    {
+        kb->Dr[i] = 0.01;
+    }
+
+    t = clock();
+    for (s = 0; s < n; s++)
+    {
+        yaflFloat z[NZ];
+
+        yafl_ukf_predict(kf);
+        for (i = 0; i < NZ; i++)
+        {
+            z[i] = sin(0.1 * s + i);
+        }
+        yafl_ukf_update(&kf->base, z);
+    }
+    return (double)(clock() - t) / CLOCKS_PER_SEC / n * 1.0e9;
+}
+
+static void report(yaflUKFSt * kf, yaflInt n)
+{
+    yaflKalmanBaseSt * kb;
+    yaflFloat x[64];
+    yaflFloat diff;
+    double t_seq;
+    double t_mwgsu;
+    yaflInt i;
+
+    kb = (yaflKalmanBaseSt *)kf;
+
+    t_seq   = run(kf, n, YAFL_UKF_UT_SEQ);
+    t_mwgsu = run(kf, n, YAFL_UKF_UT_MWGSU);
+
+    /*The test system is unstable, so compare modes on short runs*/
+    run(kf, 10, YAFL_UKF_UT_SEQ);
+    memcpy(x, kb->x, sizeof(yaflFloat) * kb->Nx);
+
+    run(kf, 10, YAFL_UKF_UT_MWGSU);
+
+    for (diff = 0.0, i = 0; i < kb->Nx; i++)
+    {
+        yaflFloat e = fabs((kb->x[i] - x[i]) / x[i]);
+        diff = (e > diff) ? e : diff;
+    }
+
+    printf("%4d  %9.1f  %9.1f  %7.2f  %.3e\n", kb->Nx, t_seq, t_mwgsu, \
+           t_seq / t_mwgsu, diff);
+}
+
+#define BENCH(nx)                                                              \
+static struct {                                                                \
+    YAFL_UKF_MEMORY_MIXIN(nx, NZ);                                             \
+    YAFL_UKF_MERWE_MEMORY_MIXIN(nx, NZ);                                       \
+} mem_##nx;                                                                    \
+                                                                               \
+static yaflUKFMerweSt sp_##nx = YAFL_UKF_MERWE_INITIALIZER(nx, 0, 0.1, 2.0,    \
+                                                           0.0, mem_##nx);     \
+                                                                               \
+static yaflUKFSt kf_##nx = YAFL_UKF_INITIALIZER(&sp_##nx.base,                 \
+                                                &yafl_ukf_merwe_spm, fx, 0, 0, \
+                                                hx, 0, 0, nx, NZ, mem_##nx);   \
+                                                                               \
+static void bench_##nx(void)                                                   \
+{                                                                              \
+    yafl_ukf_post_init(&kf_##nx.base);                                         \
+    report(&kf_##nx, 2000000 / (nx * nx * nx) + 20);                           \
+}
+
+BENCH(4)
+BENCH(8)
+BENCH(16)
+BENCH(32)
+BENCH(64)
+
+int main(void)
+{
+    printf("  nx   seq, ns  mwgsu, ns  speedup  max x rel diff\n");
+    bench_4();
+    bench_8();
+    bench_16();
+    bench_32();
+    bench_64();
+    return 0;
+}
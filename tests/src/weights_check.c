@@ -0,0 +1,148 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Sigma point weight cache check: the weights must be computed once
+and then only after yafl_ukf_sigma_touch, and a filter with changed
+parameters must give the same results as a filter created with them.
+
+Build and run:
+gcc -O2 -I../../src -I../../src/configpy weights_check.c ../../src/yafl.c ../../src/yafl_math.c -lm -o weights_check
+./weights_check
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <yafl.h>
+
+#define NX 4
+#define NZ 2
+
+#define STEPS 100
+
+#include "yafl_test.h"
+
+/*---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+/*Counts weight computations*/
+static yaflInt n_wf;
+
+static yaflStatusEn wf(yaflUKFBaseSt * self)
+{
+    n_wf++;
+    return yafl_ukf_merwe_spm.wf(self);
+}
+
+static yaflUKFSigmaMethodsSt spm;
+
+/*---------------------------------------------------------------------------*/
+typedef struct {
+    YAFL_UKF_MEMORY_MIXIN(NX, NZ);
+    YAFL_UKF_MERWE_MEMORY_MIXIN(NX, NZ);
+} ukfMemSt;
+
+static ukfMemSt       ukf_mem[2];
+static yaflUKFMerweSt ukf_sp[2];
+static yaflUKFSt      ukf[2];
+
+static void init(yaflInt k, yaflFloat alpha)
+{
+    yaflUKFMerweSt tmp_sp = YAFL_UKF_MERWE_INITIALIZER(NX, 0, alpha, 2.0, 0.0, \
+                                                       ukf_mem[k]);
+    yaflUKFSt tmp = YAFL_UKF_INITIALIZER(&ukf_sp[k].base, &spm, \
+                                         yafl_test_nl_fx, 0, 0, \
+                                         yafl_test_nl_hx, 0, 0, \
+                                         NX, NZ, ukf_mem[k]);
+    yaflInt i;
+
+    ukf_sp[k] = tmp_sp;
+    ukf[k]    = tmp;
+
+    for (i = 0; i < NX; i++)
+    {
+        ukf_mem[k].x[i]  = 0.1 * (i + 1);
+        ukf_mem[k].Dp[i] = 0.1;
+        ukf_mem[k].Dq[i] = 1.0e-4;
+    }
+
+    memset(ukf_mem[k].Up, 0, sizeof(ukf_mem[k].Up));
+    memset(ukf_mem[k].Uq, 0, sizeof(ukf_mem[k].Uq));
+
+    ukf_mem[k].Dr[0] = 1.0e-2;
+    ukf_mem[k].Dr[1] = 1.0e-2;
+    ukf_mem[k].Ur[0] = 0.0;
+
+    yafl_ukf_post_init(&ukf[k].base);
+}
+
+static yaflStatusEn run(yaflInt k, yaflInt s0, yaflInt s1)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt s;
+
+    for (s = s0; s < s1; s++)
+    {
+        yaflFloat z[NZ];
+
+        z[0] = 0.3 * sin(0.05 * s);
+        z[1] = 0.2 + 0.01 * s;
+
+        status |= yafl_ukf_base_predict(&ukf[k].base);
+        status |= yafl_ukf_update(&ukf[k].base, z);
+    }
+    return status;
+}
+
+int main(void)
+{
+    yaflStatusEn status = YAFL_ST_OK;
+    yaflInt n_run;
+    int fails = 0;
+    int same;
+
+    spm.wf   = wf;
+    spm.spgf = yafl_ukf_merwe_spm.spgf;
+
+    /*Reference: alpha = 0.5 from the start*/
+    init(1, 0.5);
+
+    /*alpha = 0.1 for the first half, then 0.5*/
+    init(0, 0.1);
+    n_wf = 0;
+    status |= run(0, 0, STEPS / 2);
+    n_run = n_wf;
+
+    ukf_sp[0].alpha = 0.5;
+    yafl_ukf_sigma_touch(&ukf_sp[0].base);
+    status |= run(0, STEPS / 2, STEPS);
+
+    printf("Weight computations in %d steps: %d, after touch: %d\n", \
+           STEPS / 2, n_run, n_wf - n_run);
+    fails += (0 != n_run) || (1 != n_wf - n_run);
+
+    /*The weights must be the same as the reference ones*/
+    same = !memcmp(ukf_mem[0].wm, ukf_mem[1].wm, sizeof(ukf_mem[0].wm)) && \
+           !memcmp(ukf_mem[0].wc, ukf_mem[1].wc, sizeof(ukf_mem[0].wc));
+    printf("Weights after touch: %s\n", same ? "same" : "DIFFERENT");
+    fails += !same;
+
+    printf("Status: 0x%x\n", status);
+    fails += status >= YAFL_ST_ERR_THR;
+
+    return yafl_test_report(fails);
+}
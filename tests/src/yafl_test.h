@@ -0,0 +1,212 @@
+/*******************************************************************************
+    Copyright 2020 anonimous <shkolnick-kun@gmail.com> and contributors.
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+
+    See the License for the specific language governing permissions
+    and limitations under the License.
+******************************************************************************/
+/*
+Shared test models and harness for the *_check.c programs.
+
+Include after the check parameters: the constant velocity and constant
+acceleration models need DT, the constant acceleration model also needs NX
+(the states past the 3 axes are kept constant). The nonlinear model has
+a fixed 0.1 step.
+
+Build and run all checks:
+make check
+*/
+#ifndef YAFL_TEST_H
+#define YAFL_TEST_H
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <yafl.h>
+
+/*---------------------------------------------------------------------------*/
+/*Prints the verdict, the result is the exit code of the check*/
+static inline int yafl_test_report(int fails)
+{
+    printf("%s\n", fails ? "FAILED" : "PASSED");
+    return fails ? 1 : 0;
+}
+
+static inline double yafl_test_ms(struct timespec * t0, struct timespec * t1)
+{
+    return (t1->tv_sec - t0->tv_sec) * 1.0e3 + \
+           (t1->tv_nsec - t0->tv_nsec) * 1.0e-6;
+}
+
+/*Sets the leading nx*nx block of the nx*2nx EKF W scratchpad to identity*/
+static inline void yafl_test_eye(yaflInt nx, yaflFloat * w)
+{
+    yaflInt i;
+
+    for (i = 0; i < nx; i++)
+    {
+        yaflInt j;
+
+        for (j = 0; j < nx; j++)
+        {
+            w[2 * nx * i + j] = (i == j) ? 1.0 : 0.0;
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*2D constant velocity: x = (px, vx, py, vy), z = (px, py)*/
+#define YAFL_TEST_CV_NX 4
+#define YAFL_TEST_CV_NZ 2
+
+#ifdef DT
+static inline yaflStatusEn yafl_test_cv_fx(yaflKalmanBaseSt * self, \
+                                           yaflFloat * x, yaflFloat * xz)
+{
+    (void)self;
+    (void)xz;
+
+    x[0] += DT * x[1];
+    x[2] += DT * x[3];
+    return YAFL_ST_OK;
+}
+
+static inline yaflStatusEn yafl_test_cv_jfx(yaflKalmanBaseSt * self, \
+                                            yaflFloat * w, yaflFloat * x)
+{
+    (void)self;
+    (void)x;
+
+    yafl_test_eye(YAFL_TEST_CV_NX, w);
+    w[1]                           = DT;
+    w[2 * YAFL_TEST_CV_NX * 2 + 3] = DT;
+    return YAFL_ST_OK;
+}
+#endif/*DT*/
+
+static inline yaflStatusEn yafl_test_cv_hx(yaflKalmanBaseSt * self, \
+                                           yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+
+    y[0] = x[0];
+    y[1] = x[2];
+    return YAFL_ST_OK;
+}
+
+static inline yaflStatusEn yafl_test_cv_jhx(yaflKalmanBaseSt * self, \
+                                            yaflFloat * h, yaflFloat * x)
+{
+    (void)self;
+    (void)x;
+
+    memset(h, 0, sizeof(yaflFloat) * YAFL_TEST_CV_NZ * YAFL_TEST_CV_NX);
+    h[0]                   = 1.0;
+    h[YAFL_TEST_CV_NX + 2] = 1.0;
+    return YAFL_ST_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/*3 axis constant acceleration: axis k is x[3k .. 3k + 2]*/
+#if defined(DT) && defined(NX)
+static inline yaflStatusEn yafl_test_ca_fx(yaflKalmanBaseSt * self, \
+                                           yaflFloat * x, yaflFloat * xz)
+{
+    yaflInt k;
+
+    (void)self;
+    (void)xz;
+
+    for (k = 0; k < 3; k++)
+    {
+        x[3 * k]     += DT * x[3 * k + 1] + 0.5 * DT * DT * x[3 * k + 2];
+        x[3 * k + 1] += DT * x[3 * k + 2];
+    }
+    return YAFL_ST_OK;
+}
+
+static inline yaflStatusEn yafl_test_ca_jfx(yaflKalmanBaseSt * self, \
+                                            yaflFloat * w, yaflFloat * x)
+{
+    yaflInt k;
+
+    (void)self;
+    (void)x;
+
+    yafl_test_eye(NX, w);
+    for (k = 0; k < 3; k++)
+    {
+        w[2 * NX * (3 * k) + 3 * k + 1]     = DT;
+        w[2 * NX * (3 * k) + 3 * k + 2]     = 0.5 * DT * DT;
+        w[2 * NX * (3 * k + 1) + 3 * k + 2] = DT;
+    }
+    return YAFL_ST_OK;
+}
+#endif/*defined(DT) && defined(NX)*/
+
+/*---------------------------------------------------------------------------*/
+/*Nonlinear 4 state model with nonlinear position sensor*/
+#define YAFL_TEST_NL_NX 4
+#define YAFL_TEST_NL_NZ 2
+
+static inline yaflStatusEn yafl_test_nl_fx(yaflKalmanBaseSt * self, \
+                                           yaflFloat * x, yaflFloat * xz)
+{
+    (void)self;
+    (void)xz;
+
+    x[0] += 0.1 * x[1];
+    x[1] -= 0.1 * sin(x[0]);
+    x[2] += 0.1 * x[3];
+    return YAFL_ST_OK;
+}
+
+static inline yaflStatusEn yafl_test_nl_jfx(yaflKalmanBaseSt * self, \
+                                            yaflFloat * w, yaflFloat * x)
+{
+    (void)self;
+
+    yafl_test_eye(YAFL_TEST_NL_NX, w);
+
+    /*x[0] was updated before x[1]*/
+    w[1]                           = 0.1;
+    w[2 * YAFL_TEST_NL_NX]         = -0.1 * cos(x[0]);
+    w[2 * YAFL_TEST_NL_NX + 1]     = 1.0 - 0.01 * cos(x[0]);
+    w[2 * YAFL_TEST_NL_NX * 2 + 3] = 0.1;
+    return YAFL_ST_OK;
+}
+
+static inline yaflStatusEn yafl_test_nl_hx(yaflKalmanBaseSt * self, \
+                                           yaflFloat * y, yaflFloat * x)
+{
+    (void)self;
+
+    y[0] = x[0] + 0.1 * x[2] * x[2];
+    y[1] = x[2];
+    return YAFL_ST_OK;
+}
+
+static inline yaflStatusEn yafl_test_nl_jhx(yaflKalmanBaseSt * self, \
+                                            yaflFloat * h, yaflFloat * x)
+{
+    (void)self;
+
+    memset(h, 0, sizeof(yaflFloat) * YAFL_TEST_NL_NZ * YAFL_TEST_NL_NX);
+    h[0]                   = 1.0;
+    h[2]                   = 0.2 * x[2];
+    h[YAFL_TEST_NL_NX + 2] = 1.0;
+    return YAFL_ST_OK;
+}
+
+#endif/*YAFL_TEST_H*/